@@ -278,8 +278,9 @@ applier_join(struct applier *applier)
 	struct ev_io *coio = &applier->io;
 	struct ibuf *ibuf = &applier->ibuf;
 	struct xrow_header row;
-	xrow_encode_join_xc(&row, &INSTANCE_UUID);
+	xrow_encode_join_xc(&row, &INSTANCE_UUID, replication_join_files);
 	coio_write_xrow(coio, &row);
+	applier->join_files = false;
 
 	/**
 	 * Tarantool < 1.7.0: if JOIN is successful, there is no "OK"
@@ -298,9 +299,13 @@ applier_join(struct applier *applier)
 		 * Start vclock. The vclock of the checkpoint
 		 * the master is sending to the replica.
 		 * Used to initialize the replica's initial
-		 * vclock in bootstrap_from_master()
+		 * vclock in bootstrap_from_master().
+		 *
+		 * Masters that don't know about file-level
+		 * JOIN don't set the flag and send rows.
 		 */
-		xrow_decode_vclock_xc(&row, &replicaset.vclock);
+		xrow_decode_join_response_xc(&row, &replicaset.vclock,
+					     &applier->join_files);
 	}
 
 	applier_set_state(applier, APPLIER_INITIAL_JOIN);
@@ -317,6 +322,9 @@ applier_join(struct applier *applier)
 			xstream_write_xc(applier->join_stream, &row);
 			if (++row_count % 100000 == 0)
 				say_info("%.1fM rows received", row_count / 1e6);
+		} else if (row.type == IPROTO_FILE_CHUNK &&
+			   applier->join_files) {
+			xstream_write_xc(applier->join_stream, &row);
 		} else if (row.type == IPROTO_OK) {
 			if (applier->version_id < version_id(1, 7, 0)) {
 				/*
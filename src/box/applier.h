@@ -96,6 +96,11 @@ struct applier {
 	uint32_t version_id;
 	/** Remote ballot at the time of connect. */
 	struct ballot ballot;
+	/**
+	 * Set if the master agreed to send initial JOIN data
+	 * as checkpoint files, see replication_join_files.
+	 */
+	bool join_files;
 	/** Remote address */
 	union {
 		struct sockaddr addr;
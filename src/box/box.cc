@@ -30,6 +30,8 @@
  */
 #include "box/box.h"
 
+#include <fcntl.h>
+
 #include "trivia/config.h"
 
 #include "lua/utils.h" /* lua_hash() */
@@ -60,6 +62,7 @@
 #include "user.h"
 #include "cfg.h"
 #include "coio.h"
+#include "coio_file.h"
 #include "replication.h" /* replica */
 #include "title.h"
 #include "xrow.h"
@@ -69,6 +72,8 @@
 #include "path_lock.h"
 #include "gc.h"
 #include "sql.h"
+#include "sql_stmt_cache.h"
+#include "execute.h"
 #include "systemd.h"
 #include "call.h"
 #include "func.h"
@@ -349,10 +354,193 @@ wal_stream_create(struct wal_stream *ctx, size_t wal_max_rows)
 	ctx->yield = (wal_max_rows >> 4)  + 1;
 }
 
+/**
+ * Return the directory where the engine with the given name
+ * stores its checkpoint files or NULL if the engine doesn't
+ * store anything on disk.
+ */
+static const char *
+box_engine_dir(const char *engine_name)
+{
+	if (strcmp(engine_name, "memtx") == 0)
+		return cfg_gets("memtx_dir");
+	if (strcmp(engine_name, "vinyl") == 0)
+		return cfg_gets("vinyl_dir");
+	return NULL;
+}
+
+/**
+ * Checkpoint file being received from the master by
+ * file-level initial join.
+ */
+struct join_file {
+	/** Descriptor of the file being written or -1. */
+	int fd;
+	/** Number of bytes written so far. */
+	uint64_t size;
+	/** Path to the file. */
+	char path[PATH_MAX];
+};
+
+static struct join_file join_file = { -1, 0, "" };
+
+/**
+ * Create a file for a checkpoint file received from the master.
+ * The file is written under a temporary name and renamed once
+ * all its contents have been received.
+ */
+static int
+join_file_open(const struct file_chunk *chunk)
+{
+	assert(join_file.fd < 0);
+	/* "<engine>/<path relative to the engine directory>" */
+	const char *name = chunk->name;
+	const char *name_end = chunk->name + chunk->name_len;
+	const char *sep = (const char *)memchr(name, '/', chunk->name_len);
+	if (sep == NULL || sep - name > ENGINE_NAME_MAX ||
+	    memmem(sep, name_end - sep, "/..", 3) != NULL) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "invalid FILE_NAME");
+		return -1;
+	}
+	char engine_name[ENGINE_NAME_MAX + 1];
+	memcpy(engine_name, name, sep - name);
+	engine_name[sep - name] = '\0';
+	const char *dir = box_engine_dir(engine_name);
+	if (dir == NULL) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "invalid FILE_NAME");
+		return -1;
+	}
+	int len = snprintf(join_file.path, sizeof(join_file.path), "%s/%.*s",
+			   dir, (int)(name_end - sep - 1), sep + 1);
+	if (len >= (int)sizeof(join_file.path)) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "invalid FILE_NAME");
+		return -1;
+	}
+
+	/* Create the directory hierarchy, e.g. for vinyl runs. */
+	char *path_sep = join_file.path;
+	while (*path_sep == '/') {
+		/* Don't create root */
+		++path_sep;
+	}
+	while ((path_sep = strchr(path_sep, '/')) != NULL) {
+		*path_sep = '\0';
+		if (coio_mkdir(join_file.path, 0777) != 0 && errno != EEXIST) {
+			diag_set(SystemError, "failed to create directory '%s'",
+				 join_file.path);
+			*path_sep = '/';
+			return -1;
+		}
+		*path_sep = '/';
+		++path_sep;
+	}
+
+	const char *tmp_path = tt_sprintf("%s%s", join_file.path,
+					  inprogress_suffix);
+	join_file.fd = coio_file_open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC,
+				      0644);
+	if (join_file.fd < 0) {
+		diag_set(SystemError, "failed to create file '%s'", tmp_path);
+		return -1;
+	}
+	join_file.size = 0;
+	say_verbose("receiving file '%s'", join_file.path);
+	return 0;
+}
+
+/** Flush a received checkpoint file to disk and make it visible. */
+static int
+join_file_close(void)
+{
+	int fd = join_file.fd;
+	join_file.fd = -1;
+	const char *tmp_path = tt_sprintf("%s%s", join_file.path,
+					  inprogress_suffix);
+	if (coio_fsync(fd) != 0) {
+		diag_set(SystemError, "failed to sync file '%s'", tmp_path);
+		coio_file_close(fd);
+		return -1;
+	}
+	coio_file_close(fd);
+	if (coio_rename(tmp_path, join_file.path) != 0) {
+		diag_set(SystemError, "failed to rename '%s'", tmp_path);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Write a chunk of a checkpoint file received from the master
+ * to disk. Snapshot and vylog files are stamped with our own
+ * instance UUID, because they are indexed along with the files
+ * written by this instance.
+ */
+static int
+apply_initial_join_file_chunk(struct xrow_header *row)
+{
+	struct file_chunk chunk;
+	if (xrow_decode_file_chunk(row, &chunk) != 0)
+		return -1;
+	size_t region_svp = region_used(&fiber()->gc);
+	bool is_first_chunk = join_file.fd < 0;
+	if (is_first_chunk && join_file_open(&chunk) != 0)
+		return -1;
+	if (join_file.size + chunk.data_len > chunk.file_size) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "invalid FILE_SIZE");
+		goto fail;
+	}
+
+	const char *data;
+	data = chunk.data;
+	const char *ext;
+	ext = strrchr(join_file.path, '.');
+	if (is_first_chunk && ext != NULL &&
+	    (strcmp(ext, ".snap") == 0 || strcmp(ext, ".vylog") == 0)) {
+		/* Don't modify the input buffer, patch a copy. */
+		char *buf = (char *)region_alloc(&fiber()->gc, chunk.data_len);
+		if (buf == NULL) {
+			diag_set(OutOfMemory, chunk.data_len,
+				 "region", "file chunk");
+			goto fail;
+		}
+		memcpy(buf, chunk.data, chunk.data_len);
+		if (xlog_meta_set_instance_uuid(buf, chunk.data_len,
+						&INSTANCE_UUID) != 0)
+			goto fail;
+		data = buf;
+	}
+	for (uint32_t written = 0; written < chunk.data_len; ) {
+		ssize_t n = coio_pwrite(join_file.fd, data + written,
+					chunk.data_len - written,
+					join_file.size + written);
+		if (n < 0) {
+			diag_set(SystemError, "failed to write file '%s%s'",
+				 join_file.path, inprogress_suffix);
+			goto fail;
+		}
+		written += n;
+	}
+	region_truncate(&fiber()->gc, region_svp);
+	join_file.size += chunk.data_len;
+	if (join_file.size == chunk.file_size)
+		return join_file_close();
+	return 0;
+fail:
+	region_truncate(&fiber()->gc, region_svp);
+	coio_file_close(join_file.fd);
+	join_file.fd = -1;
+	return -1;
+}
+
 static void
 apply_initial_join_row(struct xstream *stream, struct xrow_header *row)
 {
 	(void) stream;
+	if (row->type == IPROTO_FILE_CHUNK) {
+		if (apply_initial_join_file_chunk(row) != 0)
+			diag_raise();
+		return;
+	}
 	struct request request;
 	xrow_decode_dml_xc(row, &request, dml_request_key_map(row->type));
 	struct space *space = space_cache_find_xc(request.space_id);
@@ -481,6 +669,40 @@ box_check_replication_sync_timeout(void)
 	return timeout;
 }
 
+static double
+box_check_net_cursor_timeout(void)
+{
+	double timeout = cfg_getd("net_cursor_timeout");
+	if (timeout <= 0) {
+		tnt_raise(ClientError, ER_CFG, "net_cursor_timeout",
+			  "the value must be greater than 0");
+	}
+	return timeout;
+}
+
+static int
+box_check_sql_aggregate_threads(void)
+{
+	int count = cfg_geti("sql_aggregate_threads");
+	if (count < 1 || count > SQL_AGGREGATE_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "sql_aggregate_threads",
+			  tt_sprintf("the value must be between 1 and %d",
+				     SQL_AGGREGATE_THREADS_MAX));
+	}
+	return count;
+}
+
+static int64_t
+box_check_sql_sorter_memory(void)
+{
+	int64_t size = cfg_geti64("sql_sorter_memory");
+	if (size <= 0) {
+		tnt_raise(ClientError, ER_CFG, "sql_sorter_memory",
+			  "the value must be greater than 0");
+	}
+	return size;
+}
+
 static void
 box_check_instance_uuid(struct tt_uuid *uuid)
 {
@@ -629,6 +851,9 @@ box_check_config()
 	box_check_replication_connect_quorum();
 	box_check_replication_sync_lag();
 	box_check_replication_sync_timeout();
+	box_check_net_cursor_timeout();
+	box_check_sql_aggregate_threads();
+	box_check_sql_sorter_memory();
 	box_check_readahead(cfg_geti("readahead"));
 	box_check_checkpoint_count(cfg_geti("checkpoint_count"));
 	box_check_wal_max_rows(cfg_geti64("rows_per_wal"));
@@ -760,6 +985,12 @@ box_set_replication_skip_conflict(void)
 	replication_skip_conflict = cfg_geti("replication_skip_conflict");
 }
 
+void
+box_set_replication_join_files(void)
+{
+	replication_join_files = cfg_geti("replication_join_files");
+}
+
 void
 box_listen(void)
 {
@@ -912,6 +1143,36 @@ box_set_net_msg_max(void)
 				IPROTO_FIBER_POOL_SIZE_FACTOR);
 }
 
+void
+box_set_net_cursor_timeout(void)
+{
+	iproto_set_cursor_timeout(box_check_net_cursor_timeout());
+}
+
+void
+box_set_sql_aggregate_threads(void)
+{
+	sql_aggregate_set_threads(box_check_sql_aggregate_threads());
+}
+
+void
+box_set_sql_sorter_memory(void)
+{
+	sql_sorter_set_memory(box_check_sql_sorter_memory());
+}
+
+void
+box_set_sql_auto_analyze(void)
+{
+	sql_auto_analyze_set(cfg_getb("sql_auto_analyze"));
+}
+
+void
+box_set_sql_plan_cache(void)
+{
+	sql_plan_cache_set(cfg_getb("sql_plan_cache"));
+}
+
 /* }}} configuration bindings */
 
 /**
@@ -1401,6 +1662,90 @@ box_process_auth(struct auth_request *request, const char *salt)
 	authenticate(user, len, salt, request->scramble);
 }
 
+/** Used to collect checkpoint files for file-level JOIN. */
+struct checkpoint_files {
+	/** Engine whose files are being collected. */
+	struct engine *engine;
+	/** Directory of the engine. */
+	const char *dir;
+	/** Collected files, allocated with malloc. */
+	struct relay_file *files;
+	int count;
+	int capacity;
+};
+
+static void
+checkpoint_files_destroy(struct checkpoint_files *files)
+{
+	for (int i = 0; i < files->count; i++) {
+		free((char *)files->files[i].path);
+		free((char *)files->files[i].name);
+	}
+	free(files->files);
+}
+
+/** engine_backup_cb that appends a file to struct checkpoint_files. */
+static int
+checkpoint_files_add(const char *path, void *arg)
+{
+	struct checkpoint_files *files = (struct checkpoint_files *)arg;
+	size_t dir_len = strlen(files->dir);
+	if (strncmp(path, files->dir, dir_len) != 0 ||
+	    path[dir_len] != '/') {
+		diag_set(ClientError, ER_UNSUPPORTED, "File-level join",
+			 "files outside engine directory");
+		return -1;
+	}
+	if (files->count == files->capacity) {
+		int capacity = MAX(files->capacity * 2, 16);
+		size_t size = capacity * sizeof(*files->files);
+		struct relay_file *new_files = (struct relay_file *)
+			realloc(files->files, size);
+		if (new_files == NULL) {
+			diag_set(OutOfMemory, size, "realloc", "files");
+			return -1;
+		}
+		files->files = new_files;
+		files->capacity = capacity;
+	}
+	char *file_path = strdup(path);
+	char *file_name = strdup(tt_sprintf("%s/%s", files->engine->name,
+					    path + dir_len + 1));
+	if (file_path == NULL || file_name == NULL) {
+		free(file_path);
+		free(file_name);
+		diag_set(OutOfMemory, PATH_MAX, "strdup", "path");
+		return -1;
+	}
+	struct relay_file *file = &files->files[files->count++];
+	file->path = file_path;
+	file->name = file_name;
+	return 0;
+}
+
+/**
+ * Collect files of the checkpoint with the given vclock
+ * for sending them to a replica by file-level JOIN. We use
+ * the engine backup callbacks, since they enumerate exactly
+ * the files needed to restore the checkpoint.
+ */
+static int
+checkpoint_files_collect(struct checkpoint_files *files,
+			 const struct vclock *vclock)
+{
+	struct engine *engine;
+	engine_foreach(engine) {
+		files->engine = engine;
+		files->dir = box_engine_dir(engine->name);
+		if (files->dir == NULL)
+			continue;
+		if (engine->vtab->backup(engine, vclock, checkpoint_files_add,
+					 files) != 0)
+			return -1;
+	}
+	return 0;
+}
+
 void
 box_process_join(struct ev_io *io, struct xrow_header *header)
 {
@@ -1423,6 +1768,15 @@ box_process_join(struct ev_io *io, struct xrow_header *header)
 	 *    ...
 	 * <= INSERT
 	 * <= OK { VCLOCK: stop_vclock } - end of initial JOIN stage.
+	 *
+	 *    If the replica sends JOIN { INSTANCE_UUID, JOIN_FILES: true },
+	 *    the master replies with OK { VCLOCK, JOIN_FILES: true } and
+	 *    sends the files of the checkpoint at start_vclock instead of
+	 *    rows, each split in FILE_CHUNK { FILE_NAME, FILE_SIZE,
+	 *    FILE_DATA } packets. The files are copied verbatim, so data
+	 *    of replica-local spaces is sent along with everything else.
+	 *    A master that doesn't support file-level JOIN ignores the
+	 *    JOIN_FILES key and sends rows.
 	 *     - `stop_vclock` - master's vclock when it's done
 	 *     done sending rows from the snapshot (i.e. vclock
 	 *     for the end of final join).
@@ -1449,7 +1803,8 @@ box_process_join(struct ev_io *io, struct xrow_header *header)
 
 	/* Decode JOIN request */
 	struct tt_uuid instance_uuid = uuid_nil;
-	xrow_decode_join_xc(header, &instance_uuid);
+	bool join_files = false;
+	xrow_decode_join_xc(header, &instance_uuid, &join_files);
 
 	/* Check that bootstrap has been finished */
 	if (!is_box_configured)
@@ -1504,16 +1859,35 @@ box_process_join(struct ev_io *io, struct xrow_header *header)
 			  tt_uuid_str(&instance_uuid));
 	auto gc_guard = make_scoped_guard([&]{ gc_unref_checkpoint(&gc); });
 
+	/*
+	 * If the replica asked for it, send the checkpoint files
+	 * as is instead of decoding and sending rows.
+	 */
+	struct checkpoint_files files;
+	memset(&files, 0, sizeof(files));
+	auto files_guard = make_scoped_guard([&]{
+		checkpoint_files_destroy(&files);
+	});
+	if (join_files &&
+	    checkpoint_files_collect(&files, &start_vclock) != 0)
+		diag_raise();
+
 	/* Respond to JOIN request with start_vclock. */
 	struct xrow_header row;
-	xrow_encode_vclock_xc(&row, &start_vclock);
+	xrow_encode_join_response_xc(&row, &start_vclock, join_files);
 	row.sync = header->sync;
 	coio_write_xrow(io, &row);
 
 	/*
-	 * Initial stream: feed replica with dirty data from engines.
+	 * Initial stream: feed replica with dirty data from engines
+	 * or with checkpoint files.
 	 */
-	relay_initial_join(io->fd, header->sync, &start_vclock);
+	if (join_files) {
+		relay_initial_join_files(io->fd, header->sync,
+					 files.files, files.count);
+	} else {
+		relay_initial_join(io->fd, header->sync, &start_vclock);
+	}
 	say_info("initial data sent.");
 
 	/**
@@ -1798,18 +2172,46 @@ bootstrap_from_master(struct replica *master)
 	assert(!tt_uuid_is_nil(&INSTANCE_UUID));
 	applier_resume_to_state(applier, APPLIER_INITIAL_JOIN, TIMEOUT_INFINITY);
 
+	struct recovery_journal journal;
+	recovery_journal_create(&journal, &replicaset.vclock);
+
 	/*
 	 * Process initial data (snapshot or dirty disk data).
 	 */
-	engine_begin_initial_recovery_xc(NULL);
-	applier_resume_to_state(applier, APPLIER_FINAL_JOIN, TIMEOUT_INFINITY);
+	if (applier->join_files) {
+		/*
+		 * The master sends checkpoint files. Once they are
+		 * all on disk, recover from them as if we were
+		 * restoring a backup. As on local recovery, vinyl
+		 * needs the current vclock to skip final join rows
+		 * that have already been dumped, see local_recovery().
+		 */
+		struct vclock checkpoint_vclock;
+		vclock_copy(&checkpoint_vclock, &replicaset.vclock);
+		applier_resume_to_state(applier, APPLIER_FINAL_JOIN,
+					TIMEOUT_INFINITY);
+		engine_begin_initial_recovery_xc(&replicaset.vclock);
+		struct memtx_engine *memtx;
+		memtx = (struct memtx_engine *)engine_by_name("memtx");
+		assert(memtx != NULL);
+		journal_set(&journal.base);
+		memtx_engine_recover_snapshot_xc(memtx, &checkpoint_vclock);
+		/*
+		 * Let the garbage collector remove the received
+		 * checkpoint once it's no longer needed.
+		 */
+		xdir_add_vclock(&memtx->snap_dir, &checkpoint_vclock);
+		gc_add_checkpoint(&checkpoint_vclock);
+	} else {
+		engine_begin_initial_recovery_xc(NULL);
+		applier_resume_to_state(applier, APPLIER_FINAL_JOIN,
+					TIMEOUT_INFINITY);
+	}
 
 	/*
 	 * Process final data (WALs).
 	 */
 	engine_begin_final_recovery_xc();
-	struct recovery_journal journal;
-	recovery_journal_create(&journal, &replicaset.vclock);
 	journal_set(&journal.base);
 
 	applier_resume_to_state(applier, APPLIER_JOINED, TIMEOUT_INFINITY);
@@ -2093,6 +2495,11 @@ box_cfg_xc(void)
 	box_check_replicaset_uuid(&replicaset_uuid);
 
 	box_set_net_msg_max();
+	box_set_net_cursor_timeout();
+	box_set_sql_aggregate_threads();
+	box_set_sql_sorter_memory();
+	box_set_sql_auto_analyze();
+	box_set_sql_plan_cache();
 	box_set_too_long_threshold();
 	box_set_replication_timeout();
 	box_set_replication_connect_timeout();
@@ -2100,6 +2507,7 @@ box_cfg_xc(void)
 	box_set_replication_sync_lag();
 	box_set_replication_sync_timeout();
 	box_set_replication_skip_conflict();
+	box_set_replication_join_files();
 	xstream_create(&join_stream, apply_initial_join_row);
 	xstream_create(&subscribe_stream, apply_row);
 
@@ -2262,6 +2670,7 @@ box_reset_stat(void)
 {
 	rmean_cleanup(rmean_box);
 	rmean_cleanup(rmean_error);
+	sql_stmt_cache_reset_stat();
 	engine_reset_stat();
 	space_foreach(box_reset_space_stat, NULL);
 }
@@ -208,7 +208,13 @@ void box_set_replication_connect_quorum(void);
 void box_set_replication_sync_lag(void);
 void box_set_replication_sync_timeout(void);
 void box_set_replication_skip_conflict(void);
+void box_set_replication_join_files(void);
 void box_set_net_msg_max(void);
+void box_set_net_cursor_timeout(void);
+void box_set_sql_aggregate_threads(void);
+void box_set_sql_sorter_memory(void);
+void box_set_sql_auto_analyze(void);
+void box_set_sql_plan_cache(void);
 
 extern "C" {
 #endif /* defined(__cplusplus) */
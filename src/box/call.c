@@ -197,6 +197,13 @@ box_process_call(struct call_request *request, struct port *port)
 		fiber_set_user(fiber(), &func->owner_credentials);
 	}
 
+	/*
+	 * A request of an iproto stream may be executed in
+	 * a transaction started by a previous request, see
+	 * IPROTO_BEGIN. Only a transaction started by the
+	 * function itself must be finished on return.
+	 */
+	struct txn *txn = in_txn();
 	int rc;
 	if (func && func->def->language == FUNC_LANGUAGE_C) {
 		rc = box_c_call(func, request, port);
@@ -208,11 +215,12 @@ box_process_call(struct call_request *request, struct port *port)
 		fiber_set_user(fiber(), orig_credentials);
 
 	if (rc != 0) {
-		txn_rollback();
+		if (in_txn() != txn)
+			txn_rollback();
 		return -1;
 	}
 
-	if (in_txn()) {
+	if (in_txn() != NULL && in_txn() != txn) {
 		diag_set(ClientError, ER_FUNCTION_TX_ACTIVE);
 		txn_rollback();
 		return -1;
@@ -228,12 +236,15 @@ box_process_eval(struct call_request *request, struct port *port)
 	/* Check permissions */
 	if (access_check_universe(PRIV_X) != 0)
 		return -1;
+	/* See the comment in box_process_call(). */
+	struct txn *txn = in_txn();
 	if (box_lua_eval(request, port) != 0) {
-		txn_rollback();
+		if (in_txn() != txn)
+			txn_rollback();
 		return -1;
 	}
 
-	if (in_txn()) {
+	if (in_txn() != NULL && in_txn() != txn) {
 		diag_set(ClientError, ER_FUNCTION_TX_ACTIVE);
 		txn_rollback();
 		return -1;
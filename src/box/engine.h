@@ -199,6 +199,11 @@ enum {
 	 * transactions w/o throwing ER_CROSS_ENGINE_TRANSACTION.
 	 */
 	ENGINE_BYPASS_TX = 1 << 0,
+	/**
+	 * If set, a multi-statement transaction of the engine
+	 * is aborted as soon as its fiber yields.
+	 */
+	ENGINE_TXN_ABORT_ON_YIELD = 1 << 1,
 };
 
 struct engine {
@@ -227,6 +227,11 @@ struct errcode_record {
 	/*172 */_(ER_ROWID_OVERFLOW,            "Rowid is overflowed: too many entries in ephemeral space") \
 	/*173 */_(ER_DROP_COLLATION,		"Can't drop collation %s : %s") \
 	/*174 */_(ER_ILLEGAL_COLLATION_MIX,	"Illegal mix of collations") \
+	/*175 */_(ER_UNABLE_TO_PROCESS_OUT_OF_STREAM, "Unable to process %s request out of stream") \
+	/*176 */_(ER_WRONG_QUERY_ID,		"Prepared statement with id %u does not exist") \
+	/*177 */_(ER_NO_SUCH_CURSOR,		"Cursor %llu does not exist or has expired") \
+	/*178 */_(ER_CURSOR_BUSY,		"Cursor %llu is in use by another request") \
+	/*179 */_(ER_STREAM_TRANSACTION_YIELD,	"Transaction of the stream has been aborted: %s transactions can't wait for the next request") \
 
 /*
  * !IMPORTANT! Please follow instructions at start of the file
@@ -43,6 +43,7 @@
 #include "port.h"
 #include "tuple.h"
 #include "sql/vdbe.h"
+#include "sql_stmt_cache.h"
 
 const char *sql_type_strs[] = {
 	NULL,
@@ -57,6 +58,13 @@ const char *sql_info_key_strs[] = {
 	"row count",
 };
 
+/**
+ * True if literals of statements executed without preparation
+ * are replaced with parameters, so that their compiled programs
+ * are shared in the prepared statement cache.
+ */
+static bool sql_plan_cache_is_enabled = false;
+
 /**
  * Name and value of an SQL prepared statement parameter.
  * @todo: merge with sqlite3_value.
@@ -528,6 +536,112 @@ sql_execute(sqlite3 *db, struct sqlite3_stmt *stmt, struct port *port,
 	return 0;
 }
 
+void
+sql_plan_cache_set(bool enabled)
+{
+	sql_plan_cache_is_enabled = enabled;
+}
+
+/**
+ * Convert literals replaced by sql_normalize() into parameters.
+ * @param literals Literals.
+ * @param count Length of @a literals.
+ * @param region Allocator for the parameters.
+ *
+ * @retval not NULL Array of @a count parameters.
+ * @retval NULL Memory error.
+ */
+static struct sql_bind *
+sql_bind_literals(const struct sql_literal *literals, int count,
+		  struct region *region)
+{
+	size_t size = sizeof(struct sql_bind) * count;
+	struct sql_bind *bind = (struct sql_bind *) region_alloc(region, size);
+	if (bind == NULL) {
+		diag_set(OutOfMemory, size, "region_alloc", "struct sql_bind");
+		return NULL;
+	}
+	for (int i = 0; i < count; ++i) {
+		const struct sql_literal *literal = &literals[i];
+		bind[i].name = NULL;
+		bind[i].name_len = 0;
+		bind[i].pos = i + 1;
+		switch (literal->type) {
+		case TK_INTEGER:
+			bind[i].type = SQLITE_INTEGER;
+			bind[i].bytes = sizeof(bind[i].i64);
+			bind[i].i64 = literal->i64;
+			break;
+		case TK_FLOAT:
+			bind[i].type = SQLITE_FLOAT;
+			bind[i].bytes = sizeof(bind[i].d);
+			bind[i].d = literal->d;
+			break;
+		default:
+			assert(literal->type == TK_STRING);
+			bind[i].type = SQLITE_TEXT;
+			bind[i].bytes = literal->len;
+			bind[i].s = literal->s;
+			break;
+		}
+	}
+	return bind;
+}
+
+/**
+ * Execute a statement with its literals replaced with
+ * parameters. The statement compiled from the normalized text
+ * is kept in the prepared statement cache, so next statements
+ * which differ only in literals are neither parsed nor planned
+ * again.
+ *
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ * @retval  1 The statement can't be normalized and must be
+ *          compiled as is.
+ */
+static int
+sql_execute_normalized(const char *sql, int len,
+		       struct sql_response *response, struct region *region)
+{
+	char *text = (char *) region_alloc(region, len + 1);
+	if (text == NULL) {
+		diag_set(OutOfMemory, len + 1, "region_alloc", "text");
+		return -1;
+	}
+	memcpy(text, sql, len);
+	text[len] = '\0';
+	char *norm_sql;
+	uint32_t norm_len;
+	struct sql_literal *literals;
+	int count = sql_normalize(region, text, &norm_sql, &norm_len,
+				  &literals);
+	if (count <= 0)
+		return count < 0 ? -1 : 1;
+	struct sql_bind *bind = sql_bind_literals(literals, count, region);
+	if (bind == NULL)
+		return -1;
+	uint32_t stmt_id;
+	struct sqlite3_stmt *stmt;
+	/*
+	 * A literal may be a part of syntax where a parameter
+	 * is not allowed. Such statements are compiled as is.
+	 */
+	int rc = sql_stmt_cache_prepare_acquire(norm_sql, norm_len,
+						&stmt_id, &stmt);
+	if (rc != 0)
+		return rc;
+	port_tuple_create(&response->port);
+	response->prep_stmt = stmt;
+	response->stmt_id = stmt_id;
+	if (sql_bind(stmt, bind, count) == 0 &&
+	    sql_execute(sql_get(), stmt, &response->port, region) == 0)
+		return 0;
+	port_destroy(&response->port);
+	sql_stmt_cache_release(stmt_id, stmt);
+	return -1;
+}
+
 int
 sql_prepare_and_execute(const char *sql, int len, const struct sql_bind *bind,
 			uint32_t bind_count, struct sql_response *response,
@@ -539,6 +653,11 @@ sql_prepare_and_execute(const char *sql, int len, const struct sql_bind *bind,
 		diag_set(ClientError, ER_LOADING);
 		return -1;
 	}
+	if (sql_plan_cache_is_enabled && bind_count == 0) {
+		int rc = sql_execute_normalized(sql, len, response, region);
+		if (rc <= 0)
+			return rc;
+	}
 	if (sqlite3_prepare_v2(db, sql, len, &stmt, NULL) != SQLITE_OK) {
 		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
 		return -1;
@@ -546,6 +665,7 @@ sql_prepare_and_execute(const char *sql, int len, const struct sql_bind *bind,
 	assert(stmt != NULL);
 	port_tuple_create(&response->port);
 	response->prep_stmt = stmt;
+	response->stmt_id = 0;
 	if (sql_bind(stmt, bind, bind_count) == 0 &&
 	    sql_execute(db, stmt, &response->port, region) == 0)
 		return 0;
@@ -554,6 +674,46 @@ sql_prepare_and_execute(const char *sql, int len, const struct sql_bind *bind,
 	return -1;
 }
 
+int
+sql_prepare(const char *sql, int len, uint32_t *stmt_id)
+{
+	return sql_stmt_cache_prepare(sql, len, stmt_id);
+}
+
+int
+sql_execute_prepared(uint32_t stmt_id, const struct sql_bind *bind,
+		     uint32_t bind_count, struct sql_response *response,
+		     struct region *region)
+{
+	struct sqlite3_stmt *stmt = sql_stmt_cache_acquire(stmt_id);
+	if (stmt == NULL)
+		return -1;
+	port_tuple_create(&response->port);
+	response->prep_stmt = stmt;
+	response->stmt_id = stmt_id;
+	if (sql_bind(stmt, bind, bind_count) == 0 &&
+	    sql_execute(sql_get(), stmt, &response->port, region) == 0)
+		return 0;
+	port_destroy(&response->port);
+	sql_stmt_cache_release(stmt_id, stmt);
+	return -1;
+}
+
+int
+sql_prepare_dump(uint32_t stmt_id, int *keys, struct obuf *out)
+{
+	int size = mp_sizeof_uint(IPROTO_STMT_ID) + mp_sizeof_uint(stmt_id);
+	char *pos = (char *) obuf_alloc(out, size);
+	if (pos == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "pos");
+		return -1;
+	}
+	pos = mp_encode_uint(pos, IPROTO_STMT_ID);
+	pos = mp_encode_uint(pos, stmt_id);
+	*keys = 1;
+	return 0;
+}
+
 int
 sql_response_dump(struct sql_response *response, int *keys, struct obuf *out)
 {
@@ -635,6 +795,9 @@ err:
 	}
 finish:
 	port_destroy(&response->port);
-	sqlite3_finalize(stmt);
+	if (response->stmt_id != 0)
+		sql_stmt_cache_release(response->stmt_id, stmt);
+	else
+		sqlite3_finalize(stmt);
 	return rc;
 }
@@ -58,6 +58,11 @@ struct sql_response {
 	struct port port;
 	/** Prepared SQL statement with metadata. */
 	void *prep_stmt;
+	/**
+	 * Id of the statement in the prepared statement cache
+	 * or 0 if the statement is not cached.
+	 */
+	uint32_t stmt_id;
 };
 
 /**
@@ -132,6 +137,59 @@ sql_prepare_and_execute(const char *sql, int len, const struct sql_bind *bind,
 			uint32_t bind_count, struct sql_response *response,
 			struct region *region);
 
+/**
+ * Prepare an SQL statement and save it in the prepared
+ * statement cache for execution with sql_execute_prepared().
+ * @param sql SQL statement.
+ * @param len Length of @a sql.
+ * @param[out] stmt_id Id of the prepared statement.
+ *
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ */
+int
+sql_prepare(const char *sql, int len, uint32_t *stmt_id);
+
+/**
+ * Execute a statement prepared with sql_prepare().
+ * @param stmt_id Id of the prepared statement.
+ * @param bind Array of parameters.
+ * @param bind_count Length of @a bind.
+ * @param[out] response Response to store result.
+ * @param region Runtime allocator for temporary objects.
+ *
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ */
+int
+sql_execute_prepared(uint32_t stmt_id, const struct sql_bind *bind,
+		     uint32_t bind_count, struct sql_response *response,
+		     struct region *region);
+
+/**
+ * Dump a response on PREPARE request into @a out buffer.
+ * Response body: {IPROTO_STMT_ID: id}.
+ * @param stmt_id Id of the prepared statement.
+ * @param[out] keys Number of keys in dumped map.
+ * @param out Output buffer.
+ *
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+int
+sql_prepare_dump(uint32_t stmt_id, int *keys, struct obuf *out);
+
+/**
+ * Enable or disable the plan cache of statements executed
+ * without preparation. When enabled, literals of a query or a
+ * DML statement are replaced with parameters, and the program
+ * compiled from the normalized text is kept in the prepared
+ * statement cache, see sql_normalize().
+ * @param enabled True to enable the cache.
+ */
+void
+sql_plan_cache_set(bool enabled);
+
 #if defined(__cplusplus)
 } /* extern "C" { */
 #endif
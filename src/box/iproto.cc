@@ -61,6 +61,14 @@
 #include "rmean.h"
 #include "execute.h"
 #include "errinj.h"
+#include "txn.h"
+#include "engine.h"
+#include "assoc.h"
+#include "fiber_cond.h"
+#include "index.h"
+#include "latency.h"
+#include "clock.h"
+#include "info.h"
 
 enum {
 	IPROTO_SALT_SIZE = 32,
@@ -85,6 +93,52 @@ iproto_wpos_create(struct iproto_wpos *wpos, struct obuf *out)
 	wpos->svp = obuf_create_svp(out);
 }
 
+/**
+ * A tuple written to the connection output by reference.
+ * Instead of copying a large tuple to the output buffer, tx
+ * pins the tuple and remembers the output buffer position the
+ * tuple data belongs at. When the output is flushed up to this
+ * position, iproto writes the tuple data to the socket right
+ * from the tuple memory and then returns the splice to tx to
+ * unpin the tuple, see iproto_flush().
+ */
+struct iproto_splice {
+	/** Link in a list of splices of a message or a connection. */
+	struct stailq_entry in_list;
+	/** Output buffer the tuple data is inserted into. */
+	struct obuf *obuf;
+	/** Output buffer size at the tuple position. */
+	size_t used;
+	/** Pinned tuple. */
+	struct tuple *tuple;
+	/** Tuple data and its size. */
+	const char *data;
+	uint32_t size;
+	/** Size of the tuple data written to the socket so far. */
+	uint32_t written;
+};
+
+/**
+ * Tuples smaller than this are copied to the output buffer:
+ * a splice costs a cbus round trip and an iovec per tuple.
+ */
+enum { IPROTO_SPLICE_SIZE_MIN = 1024 };
+
+/** Max number of iovecs in a writev() interleaving splices. */
+enum { IPROTO_SPLICE_IOV_MAX = 2 * (SMALL_OBUF_IOV_MAX + 1) };
+
+static struct mempool iproto_splice_pool;
+
+/**
+ * A message to return splices written to the socket to tx
+ * thread, which unpins their tuples.
+ */
+struct iproto_splice_msg {
+	struct cmsg base;
+	/** Splices to release. */
+	struct stailq splices;
+};
+
 /**
  * In Greek mythology, Kharon is the ferryman who carries souls
  * of the newly deceased across the river Styx that divided the
@@ -178,6 +232,10 @@ struct iproto_msg
 		struct auth_request auth;
 		/* SQL request, if this is the EXECUTE request. */
 		struct sql_request sql;
+		/** BATCH request. */
+		struct batch_request batch;
+		/** FETCH request. */
+		struct fetch_request fetch;
 		/** In case of iproto parse error, saved diagnostics. */
 		struct diag diag;
 	};
@@ -213,6 +271,43 @@ struct iproto_msg
 	 * and the connection must be closed.
 	 */
 	bool close_connection;
+	/**
+	 * Route of a request sent to a stream. The request is
+	 * first queued to the stream and then processed along
+	 * this route, see tx_process_stream().
+	 */
+	const struct cmsg_hop *stream_route;
+	/**
+	 * Messages sent by the tx thread to free the tx window
+	 * slot of a request while it waits in a stream queue,
+	 * and to take the slot back when the request is
+	 * processed, see tx_process_stream().
+	 */
+	struct cmsg stream_park;
+	struct cmsg stream_unpark;
+	/** True if the request waited in a stream queue. */
+	bool is_parked;
+	/**
+	 * Tuples of the reply written by reference, in the order
+	 * of their positions in the output buffer. Handed over to
+	 * the connection when the reply is sent, see
+	 * net_send_msg().
+	 */
+	struct stailq splices;
+	/** Priority class the request is queued with. */
+	enum iproto_priority priority;
+	/** True if the request went through a priority queue. */
+	bool is_dispatched;
+	/** True if the request occupies a slot in the tx window. */
+	bool in_tx_window;
+	/** Time the request was queued, by the net thread clock. */
+	double queue_time;
+	/** Time the request was sent to tx thread. */
+	double dispatch_time;
+	/** Time tx thread started processing the request. */
+	double tx_start;
+	/** Latency of the called function, if tracked. */
+	struct iproto_latency *func_latency;
 };
 
 static struct mempool iproto_msg_pool;
@@ -230,9 +325,18 @@ static void
 iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input);
 
+/**
+ * Account a completed request in the statistics of its
+ * priority class and send more queued requests to tx.
+ */
+static void
+iproto_priority_complete(struct iproto_msg *msg);
+
 static inline void
 iproto_msg_delete(struct iproto_msg *msg)
 {
+	if (msg->is_dispatched)
+		iproto_priority_complete(msg);
 	mempool_free(&iproto_msg_pool, msg);
 	iproto_resume();
 }
@@ -313,6 +417,21 @@ static const struct cmsg_hop push_route[] = {
 	{ tx_end_push, NULL }
 };
 
+/** Unpin tuples of splices written to the socket. */
+static void
+tx_release_splices(struct cmsg *m);
+
+/**
+ * The splice message is back to iproto, send it again
+ * if more splices have been written meanwhile.
+ */
+static void
+net_end_release_splices(struct cmsg *m);
+
+static const struct cmsg_hop release_splices_route[] = {
+	{ tx_release_splices, &net_pipe },
+	{ net_end_release_splices, NULL }
+};
 
 /* }}} */
 
@@ -455,6 +574,42 @@ struct iproto_connection
 	 *                          ...
 	 */
 	struct iproto_kharon kharon;
+	/**
+	 * Splices of the sent replies which haven't been written
+	 * to the socket yet, in the order of their positions in
+	 * the output buffers.
+	 */
+	struct stailq splices;
+	/**
+	 * Splices written to the socket, waiting for the splice
+	 * message to carry them to tx.
+	 */
+	struct stailq spliced;
+	/**
+	 * Pre-allocated message to return written splices to tx.
+	 * Like Kharon, it can not be in two places at the time:
+	 * splices written while it travels are queued to @a spliced
+	 * and are sent on its return.
+	 */
+	struct iproto_splice_msg splice_msg;
+	/** True if the splice message is travelling. */
+	bool is_splice_sent;
+	/**
+	 * Priority class of the connection requests. Assigned
+	 * without locks in tx thread and read in iproto thread
+	 * when a request is queued: a stale value only affects
+	 * a few requests following the change.
+	 */
+	enum iproto_priority priority;
+	/**
+	 * Priority class of the requests of the connection
+	 * waiting in a priority queue. It's changed only when
+	 * none of them are queued so that the requests of one
+	 * connection are never reordered.
+	 */
+	enum iproto_priority queue_priority;
+	/** Number of requests waiting in a priority queue. */
+	int n_queued;
 	/**
 	 * The following fields are used exclusively by the tx thread.
 	 * Align them to prevent false-sharing.
@@ -470,6 +625,16 @@ struct iproto_connection
 		 * return.
 		 */
 		bool is_push_pending;
+		/** Streams of the connection, by stream id. */
+		struct mh_i64ptr_t *streams;
+		/** Signaled when a stream is deleted. */
+		struct fiber_cond stream_deleted;
+		/** True if the client has disconnected. */
+		bool is_disconnected;
+		/** Open cursors of the connection, by cursor id. */
+		struct mh_i64ptr_t *cursors;
+		/** Id of the last cursor opened by the connection. */
+		uint64_t last_cursor_id;
 	} tx;
 	/** Authentication salt. */
 	char salt[IPROTO_SALT_SIZE];
@@ -505,9 +670,243 @@ iproto_msg_new(struct iproto_connection *con)
 		return NULL;
 	}
 	msg->connection = con;
+	stailq_create(&msg->splices);
+	msg->is_dispatched = false;
+	msg->in_tx_window = false;
+	msg->is_parked = false;
+	msg->tx_start = 0;
 	return msg;
 }
 
+/* {{{ Priority queues */
+
+const char *iproto_priority_strs[] = { "high", "normal", "low" };
+
+/**
+ * Weights of the priority classes: when all classes have
+ * requests waiting, they are sent to tx in this proportion.
+ */
+static const int iproto_priority_weight[] = { 16, 4, 1 };
+
+static_assert(lengthof(iproto_priority_weight) == iproto_priority_MAX,
+	      "a weight is defined for every priority class");
+
+/**
+ * The requests of a priority class waiting to be sent
+ * to tx thread.
+ */
+struct iproto_priority_queue {
+	/** Queued requests, linked by iproto_msg.base.fifo. */
+	struct stailq msgs;
+	/** Number of queued requests. */
+	size_t size;
+	/** Requests sent to tx thread and not completed yet. */
+	size_t in_flight;
+	/** Requests the class may send in the current round. */
+	int credit;
+	/** Requests completed since the last reset. */
+	uint64_t total;
+	/** Total time completed requests waited in the queue. */
+	double wait_sum;
+	/** Total time to complete the requests. */
+	double latency_sum;
+};
+
+static struct iproto_priority_queue iproto_queues[iproto_priority_MAX];
+
+/** Priority class served by the dispatcher at the moment. */
+static int iproto_dispatch_cursor;
+
+/** Number of requests in all priority queues. */
+static size_t iproto_queued;
+
+/** Number of requests occupying the tx window. */
+static int iproto_tx_in_flight;
+
+/**
+ * Requests are queued in iproto thread rather than in tx, or
+ * the order of their processing would be defined by cbus. The
+ * window must be small enough for a request of a high priority
+ * not to wait for a long queue in tx, and big enough to keep
+ * tx busy.
+ */
+static inline int
+iproto_tx_window(void)
+{
+	return MAX(iproto_msg_max / 4, IPROTO_MSG_MAX_MIN);
+}
+
+static void
+iproto_priority_init(void)
+{
+	for (int i = 0; i < iproto_priority_MAX; i++) {
+		struct iproto_priority_queue *queue = &iproto_queues[i];
+		memset(queue, 0, sizeof(*queue));
+		stailq_create(&queue->msgs);
+	}
+	iproto_dispatch_cursor = 0;
+	iproto_queued = 0;
+	iproto_tx_in_flight = 0;
+}
+
+/**
+ * Send queued requests to tx thread while there is room in
+ * the tx window. The classes are served by deficit round robin
+ * with the quantum equal to the class weight.
+ */
+static void
+iproto_dispatch(void)
+{
+	int count = 0;
+	while (iproto_queued > 0 &&
+	       iproto_tx_in_flight < iproto_tx_window()) {
+		struct iproto_priority_queue *queue =
+			&iproto_queues[iproto_dispatch_cursor];
+		if (queue->size == 0 || queue->credit == 0) {
+			/* An idle class doesn't save its credit. */
+			if (queue->size == 0)
+				queue->credit = 0;
+			iproto_dispatch_cursor = (iproto_dispatch_cursor + 1) %
+						 iproto_priority_MAX;
+			queue = &iproto_queues[iproto_dispatch_cursor];
+			if (queue->size > 0)
+				queue->credit += iproto_priority_weight[
+						iproto_dispatch_cursor];
+			continue;
+		}
+		struct iproto_msg *msg =
+			stailq_shift_entry(&queue->msgs, struct iproto_msg,
+					   base.fifo);
+		queue->size--;
+		queue->credit--;
+		queue->in_flight++;
+		iproto_queued--;
+		iproto_tx_in_flight++;
+		msg->connection->n_queued--;
+		msg->in_tx_window = true;
+		msg->dispatch_time = ev_monotonic_now(loop());
+		cpipe_push_input(&tx_pipe, &msg->base);
+		count++;
+	}
+	if (count > 0)
+		cpipe_flush_input(&tx_pipe);
+}
+
+/**
+ * Queue a request to the priority queue of its connection
+ * and dispatch the queues.
+ */
+static void
+iproto_queue_msg(struct iproto_connection *con, struct iproto_msg *msg)
+{
+	if (con->n_queued == 0)
+		con->queue_priority = con->priority;
+	struct iproto_priority_queue *queue =
+		&iproto_queues[con->queue_priority];
+	msg->priority = con->queue_priority;
+	msg->is_dispatched = true;
+	stailq_add_tail_entry(&queue->msgs, msg, base.fifo);
+	queue->size++;
+	con->n_queued++;
+	iproto_queued++;
+	iproto_dispatch();
+}
+
+/**
+ * Free the tx window slot of a request. Called when the
+ * request completes, or when it turns out to be a long poll:
+ * it may take arbitrary long, and must not make the others
+ * wait.
+ */
+static void
+iproto_leave_tx_window(struct iproto_msg *msg)
+{
+	if (! msg->in_tx_window)
+		return;
+	msg->in_tx_window = false;
+	assert(iproto_tx_in_flight > 0);
+	iproto_tx_in_flight--;
+	iproto_dispatch();
+}
+
+/**
+ * Take a tx window slot for a request which is processed
+ * after it waited in a stream queue. The slot is taken even
+ * if the window is full: the request is already in tx.
+ */
+static void
+iproto_enter_tx_window(struct iproto_msg *msg)
+{
+	assert(! msg->in_tx_window);
+	if (! msg->is_dispatched)
+		return;
+	msg->in_tx_window = true;
+	iproto_tx_in_flight++;
+}
+
+static void
+iproto_priority_complete(struct iproto_msg *msg)
+{
+	struct iproto_priority_queue *queue = &iproto_queues[msg->priority];
+	double now = ev_monotonic_now(loop());
+	assert(queue->in_flight > 0);
+	queue->in_flight--;
+	queue->total++;
+	queue->wait_sum += msg->dispatch_time - msg->queue_time;
+	queue->latency_sum += now - msg->queue_time;
+	iproto_leave_tx_window(msg);
+}
+
+/** Reset the statistics of the priority classes. */
+static void
+iproto_priority_reset_stat(void)
+{
+	for (int i = 0; i < iproto_priority_MAX; i++) {
+		struct iproto_priority_queue *queue = &iproto_queues[i];
+		queue->total = 0;
+		queue->wait_sum = 0;
+		queue->latency_sum = 0;
+	}
+}
+
+void
+iproto_priority_stat(enum iproto_priority priority,
+		     struct iproto_priority_stat *stat)
+{
+	/*
+	 * The statistics is updated in iproto thread,
+	 * but the values are fine to be slightly stale.
+	 */
+	struct iproto_priority_queue *queue = &iproto_queues[priority];
+	stat->queue = queue->size;
+	stat->in_flight = queue->in_flight;
+	stat->total = queue->total;
+	stat->wait = queue->total > 0 ? queue->wait_sum / queue->total : 0;
+	stat->latency = queue->total > 0 ?
+			queue->latency_sum / queue->total : 0;
+}
+
+enum iproto_priority
+iproto_session_priority(struct session *session)
+{
+	assert(session->type == SESSION_TYPE_BINARY);
+	struct iproto_connection *con =
+		(struct iproto_connection *) session->meta.connection;
+	return con->priority;
+}
+
+void
+iproto_session_set_priority(struct session *session,
+			    enum iproto_priority priority)
+{
+	assert(session->type == SESSION_TYPE_BINARY);
+	struct iproto_connection *con =
+		(struct iproto_connection *) session->meta.connection;
+	con->priority = priority;
+}
+
+/* }}} */
+
 /**
  * A connection is idle when the client is gone
  * and there are no outstanding msgs in the msg queue.
@@ -757,13 +1156,21 @@ err_msgpack:
 		msg->wpos = con->wpos;
 
 		msg->len = reqend - reqstart; /* total request length */
+		msg->queue_time = ev_monotonic_now(loop());
 
 		iproto_msg_decode(msg, &pos, reqend, &stop_input);
 		/*
 		 * This can't throw, but should not be
 		 * done in case of exception.
+		 *
+		 * JOIN and SUBSCRIBE occupy tx for the whole
+		 * life of a replica, so they bypass the priority
+		 * queues not to take a slot of the tx window.
 		 */
-		cpipe_push_input(&tx_pipe, &msg->base);
+		if (stop_input)
+			cpipe_push_input(&tx_pipe, &msg->base);
+		else
+			iproto_queue_msg(con, msg);
 		n_requests++;
 		/* Request is parsed */
 		assert(reqend > reqstart);
@@ -908,6 +1315,144 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	}
 }
 
+/**
+ * Return the first splice waiting to be written to the socket
+ * if it belongs at @a obuf position not greater than @a used.
+ */
+static inline struct iproto_splice *
+iproto_connection_next_splice(struct iproto_connection *con,
+			      struct obuf *obuf, size_t used)
+{
+	if (stailq_empty(&con->splices))
+		return NULL;
+	struct iproto_splice *splice =
+		stailq_first_entry(&con->splices, struct iproto_splice,
+				   in_list);
+	if (splice->obuf != obuf || splice->used > used)
+		return NULL;
+	return splice;
+}
+
+/**
+ * Carry the splices written to the socket to tx thread, unless
+ * the splice message is already on its way.
+ */
+static void
+iproto_connection_release_splices(struct iproto_connection *con)
+{
+	if (con->is_splice_sent || stailq_empty(&con->spliced))
+		return;
+	stailq_concat(&con->splice_msg.splices, &con->spliced);
+	cmsg_init(&con->splice_msg.base, release_splices_route);
+	con->is_splice_sent = true;
+	cpipe_push(&tx_pipe, &con->splice_msg.base);
+}
+
+/**
+ * Advance a position in the output buffer by @a size bytes.
+ * iov_len of the last buffer position may be concurrently
+ * modified in tx thread, but it never gets below the data
+ * which has been sent to iproto.
+ */
+static void
+iproto_svp_advance(struct obuf *obuf, struct obuf_svp *svp, size_t size)
+{
+	svp->used += size;
+	while (size > 0) {
+		size_t left = obuf->iov[svp->pos].iov_len - svp->iov_len;
+		if (size <= left) {
+			svp->iov_len += size;
+			break;
+		}
+		size -= left;
+		svp->pos++;
+		svp->iov_len = 0;
+	}
+}
+
+/**
+ * writev() the output buffer data in range [begin, end)
+ * interleaved with the data of the spliced tuples positioned
+ * within this range and handle the result.
+ */
+static int
+iproto_flush_splices(struct iproto_connection *con, struct obuf *obuf,
+		     struct obuf_svp *begin, struct obuf_svp *end)
+{
+	struct iovec iov[IPROTO_SPLICE_IOV_MAX];
+	/* The splice of each iov, NULL for the buffer data. */
+	struct iproto_splice *owner[IPROTO_SPLICE_IOV_MAX];
+	int iovcnt = 0;
+	size_t total = 0;
+	struct obuf_svp pos = *begin;
+	struct iproto_splice *splice =
+		iproto_connection_next_splice(con, obuf, end->used);
+	while (iovcnt < IPROTO_SPLICE_IOV_MAX) {
+		size_t limit = splice != NULL ? splice->used : end->used;
+		while (pos.used < limit && iovcnt < IPROTO_SPLICE_IOV_MAX) {
+			struct iovec *src = &obuf->iov[pos.pos];
+			size_t len = src->iov_len - pos.iov_len;
+			if (len == 0) {
+				pos.pos++;
+				pos.iov_len = 0;
+				continue;
+			}
+			len = MIN(len, limit - pos.used);
+			iov[iovcnt].iov_base = (char *) src->iov_base +
+					       pos.iov_len;
+			iov[iovcnt].iov_len = len;
+			owner[iovcnt++] = NULL;
+			pos.used += len;
+			pos.iov_len += len;
+			total += len;
+		}
+		if (splice == NULL || pos.used < limit ||
+		    iovcnt == IPROTO_SPLICE_IOV_MAX)
+			break;
+		iov[iovcnt].iov_base = (char *) splice->data + splice->written;
+		iov[iovcnt].iov_len = splice->size - splice->written;
+		owner[iovcnt++] = splice;
+		total += splice->size - splice->written;
+		if (stailq_next(&splice->in_list) == NULL)
+			splice = NULL;
+		else
+			splice = stailq_next_entry(splice, in_list);
+		if (splice != NULL &&
+		    (splice->obuf != obuf || splice->used > end->used))
+			splice = NULL;
+	}
+	assert(iovcnt > 0);
+
+	ssize_t nwr = sio_writev(con->output.fd, iov, iovcnt);
+	if (nwr < 0) {
+		if (! sio_wouldblock(errno))
+			diag_raise();
+		return -1;
+	}
+	/* Count statistics */
+	rmean_collect(rmean_net, IPROTO_SENT, nwr);
+	bool is_complete = (size_t) nwr == total;
+	for (int i = 0; i < iovcnt && nwr > 0; i++) {
+		size_t len = MIN((size_t) nwr, iov[i].iov_len);
+		nwr -= len;
+		if (owner[i] == NULL) {
+			iproto_svp_advance(obuf, begin, len);
+			continue;
+		}
+		owner[i]->written += len;
+		if (owner[i]->written < owner[i]->size)
+			continue;
+		/* Splices are written strictly in order. */
+		assert(owner[i] == stailq_first_entry(&con->splices,
+						      struct iproto_splice,
+						      in_list));
+		stailq_shift(&con->splices);
+		stailq_add_tail_entry(&con->spliced, owner[i], in_list);
+	}
+	iproto_connection_release_splices(con);
+	return is_complete ? 0 : -1;
+}
+
 /** writev() to the socket and handle the result. */
 
 static int
@@ -923,13 +1468,17 @@ iproto_flush(struct iproto_connection *con)
 		 * Flush the current buffer before
 		 * advancing to the next one.
 		 */
-		if (begin->used == obuf_end.used) {
+		if (begin->used == obuf_end.used &&
+		    iproto_connection_next_splice(con, obuf,
+						  obuf_end.used) == NULL) {
 			obuf = con->wpos.obuf = con->wend.obuf;
 			obuf_svp_reset(begin);
 		} else {
 			end = &obuf_end;
 		}
 	}
+	if (iproto_connection_next_splice(con, obuf, end->used) != NULL)
+		return iproto_flush_splices(con, obuf, begin, end);
 	if (begin->used == end->used) {
 		/* Nothing to do. */
 		return 1;
@@ -1004,6 +1553,22 @@ iproto_connection_new(int fd)
 		diag_set(OutOfMemory, sizeof(*con), "mempool_alloc", "con");
 		return NULL;
 	}
+	con->tx.streams = mh_i64ptr_new();
+	if (con->tx.streams == NULL) {
+		mempool_free(&iproto_connection_pool, con);
+		diag_set(OutOfMemory, sizeof(*con->tx.streams),
+			 "mh_i64ptr_new", "streams");
+		return NULL;
+	}
+	con->tx.cursors = mh_i64ptr_new();
+	if (con->tx.cursors == NULL) {
+		mh_i64ptr_delete(con->tx.streams);
+		mempool_free(&iproto_connection_pool, con);
+		diag_set(OutOfMemory, sizeof(*con->tx.cursors),
+			 "mh_i64ptr_new", "cursors");
+		return NULL;
+	}
+	con->tx.last_cursor_id = 0;
 	con->input.data = con->output.data = con;
 	con->loop = loop();
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
@@ -1024,8 +1589,18 @@ iproto_connection_new(int fd)
 	cmsg_init(&con->destroy_msg, destroy_route);
 	cmsg_init(&con->disconnect_msg, disconnect_route);
 	con->is_destroy_sent = false;
+	stailq_create(&con->splices);
+	stailq_create(&con->spliced);
+	cmsg_init(&con->splice_msg.base, release_splices_route);
+	stailq_create(&con->splice_msg.splices);
+	con->is_splice_sent = false;
+	con->priority = IPROTO_PRIORITY_NORMAL;
+	con->queue_priority = IPROTO_PRIORITY_NORMAL;
+	con->n_queued = 0;
 	con->tx.is_push_pending = false;
 	con->tx.is_push_sent = false;
+	fiber_cond_create(&con->tx.stream_deleted);
+	con->tx.is_disconnected = false;
 	return con;
 }
 
@@ -1047,6 +1622,14 @@ iproto_connection_delete(struct iproto_connection *con)
 	       con->obuf[0].iov[0].iov_base == NULL);
 	assert(con->obuf[1].pos == 0 &&
 	       con->obuf[1].iov[0].iov_base == NULL);
+	/* The splices must have been released in tx thread. */
+	assert(stailq_empty(&con->splices));
+	assert(stailq_empty(&con->spliced));
+	assert(mh_size(con->tx.streams) == 0);
+	mh_i64ptr_delete(con->tx.streams);
+	assert(mh_size(con->tx.cursors) == 0);
+	mh_i64ptr_delete(con->tx.cursors);
+	fiber_cond_destroy(&con->tx.stream_deleted);
 	mempool_free(&iproto_connection_pool, con);
 }
 
@@ -1069,6 +1652,18 @@ tx_process_select(struct cmsg *msg);
 static void
 tx_process_sql(struct cmsg *msg);
 
+static void
+tx_process_txn(struct cmsg *msg);
+
+static void
+tx_process_batch(struct cmsg *msg);
+
+static void
+tx_process_fetch(struct cmsg *msg);
+
+static void
+tx_process_stream(struct cmsg *msg);
+
 static void
 tx_reply_error(struct iproto_msg *msg);
 
@@ -1115,6 +1710,29 @@ static const struct cmsg_hop sql_route[] = {
 	{ net_send_msg, NULL },
 };
 
+static const struct cmsg_hop txn_route[] = {
+	{ tx_process_txn, &net_pipe },
+	{ net_send_msg, NULL },
+};
+
+static const struct cmsg_hop batch_route[] = {
+	{ tx_process_batch, &net_pipe },
+	{ net_send_msg, NULL },
+};
+
+static const struct cmsg_hop fetch_route[] = {
+	{ tx_process_fetch, &net_pipe },
+	{ net_send_msg, NULL },
+};
+
+/**
+ * The first hop of a request sent to a stream. The request
+ * is forwarded along iproto_msg::stream_route by the stream.
+ */
+static const struct cmsg_hop stream_route[] = {
+	{ tx_process_stream, NULL },
+};
+
 static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
 	NULL,                                   /* IPROTO_OK */
 	select_route,                           /* IPROTO_SELECT */
@@ -1129,6 +1747,12 @@ static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
 	call_route,                             /* IPROTO_CALL */
 	sql_route,                              /* IPROTO_EXECUTE */
 	NULL,                                   /* IPROTO_NOP */
+	sql_route,                              /* IPROTO_PREPARE */
+	NULL,                                   /* IPROTO_BEGIN */
+	NULL,                                   /* IPROTO_COMMIT */
+	NULL,                                   /* IPROTO_ROLLBACK */
+	batch_route,                            /* IPROTO_BATCH */
+	fetch_route,                            /* IPROTO_FETCH */
 };
 
 static const struct cmsg_hop join_route[] = {
@@ -1184,6 +1808,7 @@ iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		cmsg_init(&msg->base, call_route);
 		break;
 	case IPROTO_EXECUTE:
+	case IPROTO_PREPARE:
 		if (xrow_decode_sql(&msg->header, &msg->sql) != 0)
 			goto error;
 		cmsg_init(&msg->base, sql_route);
@@ -1208,11 +1833,41 @@ iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 			goto error;
 		cmsg_init(&msg->base, misc_route);
 		break;
+	case IPROTO_BEGIN:
+	case IPROTO_COMMIT:
+	case IPROTO_ROLLBACK:
+		/*
+		 * A transaction must be finished by the same
+		 * fiber it was started in, which is only
+		 * guaranteed for requests of a stream.
+		 */
+		if (msg->header.stream_id == 0) {
+			diag_set(ClientError,
+				 ER_UNABLE_TO_PROCESS_OUT_OF_STREAM,
+				 iproto_type_name(type));
+			goto error;
+		}
+		cmsg_init(&msg->base, txn_route);
+		break;
+	case IPROTO_BATCH:
+		if (xrow_decode_batch(&msg->header, &msg->batch) != 0)
+			goto error;
+		cmsg_init(&msg->base, batch_route);
+		break;
+	case IPROTO_FETCH:
+		if (xrow_decode_fetch(&msg->header, &msg->fetch) != 0)
+			goto error;
+		cmsg_init(&msg->base, fetch_route);
+		break;
 	default:
 		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
 			 (uint32_t) type);
 		goto error;
 	}
+	if (msg->header.stream_id != 0 && iproto_type_is_stream(type)) {
+		msg->stream_route = msg->base.route;
+		cmsg_init(&msg->base, stream_route);
+	}
 	return;
 error:
 	/** Log and send the error. */
@@ -1227,6 +1882,7 @@ tx_fiber_init(struct session *session, uint64_t sync)
 {
 	struct fiber *f = fiber();
 	f->storage.net.sync = sync;
+	f->storage.net.wal_wait = 0;
 	/*
 	 * We do not cleanup fiber keys at the end of each request.
 	 * This does not lead to privilege escalation as long as
@@ -1241,68 +1897,673 @@ tx_fiber_init(struct session *session, uint64_t sync)
 	fiber_set_user(f, &session->credentials);
 }
 
-static void
-tx_process_disconnect(struct cmsg *m)
-{
-	struct iproto_connection *con =
-		container_of(m, struct iproto_connection, disconnect_msg);
-	if (con->session != NULL) {
-		session_close(con->session);
-		if (! rlist_empty(&session_on_disconnect)) {
-			tx_fiber_init(con->session, 0);
-			session_run_on_disconnect_triggers(con->session);
-		}
-	}
-}
+/* {{{ Request latency */
 
 /**
- * Destroy the session object, as well as output buffers of the
- * connection.
+ * Latency histograms of the stages of request processing.
+ * Collected in tx thread when a reply is ready.
  */
-static void
-tx_process_destroy(struct cmsg *m)
-{
-	struct iproto_connection *con =
-		container_of(m, struct iproto_connection, destroy_msg);
-	if (con->session) {
-		session_destroy(con->session);
-		con->session = NULL; /* safety */
-	}
-	/*
-	 * Got to be done in iproto thread since
-	 * that's where the memory is allocated.
-	 */
-	obuf_destroy(&con->obuf[0]);
-	obuf_destroy(&con->obuf[1]);
-}
+struct iproto_latency {
+	/** Number of requests. */
+	uint64_t count;
+	/** Time between a request is read and its processing starts. */
+	struct latency net;
+	/** Time to process a request in tx, including WAL wait. */
+	struct latency tx;
+	/** Time a request waited for WAL. */
+	struct latency wal;
+};
+
+/** Latency of a called function. */
+struct iproto_func_latency {
+	struct iproto_latency latency;
+	uint32_t name_len;
+	char name[0];
+};
 
 /**
- * Cleanup the net thread resources of a connection
- * and close the connection.
+ * Functions are tracked by name, and a client may call any
+ * number of distinct names, so the number is limited.
  */
-static void
-net_finish_destroy(struct cmsg *m)
-{
-	struct iproto_connection *con =
-		container_of(m, struct iproto_connection, destroy_msg);
-	/* Runs the trigger, which may yield. */
-	iproto_connection_delete(con);
-}
+enum { IPROTO_FUNC_LATENCY_MAX = 1000 };
+
+/** Latency of requests by IPROTO type. */
+static struct iproto_latency tx_type_latency[IPROTO_TYPE_STAT_MAX];
 
+/** Latency of called functions, by name. */
+static struct mh_strnptr_t *tx_func_latency;
 
 static int
-tx_check_schema(uint32_t new_schema_version)
+iproto_latency_create(struct iproto_latency *latency)
 {
-	if (new_schema_version && new_schema_version != schema_version) {
-		diag_set(ClientError, ER_WRONG_SCHEMA_VERSION,
-			 new_schema_version, schema_version);
-		return -1;
-	}
+	latency->count = 0;
+	if (latency_create(&latency->net) != 0)
+		goto fail;
+	if (latency_create(&latency->tx) != 0)
+		goto fail_net;
+	if (latency_create(&latency->wal) != 0)
+		goto fail_tx;
 	return 0;
+fail_tx:
+	latency_destroy(&latency->tx);
+fail_net:
+	latency_destroy(&latency->net);
+fail:
+	diag_set(OutOfMemory, sizeof(struct latency), "malloc", "latency");
+	return -1;
 }
 
 static void
-net_discard_input(struct cmsg *m)
+iproto_latency_destroy(struct iproto_latency *latency)
+{
+	latency_destroy(&latency->net);
+	latency_destroy(&latency->tx);
+	latency_destroy(&latency->wal);
+}
+
+static void
+iproto_latency_reset(struct iproto_latency *latency)
+{
+	latency->count = 0;
+	latency_reset(&latency->net);
+	latency_reset(&latency->tx);
+	latency_reset(&latency->wal);
+}
+
+/**
+ * Find the latency of a called function, create it if it is
+ * not tracked yet. Returns NULL if the function is not tracked.
+ */
+static struct iproto_latency *
+tx_func_latency_find(const char *name, uint32_t name_len)
+{
+	mh_int_t k = mh_strnptr_find_inp(tx_func_latency, name, name_len);
+	if (k != mh_end(tx_func_latency)) {
+		struct iproto_func_latency *func =
+			(struct iproto_func_latency *)
+			mh_strnptr_node(tx_func_latency, k)->val;
+		return &func->latency;
+	}
+	if (mh_size(tx_func_latency) >= IPROTO_FUNC_LATENCY_MAX)
+		return NULL;
+	struct iproto_func_latency *func = (struct iproto_func_latency *)
+		malloc(sizeof(*func) + name_len + 1);
+	if (func == NULL)
+		return NULL;
+	if (iproto_latency_create(&func->latency) != 0) {
+		diag_clear(diag_get());
+		free(func);
+		return NULL;
+	}
+	memcpy(func->name, name, name_len);
+	func->name[name_len] = '\0';
+	func->name_len = name_len;
+	const struct mh_strnptr_node_t node = {
+		func->name, name_len, mh_strn_hash(name, name_len), func
+	};
+	k = mh_strnptr_put(tx_func_latency, &node, NULL, NULL);
+	if (k == mh_end(tx_func_latency)) {
+		iproto_latency_destroy(&func->latency);
+		free(func);
+		return NULL;
+	}
+	return &func->latency;
+}
+
+/**
+ * Account the latency of a request which reply has just been
+ * written to the output buffer.
+ */
+static void
+tx_latency_collect(struct iproto_msg *msg)
+{
+	/* Connect and the like are not requests. */
+	if (msg->tx_start == 0)
+		return;
+	uint32_t type = msg->header.type;
+	if (type >= IPROTO_TYPE_STAT_MAX)
+		return;
+	double net = MAX(msg->tx_start - msg->queue_time, 0);
+	double tx = clock_monotonic() - msg->tx_start;
+	double wal = fiber()->storage.net.wal_wait;
+	struct iproto_latency *latency[] = {
+		&tx_type_latency[type], msg->func_latency
+	};
+	for (unsigned i = 0; i < lengthof(latency); i++) {
+		if (latency[i] == NULL)
+			continue;
+		latency[i]->count++;
+		latency_collect(&latency[i]->net, net);
+		latency_collect(&latency[i]->tx, tx);
+		latency_collect(&latency[i]->wal, wal);
+	}
+	msg->tx_start = 0;
+}
+
+/**
+ * Set the write position of a request to the end of its
+ * reply and account the request latency.
+ */
+static inline void
+tx_end_msg(struct iproto_msg *msg, struct obuf *out)
+{
+	iproto_wpos_create(&msg->wpos, out);
+	tx_latency_collect(msg);
+}
+
+static void
+tx_latency_init(void)
+{
+	for (int i = 0; i < IPROTO_TYPE_STAT_MAX; i++) {
+		if (iproto_latency_create(&tx_type_latency[i]) != 0)
+			diag_raise();
+	}
+	tx_func_latency = mh_strnptr_new();
+	if (tx_func_latency == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*tx_func_latency),
+			  "mh_strnptr_new", "tx_func_latency");
+	}
+}
+
+static void
+iproto_latency_stat_stage(struct info_handler *h, const char *name,
+			  struct latency *latency)
+{
+	info_table_begin(h, name);
+	info_append_double(h, "p50", latency_get(latency, 50));
+	info_append_double(h, "p90", latency_get(latency, 90));
+	info_append_double(h, "p99", latency_get(latency, 99));
+	info_append_double(h, "p999", latency_get_permille(latency, 999));
+	info_table_end(h);
+}
+
+static void
+iproto_latency_stat_append(struct info_handler *h, const char *name,
+			   struct iproto_latency *latency)
+{
+	info_table_begin(h, name);
+	info_append_int(h, "count", latency->count);
+	iproto_latency_stat_stage(h, "net", &latency->net);
+	iproto_latency_stat_stage(h, "tx", &latency->tx);
+	iproto_latency_stat_stage(h, "wal", &latency->wal);
+	info_table_end(h);
+}
+
+void
+iproto_latency_stat(struct info_handler *h)
+{
+	info_begin(h);
+	for (int i = 0; i < IPROTO_TYPE_STAT_MAX; i++) {
+		struct iproto_latency *latency = &tx_type_latency[i];
+		const char *name = iproto_type_name(i);
+		if (latency->count == 0 || name == NULL)
+			continue;
+		iproto_latency_stat_append(h, name, latency);
+	}
+	info_table_begin(h, "functions");
+	mh_int_t k;
+	mh_foreach(tx_func_latency, k) {
+		struct iproto_func_latency *func =
+			(struct iproto_func_latency *)
+			mh_strnptr_node(tx_func_latency, k)->val;
+		if (func->latency.count == 0)
+			continue;
+		iproto_latency_stat_append(h, func->name, &func->latency);
+	}
+	info_table_end(h);
+	info_end(h);
+}
+
+/**
+ * The functions are reset in place rather than freed: a call
+ * in progress refers to the latency of its function, and adds
+ * to it when it completes.
+ */
+static void
+tx_latency_reset(void)
+{
+	for (int i = 0; i < IPROTO_TYPE_STAT_MAX; i++)
+		iproto_latency_reset(&tx_type_latency[i]);
+	mh_int_t k;
+	mh_foreach(tx_func_latency, k) {
+		struct iproto_func_latency *func =
+			(struct iproto_func_latency *)
+			mh_strnptr_node(tx_func_latency, k)->val;
+		iproto_latency_reset(&func->latency);
+	}
+}
+
+/* }}} */
+
+/** Memory pool for struct iproto_stream, used in tx thread. */
+static struct mempool iproto_stream_pool;
+
+/**
+ * A stream is a sequence of requests of a connection sharing
+ * the same IPROTO_STREAM_ID. Requests of a stream are processed
+ * one by one by a dedicated fiber, so a transaction started by
+ * IPROTO_BEGIN spans all requests up to IPROTO_COMMIT or
+ * IPROTO_ROLLBACK. A stream exists as long as it has requests
+ * to process or an open transaction.
+ */
+struct iproto_stream {
+	/** Stream id, unique within the connection. */
+	uint64_t id;
+	/** Connection the stream belongs to. */
+	struct iproto_connection *connection;
+	/** Requests waiting to be processed, linked by cmsg::fifo. */
+	struct stailq pending;
+	/** Fiber processing the requests of the stream. */
+	struct fiber *fiber;
+	/**
+	 * Signaled when a request is queued to the stream or
+	 * the client disconnects.
+	 */
+	struct fiber_cond cond;
+	/**
+	 * Set if the open transaction was aborted, because its
+	 * engine can't wait for the next request. Requests other
+	 * than IPROTO_ROLLBACK and IPROTO_COMMIT fail until the
+	 * transaction ends.
+	 */
+	bool is_txn_aborted;
+	/** Set while the fiber waits for the next request. */
+	bool is_idle;
+};
+
+/** Memory pool for struct iproto_cursor, used in tx thread. */
+static struct mempool iproto_cursor_pool;
+
+/**
+ * A server-side cursor is an index iterator opened by SELECT
+ * with IPROTO_CURSOR and read by IPROTO_FETCH requests of the
+ * same connection, so that a client paging through a large
+ * result doesn't re-position the iterator for each page.
+ */
+struct iproto_cursor {
+	/** Cursor id, unique within the connection. */
+	uint64_t id;
+	/** Connection the cursor belongs to. */
+	struct iproto_connection *connection;
+	/** Index iterator. */
+	struct iterator *it;
+	/** True while a request is reading from the cursor. */
+	bool is_busy;
+	/** Time of the last request to the cursor. */
+	double last_used;
+	/** Link in tx_cursor_lru, unless the cursor is busy. */
+	struct rlist in_lru;
+};
+
+/**
+ * Idle cursors of all connections, least recently used first.
+ * Used to close cursors idle for longer than net_cursor_timeout.
+ */
+static RLIST_HEAD(tx_cursor_lru);
+
+/** Fires when the least recently used cursor expires. */
+static struct ev_timer tx_cursor_timer;
+
+/** Idle time after which a cursor is closed, in seconds. */
+static double tx_cursor_timeout = 60;
+
+/** Arm the timer to close the least recently used cursor. */
+static void
+tx_cursor_timer_start(void)
+{
+	if (ev_is_active(&tx_cursor_timer) || rlist_empty(&tx_cursor_lru))
+		return;
+	struct iproto_cursor *cursor =
+		rlist_first_entry(&tx_cursor_lru, struct iproto_cursor,
+				  in_lru);
+	double timeout = cursor->last_used + tx_cursor_timeout -
+			 ev_monotonic_now(loop());
+	ev_timer_set(&tx_cursor_timer, MAX(timeout, 0), 0);
+	ev_timer_start(loop(), &tx_cursor_timer);
+}
+
+/** Close a cursor. */
+static void
+tx_cursor_delete(struct iproto_cursor *cursor)
+{
+	struct mh_i64ptr_t *cursors = cursor->connection->tx.cursors;
+	mh_int_t k = mh_i64ptr_find(cursors, cursor->id, NULL);
+	assert(k != mh_end(cursors));
+	mh_i64ptr_del(cursors, k, NULL);
+	rlist_del_entry(cursor, in_lru);
+	iterator_delete(cursor->it);
+	mempool_free(&iproto_cursor_pool, cursor);
+}
+
+/** Close all cursors of a connection. */
+static void
+tx_cursor_delete_all(struct iproto_connection *con)
+{
+	struct mh_i64ptr_t *cursors = con->tx.cursors;
+	while (mh_size(cursors) > 0) {
+		mh_int_t k = mh_first(cursors);
+		struct iproto_cursor *cursor = (struct iproto_cursor *)
+			mh_i64ptr_node(cursors, k)->val;
+		assert(!cursor->is_busy);
+		tx_cursor_delete(cursor);
+	}
+}
+
+static void
+tx_cursor_timer_cb(ev_loop *loop, struct ev_timer *watcher, int revents)
+{
+	(void) watcher;
+	(void) revents;
+	double now = ev_monotonic_now(loop);
+	while (!rlist_empty(&tx_cursor_lru)) {
+		struct iproto_cursor *cursor =
+			rlist_first_entry(&tx_cursor_lru,
+					  struct iproto_cursor, in_lru);
+		if (cursor->last_used + tx_cursor_timeout > now)
+			break;
+		tx_cursor_delete(cursor);
+	}
+	tx_cursor_timer_start();
+}
+
+/**
+ * Open a cursor for a SELECT request. The cursor is returned
+ * busy, see tx_cursor_release().
+ */
+static struct iproto_cursor *
+tx_cursor_new(struct iproto_connection *con, struct request *req)
+{
+	rmean_collect(rmean_box, IPROTO_SELECT, 1);
+	struct iterator *it = box_index_iterator(req->space_id, req->index_id,
+						 req->iterator, req->key,
+						 req->key_end);
+	if (it == NULL)
+		return NULL;
+	struct iproto_cursor *cursor = (struct iproto_cursor *)
+		mempool_alloc(&iproto_cursor_pool);
+	if (cursor == NULL) {
+		diag_set(OutOfMemory, sizeof(*cursor), "mempool_alloc",
+			 "cursor");
+		iterator_delete(it);
+		return NULL;
+	}
+	cursor->id = ++con->tx.last_cursor_id;
+	struct mh_i64ptr_node_t node = { cursor->id, cursor };
+	if (mh_i64ptr_put(con->tx.cursors, &node, NULL, NULL) ==
+	    mh_end(con->tx.cursors)) {
+		diag_set(OutOfMemory, sizeof(node), "mh_i64ptr_put",
+			 "cursor");
+		mempool_free(&iproto_cursor_pool, cursor);
+		iterator_delete(it);
+		return NULL;
+	}
+	cursor->connection = con;
+	cursor->it = it;
+	cursor->is_busy = true;
+	cursor->last_used = ev_monotonic_now(loop());
+	rlist_create(&cursor->in_lru);
+	return cursor;
+}
+
+/**
+ * Find a cursor of the connection for a FETCH request and
+ * mark it busy, so that the cursor isn't read by two requests
+ * at once and doesn't expire while in use.
+ */
+static struct iproto_cursor *
+tx_cursor_acquire(struct iproto_connection *con, uint64_t id)
+{
+	mh_int_t k = mh_i64ptr_find(con->tx.cursors, id, NULL);
+	if (k == mh_end(con->tx.cursors)) {
+		diag_set(ClientError, ER_NO_SUCH_CURSOR,
+			 (unsigned long long) id);
+		return NULL;
+	}
+	struct iproto_cursor *cursor = (struct iproto_cursor *)
+		mh_i64ptr_node(con->tx.cursors, k)->val;
+	if (cursor->is_busy) {
+		diag_set(ClientError, ER_CURSOR_BUSY,
+			 (unsigned long long) id);
+		return NULL;
+	}
+	cursor->is_busy = true;
+	rlist_del_entry(cursor, in_lru);
+	return cursor;
+}
+
+/** Make a cursor idle after a request is done with it. */
+static void
+tx_cursor_release(struct iproto_cursor *cursor)
+{
+	assert(cursor->is_busy);
+	cursor->is_busy = false;
+	cursor->last_used = ev_monotonic_now(loop());
+	rlist_add_tail_entry(&tx_cursor_lru, cursor, in_lru);
+	tx_cursor_timer_start();
+}
+
+/**
+ * Read up to @a limit tuples from a cursor to a port, after
+ * skipping @a offset tuples. May yield.
+ * @param[out] is_eof Set if the iterator is exhausted.
+ */
+static int
+tx_cursor_read(struct iproto_cursor *cursor, uint32_t offset,
+	       uint32_t limit, struct port *port, bool *is_eof)
+{
+	struct tuple *tuple;
+	uint32_t found = 0;
+	*is_eof = false;
+	port_tuple_create(port);
+	while (found < limit) {
+		if (iterator_next(cursor->it, &tuple) != 0)
+			goto error;
+		if (tuple == NULL) {
+			*is_eof = true;
+			break;
+		}
+		if (offset > 0) {
+			offset--;
+			continue;
+		}
+		if (port_tuple_add(port, tuple) != 0)
+			goto error;
+		found++;
+	}
+	return 0;
+error:
+	port_destroy(port);
+	return -1;
+}
+
+/**
+ * Send tuples read from a cursor to the client, followed by
+ * the cursor id unless the cursor is exhausted, in which case
+ * it is closed:
+ * IPROTO_DATA: [tuple, ...], IPROTO_CURSOR_ID: id
+ * Destroys the port.
+ */
+static int
+tx_cursor_reply(struct iproto_msg *msg, struct iproto_cursor *cursor,
+		struct port *port, bool is_eof)
+{
+	struct obuf *out = msg->connection->tx.p_obuf;
+	struct obuf_svp svp;
+	int keys = 1;
+	int count;
+	char *pos;
+	size_t size = mp_sizeof_uint(IPROTO_DATA) +
+		      mp_sizeof_array(UINT32_MAX);
+	if (iproto_prepare_header(out, &svp, IPROTO_SQL_HEADER_LEN) != 0)
+		goto error;
+	pos = (char *) obuf_alloc(out, size);
+	if (pos == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "pos");
+		goto rollback;
+	}
+	pos = mp_encode_uint(pos, IPROTO_DATA);
+	count = port_dump_msgpack_16(port, out);
+	if (count < 0)
+		goto rollback;
+	/* Patch the array header reserved above. */
+	*(pos++) = 0xdd;
+	mp_store_u32(pos, count);
+	if (!is_eof) {
+		size = mp_sizeof_uint(IPROTO_CURSOR_ID) +
+		       mp_sizeof_uint(cursor->id);
+		pos = (char *) obuf_alloc(out, size);
+		if (pos == NULL) {
+			diag_set(OutOfMemory, size, "obuf_alloc", "pos");
+			goto rollback;
+		}
+		pos = mp_encode_uint(pos, IPROTO_CURSOR_ID);
+		pos = mp_encode_uint(pos, cursor->id);
+		keys = 2;
+	}
+	iproto_reply_sql(out, &svp, msg->header.sync, ::schema_version, keys);
+	tx_end_msg(msg, out);
+	port_destroy(port);
+	if (is_eof)
+		tx_cursor_delete(cursor);
+	else
+		tx_cursor_release(cursor);
+	return 0;
+rollback:
+	obuf_rollback_to_svp(out, &svp);
+error:
+	port_destroy(port);
+	tx_cursor_delete(cursor);
+	return -1;
+}
+
+/**
+ * Wake up the fibers of all streams of a connection, so that
+ * those waiting for the next request in a transaction roll it
+ * back and exit after the client has disconnected.
+ */
+static void
+tx_wakeup_streams(struct iproto_connection *con)
+{
+	struct mh_i64ptr_t *streams = con->tx.streams;
+	mh_int_t k;
+	mh_foreach(streams, k) {
+		struct iproto_stream *stream = (struct iproto_stream *)
+			mh_i64ptr_node(streams, k)->val;
+		fiber_cond_signal(&stream->cond);
+	}
+}
+
+static void
+tx_process_disconnect(struct cmsg *m)
+{
+	struct iproto_connection *con =
+		container_of(m, struct iproto_connection, disconnect_msg);
+	con->tx.is_disconnected = true;
+	tx_wakeup_streams(con);
+	if (con->session != NULL) {
+		session_close(con->session);
+		if (! rlist_empty(&session_on_disconnect)) {
+			tx_fiber_init(con->session, 0);
+			session_run_on_disconnect_triggers(con->session);
+		}
+	}
+}
+
+/** Unpin tuples of the splices in @a list and free them. */
+static void
+tx_splice_release_list(struct stailq *list)
+{
+	struct iproto_splice *splice, *next;
+	stailq_foreach_entry_safe(splice, next, list, in_list) {
+		tuple_unref(splice->tuple);
+		mempool_free(&iproto_splice_pool, splice);
+	}
+	stailq_create(list);
+}
+
+static void
+tx_release_splices(struct cmsg *m)
+{
+	struct iproto_splice_msg *msg = (struct iproto_splice_msg *) m;
+	tx_splice_release_list(&msg->splices);
+}
+
+static void
+net_end_release_splices(struct cmsg *m)
+{
+	struct iproto_connection *con =
+		container_of(m, struct iproto_connection, splice_msg.base);
+	con->is_splice_sent = false;
+	/*
+	 * Splices of a closed connection are released by
+	 * tx_process_destroy(), don't touch them here.
+	 */
+	if (evio_has_fd(&con->output))
+		iproto_connection_release_splices(con);
+}
+
+/**
+ * Destroy the session object, as well as output buffers of the
+ * connection.
+ */
+static void
+tx_process_destroy(struct cmsg *m)
+{
+	struct iproto_connection *con =
+		container_of(m, struct iproto_connection, destroy_msg);
+	/*
+	 * The connection has no requests in progress, but
+	 * fibers of streams with an open transaction may not
+	 * have noticed the disconnect yet.
+	 */
+	while (mh_size(con->tx.streams) > 0)
+		fiber_cond_wait(&con->tx.stream_deleted);
+	tx_cursor_delete_all(con);
+	/*
+	 * The connection is closed, so iproto won't write
+	 * the rest of the splices.
+	 */
+	tx_splice_release_list(&con->splices);
+	tx_splice_release_list(&con->spliced);
+	if (con->session) {
+		session_destroy(con->session);
+		con->session = NULL; /* safety */
+	}
+	/*
+	 * Got to be done in iproto thread since
+	 * that's where the memory is allocated.
+	 */
+	obuf_destroy(&con->obuf[0]);
+	obuf_destroy(&con->obuf[1]);
+}
+
+/**
+ * Cleanup the net thread resources of a connection
+ * and close the connection.
+ */
+static void
+net_finish_destroy(struct cmsg *m)
+{
+	struct iproto_connection *con =
+		container_of(m, struct iproto_connection, destroy_msg);
+	/* Runs the trigger, which may yield. */
+	iproto_connection_delete(con);
+}
+
+
+static int
+tx_check_schema(uint32_t new_schema_version)
+{
+	if (new_schema_version && new_schema_version != schema_version) {
+		diag_set(ClientError, ER_WRONG_SCHEMA_VERSION,
+			 new_schema_version, schema_version);
+		return -1;
+	}
+	return 0;
+}
+
+static void
+net_discard_input(struct cmsg *m)
 {
 	struct iproto_msg *msg = container_of(m, struct iproto_msg,
 					      discard_input);
@@ -1310,6 +2571,7 @@ net_discard_input(struct cmsg *m)
 	msg->p_ibuf->rpos += msg->len;
 	msg->len = 0;
 	con->long_poll_count++;
+	iproto_leave_tx_window(msg);
 	if (evio_has_fd(&con->input) && !ev_is_active(&con->input) &&
 	    rlist_empty(&con->in_stop_list))
 		ev_feed_event(con->loop, &con->input, EV_READ);
@@ -1370,6 +2632,8 @@ tx_accept_msg(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	tx_accept_wpos(msg->connection, &msg->wpos);
 	tx_fiber_init(msg->connection->session, msg->header.sync);
+	msg->tx_start = clock_monotonic();
+	msg->func_latency = NULL;
 	return msg;
 }
 
@@ -1383,7 +2647,7 @@ tx_reply_error(struct iproto_msg *msg)
 	struct obuf *out = msg->connection->tx.p_obuf;
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 }
 
 /**
@@ -1397,7 +2661,7 @@ tx_reply_iproto_error(struct cmsg *m)
 	struct obuf *out = msg->connection->tx.p_obuf;
 	iproto_reply_error(out, diag_last_error(&msg->diag),
 			   msg->header.sync, ::schema_version);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 }
 
 /** Inject a short delay on tx request processing for testing. */
@@ -1430,12 +2694,64 @@ tx_process1(struct cmsg *m)
 		goto error;
 	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
 			    tuple != 0);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 	return;
 error:
 	tx_reply_error(msg);
 }
 
+/**
+ * Dump tuples of a SELECT result to the output buffer in
+ * Tarantool 1.6 format. Large tuples are not copied: they are
+ * pinned and written to the socket right from the tuple memory
+ * by iproto thread, see struct iproto_splice.
+ *
+ * @param msg Request message, accumulates the splices.
+ * @param port Port with the tuples.
+ * @param out Output buffer.
+ * @param[out] spliced Size of the spliced tuple data.
+ *
+ * @retval >= 0 Number of tuples dumped.
+ * @retval -1 Memory error.
+ */
+static int
+tx_dump_select(struct iproto_msg *msg, struct port *port,
+	       struct obuf *out, size_t *spliced)
+{
+	struct port_tuple *tuples = port_tuple(port);
+	struct port_tuple_entry *pe;
+	*spliced = 0;
+	for (pe = tuples->first; pe != NULL; pe = pe->next) {
+		struct tuple *tuple = pe->tuple;
+		ERROR_INJECT(ERRINJ_PORT_DUMP, {
+			diag_set(OutOfMemory, tuple_size(tuple), "obuf_dup",
+				 "data");
+			return -1;
+		});
+		if (tuple->bsize < IPROTO_SPLICE_SIZE_MIN) {
+			if (tuple_to_obuf(tuple, out) != 0)
+				return -1;
+			continue;
+		}
+		struct iproto_splice *splice = (struct iproto_splice *)
+			mempool_alloc(&iproto_splice_pool);
+		if (splice == NULL) {
+			diag_set(OutOfMemory, sizeof(*splice),
+				 "mempool_alloc", "splice");
+			return -1;
+		}
+		tuple_ref(tuple);
+		splice->tuple = tuple;
+		splice->data = tuple_data_range(tuple, &splice->size);
+		splice->written = 0;
+		splice->obuf = out;
+		splice->used = obuf_size(out);
+		stailq_add_tail_entry(&msg->splices, splice, in_list);
+		*spliced += splice->size;
+	}
+	return tuples->size;
+}
+
 static void
 tx_process_select(struct cmsg *m)
 {
@@ -1446,10 +2762,26 @@ tx_process_select(struct cmsg *m)
 	int count;
 	int rc;
 	struct request *req = &msg->dml;
+	struct iproto_cursor *cursor;
+	bool is_eof;
+	size_t spliced;
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
 
 	tx_inject_delay();
+	if (req->is_cursor) {
+		cursor = tx_cursor_new(msg->connection, req);
+		if (cursor == NULL)
+			goto error;
+		if (tx_cursor_read(cursor, req->offset, req->limit,
+				   &port, &is_eof) != 0) {
+			tx_cursor_delete(cursor);
+			goto error;
+		}
+		if (tx_cursor_reply(msg, cursor, &port, is_eof) != 0)
+			goto error;
+		return;
+	}
 	rc = box_select(req->space_id, req->index_id,
 			req->iterator, req->offset, req->limit,
 			req->key, req->key_end, &port);
@@ -1464,26 +2796,87 @@ tx_process_select(struct cmsg *m)
 	/*
 	 * SELECT output format has not changed since Tarantool 1.6
 	 */
-	count = port_dump_msgpack_16(&port, out);
+	count = tx_dump_select(msg, &port, out, &spliced);
 	port_destroy(&port);
 	if (count < 0) {
 		/* Discard the prepared select. */
+		tx_splice_release_list(&msg->splices);
 		obuf_rollback_to_svp(out, &svp);
 		goto error;
 	}
 	iproto_reply_select(out, &svp, msg->header.sync,
 			    ::schema_version, count);
-	iproto_wpos_create(&msg->wpos, out);
+	if (spliced > 0) {
+		/* The body length must account the spliced tuples. */
+		iproto_header_encode((char *) obuf_svp_to_ptr(out, &svp),
+				     IPROTO_OK, msg->header.sync,
+				     ::schema_version, obuf_size(out) -
+				     svp.used - IPROTO_HEADER_LEN + spliced);
+	}
+	tx_end_msg(msg, out);
+	return;
+error:
+	tx_reply_error(msg);
+}
+
+static void
+tx_process_fetch(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	struct fetch_request *req = &msg->fetch;
+	struct iproto_cursor *cursor;
+	struct port port;
+	bool is_eof = true;
+	if (tx_check_schema(msg->header.schema_version))
+		goto error;
+
+	cursor = tx_cursor_acquire(msg->connection, req->cursor_id);
+	if (cursor == NULL)
+		goto error;
+	tx_inject_delay();
+	/* FETCH with zero limit closes the cursor. */
+	if (req->limit == 0) {
+		port_tuple_create(&port);
+	} else if (tx_cursor_read(cursor, 0, req->limit, &port,
+				  &is_eof) != 0) {
+		tx_cursor_delete(cursor);
+		goto error;
+	}
+	if (tx_cursor_reply(msg, cursor, &port, is_eof) != 0)
+		goto error;
 	return;
 error:
 	tx_reply_error(msg);
 }
 
+/**
+ * Check if a CALL failed before running the function body:
+ * the function is not defined or the user may not call it.
+ */
+static bool
+tx_call_is_rejected(void)
+{
+	struct error *e = diag_last_error(diag_get());
+	if (e->type == &type_AccessDeniedError)
+		return true;
+	return e->type == &type_ClientError &&
+	       box_error_code(e) == ER_NO_SUCH_PROC;
+}
+
 static void
 tx_process_call_on_yield(struct trigger *trigger, void *event)
 {
 	(void)event;
 	struct iproto_msg *msg = (struct iproto_msg *)trigger->data;
+	/*
+	 * Only the function body yields, so the function has
+	 * been resolved and access to it granted by now. Take
+	 * its latency slot while the name is still there.
+	 */
+	if (msg->header.type != IPROTO_EVAL) {
+		msg->func_latency = tx_func_latency_find(msg->call.name,
+							 msg->call.name_len);
+	}
 	TRASH(&msg->call);
 	tx_discard_input(msg);
 	trigger_clear(trigger);
@@ -1512,6 +2905,18 @@ tx_process_call(struct cmsg *m)
 	case IPROTO_CALL:
 	case IPROTO_CALL_16:
 		rc = box_process_call(&msg->call, &port);
+		/*
+		 * A function that yielded got its latency slot in
+		 * the on_yield trigger, which clears itself, and
+		 * its name is gone. Don't create slots for names
+		 * that were never resolved to a function.
+		 */
+		if (!rlist_empty(&fiber_on_yield.link) &&
+		    (rc == 0 || !tx_call_is_rejected())) {
+			msg->func_latency =
+				tx_func_latency_find(msg->call.name,
+						     msg->call.name_len);
+		}
 		break;
 	case IPROTO_EVAL:
 		rc = box_process_eval(&msg->call, &port);
@@ -1562,7 +2967,7 @@ tx_process_call(struct cmsg *m)
 
 	iproto_reply_select(out, &svp, msg->header.sync,
 			    ::schema_version, count);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 	return;
 error:
 	tx_reply_error(msg);
@@ -1602,7 +3007,7 @@ tx_process_misc(struct cmsg *m)
 		default:
 			unreachable();
 		}
-		iproto_wpos_create(&msg->wpos, out);
+		tx_end_msg(msg, out);
 	} catch (Exception *e) {
 		tx_reply_error(msg);
 	}
@@ -1621,28 +3026,52 @@ tx_process_sql(struct cmsg *m)
 	int bind_count;
 	const char *sql;
 	uint32_t len;
+	uint32_t stmt_id;
+	int keys;
+	struct obuf_svp header_svp;
 
 	tx_fiber_init(msg->connection->session, msg->header.sync);
 
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
-	assert(msg->header.type == IPROTO_EXECUTE);
+	assert(msg->header.type == IPROTO_EXECUTE ||
+	       msg->header.type == IPROTO_PREPARE);
 	tx_inject_delay();
+	if (msg->header.type == IPROTO_PREPARE) {
+		rmean_collect(rmean_box, IPROTO_PREPARE, 1);
+		sql = msg->sql.sql_text;
+		sql = mp_decode_str(&sql, &len);
+		if (sql_prepare(sql, len, &stmt_id) != 0)
+			goto error;
+		out = msg->connection->tx.p_obuf;
+		if (iproto_prepare_header(out, &header_svp,
+					  IPROTO_SQL_HEADER_LEN) != 0)
+			goto error;
+		if (sql_prepare_dump(stmt_id, &keys, out) != 0) {
+			obuf_rollback_to_svp(out, &header_svp);
+			goto error;
+		}
+		goto reply;
+	}
 	bind_count = sql_bind_list_decode(msg->sql.bind, &bind);
 	if (bind_count < 0)
 		goto error;
-	sql = msg->sql.sql_text;
-	sql = mp_decode_str(&sql, &len);
-	if (sql_prepare_and_execute(sql, len, bind, bind_count, &response,
-				    &fiber()->gc) != 0)
-		goto error;
+	if (msg->sql.stmt_id != 0) {
+		if (sql_execute_prepared(msg->sql.stmt_id, bind, bind_count,
+					 &response, &fiber()->gc) != 0)
+			goto error;
+	} else {
+		sql = msg->sql.sql_text;
+		sql = mp_decode_str(&sql, &len);
+		if (sql_prepare_and_execute(sql, len, bind, bind_count,
+					    &response, &fiber()->gc) != 0)
+			goto error;
+	}
 	/*
 	 * Take an obuf only after execute(). Else the buffer can
 	 * become out of date during yield.
 	 */
 	out = msg->connection->tx.p_obuf;
-	int keys;
-	struct obuf_svp header_svp;
 	/* Prepare memory for the iproto header. */
 	if (iproto_prepare_header(out, &header_svp, IPROTO_SQL_HEADER_LEN) != 0)
 		goto error;
@@ -1650,14 +3079,517 @@ tx_process_sql(struct cmsg *m)
 		obuf_rollback_to_svp(out, &header_svp);
 		goto error;
 	}
+reply:
 	iproto_reply_sql(out, &header_svp, msg->header.sync, schema_version,
 			 keys);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 	return;
 error:
 	tx_reply_error(msg);
 }
 
+static void
+tx_process_txn(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	struct obuf *out;
+	int rc;
+
+	if (tx_check_schema(msg->header.schema_version))
+		goto error;
+	switch (msg->header.type) {
+	case IPROTO_BEGIN:
+		rc = box_txn_begin();
+		break;
+	case IPROTO_COMMIT:
+		rc = box_txn_commit();
+		break;
+	case IPROTO_ROLLBACK:
+		rc = box_txn_rollback();
+		break;
+	default:
+		unreachable();
+	}
+	if (rc != 0)
+		goto error;
+	/* Take an obuf only after commit, which may yield. */
+	out = msg->connection->tx.p_obuf;
+	if (iproto_reply_ok(out, msg->header.sync, ::schema_version) != 0)
+		goto error;
+	tx_end_msg(msg, out);
+	return;
+error:
+	tx_reply_error(msg);
+}
+
+/** Result of a request of a batch. */
+struct batch_result {
+	/** Tuple returned by the request or NULL. */
+	struct tuple *tuple;
+	/** Error the request failed with or NULL. */
+	struct error *error;
+};
+
+/**
+ * Decode and execute the next request of a batch.
+ * @param msg BATCH message. Its header is used as a template
+ *        for the header of the request, which is written to
+ *        WAL.
+ * @param[in,out] data Pointer to the [type, body] pair of the
+ *        request, advanced past it.
+ * @param[out] result Referenced tuple returned by the request
+ *        or NULL.
+ *
+ * @retval  0 Success.
+ * @retval -1 Error.
+ */
+static int
+tx_process_batch_request(struct iproto_msg *msg, const char **data,
+			 struct tuple **result)
+{
+	mp_decode_array(data);
+	uint64_t type = mp_decode_uint(data);
+	const char *body = *data;
+	mp_next(data);
+	if (type != IPROTO_INSERT && type != IPROTO_REPLACE &&
+	    type != IPROTO_UPDATE && type != IPROTO_DELETE &&
+	    type != IPROTO_UPSERT) {
+		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
+			 (uint32_t) type);
+		return -1;
+	}
+	struct xrow_header *row = region_alloc_object(&fiber()->gc,
+						      struct xrow_header);
+	if (row == NULL) {
+		diag_set(OutOfMemory, sizeof(*row), "region", "xrow_header");
+		return -1;
+	}
+	*row = msg->header;
+	row->type = type;
+	row->bodycnt = 1;
+	row->body[0].iov_base = (void *) body;
+	row->body[0].iov_len = *data - body;
+	struct request request;
+	if (xrow_decode_dml(row, &request, dml_request_key_map(type)) != 0)
+		return -1;
+	if (box_process1(&request, result) != 0)
+		return -1;
+	if (*result != NULL)
+		tuple_ref(*result);
+	return 0;
+}
+
+/**
+ * Encode results of a batch:
+ * IPROTO_DATA: [tuple or nil, ...],
+ * IPROTO_BATCH_ERRORS: {offset: [code, message], ...}
+ * The latter is omitted if all requests succeeded.
+ */
+static int
+tx_batch_dump(struct batch_result *results, uint32_t count,
+	      uint32_t error_count, int *keys, struct obuf *out)
+{
+	int size = mp_sizeof_uint(IPROTO_DATA) + mp_sizeof_array(count);
+	char *pos = (char *) obuf_alloc(out, size);
+	if (pos == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "pos");
+		return -1;
+	}
+	pos = mp_encode_uint(pos, IPROTO_DATA);
+	pos = mp_encode_array(pos, count);
+	for (uint32_t i = 0; i < count; i++) {
+		struct tuple *tuple = results[i].tuple;
+		if (tuple != NULL) {
+			if (tuple_to_obuf(tuple, out) != 0)
+				return -1;
+			continue;
+		}
+		pos = (char *) obuf_alloc(out, mp_sizeof_nil());
+		if (pos == NULL) {
+			diag_set(OutOfMemory, mp_sizeof_nil(), "obuf_alloc",
+				 "pos");
+			return -1;
+		}
+		mp_encode_nil(pos);
+	}
+	*keys = 1;
+	if (error_count == 0)
+		return 0;
+	size = mp_sizeof_uint(IPROTO_BATCH_ERRORS) +
+	       mp_sizeof_map(error_count);
+	pos = (char *) obuf_alloc(out, size);
+	if (pos == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "pos");
+		return -1;
+	}
+	pos = mp_encode_uint(pos, IPROTO_BATCH_ERRORS);
+	pos = mp_encode_map(pos, error_count);
+	for (uint32_t i = 0; i < count; i++) {
+		struct error *e = results[i].error;
+		if (e == NULL)
+			continue;
+		uint32_t code = box_error_code(e);
+		uint32_t len = strlen(e->errmsg);
+		size = mp_sizeof_uint(i) + mp_sizeof_array(2) +
+		       mp_sizeof_uint(code) + mp_sizeof_str(len);
+		pos = (char *) obuf_alloc(out, size);
+		if (pos == NULL) {
+			diag_set(OutOfMemory, size, "obuf_alloc", "pos");
+			return -1;
+		}
+		pos = mp_encode_uint(pos, i);
+		pos = mp_encode_array(pos, 2);
+		pos = mp_encode_uint(pos, code);
+		pos = mp_encode_str(pos, e->errmsg, len);
+	}
+	*keys = 2;
+	return 0;
+}
+
+/**
+ * Execute DML requests of a batch. An atomic batch is executed
+ * in one transaction: the first failed request rolls back all
+ * the previous ones and its error is sent to the client. When
+ * sent to a stream with an open transaction, an atomic batch
+ * is rolled back to a savepoint instead, and the transaction
+ * remains open. Requests of a non-atomic batch are executed
+ * one by one, and errors are sent along with the results.
+ */
+static void
+tx_process_batch(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	struct batch_request *batch = &msg->batch;
+	struct batch_result *results = NULL;
+	box_txn_savepoint_t *svp = NULL;
+	bool is_own_txn = false;
+	uint32_t error_count = 0;
+	struct obuf *out;
+	struct obuf_svp header_svp;
+	const char *data;
+	size_t size;
+	int keys;
+
+	if (tx_check_schema(msg->header.schema_version))
+		goto error;
+	size = sizeof(*results) * batch->count;
+	results = (struct batch_result *) calloc(1, size + 1);
+	if (results == NULL) {
+		diag_set(OutOfMemory, size, "calloc", "results");
+		goto error;
+	}
+	if (batch->is_atomic && in_txn() != NULL) {
+		svp = box_txn_savepoint();
+		if (svp == NULL)
+			goto error;
+	} else if (batch->is_atomic) {
+		if (box_txn_begin() != 0)
+			goto error;
+		is_own_txn = true;
+	}
+	tx_inject_delay();
+	data = batch->requests;
+	mp_decode_array(&data);
+	for (uint32_t i = 0; i < batch->count; i++) {
+		if (tx_process_batch_request(msg, &data,
+					     &results[i].tuple) == 0)
+			continue;
+		if (batch->is_atomic)
+			goto rollback;
+		results[i].error = diag_last_error(diag_get());
+		error_ref(results[i].error);
+		error_count++;
+	}
+	assert(data == batch->requests_end);
+	if (is_own_txn && box_txn_commit() != 0)
+		goto error;
+	/* Take an obuf only after commit, which may yield. */
+	out = msg->connection->tx.p_obuf;
+	if (iproto_prepare_header(out, &header_svp,
+				  IPROTO_SQL_HEADER_LEN) != 0)
+		goto error;
+	if (tx_batch_dump(results, batch->count, error_count,
+			  &keys, out) != 0) {
+		obuf_rollback_to_svp(out, &header_svp);
+		goto error;
+	}
+	iproto_reply_sql(out, &header_svp, msg->header.sync,
+			 ::schema_version, keys);
+	tx_end_msg(msg, out);
+	goto finish;
+rollback:
+	if (is_own_txn) {
+		txn_rollback();
+	} else {
+		/* Can't fail: the savepoint statement is intact. */
+		int rc = box_txn_rollback_to_savepoint(svp);
+		assert(rc == 0);
+		(void) rc;
+	}
+error:
+	tx_reply_error(msg);
+finish:
+	if (results == NULL)
+		return;
+	for (uint32_t i = 0; i < batch->count; i++) {
+		if (results[i].tuple != NULL)
+			tuple_unref(results[i].tuple);
+		if (results[i].error != NULL)
+			error_unref(results[i].error);
+	}
+	free(results);
+}
+
+/**
+ * A statement of a multi-statement transaction references its
+ * request until the transaction ends, see txn_add_redo(), while
+ * the input buffer the request was read to is reused as soon as
+ * the response is sent. Copy the request to the fiber region,
+ * which is not freed until the transaction ends.
+ */
+static int
+tx_stream_copy_request(struct iproto_msg *msg)
+{
+	struct region *region = &fiber()->gc;
+	struct xrow_header *row = region_alloc_object(region,
+						      struct xrow_header);
+	if (row == NULL) {
+		diag_set(OutOfMemory, sizeof(*row), "region", "xrow_header");
+		return -1;
+	}
+	*row = msg->header;
+	if (row->bodycnt > 0) {
+		assert(row->bodycnt == 1);
+		size_t size = row->body[0].iov_len;
+		void *body = region_alloc(region, size);
+		if (body == NULL) {
+			diag_set(OutOfMemory, size, "region", "request body");
+			return -1;
+		}
+		memcpy(body, row->body[0].iov_base, size);
+		row->body[0].iov_base = body;
+	}
+	if (row->type == IPROTO_BATCH)
+		return xrow_decode_batch(row, &msg->batch);
+	return xrow_decode_dml(row, &msg->dml, dml_request_key_map(row->type));
+}
+
+/**
+ * Send a request which could not be queued to its stream
+ * back to iproto thread with an error.
+ */
+static void
+tx_stream_reply_error(struct iproto_msg *msg)
+{
+	cmsg_init(&msg->base, msg->stream_route);
+	tx_accept_msg(&msg->base);
+	tx_reply_error(msg);
+	msg->base.hop++;
+	cpipe_push(&net_pipe, &msg->base);
+}
+
+/**
+ * Abort the open transaction of a stream before waiting for
+ * the next request if its engine doesn't survive a yield.
+ * Memtx would abort it anyway, but the client would only learn
+ * about it at commit, after executing all the requests.
+ */
+static void
+tx_stream_abort_txn_on_wait(struct iproto_stream *stream)
+{
+	struct txn *txn = in_txn();
+	if (stream->is_txn_aborted || txn->engine == NULL ||
+	    (txn->engine->flags & ENGINE_TXN_ABORT_ON_YIELD) == 0)
+		return;
+	txn_abort(txn);
+	stream->is_txn_aborted = true;
+}
+
+/**
+ * Fail a request of an aborted stream transaction with the
+ * error it was aborted with. COMMIT also ends the transaction,
+ * as failed commits do. Return false if the request should be
+ * processed as usual.
+ */
+static bool
+tx_stream_reject_request(struct iproto_stream *stream,
+			 struct iproto_msg *msg)
+{
+	if (!stream->is_txn_aborted || in_txn() == NULL) {
+		stream->is_txn_aborted = false;
+		return false;
+	}
+	if (msg->header.type == IPROTO_ROLLBACK) {
+		stream->is_txn_aborted = false;
+		return false;
+	}
+	diag_set(ClientError, ER_STREAM_TRANSACTION_YIELD,
+		 in_txn()->engine->name);
+	tx_stream_reply_error(msg);
+	if (msg->header.type == IPROTO_COMMIT) {
+		txn_rollback();
+		fiber_gc();
+		stream->is_txn_aborted = false;
+	}
+	return true;
+}
+
+static void
+net_stream_park(struct cmsg *m)
+{
+	struct iproto_msg *msg = container_of(m, struct iproto_msg,
+					      stream_park);
+	iproto_leave_tx_window(msg);
+}
+
+static void
+net_stream_unpark(struct cmsg *m)
+{
+	struct iproto_msg *msg = container_of(m, struct iproto_msg,
+					      stream_unpark);
+	iproto_enter_tx_window(msg);
+}
+
+/**
+ * Free the tx window slot of a request queued behind other
+ * requests of its stream. A stream may wait for a long
+ * request, and the requests queued behind it must not keep
+ * the requests of other connections from being dispatched.
+ */
+static void
+tx_stream_park(struct iproto_msg *msg)
+{
+	static const struct cmsg_hop route[] = {
+		{ net_stream_park, NULL },
+	};
+	msg->is_parked = true;
+	cmsg_init(&msg->stream_park, route);
+	cpipe_push(&net_pipe, &msg->stream_park);
+}
+
+/** Take back the tx window slot of a parked request. */
+static void
+tx_stream_unpark(struct iproto_msg *msg)
+{
+	static const struct cmsg_hop route[] = {
+		{ net_stream_unpark, NULL },
+	};
+	msg->is_parked = false;
+	cmsg_init(&msg->stream_unpark, route);
+	cpipe_push(&net_pipe, &msg->stream_unpark);
+}
+
+/** Process requests of a stream until there is nothing to do. */
+static int
+tx_stream_f(va_list ap)
+{
+	struct iproto_stream *stream = va_arg(ap, struct iproto_stream *);
+	struct iproto_connection *con = stream->connection;
+	while (true) {
+		if (stailq_empty(&stream->pending)) {
+			/*
+			 * Wait for the next request of an open
+			 * transaction. A memtx transaction can't
+			 * wait, so it survives only if the next
+			 * request has already been received, e.g.
+			 * when requests are pipelined.
+			 */
+			if (in_txn() == NULL || con->tx.is_disconnected)
+				break;
+			tx_stream_abort_txn_on_wait(stream);
+			stream->is_idle = true;
+			fiber_cond_wait(&stream->cond);
+			stream->is_idle = false;
+			continue;
+		}
+		struct iproto_msg *msg =
+			stailq_shift_entry(&stream->pending,
+					   struct iproto_msg, base.fifo);
+		if (msg->is_parked)
+			tx_stream_unpark(msg);
+		if (tx_stream_reject_request(stream, msg))
+			continue;
+		if (in_txn() != NULL &&
+		    ((iproto_type_is_dml(msg->header.type) &&
+		      msg->header.type != IPROTO_SELECT) ||
+		     msg->header.type == IPROTO_BATCH) &&
+		    tx_stream_copy_request(msg) != 0) {
+			tx_stream_reply_error(msg);
+			continue;
+		}
+		cmsg_init(&msg->base, msg->stream_route);
+		cmsg_deliver(&msg->base);
+		if (in_txn() == NULL)
+			fiber_gc();
+	}
+	/* The client is gone, roll back the unfinished transaction. */
+	txn_rollback();
+	mh_int_t k = mh_i64ptr_find(con->tx.streams, stream->id, NULL);
+	assert(k != mh_end(con->tx.streams));
+	mh_i64ptr_del(con->tx.streams, k, NULL);
+	fiber_cond_destroy(&stream->cond);
+	mempool_free(&iproto_stream_pool, stream);
+	fiber_cond_broadcast(&con->tx.stream_deleted);
+	return 0;
+}
+
+/**
+ * Queue a request to its stream, creating the stream if it
+ * doesn't exist.
+ */
+static void
+tx_process_stream(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_connection *con = msg->connection;
+	struct mh_i64ptr_t *streams = con->tx.streams;
+	uint64_t id = msg->header.stream_id;
+	struct iproto_stream *stream;
+
+	mh_int_t k = mh_i64ptr_find(streams, id, NULL);
+	if (k != mh_end(streams)) {
+		stream = (struct iproto_stream *)
+			mh_i64ptr_node(streams, k)->val;
+		if (!stream->is_idle || !stailq_empty(&stream->pending))
+			tx_stream_park(msg);
+		stailq_add_tail_entry(&stream->pending, msg, base.fifo);
+		fiber_cond_signal(&stream->cond);
+		return;
+	}
+	stream = (struct iproto_stream *) mempool_alloc(&iproto_stream_pool);
+	if (stream == NULL) {
+		diag_set(OutOfMemory, sizeof(*stream), "mempool_alloc",
+			 "stream");
+		goto error;
+	}
+	struct mh_i64ptr_node_t node;
+	node.key = id;
+	node.val = stream;
+	k = mh_i64ptr_put(streams, &node, NULL, NULL);
+	if (k == mh_end(streams)) {
+		mempool_free(&iproto_stream_pool, stream);
+		diag_set(OutOfMemory, 0, "mh_i64ptr_put", "stream");
+		goto error;
+	}
+	stream->fiber = fiber_new("iproto stream", tx_stream_f);
+	if (stream->fiber == NULL) {
+		mh_i64ptr_del(streams, k, NULL);
+		mempool_free(&iproto_stream_pool, stream);
+		goto error;
+	}
+	stream->id = id;
+	stream->connection = con;
+	stailq_create(&stream->pending);
+	fiber_cond_create(&stream->cond);
+	stream->is_txn_aborted = false;
+	stream->is_idle = false;
+	stailq_add_tail_entry(&stream->pending, msg, base.fifo);
+	fiber_start(stream->fiber, stream);
+	return;
+error:
+	tx_stream_reply_error(msg);
+}
+
 static void
 tx_process_join_subscribe(struct cmsg *m)
 {
@@ -1707,6 +3639,7 @@ net_send_msg(struct cmsg *m)
 		assert(con->long_poll_count > 0);
 		con->long_poll_count--;
 	}
+	stailq_concat(&con->splices, &msg->splices);
 	con->wend = msg->wpos;
 
 	if (evio_has_fd(&con->output)) {
@@ -1862,6 +3795,8 @@ iproto_on_accept(struct evio_service * /* service */, int fd,
 	 */
 	msg = iproto_msg_new(con);
 	if (msg == NULL) {
+		mh_i64ptr_delete(con->tx.streams);
+		mh_i64ptr_delete(con->tx.cursors);
 		mempool_free(&iproto_connection_pool, con);
 		return -1;
 	}
@@ -1886,6 +3821,7 @@ net_cord_f(va_list /* ap */)
 		       sizeof(struct iproto_msg));
 	mempool_create(&iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
+	iproto_priority_init();
 
 	evio_service_init(loop(), &binary, "binary",
 			  iproto_on_accept, NULL);
@@ -2016,6 +3952,14 @@ void
 iproto_init()
 {
 	slab_cache_create(&net_slabc, &runtime);
+	mempool_create(&iproto_stream_pool, &cord()->slabc,
+		       sizeof(struct iproto_stream));
+	mempool_create(&iproto_cursor_pool, &cord()->slabc,
+		       sizeof(struct iproto_cursor));
+	mempool_create(&iproto_splice_pool, &cord()->slabc,
+		       sizeof(struct iproto_splice));
+	tx_latency_init();
+	ev_timer_init(&tx_cursor_timer, tx_cursor_timer_cb, 0, 0);
 
 	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
 		panic("failed to initialize iproto thread");
@@ -2034,14 +3978,15 @@ iproto_init()
 /** Available iproto configuration changes. */
 enum iproto_cfg_op {
 	IPROTO_CFG_MSG_MAX,
-	IPROTO_CFG_LISTEN
+	IPROTO_CFG_LISTEN,
+	IPROTO_CFG_STAT_RESET,
 };
 
 /**
  * Since there is no way to "synchronously" change the
  * state of the io thread, to change the listen port or max
- * message count in flight send a special message to iproto
- * thread.
+ * message count in flight, or to reset its statistics, send
+ * a special message to iproto thread.
  */
 struct iproto_cfg_msg: public cbus_call_msg
 {
@@ -2086,6 +4031,9 @@ iproto_do_cfg_f(struct cbus_call_msg *m)
 			     evio_service_listen(&binary) != 0))
 				diag_raise();
 			break;
+		case IPROTO_CFG_STAT_RESET:
+			iproto_priority_reset_stat();
+			break;
 		default:
 			unreachable();
 		}
@@ -2122,6 +4070,20 @@ void
 iproto_reset_stat(void)
 {
 	rmean_cleanup(rmean_net);
+	tx_latency_reset();
+	/* The priority queues are owned by iproto thread. */
+	struct iproto_cfg_msg cfg_msg;
+	iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_STAT_RESET);
+	iproto_do_cfg(&cfg_msg);
+}
+
+void
+iproto_set_cursor_timeout(double timeout)
+{
+	tx_cursor_timeout = timeout;
+	/* Re-arm the timer for the new timeout. */
+	ev_timer_stop(loop(), &tx_cursor_timer);
+	tx_cursor_timer_start();
 }
 
 void
@@ -32,6 +32,7 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 
 #if defined(__cplusplus)
 extern "C" {
@@ -56,6 +57,58 @@ enum {
 
 extern unsigned iproto_readahead;
 
+struct session;
+
+/**
+ * Priority class of iproto requests. Requests of different
+ * classes are sent to tx thread by weighted fair queueing,
+ * so that a client flooding the instance with heavy requests
+ * doesn't starve the others.
+ */
+enum iproto_priority {
+	IPROTO_PRIORITY_HIGH,
+	IPROTO_PRIORITY_NORMAL,
+	IPROTO_PRIORITY_LOW,
+	iproto_priority_MAX,
+};
+
+extern const char *iproto_priority_strs[];
+
+/** Statistics of a priority class. */
+struct iproto_priority_stat {
+	/** Requests waiting to be sent to tx thread. */
+	size_t queue;
+	/** Requests sent to tx thread and not completed yet. */
+	size_t in_flight;
+	/** Requests completed since the last reset. */
+	uint64_t total;
+	/** Average time a request waited in the queue, seconds. */
+	double wait;
+	/** Average time to complete a request, seconds. */
+	double latency;
+};
+
+/**
+ * Get statistics of a priority class.
+ */
+void
+iproto_priority_stat(enum iproto_priority priority,
+		     struct iproto_priority_stat *stat);
+
+/**
+ * Get the priority class of requests of a binary session.
+ */
+enum iproto_priority
+iproto_session_priority(struct session *session);
+
+/**
+ * Set the priority class of requests of a binary session.
+ * Requests already received keep their class.
+ */
+void
+iproto_session_set_priority(struct session *session,
+			    enum iproto_priority priority);
+
 /**
  * Return size of memory used for storing network buffers.
  */
@@ -63,11 +116,20 @@ size_t
 iproto_mem_used(void);
 
 /**
- * Reset network statistics.
+ * Reset network statistics, including request latency.
  */
 void
 iproto_reset_stat(void);
 
+struct info_handler;
+
+/**
+ * Report latency percentiles of the stages of request
+ * processing, by request type and by called function.
+ */
+void
+iproto_latency_stat(struct info_handler *h);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 
@@ -80,6 +142,13 @@ iproto_listen(const char *uri);
 void
 iproto_set_msg_max(int iproto_msg_max);
 
+/**
+ * Set the time after which an idle cursor opened by
+ * SELECT with IPROTO_CURSOR is closed.
+ */
+void
+iproto_set_cursor_timeout(double timeout);
+
 #endif /* defined(__cplusplus) */
 
 #endif
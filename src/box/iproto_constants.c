@@ -46,7 +46,7 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 	/* {{{ unused */
 		/* 0x08 */	MP_UINT,
 		/* 0x09 */	MP_UINT,
-		/* 0x0a */	MP_UINT,
+		/* 0x0a */	MP_UINT,   /* IPROTO_STREAM_ID */
 		/* 0x0b */	MP_UINT,
 		/* 0x0c */	MP_UINT,
 		/* 0x0d */	MP_UINT,
@@ -61,10 +61,10 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 		/* 0x13 */	MP_UINT, /* IPROTO_OFFSET */
 		/* 0x14 */	MP_UINT, /* IPROTO_ITERATOR */
 		/* 0x15 */	MP_UINT, /* IPROTO_INDEX_BASE */
+		/* 0x16 */	MP_BOOL, /* IPROTO_CURSOR */
 	/* }}} */
 
 	/* {{{ unused */
-		/* 0x16 */	MP_UINT,
 		/* 0x17 */	MP_UINT,
 		/* 0x18 */	MP_UINT,
 		/* 0x19 */	MP_UINT,
@@ -89,6 +89,10 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 	/* 0x29 */	MP_MAP, /* IPROTO_BALLOT */
 	/* 0x2a */	MP_MAP, /* IPROTO_TUPLE_META */
 	/* 0x2b */	MP_MAP, /* IPROTO_OPTIONS */
+	/* 0x2c */	MP_BOOL, /* IPROTO_JOIN_FILES */
+	/* 0x2d */	MP_STR, /* IPROTO_FILE_NAME */
+	/* 0x2e */	MP_UINT, /* IPROTO_FILE_SIZE */
+	/* 0x2f */	MP_BIN, /* IPROTO_FILE_DATA */
 	/* }}} */
 };
 
@@ -107,6 +111,12 @@ const char *iproto_type_strs[] =
 	"CALL",
 	"EXECUTE",
 	NULL, /* NOP */
+	"PREPARE",
+	NULL, /* BEGIN */
+	NULL, /* COMMIT */
+	NULL, /* ROLLBACK */
+	NULL, /* BATCH */
+	NULL, /* FETCH */
 };
 
 #define bit(c) (1ULL<<IPROTO_##c)
@@ -124,6 +134,12 @@ const uint64_t iproto_body_key_map[IPROTO_TYPE_STAT_MAX] = {
 	0,                                                     /* CALL */
 	0,                                                     /* EXECUTE */
 	0,                                                     /* NOP */
+	0,                                                     /* PREPARE */
+	0,                                                     /* BEGIN */
+	0,                                                     /* COMMIT */
+	0,                                                     /* ROLLBACK */
+	0,                                                     /* BATCH */
+	0,                                                     /* FETCH */
 };
 #undef bit
 
@@ -138,7 +154,7 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"group id",         /* 0x07 */
 	NULL,               /* 0x08 */
 	NULL,               /* 0x09 */
-	NULL,               /* 0x0a */
+	"stream id",        /* 0x0a */
 	NULL,               /* 0x0b */
 	NULL,               /* 0x0c */
 	NULL,               /* 0x0d */
@@ -150,7 +166,7 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"offset",           /* 0x13 */
 	"iterator",         /* 0x14 */
 	"index base",       /* 0x15 */
-	NULL,               /* 0x16 */
+	"cursor",           /* 0x16 */
 	NULL,               /* 0x17 */
 	NULL,               /* 0x18 */
 	NULL,               /* 0x19 */
@@ -172,15 +188,15 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"ballot",           /* 0x29 */
 	"tuple meta",       /* 0x2a */
 	"options",          /* 0x2b */
-	NULL,               /* 0x2c */
-	NULL,               /* 0x2d */
-	NULL,               /* 0x2e */
-	NULL,               /* 0x2f */
+	"join files",       /* 0x2c */
+	"file name",        /* 0x2d */
+	"file size",        /* 0x2e */
+	"file data",        /* 0x2f */
 	"data",             /* 0x30 */
 	"error",            /* 0x31 */
 	"metadata",         /* 0x32 */
-	NULL,               /* 0x33 */
-	NULL,               /* 0x34 */
+	"batch errors",     /* 0x33 */
+	"cursor id",        /* 0x34 */
 	NULL,               /* 0x35 */
 	NULL,               /* 0x36 */
 	NULL,               /* 0x37 */
@@ -195,6 +211,21 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"SQL text",         /* 0x40 */
 	"SQL bind",         /* 0x41 */
 	"SQL info",         /* 0x42 */
+	"statement id",     /* 0x43 */
+	NULL,               /* 0x44 */
+	NULL,               /* 0x45 */
+	NULL,               /* 0x46 */
+	NULL,               /* 0x47 */
+	NULL,               /* 0x48 */
+	NULL,               /* 0x49 */
+	NULL,               /* 0x4a */
+	NULL,               /* 0x4b */
+	NULL,               /* 0x4c */
+	NULL,               /* 0x4d */
+	NULL,               /* 0x4e */
+	NULL,               /* 0x4f */
+	"batch requests",   /* 0x50 */
+	"batch is atomic",  /* 0x51 */
 };
 
 const char *vy_page_info_key_strs[VY_PAGE_INFO_KEY_MAX] = {
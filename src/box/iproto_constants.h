@@ -60,6 +60,12 @@ enum iproto_key {
 	IPROTO_SCHEMA_VERSION = 0x05,
 	IPROTO_SERVER_VERSION = 0x06,
 	IPROTO_GROUP_ID = 0x07,
+	/**
+	 * Id of the stream a request belongs to, see
+	 * IPROTO_BEGIN. Requests of the same stream are
+	 * processed one by one in the order they were sent.
+	 */
+	IPROTO_STREAM_ID = 0x0a,
 	/* Leave a gap for other keys in the header. */
 	IPROTO_SPACE_ID = 0x10,
 	IPROTO_INDEX_ID = 0x11,
@@ -67,6 +73,11 @@ enum iproto_key {
 	IPROTO_OFFSET = 0x13,
 	IPROTO_ITERATOR = 0x14,
 	IPROTO_INDEX_BASE = 0x15,
+	/**
+	 * SELECT: keep the iterator open after LIMIT tuples are
+	 * read, see IPROTO_FETCH.
+	 */
+	IPROTO_CURSOR = 0x16,
 
 	/* Leave a gap between integer values and other keys */
 	IPROTO_KEY = 0x20,
@@ -91,6 +102,16 @@ enum iproto_key {
 	IPROTO_BALLOT = 0x29,
 	IPROTO_TUPLE_META = 0x2a,
 	IPROTO_OPTIONS = 0x2b,
+	/** Request file-level initial JOIN, see IPROTO_FILE_CHUNK. */
+	IPROTO_JOIN_FILES = 0x2c,
+	/**
+	 * Keys of IPROTO_FILE_CHUNK: the file name relative to
+	 * the data directory, the total size of the file and
+	 * a piece of its contents.
+	 */
+	IPROTO_FILE_NAME = 0x2d,
+	IPROTO_FILE_SIZE = 0x2e,
+	IPROTO_FILE_DATA = 0x2f,
 
 	/* Leave a gap between request keys and response keys */
 	IPROTO_DATA = 0x30,
@@ -103,6 +124,20 @@ enum iproto_key {
 	 * ]
 	 */
 	IPROTO_METADATA = 0x32,
+	/**
+	 * Errors of a non-atomic BATCH request:
+	 * IPROTO_BATCH_ERRORS: {
+	 *     request offset: [error code, error message],
+	 *     ...
+	 * }
+	 */
+	IPROTO_BATCH_ERRORS = 0x33,
+	/**
+	 * Id of a cursor returned by SELECT with IPROTO_CURSOR
+	 * and IPROTO_FETCH, unless the cursor is exhausted, and
+	 * accepted by IPROTO_FETCH.
+	 */
+	IPROTO_CURSOR_ID = 0x34,
 
 	/* Leave a gap between response keys and SQL keys. */
 	IPROTO_SQL_TEXT = 0x40,
@@ -113,6 +148,22 @@ enum iproto_key {
 	 * }
 	 */
 	IPROTO_SQL_INFO = 0x42,
+	/**
+	 * Id of a prepared statement. Returned by PREPARE
+	 * and accepted by EXECUTE instead of IPROTO_SQL_TEXT.
+	 */
+	IPROTO_STMT_ID = 0x43,
+
+	/* Leave a gap between SQL keys and BATCH keys. */
+	/**
+	 * IPROTO_BATCH_REQUESTS: [
+	 *     [request type, request body],
+	 *     ...
+	 * ]
+	 */
+	IPROTO_BATCH_REQUESTS = 0x50,
+	/** Execute all requests of a batch in one transaction. */
+	IPROTO_BATCH_IS_ATOMIC = 0x51,
 	IPROTO_KEY_MAX
 };
 
@@ -135,10 +186,11 @@ enum iproto_ballot_key {
 #define bit(c) (1ULL<<IPROTO_##c)
 
 #define IPROTO_HEAD_BMAP (bit(REQUEST_TYPE) | bit(SYNC) | bit(REPLICA_ID) |\
-			  bit(LSN) | bit(SCHEMA_VERSION))
+			  bit(LSN) | bit(SCHEMA_VERSION) | bit(STREAM_ID))
 #define IPROTO_DML_BODY_BMAP (bit(SPACE_ID) | bit(INDEX_ID) | bit(LIMIT) |\
 			      bit(OFFSET) | bit(ITERATOR) | bit(INDEX_BASE) |\
-			      bit(KEY) | bit(TUPLE) | bit(OPS) | bit(TUPLE_META))
+			      bit(CURSOR) | bit(KEY) | bit(TUPLE) | bit(OPS) |\
+			      bit(TUPLE_META))
 
 static inline bool
 xrow_header_has_key(const char *pos, const char *end)
@@ -195,6 +247,21 @@ enum iproto_type {
 	IPROTO_EXECUTE = 11,
 	/** No operation. Treated as DML, used to bump LSN. */
 	IPROTO_NOP = 12,
+	/** Prepare an SQL statement for execution by id. */
+	IPROTO_PREPARE = 13,
+	/** Begin a transaction in a stream, see IPROTO_STREAM_ID. */
+	IPROTO_BEGIN = 14,
+	/** Commit the transaction of a stream. */
+	IPROTO_COMMIT = 15,
+	/** Rollback the transaction of a stream. */
+	IPROTO_ROLLBACK = 16,
+	/** Execute an array of DML requests. */
+	IPROTO_BATCH = 17,
+	/**
+	 * Read the next LIMIT tuples from a cursor opened by
+	 * SELECT, or close the cursor if LIMIT is 0.
+	 */
+	IPROTO_FETCH = 18,
 	/** The maximum typecode used for box.stat() */
 	IPROTO_TYPE_STAT_MAX,
 
@@ -208,6 +275,8 @@ enum iproto_type {
 	IPROTO_VOTE_DEPRECATED = 67,
 	/** Vote request command for master election */
 	IPROTO_VOTE = 68,
+	/** A piece of a checkpoint file sent by file-level JOIN */
+	IPROTO_FILE_CHUNK = 69,
 
 	/** Vinyl run info stored in .index file */
 	VY_INDEX_RUN_INFO = 100,
@@ -242,10 +311,20 @@ iproto_type_name(uint32_t type)
 	if (type == IPROTO_NOP)
 		return "NOP";
 
-	if (type < IPROTO_TYPE_STAT_MAX)
+	if (type < IPROTO_TYPE_STAT_MAX && iproto_type_strs[type] != NULL)
 		return iproto_type_strs[type];
 
 	switch (type) {
+	case IPROTO_BEGIN:
+		return "BEGIN";
+	case IPROTO_COMMIT:
+		return "COMMIT";
+	case IPROTO_ROLLBACK:
+		return "ROLLBACK";
+	case IPROTO_BATCH:
+		return "BATCH";
+	case IPROTO_FETCH:
+		return "FETCH";
 	case VY_INDEX_RUN_INFO:
 		return "RUNINFO";
 	case VY_INDEX_PAGE_INFO:
@@ -309,6 +388,18 @@ iproto_type_is_request(uint32_t type)
 	return type > IPROTO_OK && type <= IPROTO_TYPE_STAT_MAX;
 }
 
+/**
+ * A request that can be sent to a stream, see IPROTO_STREAM_ID.
+ * The stream id of other requests is ignored.
+ */
+static inline bool
+iproto_type_is_stream(uint32_t type)
+{
+	return (type >= IPROTO_SELECT && type <= IPROTO_FETCH &&
+		type != IPROTO_AUTH && type != IPROTO_NOP) ||
+	       type == IPROTO_PING;
+}
+
 /**
  * The request is "synchronous": no other requests
  * on this connection should be taken before this one
@@ -263,6 +263,61 @@ lbox_cfg_set_vinyl_timeout(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_net_cursor_timeout(struct lua_State *L)
+{
+	try {
+		box_set_net_cursor_timeout();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_sql_aggregate_threads(struct lua_State *L)
+{
+	try {
+		box_set_sql_aggregate_threads();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_sql_sorter_memory(struct lua_State *L)
+{
+	try {
+		box_set_sql_sorter_memory();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_sql_auto_analyze(struct lua_State *L)
+{
+	try {
+		box_set_sql_auto_analyze();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_sql_plan_cache(struct lua_State *L)
+{
+	try {
+		box_set_sql_plan_cache();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_cfg_set_net_msg_max(struct lua_State *L)
 {
@@ -346,6 +401,14 @@ lbox_cfg_set_replication_skip_conflict(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_replication_join_files(struct lua_State *L)
+{
+	(void) L;
+	box_set_replication_join_files();
+	return 0;
+}
+
 void
 box_lua_cfg_init(struct lua_State *L)
 {
@@ -377,7 +440,13 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_replication_sync_lag", lbox_cfg_set_replication_sync_lag},
 		{"cfg_set_replication_sync_timeout", lbox_cfg_set_replication_sync_timeout},
 		{"cfg_set_replication_skip_conflict", lbox_cfg_set_replication_skip_conflict},
+		{"cfg_set_replication_join_files", lbox_cfg_set_replication_join_files},
 		{"cfg_set_net_msg_max", lbox_cfg_set_net_msg_max},
+		{"cfg_set_net_cursor_timeout", lbox_cfg_set_net_cursor_timeout},
+		{"cfg_set_sql_aggregate_threads", lbox_cfg_set_sql_aggregate_threads},
+		{"cfg_set_sql_sorter_memory", lbox_cfg_set_sql_sorter_memory},
+		{"cfg_set_sql_auto_analyze", lbox_cfg_set_sql_auto_analyze},
+		{"cfg_set_sql_plan_cache", lbox_cfg_set_sql_plan_cache},
 		{NULL, NULL}
 	};
 
@@ -77,10 +77,16 @@ local default_cfg = {
     replication_connect_timeout = 30,
     replication_connect_quorum = nil, -- connect all
     replication_skip_conflict = false,
+    replication_join_files = false,
     feedback_enabled      = true,
     feedback_host         = "https://feedback.tarantool.io",
     feedback_interval     = 3600,
     net_msg_max           = 768,
+    net_cursor_timeout    = 60,
+    sql_sorter_memory     = 2 * 1024 * 1024,
+    sql_auto_analyze      = false,
+    sql_plan_cache        = false,
+    sql_aggregate_threads = 4,
 }
 
 -- types of available options
@@ -140,10 +146,16 @@ local template_cfg = {
     replication_connect_timeout = 'number',
     replication_connect_quorum = 'number',
     replication_skip_conflict = 'boolean',
+    replication_join_files = 'boolean',
     feedback_enabled      = 'boolean',
     feedback_host         = 'string',
     feedback_interval     = 'number',
     net_msg_max           = 'number',
+    net_cursor_timeout    = 'number',
+    sql_sorter_memory     = 'number',
+    sql_auto_analyze      = 'boolean',
+    sql_plan_cache        = 'boolean',
+    sql_aggregate_threads = 'number',
 }
 
 local function normalize_uri(port)
@@ -247,9 +259,15 @@ local dynamic_cfg = {
     replication_sync_lag    = private.cfg_set_replication_sync_lag,
     replication_sync_timeout = private.cfg_set_replication_sync_timeout,
     replication_skip_conflict = private.cfg_set_replication_skip_conflict,
+    replication_join_files = private.cfg_set_replication_join_files,
     instance_uuid           = check_instance_uuid,
     replicaset_uuid         = check_replicaset_uuid,
     net_msg_max             = private.cfg_set_net_msg_max,
+    net_cursor_timeout      = private.cfg_set_net_cursor_timeout,
+    sql_sorter_memory       = private.cfg_set_sql_sorter_memory,
+    sql_auto_analyze        = private.cfg_set_sql_auto_analyze,
+    sql_plan_cache          = private.cfg_set_sql_plan_cache,
+    sql_aggregate_threads   = private.cfg_set_sql_aggregate_threads,
 }
 
 local dynamic_cfg_skip_at_load = {
@@ -268,12 +286,18 @@ local dynamic_cfg_skip_at_load = {
     replication_sync_lag    = true,
     replication_sync_timeout = true,
     replication_skip_conflict = true,
+    replication_join_files = true,
     wal_dir_rescan_delay    = true,
     custom_proc_title       = true,
     force_recovery          = true,
     instance_uuid           = true,
     replicaset_uuid         = true,
     net_msg_max             = true,
+    net_cursor_timeout      = true,
+    sql_sorter_memory       = true,
+    sql_auto_analyze        = true,
+    sql_plan_cache          = true,
+    sql_aggregate_threads   = true,
 }
 
 local function convert_gb(size)
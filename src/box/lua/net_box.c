@@ -51,11 +51,14 @@
 
 #define cfg luaL_msgpack_default
 
+static uint32_t CTID_CHAR_PTR;
+
 static inline size_t
 netbox_prepare_request(lua_State *L, struct mpstream *stream, uint32_t r_type)
 {
 	struct ibuf *ibuf = (struct ibuf *) lua_topointer(L, 1);
 	uint64_t sync = luaL_touint64(L, 2);
+	uint64_t stream_id = luaL_touint64(L, 3);
 
 	mpstream_init(stream, ibuf, ibuf_reserve_cb, ibuf_alloc_cb,
 		      luamp_error, L);
@@ -69,7 +72,7 @@ netbox_prepare_request(lua_State *L, struct mpstream *stream, uint32_t r_type)
 	mpstream_advance(stream, fixheader_size);
 
 	/* encode header */
-	mpstream_encode_map(stream, 2);
+	mpstream_encode_map(stream, stream_id != 0 ? 3 : 2);
 
 	mpstream_encode_uint(stream, IPROTO_SYNC);
 	mpstream_encode_uint(stream, sync);
@@ -77,6 +80,11 @@ netbox_prepare_request(lua_State *L, struct mpstream *stream, uint32_t r_type)
 	mpstream_encode_uint(stream, IPROTO_REQUEST_TYPE);
 	mpstream_encode_uint(stream, r_type);
 
+	if (stream_id != 0) {
+		mpstream_encode_uint(stream, IPROTO_STREAM_ID);
+		mpstream_encode_uint(stream, stream_id);
+	}
+
 	/* Caller should remember how many bytes was used in ibuf */
 	return used;
 }
@@ -110,8 +118,9 @@ netbox_encode_request(struct mpstream *stream, size_t initial_size)
 static int
 netbox_encode_ping(lua_State *L)
 {
-	if (lua_gettop(L) < 2)
-		return luaL_error(L, "Usage: netbox.encode_ping(ibuf, sync)");
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: netbox.encode_ping(ibuf, sync, "
+				  "stream_id)");
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_PING);
@@ -119,23 +128,54 @@ netbox_encode_ping(lua_State *L)
 	return 0;
 }
 
+static inline int
+netbox_encode_txn(lua_State *L, enum iproto_type type)
+{
+	if (lua_gettop(L) < 3) {
+		return luaL_error(L, "Usage: netbox.encode_begin(ibuf, sync, "
+				     "stream_id)");
+	}
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, type);
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+static int
+netbox_encode_begin(lua_State *L)
+{
+	return netbox_encode_txn(L, IPROTO_BEGIN);
+}
+
+static int
+netbox_encode_commit(lua_State *L)
+{
+	return netbox_encode_txn(L, IPROTO_COMMIT);
+}
+
+static int
+netbox_encode_rollback(lua_State *L)
+{
+	return netbox_encode_txn(L, IPROTO_ROLLBACK);
+}
+
 static int
 netbox_encode_auth(lua_State *L)
 {
-	if (lua_gettop(L) < 5) {
+	if (lua_gettop(L) < 6) {
 		return luaL_error(L, "Usage: netbox.encode_update(ibuf, sync, "
-				     "user, password, greeting)");
+				     "stream_id, user, password, greeting)");
 	}
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_AUTH);
 
 	size_t user_len;
-	const char *user = lua_tolstring(L, 3, &user_len);
+	const char *user = lua_tolstring(L, 4, &user_len);
 	size_t password_len;
-	const char *password = lua_tolstring(L, 4, &password_len);
+	const char *password = lua_tolstring(L, 5, &password_len);
 	size_t salt_len;
-	const char *salt = lua_tolstring(L, 5, &salt_len);
+	const char *salt = lua_tolstring(L, 6, &salt_len);
 	if (salt_len < SCRAMBLE_SIZE)
 		return luaL_error(L, "Invalid salt");
 
@@ -159,9 +199,9 @@ netbox_encode_auth(lua_State *L)
 static int
 netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 {
-	if (lua_gettop(L) < 4) {
+	if (lua_gettop(L) < 5) {
 		return luaL_error(L, "Usage: netbox.encode_call(ibuf, sync, "
-				     "function_name, args)");
+				     "stream_id, function_name, args)");
 	}
 
 	struct mpstream stream;
@@ -171,13 +211,13 @@ netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 
 	/* encode proc name */
 	size_t name_len;
-	const char *name = lua_tolstring(L, 3, &name_len);
+	const char *name = lua_tolstring(L, 4, &name_len);
 	mpstream_encode_uint(&stream, IPROTO_FUNCTION_NAME);
 	mpstream_encode_strn(&stream, name, name_len);
 
 	/* encode args */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 5);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -198,9 +238,9 @@ netbox_encode_call(lua_State *L)
 static int
 netbox_encode_eval(lua_State *L)
 {
-	if (lua_gettop(L) < 4) {
+	if (lua_gettop(L) < 5) {
 		return luaL_error(L, "Usage: netbox.encode_eval(ibuf, sync, "
-				     "expr, args)");
+				     "stream_id, expr, args)");
 	}
 
 	struct mpstream stream;
@@ -210,13 +250,13 @@ netbox_encode_eval(lua_State *L)
 
 	/* encode expr */
 	size_t expr_len;
-	const char *expr = lua_tolstring(L, 3, &expr_len);
+	const char *expr = lua_tolstring(L, 4, &expr_len);
 	mpstream_encode_uint(&stream, IPROTO_EXPR);
 	mpstream_encode_strn(&stream, expr, expr_len);
 
 	/* encode args */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 5);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -225,22 +265,29 @@ netbox_encode_eval(lua_State *L)
 static int
 netbox_encode_select(lua_State *L)
 {
-	if (lua_gettop(L) < 8) {
+	if (lua_gettop(L) < 9) {
 		return luaL_error(L, "Usage netbox.encode_select(ibuf, sync, "
-				     "space_id, index_id, iterator, offset, "
-				     "limit, key)");
+				     "stream_id, space_id, index_id, iterator, "
+				     "offset, limit, key)");
 	}
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_SELECT);
 
-	mpstream_encode_map(&stream, 6);
+	/* Optional: keep the iterator open on the server. */
+	bool is_cursor = lua_toboolean(L, 10);
+	mpstream_encode_map(&stream, is_cursor ? 7 : 6);
 
-	uint32_t space_id = lua_tonumber(L, 3);
-	uint32_t index_id = lua_tonumber(L, 4);
-	int iterator = lua_tointeger(L, 5);
-	uint32_t offset = lua_tonumber(L, 6);
-	uint32_t limit = lua_tonumber(L, 7);
+	uint32_t space_id = lua_tonumber(L, 4);
+	uint32_t index_id = lua_tonumber(L, 5);
+	int iterator = lua_tointeger(L, 6);
+	uint32_t offset = lua_tonumber(L, 7);
+	uint32_t limit = lua_tonumber(L, 8);
+
+	if (is_cursor) {
+		mpstream_encode_uint(&stream, IPROTO_CURSOR);
+		mpstream_encode_bool(&stream, true);
+	}
 
 	/* encode space_id */
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
@@ -264,7 +311,7 @@ netbox_encode_select(lua_State *L)
 
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
-	luamp_convert_key(L, cfg, &stream, 8);
+	luamp_convert_key(L, cfg, &stream, 9);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -273,9 +320,9 @@ netbox_encode_select(lua_State *L)
 static inline int
 netbox_encode_insert_or_replace(lua_State *L, uint32_t reqtype)
 {
-	if (lua_gettop(L) < 4) {
+	if (lua_gettop(L) < 5) {
 		return luaL_error(L, "Usage: netbox.encode_insert(ibuf, sync, "
-				     "space_id, tuple)");
+				     "stream_id, space_id, tuple)");
 	}
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, reqtype);
@@ -283,13 +330,13 @@ netbox_encode_insert_or_replace(lua_State *L, uint32_t reqtype)
 	mpstream_encode_map(&stream, 2);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 4);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
 	/* encode args */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 5);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -310,9 +357,9 @@ netbox_encode_replace(lua_State *L)
 static int
 netbox_encode_delete(lua_State *L)
 {
-	if (lua_gettop(L) < 5) {
+	if (lua_gettop(L) < 6) {
 		return luaL_error(L, "Usage: netbox.encode_delete(ibuf, sync, "
-				     "space_id, index_id, key)");
+				     "stream_id, space_id, index_id, key)");
 	}
 
 	struct mpstream stream;
@@ -321,18 +368,18 @@ netbox_encode_delete(lua_State *L)
 	mpstream_encode_map(&stream, 3);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 4);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
 	/* encode space_id */
-	uint32_t index_id = lua_tonumber(L, 4);
+	uint32_t index_id = lua_tonumber(L, 5);
 	mpstream_encode_uint(&stream, IPROTO_INDEX_ID);
 	mpstream_encode_uint(&stream, index_id);
 
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
-	luamp_convert_key(L, cfg, &stream, 5);
+	luamp_convert_key(L, cfg, &stream, 6);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -341,9 +388,10 @@ netbox_encode_delete(lua_State *L)
 static int
 netbox_encode_update(lua_State *L)
 {
-	if (lua_gettop(L) < 6) {
+	if (lua_gettop(L) < 7) {
 		return luaL_error(L, "Usage: netbox.encode_update(ibuf, sync, "
-				     "space_id, index_id, key, ops)");
+				     "stream_id, space_id, index_id, key, "
+				     "ops)");
 	}
 
 	struct mpstream stream;
@@ -352,12 +400,12 @@ netbox_encode_update(lua_State *L)
 	mpstream_encode_map(&stream, 5);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 4);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
 	/* encode index_id */
-	uint32_t index_id = lua_tonumber(L, 4);
+	uint32_t index_id = lua_tonumber(L, 5);
 	mpstream_encode_uint(&stream, IPROTO_INDEX_ID);
 	mpstream_encode_uint(&stream, index_id);
 
@@ -368,12 +416,12 @@ netbox_encode_update(lua_State *L)
 	/* encode in reverse order for speedup - see luamp_encode() code */
 	/* encode ops */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 6);
+	luamp_encode_tuple(L, cfg, &stream, 7);
 	lua_pop(L, 1); /* ops */
 
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
-	luamp_convert_key(L, cfg, &stream, 5);
+	luamp_convert_key(L, cfg, &stream, 6);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -382,9 +430,9 @@ netbox_encode_update(lua_State *L)
 static int
 netbox_encode_upsert(lua_State *L)
 {
-	if (lua_gettop(L) != 5) {
+	if (lua_gettop(L) != 6) {
 		return luaL_error(L, "Usage: netbox.encode_upsert(ibuf, sync, "
-				     "space_id, tuple, ops)");
+				     "stream_id, space_id, tuple, ops)");
 	}
 
 	struct mpstream stream;
@@ -393,7 +441,7 @@ netbox_encode_upsert(lua_State *L)
 	mpstream_encode_map(&stream, 4);
 
 	/* encode space_id */
-	uint32_t space_id = lua_tonumber(L, 3);
+	uint32_t space_id = lua_tonumber(L, 4);
 	mpstream_encode_uint(&stream, IPROTO_SPACE_ID);
 	mpstream_encode_uint(&stream, space_id);
 
@@ -404,12 +452,131 @@ netbox_encode_upsert(lua_State *L)
 	/* encode in reverse order for speedup - see luamp_encode() code */
 	/* encode ops */
 	mpstream_encode_uint(&stream, IPROTO_OPS);
-	luamp_encode_tuple(L, cfg, &stream, 5);
+	luamp_encode_tuple(L, cfg, &stream, 6);
 	lua_pop(L, 1); /* ops */
 
 	/* encode tuple */
 	mpstream_encode_uint(&stream, IPROTO_TUPLE);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 5);
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+static int
+netbox_encode_fetch(lua_State *L)
+{
+	if (lua_gettop(L) < 5) {
+		return luaL_error(L, "Usage: netbox.encode_fetch(ibuf, sync, "
+				     "stream_id, cursor_id, limit)");
+	}
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_FETCH);
+
+	mpstream_encode_map(&stream, 2);
+
+	uint64_t cursor_id = luaL_touint64(L, 4);
+	mpstream_encode_uint(&stream, IPROTO_CURSOR_ID);
+	mpstream_encode_uint(&stream, cursor_id);
+
+	uint32_t limit = lua_tonumber(L, 5);
+	mpstream_encode_uint(&stream, IPROTO_LIMIT);
+	mpstream_encode_uint(&stream, limit);
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+/**
+ * Encode a request of a batch as [type, body]. The request is
+ * a table {type, space_id, index_id, tuple or key, ops} at
+ * @a idx, see remote_methods:batch() in net_box.lua.
+ */
+static void
+netbox_encode_batch_request(lua_State *L, struct mpstream *stream, int idx)
+{
+	lua_rawgeti(L, idx, 1);
+	uint32_t type = lua_tonumber(L, -1);
+	lua_rawgeti(L, idx, 2);
+	uint32_t space_id = lua_tonumber(L, -1);
+	lua_rawgeti(L, idx, 3);
+	uint32_t index_id = lua_tonumber(L, -1);
+	lua_pop(L, 3);
+	lua_rawgeti(L, idx, 4); /* tuple or key */
+	lua_rawgeti(L, idx, 5); /* ops */
+	int ops = lua_gettop(L);
+	int tuple = ops - 1;
+
+	mpstream_encode_array(stream, 2);
+	mpstream_encode_uint(stream, type);
+	switch (type) {
+	case IPROTO_INSERT:
+	case IPROTO_REPLACE:
+		mpstream_encode_map(stream, 2);
+		break;
+	case IPROTO_DELETE:
+		mpstream_encode_map(stream, 3);
+		break;
+	case IPROTO_UPDATE:
+		mpstream_encode_map(stream, 5);
+		break;
+	case IPROTO_UPSERT:
+		mpstream_encode_map(stream, 4);
+		break;
+	default:
+		unreachable();
+	}
+	mpstream_encode_uint(stream, IPROTO_SPACE_ID);
+	mpstream_encode_uint(stream, space_id);
+	if (type == IPROTO_DELETE || type == IPROTO_UPDATE) {
+		mpstream_encode_uint(stream, IPROTO_INDEX_ID);
+		mpstream_encode_uint(stream, index_id);
+		mpstream_encode_uint(stream, IPROTO_KEY);
+		luamp_convert_key(L, cfg, stream, tuple);
+	}
+	if (type == IPROTO_UPDATE || type == IPROTO_UPSERT) {
+		mpstream_encode_uint(stream, IPROTO_INDEX_BASE);
+		mpstream_encode_uint(stream, 1);
+	}
+	if (type == IPROTO_UPSERT) {
+		mpstream_encode_uint(stream, IPROTO_OPS);
+		luamp_encode_tuple(L, cfg, stream, ops);
+	}
+	if (type == IPROTO_UPDATE) {
+		/* Update operations are sent as IPROTO_TUPLE. */
+		mpstream_encode_uint(stream, IPROTO_TUPLE);
+		luamp_encode_tuple(L, cfg, stream, ops);
+	} else if (type != IPROTO_DELETE) {
+		mpstream_encode_uint(stream, IPROTO_TUPLE);
+		luamp_encode_tuple(L, cfg, stream, tuple);
+	}
+	lua_pop(L, 2);
+}
+
+static int
+netbox_encode_batch(lua_State *L)
+{
+	if (lua_gettop(L) < 5 || !lua_istable(L, 4)) {
+		return luaL_error(L, "Usage: netbox.encode_batch(ibuf, sync, "
+				     "stream_id, requests, is_atomic)");
+	}
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_BATCH);
+
+	bool is_atomic = lua_toboolean(L, 5);
+	mpstream_encode_map(&stream, is_atomic ? 2 : 1);
+	if (is_atomic) {
+		mpstream_encode_uint(&stream, IPROTO_BATCH_IS_ATOMIC);
+		mpstream_encode_bool(&stream, true);
+	}
+	uint32_t count = lua_objlen(L, 4);
+	mpstream_encode_uint(&stream, IPROTO_BATCH_REQUESTS);
+	mpstream_encode_array(&stream, count);
+	for (uint32_t i = 1; i <= count; i++) {
+		lua_rawgeti(L, 4, i);
+		netbox_encode_batch_request(L, &stream, lua_gettop(L));
+		lua_pop(L, 1);
+	}
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -450,9 +617,9 @@ netbox_decode_greeting(lua_State *L)
 }
 
 /**
- * communicate(fd, send_buf, recv_buf, limit_or_boundary, timeout)
- *  -> errno, error
- *  -> nil, limit/boundary_pos
+ * Send the contents of @a send_buf and read into @a recv_buf
+ * until it has at least @a limit bytes or contains @a boundary,
+ * whichever is given.
  *
  * The need for this function arises from not wanting to
  * have more than one watcher for a single fd, and thus issue
@@ -462,52 +629,37 @@ netbox_decode_greeting(lua_State *L)
  * Instead, this function takes an fd, input and output buffer,
  * and does sending and receiving on it in a single event loop
  * interaction.
+ *
+ * @param[out] boundary_pos Offset of the boundary in @a recv_buf.
+ * @param[out] errmsg Error message, set on failure.
+ * @retval 0 Success.
+ * @retval error code (ER_TIMEOUT, ER_NO_CONNECTION) otherwise.
  */
 static int
-netbox_communicate(lua_State *L)
+netbox_communicate_impl(lua_State *L, int fd, struct ibuf *send_buf,
+			struct ibuf *recv_buf, size_t limit,
+			const void *boundary, size_t boundary_len,
+			ev_tstamp timeout, size_t *boundary_pos,
+			const char **errmsg)
 {
-	uint32_t fd = lua_tonumber(L, 1);
 	const int NETBOX_READAHEAD = 16320;
-	struct ibuf *send_buf = (struct ibuf *) lua_topointer(L, 2);
-	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 3);
-
-	/* limit or boundary */
-	size_t limit = SIZE_MAX;
-	const void *boundary = NULL;
-	size_t boundary_len;
-
-	if (lua_type(L, 4) == LUA_TSTRING)
-		boundary = lua_tolstring(L, 4, &boundary_len);
-	else
-		limit = lua_tonumber(L, 4);
-
-	/* timeout */
-	ev_tstamp timeout = TIMEOUT_INFINITY;
-	if (lua_type(L, 5) == LUA_TNUMBER)
-		timeout = lua_tonumber(L, 5);
 	if (timeout < 0) {
-		lua_pushinteger(L, ER_TIMEOUT);
-		lua_pushstring(L, "Timeout exceeded");
-		return 2;
+		*errmsg = "Timeout exceeded";
+		return ER_TIMEOUT;
 	}
 	int revents = COIO_READ;
 	while (true) {
 		/* reader serviced first */
 check_limit:
-		if (ibuf_used(recv_buf) >= limit) {
-			lua_pushnil(L);
-			lua_pushinteger(L, (lua_Integer)limit);
-			return 2;
-		}
+		if (ibuf_used(recv_buf) >= limit)
+			return 0;
 		const char *p;
 		if (boundary != NULL && (p = memmem(
 					recv_buf->rpos,
 					ibuf_used(recv_buf),
 					boundary, boundary_len)) != NULL) {
-			lua_pushnil(L);
-			lua_pushinteger(L, (lua_Integer)(
-					p - recv_buf->rpos));
-			return 2;
+			*boundary_pos = p - recv_buf->rpos;
+			return 0;
 		}
 
 		while (revents & COIO_READ) {
@@ -517,9 +669,8 @@ check_limit:
 			ssize_t rc = recv(
 				fd, recv_buf->wpos, ibuf_unused(recv_buf), 0);
 			if (rc == 0) {
-				lua_pushinteger(L, ER_NO_CONNECTION);
-				lua_pushstring(L, "Peer closed");
-				return 2;
+				*errmsg = "Peer closed";
+				return ER_NO_CONNECTION;
 			} if (rc > 0) {
 				recv_buf->wpos += rc;
 				goto check_limit;
@@ -547,38 +698,227 @@ check_limit:
 		timeout = deadline - ev_monotonic_now(loop());
 		timeout = MAX(0.0, timeout);
 		if (revents == 0 && timeout == 0.0) {
-			lua_pushinteger(L, ER_TIMEOUT);
-			lua_pushstring(L, "Timeout exceeded");
-			return 2;
+			*errmsg = "Timeout exceeded";
+			return ER_TIMEOUT;
 		}
 	}
 handle_error:
-	lua_pushinteger(L, ER_NO_CONNECTION);
-	lua_pushstring(L, strerror(errno));
+	*errmsg = strerror(errno);
+	return ER_NO_CONNECTION;
+}
+
+/**
+ * communicate(fd, send_buf, recv_buf, limit_or_boundary, timeout)
+ *  -> errno, error
+ *  -> nil, limit/boundary_pos
+ */
+static int
+netbox_communicate(lua_State *L)
+{
+	uint32_t fd = lua_tonumber(L, 1);
+	struct ibuf *send_buf = (struct ibuf *) lua_topointer(L, 2);
+	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 3);
+
+	/* limit or boundary */
+	size_t limit = SIZE_MAX;
+	const void *boundary = NULL;
+	size_t boundary_len = 0;
+
+	if (lua_type(L, 4) == LUA_TSTRING)
+		boundary = lua_tolstring(L, 4, &boundary_len);
+	else
+		limit = lua_tonumber(L, 4);
+
+	/* timeout */
+	ev_tstamp timeout = TIMEOUT_INFINITY;
+	if (lua_type(L, 5) == LUA_TNUMBER)
+		timeout = lua_tonumber(L, 5);
+
+	size_t boundary_pos = 0;
+	const char *errmsg;
+	int rc = netbox_communicate_impl(L, fd, send_buf, recv_buf, limit,
+					 boundary, boundary_len, timeout,
+					 &boundary_pos, &errmsg);
+	if (rc != 0) {
+		lua_pushinteger(L, rc);
+		lua_pushstring(L, errmsg);
+		return 2;
+	}
+	lua_pushnil(L);
+	lua_pushinteger(L, (lua_Integer)(boundary != NULL ?
+					 boundary_pos : limit));
+	return 2;
+}
+
+/**
+ * Parse the header of a response in [pos, end) and validate
+ * the whole packet. Only the keys net.box dispatches on are
+ * extracted, the rest are skipped.
+ * @retval 0 Success, @a pos points at the body.
+ * @retval -1 The packet is not valid MessagePack.
+ */
+static int
+netbox_decode_header(const char **pos, const char *end, uint64_t *sync,
+		     uint64_t *status, uint64_t *schema_version)
+{
+	const char *check = *pos;
+	if (mp_typeof(**pos) != MP_MAP || mp_check(&check, end) != 0)
+		return -1;
+	const char *body = check;
+	if (body < end && (mp_check(&check, end) != 0 || check != end))
+		return -1;
+	*sync = 0;
+	*status = 0;
+	*schema_version = 0;
+	uint32_t size = mp_decode_map(pos);
+	for (uint32_t i = 0; i < size; i++) {
+		if (mp_typeof(**pos) != MP_UINT)
+			return -1;
+		uint64_t key = mp_decode_uint(pos);
+		uint64_t *value;
+		switch (key) {
+		case IPROTO_SYNC:
+			value = sync;
+			break;
+		case IPROTO_REQUEST_TYPE:
+			value = status;
+			break;
+		case IPROTO_SCHEMA_VERSION:
+			value = schema_version;
+			break;
+		default:
+			mp_next(pos);
+			continue;
+		}
+		if (mp_typeof(**pos) != MP_UINT)
+			return -1;
+		*value = mp_decode_uint(pos);
+	}
+	assert(*pos == body);
+	return 0;
+}
+
+/**
+ * recv_response(fd, send_buf, recv_buf, timeout)
+ *  -> errno, error
+ *  -> nil, sync, status, schema_version, body_rpos, body_end
+ *
+ * Flush @a send_buf and read a single IPROTO response. Unlike
+ * decoding the header with msgpack.decode(), no Lua table is
+ * created per response, and the packet is validated before it
+ * is handed to the unchecked body decoders.
+ */
+static int
+netbox_recv_response(lua_State *L)
+{
+	uint32_t fd = lua_tonumber(L, 1);
+	struct ibuf *send_buf = (struct ibuf *) lua_topointer(L, 2);
+	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 3);
+	ev_tstamp timeout = TIMEOUT_INFINITY;
+	if (lua_type(L, 4) == LUA_TNUMBER)
+		timeout = lua_tonumber(L, 4);
+	ev_tstamp deadline = ev_monotonic_now(loop()) + timeout;
+	const char *errmsg;
+	int rc;
+	while (true) {
+		size_t data_len = ibuf_used(recv_buf);
+		size_t required = 5;
+		if (data_len >= required) {
+			const char *pos = recv_buf->rpos;
+			if (mp_typeof(*pos) != MP_UINT)
+				goto invalid;
+			ptrdiff_t more = mp_check_uint(pos, recv_buf->wpos);
+			if (more > 0) {
+				required = data_len + more;
+			} else {
+				uint64_t len = mp_decode_uint(&pos);
+				if (len > SIZE_MAX / 2)
+					goto invalid;
+				required = (pos - recv_buf->rpos) + len;
+			}
+			if (data_len >= required) {
+				const char *end = recv_buf->rpos + required;
+				uint64_t sync, status, schema_version;
+				if (netbox_decode_header(&pos, end, &sync,
+							 &status,
+							 &schema_version) != 0)
+					goto invalid;
+				recv_buf->rpos = (char *) end;
+				lua_pushnil(L);
+				lua_pushnumber(L, sync);
+				lua_pushnumber(L, status);
+				lua_pushnumber(L, schema_version);
+				*(const char **)luaL_pushcdata(L, CTID_CHAR_PTR) =
+					pos;
+				*(const char **)luaL_pushcdata(L, CTID_CHAR_PTR) =
+					end;
+				return 6;
+			}
+		}
+		timeout = MAX(0.0, deadline - ev_monotonic_now(loop()));
+		rc = netbox_communicate_impl(L, fd, send_buf, recv_buf,
+					     required, NULL, 0, timeout,
+					     NULL, &errmsg);
+		if (rc != 0)
+			goto error;
+	}
+invalid:
+	rc = ER_NO_CONNECTION;
+	errmsg = "Invalid MsgPack in response";
+error:
+	lua_pushinteger(L, rc);
+	lua_pushstring(L, errmsg);
 	return 2;
 }
 
 static int
 netbox_encode_execute(lua_State *L)
 {
-	if (lua_gettop(L) < 5)
+	if (lua_gettop(L) < 6)
 		return luaL_error(L, "Usage: netbox.encode_execute(ibuf, "\
-				  "sync, query, parameters, options)");
+				  "sync, stream_id, query, parameters, "\
+				  "options)");
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_EXECUTE);
 
 	mpstream_encode_map(&stream, 3);
 
-	size_t len;
-	const char *query = lua_tolstring(L, 3, &len);
-	mpstream_encode_uint(&stream, IPROTO_SQL_TEXT);
-	mpstream_encode_strn(&stream, query, len);
+	if (lua_type(L, 4) == LUA_TNUMBER) {
+		/* A statement prepared with encode_prepare(). */
+		mpstream_encode_uint(&stream, IPROTO_STMT_ID);
+		mpstream_encode_uint(&stream, lua_tointeger(L, 4));
+	} else {
+		size_t len;
+		const char *query = lua_tolstring(L, 4, &len);
+		mpstream_encode_uint(&stream, IPROTO_SQL_TEXT);
+		mpstream_encode_strn(&stream, query, len);
+	}
 
 	mpstream_encode_uint(&stream, IPROTO_SQL_BIND);
-	luamp_encode_tuple(L, cfg, &stream, 4);
+	luamp_encode_tuple(L, cfg, &stream, 5);
 
 	mpstream_encode_uint(&stream, IPROTO_OPTIONS);
-	luamp_encode_tuple(L, cfg, &stream, 5);
+	luamp_encode_tuple(L, cfg, &stream, 6);
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
+static int
+netbox_encode_prepare(lua_State *L)
+{
+	if (lua_gettop(L) < 4)
+		return luaL_error(L, "Usage: netbox.encode_prepare(ibuf, "\
+				  "sync, stream_id, query)");
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_PREPARE);
+
+	mpstream_encode_map(&stream, 1);
+
+	size_t len;
+	const char *query = lua_tolstring(L, 4, &len);
+	mpstream_encode_uint(&stream, IPROTO_SQL_TEXT);
+	mpstream_encode_strn(&stream, query, len);
 
 	netbox_encode_request(&stream, svp);
 	return 0;
@@ -745,6 +1085,37 @@ netbox_decode_execute(struct lua_State *L)
 	return 2;
 }
 
+/**
+ * Decode a reply to SELECT with IPROTO_CURSOR or to FETCH into
+ * {rows = {tuple, ...}, cursor_id = id}. The cursor id is nil
+ * if the cursor is exhausted.
+ */
+static int
+netbox_decode_cursor(struct lua_State *L)
+{
+	uint32_t ctypeid;
+	const char *data = *(const char **)luaL_checkcdata(L, 1, &ctypeid);
+	assert(mp_typeof(*data) == MP_MAP);
+	uint32_t map_size = mp_decode_map(&data);
+	lua_createtable(L, 0, 2);
+	for (uint32_t i = 0; i < map_size; ++i) {
+		uint32_t key = mp_decode_uint(&data);
+		switch (key) {
+		case IPROTO_DATA:
+			netbox_decode_data(L, &data);
+			lua_setfield(L, -2, "rows");
+			break;
+		default:
+			assert(key == IPROTO_CURSOR_ID);
+			luaL_pushuint64(L, mp_decode_uint(&data));
+			lua_setfield(L, -2, "cursor_id");
+			break;
+		}
+	}
+	*(const char **)luaL_pushcdata(L, ctypeid) = data;
+	return 2;
+}
+
 int
 luaopen_net_box(struct lua_State *L)
 {
@@ -760,13 +1131,23 @@ luaopen_net_box(struct lua_State *L)
 		{ "encode_update",  netbox_encode_update },
 		{ "encode_upsert",  netbox_encode_upsert },
 		{ "encode_execute", netbox_encode_execute},
+		{ "encode_prepare", netbox_encode_prepare},
 		{ "encode_auth",    netbox_encode_auth },
+		{ "encode_begin",   netbox_encode_begin },
+		{ "encode_commit",  netbox_encode_commit },
+		{ "encode_rollback",netbox_encode_rollback },
+		{ "encode_batch",   netbox_encode_batch },
+		{ "encode_fetch",   netbox_encode_fetch },
 		{ "decode_greeting",netbox_decode_greeting },
 		{ "communicate",    netbox_communicate },
+		{ "recv_response",  netbox_recv_response },
 		{ "decode_select",  netbox_decode_select },
 		{ "decode_execute", netbox_decode_execute },
+		{ "decode_cursor",  netbox_decode_cursor },
 		{ NULL, NULL}
 	};
+	CTID_CHAR_PTR = luaL_ctypeid(L, "char *");
+	assert(CTID_CHAR_PTR != 0);
 	/* luaL_register_module polutes _G */
 	lua_newtable(L);
 	luaL_openlib(L, NULL, net_box_lib, 0);
@@ -23,6 +23,7 @@ local check_space_arg     = box.internal.check_space_arg
 local check_primary_index = box.internal.check_primary_index
 
 local communicate     = internal.communicate
+local recv_response   = internal.recv_response
 local encode_auth     = internal.encode_auth
 local encode_select   = internal.encode_select
 local decode_greeting = internal.decode_greeting
@@ -31,13 +32,13 @@ local TIMEOUT_INFINITY = 500 * 365 * 86400
 local VSPACE_ID        = 281
 local VINDEX_ID        = 289
 local DEFAULT_CONNECT_TIMEOUT = 10
+local DEFAULT_FETCH_LIMIT = 1000
 
-local IPROTO_STATUS_KEY    = 0x00
 local IPROTO_ERRNO_MASK    = 0x7FFF
-local IPROTO_SYNC_KEY      = 0x01
-local IPROTO_SCHEMA_VERSION_KEY = 0x05
 local IPROTO_METADATA_KEY = 0x32
 local IPROTO_SQL_INFO_KEY = 0x42
+local IPROTO_STMT_ID_KEY = 0x43
+local IPROTO_BATCH_ERRORS_KEY = 0x33
 local SQL_INFO_ROW_COUNT_KEY = 0
 local IPROTO_FIELD_NAME_KEY = 0
 local IPROTO_DATA_KEY      = 0x30
@@ -77,6 +78,24 @@ local function decode_count(raw_data)
     local response, raw_end = decode(raw_data)
     return response[IPROTO_DATA_KEY][1], raw_end
 end
+local function decode_prepare(raw_data)
+    local response, raw_end = decode(raw_data)
+    return {stmt_id = response[IPROTO_STMT_ID_KEY]}, raw_end
+end
+local function decode_batch(raw_data)
+    local response, raw_end = decode(raw_data)
+    local result = response[IPROTO_DATA_KEY]
+    for i, tuple in ipairs(result) do
+        if type(tuple) == 'table' then
+            result[i] = box.tuple.new(tuple)
+        end
+    end
+    local errors = response[IPROTO_BATCH_ERRORS_KEY] or {}
+    for offset, err in pairs(errors) do
+        result[offset + 1] = box.error.new({code = err[1], reason = err[2]})
+    end
+    return result, raw_end
+end
 local function decode_push(raw_data)
     local response, raw_end = decode(raw_data)
     return response[IPROTO_DATA_KEY][1], raw_end
@@ -94,12 +113,19 @@ local method_encoder = {
     upsert  = internal.encode_upsert,
     select  = internal.encode_select,
     execute = internal.encode_execute,
+    prepare = internal.encode_prepare,
     get     = internal.encode_select,
     min     = internal.encode_select,
     max     = internal.encode_select,
     count   = internal.encode_call,
+    begin   = internal.encode_begin,
+    commit  = internal.encode_commit,
+    rollback = internal.encode_rollback,
+    batch   = internal.encode_batch,
+    open_cursor = internal.encode_select,
+    fetch   = internal.encode_fetch,
     -- inject raw data into connection, used by console and tests
-    inject = function(buf, id, bytes)
+    inject = function(buf, id, stream_id, bytes)
         local ptr = buf:reserve(#bytes)
         ffi.copy(ptr, bytes, #bytes)
         buf.wpos = ptr + #bytes
@@ -118,10 +144,17 @@ local method_decoder = {
     upsert  = decode_nil,
     select  = internal.decode_select,
     execute = internal.decode_execute,
+    prepare = decode_prepare,
     get     = decode_get,
     min     = decode_get,
     max     = decode_get,
     count   = decode_count,
+    begin   = decode_nil,
+    commit  = decode_nil,
+    rollback = decode_nil,
+    batch   = decode_batch,
+    open_cursor = internal.decode_cursor,
+    fetch   = internal.decode_cursor,
     inject  = decode_data,
     push    = decode_push,
 }
@@ -317,9 +350,14 @@ local function create_transport(host, port, user, password, callback,
         end
         local old_message_count = #messages
         local timeout = iterator.timeout
+        local cond = request.cond
+        if cond == nil then
+            cond = fiber.cond()
+            request.cond = cond
+        end
         repeat
             local ts = fiber_clock()
-            request.cond:wait(timeout)
+            cond:wait(timeout)
             timeout = timeout - (fiber_clock() - ts)
             if request:is_ready() or old_message_count ~= #messages then
                 goto retry
@@ -360,11 +398,16 @@ local function create_transport(host, port, user, password, callback,
             timeout = TIMEOUT_INFINITY
         end
         if not self:is_ready() then
+            local cond = self.cond
+            if cond == nil then
+                cond = fiber.cond()
+                self.cond = cond
+            end
             -- When a response is ready before timeout, the
             -- waiting client is waked up prematurely.
             while timeout > 0 and not self:is_ready() do
                 local ts = fiber.clock()
-                self.cond:wait(timeout)
+                cond:wait(timeout)
                 timeout = timeout - (fiber.clock() - ts)
             end
             if not self:is_ready() then
@@ -386,9 +429,56 @@ local function create_transport(host, port, user, password, callback,
             self.response = 'Response is discarded'
         end
     end
+    --
+    -- Set a function to be called when the request is finished,
+    -- with the future as the only argument. The callback is
+    -- invoked right away if the request is already finished,
+    -- otherwise from the connection worker fiber, so it must not
+    -- yield: the connection does not read responses until it
+    -- returns. Pushes do not invoke the callback.
+    --
+    function request_index:on_complete(callback)
+        if type(callback) ~= 'function' then
+            error('Usage: future:on_complete(callback)')
+        end
+        if self:is_ready() then
+            callback(self)
+        else
+            self.on_complete_cb = callback
+        end
+    end
 
     local request_mt = { __index = request_index }
 
+    --
+    -- Wake up the fibers waiting for a request and, if it is
+    -- finished, run its completion callback. The condition
+    -- variable is created lazily by the first waiter, so requests
+    -- nobody waits for, e.g. discarded or polled futures, cost
+    -- no fiber.cond() at all.
+    --
+    local function wakeup_request(request)
+        local cond = request.cond
+        if cond ~= nil then
+            cond:broadcast()
+        end
+        -- Conditions of wait_any()/wait_all() in progress.
+        local waiters = request.waiters
+        if waiters ~= nil then
+            for waiter in pairs(waiters) do
+                waiter:broadcast()
+            end
+        end
+        local callback = request.on_complete_cb
+        if callback ~= nil and request.id == nil then
+            request.on_complete_cb = nil
+            local ok, err = pcall(callback, request)
+            if not ok then
+                log.error('net.box: on_complete callback failed: %s', err)
+            end
+        end
+    end
+
     -- STATE SWITCHING --
     local function set_state(new_state, new_errno, new_error)
         state = new_state
@@ -402,7 +492,7 @@ local function create_transport(host, port, user, password, callback,
                 request.id = nil
                 request.errno = new_errno
                 request.response = new_error
-                request.cond:broadcast()
+                wakeup_request(request)
             end
             requests = {}
         end
@@ -480,11 +570,13 @@ local function create_transport(host, port, user, password, callback,
 
     --
     -- Send a request and do not wait for response.
+    -- @param stream_id Id of the stream to send the request in,
+    --        nil or 0 if the request does not belong to a stream.
     -- @retval nil, error Error occured.
     -- @retval not nil Future object.
     --
     local function perform_async_request(buffer, method, on_push, on_push_ctx,
-                                         ...)
+                                         stream_id, ...)
         if state ~= 'active' and state ~= 'fetch_schema' then
             return nil, box.error.new({code = last_errno or E_NO_CONNECTION,
                                        reason = last_error})
@@ -495,16 +587,15 @@ local function create_transport(host, port, user, password, callback,
             worker_fiber:wakeup()
         end
         local id = next_request_id
-        method_encoder[method](send_buf, id, ...)
+        method_encoder[method](send_buf, id, stream_id, ...)
         next_request_id = next_id(id)
         -- Request in most cases has maximum 8 members:
         -- method, buffer, id, cond, errno, response, on_push,
-        -- on_push_ctx.
+        -- on_push_ctx. The cond is created by the first waiter.
         local request = setmetatable(table_new(0, 8), request_mt)
         request.method = method
         request.buffer = buffer
         request.id = id
-        request.cond = fiber.cond()
         requests[id] = request
         request.on_push = on_push
         request.on_push_ctx = on_push_ctx
@@ -517,22 +608,21 @@ local function create_transport(host, port, user, password, callback,
     -- @retval not nil Response object.
     --
     local function perform_request(timeout, buffer, method, on_push,
-                                   on_push_ctx, ...)
+                                   on_push_ctx, stream_id, ...)
         local request, err =
-            perform_async_request(buffer, method, on_push, on_push_ctx, ...)
+            perform_async_request(buffer, method, on_push, on_push_ctx,
+                                  stream_id, ...)
         if not request then
             return nil, err
         end
         return request:wait_result(timeout)
     end
 
-    local function dispatch_response_iproto(hdr, body_rpos, body_end)
-        local id = hdr[IPROTO_SYNC_KEY]
+    local function dispatch_response_iproto(id, status, body_rpos, body_end)
         local request = requests[id]
         if request == nil then -- nobody is waiting for the response
             return
         end
-        local status = hdr[IPROTO_STATUS_KEY]
         local body, body_end_check
 
         if status > IPROTO_CHUNK_KEY then
@@ -543,7 +633,7 @@ local function create_transport(host, port, user, password, callback,
             assert(body_end == body_end_check, "invalid xrow length")
             request.errno = band(status, IPROTO_ERRNO_MASK)
             request.response = body[IPROTO_ERROR_KEY]
-            request.cond:broadcast()
+            wakeup_request(request)
             return
         end
 
@@ -561,7 +651,7 @@ local function create_transport(host, port, user, password, callback,
             else
                 request.on_push(request.on_push_ctx, body_len)
             end
-            request.cond:broadcast()
+            wakeup_request(request)
             return
         end
 
@@ -580,7 +670,7 @@ local function create_transport(host, port, user, password, callback,
             assert(real_end == body_end, "invalid body length")
             request.on_push(request.on_push_ctx, msg)
         end
-        request.cond:broadcast()
+        wakeup_request(request)
     end
 
     local function new_request_id()
@@ -595,29 +685,15 @@ local function create_transport(host, port, user, password, callback,
                            limit_or_boundary, timeout)
     end
 
+    --
+    -- Read one response. The header is parsed in C, so that
+    -- no Lua table is created for it.
+    -- @retval err, message Error occured.
+    -- @retval nil, sync, status, schema_version, body_rpos,
+    --         body_end Success.
+    --
     local function send_and_recv_iproto(timeout)
-        local data_len = recv_buf.wpos - recv_buf.rpos
-        local required = 0
-        if data_len < 5 then
-            required = 5
-        else
-            -- PWN! insufficient input validation
-            local bufpos = recv_buf.rpos
-            local len, rpos = decode(bufpos)
-            required = (rpos - bufpos) + len
-            if data_len >= required then
-                local body_end = rpos + len
-                local hdr, body_rpos = decode(rpos)
-                recv_buf.rpos = body_end
-                return nil, hdr, body_rpos, body_end
-            end
-        end
-        local deadline = fiber_clock() + (timeout or TIMEOUT_INFINITY)
-        local err, extra = send_and_recv(required, timeout)
-        if err then
-            return err, extra
-        end
-        return send_and_recv_iproto(max(0, deadline - fiber_clock()))
+        return recv_response(connection:fd(), send_buf, recv_buf, timeout)
     end
 
     local function send_and_recv_console(timeout)
@@ -638,6 +714,14 @@ local function create_transport(host, port, user, password, callback,
     -- tail-recursive calls to each other. Yep, Lua optimizes
     -- such calls, and yep, this is the canonical way to implement
     -- a state machine in Lua.
+    --
+    -- Only the per-packet work is done in C: request encoding,
+    -- response framing and header parsing (recv_response) and
+    -- body decoding of the hot methods. The state machine, the
+    -- map of pending requests, timeouts and futures are kept in
+    -- Lua on purpose: they are the module's public behaviour
+    -- (on_push, is_async, buffer, schema reload), and porting them
+    -- means rewriting net.box rather than speeding it up.
     local console_sm, iproto_auth_sm, iproto_schema_sm, iproto_sm, error_sm
 
     --
@@ -691,7 +775,7 @@ local function create_transport(host, port, user, password, callback,
             request.id = nil
             requests[rid] = nil
             request.response = response
-            request.cond:broadcast()
+            wakeup_request(request)
             return console_sm(next_id(rid))
         end
     end
@@ -702,18 +786,18 @@ local function create_transport(host, port, user, password, callback,
             set_state('fetch_schema')
             return iproto_schema_sm()
         end
-        encode_auth(send_buf, new_request_id(), user, password, salt)
-        local err, hdr, body_rpos, body_end = send_and_recv_iproto()
+        encode_auth(send_buf, new_request_id(), nil, user, password, salt)
+        local err, sync, status, schema_version, body_rpos =
+            send_and_recv_iproto()
         if err then
-            return error_sm(err, hdr)
+            return error_sm(err, sync)
         end
-        if hdr[IPROTO_STATUS_KEY] ~= 0 then
-            local body
-            body, body_end = decode(body_rpos)
+        if status ~= 0 then
+            local body = decode(body_rpos)
             return error_sm(E_NO_CONNECTION, body[IPROTO_ERROR_KEY])
         end
         set_state('fetch_schema')
-        return iproto_schema_sm(hdr[IPROTO_SCHEMA_VERSION_KEY])
+        return iproto_schema_sm(schema_version)
     end
 
     iproto_schema_sm = function(schema_version)
@@ -725,23 +809,22 @@ local function create_transport(host, port, user, password, callback,
         local select2_id = new_request_id()
         local response = {}
         -- fetch everything from space _vspace, 2 = ITER_ALL
-        encode_select(send_buf, select1_id, VSPACE_ID, 0, 2, 0, 0xFFFFFFFF, nil)
+        encode_select(send_buf, select1_id, nil, VSPACE_ID, 0, 2, 0,
+                      0xFFFFFFFF, nil)
         -- fetch everything from space _vindex, 2 = ITER_ALL
-        encode_select(send_buf, select2_id, VINDEX_ID, 0, 2, 0, 0xFFFFFFFF, nil)
+        encode_select(send_buf, select2_id, nil, VINDEX_ID, 0, 2, 0,
+                      0xFFFFFFFF, nil)
         schema_version = nil -- any schema_version will do provided that
                              -- it is consistent across responses
         repeat
-            local err, hdr, body_rpos, body_end = send_and_recv_iproto()
-            if err then return error_sm(err, hdr) end
-            dispatch_response_iproto(hdr, body_rpos, body_end)
-            local id = hdr[IPROTO_SYNC_KEY]
+            local err, id, status, response_schema_version, body_rpos,
+                  body_end = send_and_recv_iproto()
+            if err then return error_sm(err, id) end
+            dispatch_response_iproto(id, status, body_rpos, body_end)
             if id == select1_id or id == select2_id then
                 -- response to a schema query we've submitted
-                local status = hdr[IPROTO_STATUS_KEY]
-                local response_schema_version = hdr[IPROTO_SCHEMA_VERSION_KEY]
                 if status ~= 0 then
-                    local body
-                    body, body_end = decode(body_rpos)
+                    local body = decode(body_rpos)
                     return error_sm(E_NO_CONNECTION, body[IPROTO_ERROR_KEY])
                 end
                 if schema_version == nil then
@@ -750,8 +833,7 @@ local function create_transport(host, port, user, password, callback,
                     -- schema changed while fetching schema; restart loader
                     return iproto_schema_sm()
                 end
-                local body
-                body, body_end = decode(body_rpos)
+                local body = decode(body_rpos)
                 response[id] = body[IPROTO_DATA_KEY]
             end
         until response[select1_id] and response[select2_id]
@@ -762,17 +844,14 @@ local function create_transport(host, port, user, password, callback,
     end
 
     iproto_sm = function(schema_version)
-        local err, hdr, body_rpos, body_end = send_and_recv_iproto()
-        if err then return error_sm(err, hdr) end
-        dispatch_response_iproto(hdr, body_rpos, body_end)
-        local status = hdr[IPROTO_STATUS_KEY]
-        local response_schema_version = hdr[IPROTO_SCHEMA_VERSION_KEY]
+        local err, id, status, response_schema_version, body_rpos,
+              body_end = send_and_recv_iproto()
+        if err then return error_sm(err, id) end
+        dispatch_response_iproto(id, status, body_rpos, body_end)
         if response_schema_version > 0 and
            response_schema_version ~= schema_version then
             -- schema_version has been changed - start to load a new version.
             -- Sic: self.schema_version will be updated only after reload.
-            local body
-            body, body_end = decode(body_rpos)
             set_state('fetch_schema')
             return iproto_schema_sm(schema_version)
         end
@@ -941,6 +1020,7 @@ local function new_sm(host, port, opts, connection, greeting)
         setmetatable(remote, remote_mt)
         -- @deprecated since 1.7.4
         remote._deadlines = setmetatable({}, {__mode = 'k'})
+        remote._last_stream_id = 0
 
         remote._space_mt = space_metatable(remote)
         remote._index_mt = index_metatable(remote)
@@ -1057,7 +1137,7 @@ function remote_methods:_request(method, opts, ...)
                 error('To handle pushes in an async request use future:pairs()')
             end
             return transport.perform_async_request(buffer, method, table.insert,
-                                                   {}, ...)
+                                                   {}, self._stream_id, ...)
         end
         if opts.timeout then
             -- conn.space:request(, { timeout = timeout })
@@ -1080,7 +1160,8 @@ function remote_methods:_request(method, opts, ...)
         timeout = deadline and max(0, deadline - fiber_clock())
     end
     local res, err = transport.perform_request(timeout, buffer, method,
-                                               on_push, on_push_ctx, ...)
+                                               on_push, on_push_ctx,
+                                               self._stream_id, ...)
     if err then
         box.error(err)
     end
@@ -1147,6 +1228,61 @@ function remote_methods:execute(query, parameters, sql_opts, netbox_opts)
                          sql_opts or {})
 end
 
+--
+-- Prepare an SQL statement on the server. The returned
+-- stmt_id can be passed to execute() instead of the query
+-- text to skip parsing and planning of the statement.
+--
+function remote_methods:prepare(query, netbox_opts)
+    check_remote_arg(self, "prepare")
+    if type(query) ~= 'string' then
+        error("Usage: remote:prepare(query)")
+    end
+    return self:_request('prepare', netbox_opts, query)
+end
+
+local batch_request_type = {
+    insert = 2, replace = 3, update = 4, delete = 5, upsert = 9
+}
+
+--
+-- Execute several DML requests in one round trip:
+--
+-- conn:batch({{'insert', 'test', {1}}, {'update', 'test', {2}, ops},
+--             {'delete', 'test', {3}}}, {is_atomic = true})
+--
+-- Each request is {method, space, args...}, where the arguments
+-- are the same as of the space method of the same name. update
+-- and delete use the primary index. Returns an array of results
+-- of the requests: a tuple, box.NULL or, unless the batch is
+-- atomic, an error object. An atomic batch is executed in one
+-- transaction and fails with the error of the first failed
+-- request.
+--
+function remote_methods:batch(requests, opts)
+    check_remote_arg(self, 'batch')
+    if type(requests) ~= 'table' then
+        error("Usage: remote:batch(requests, opts)")
+    end
+    local encoded = table_new(#requests, 0)
+    for i, request in ipairs(requests) do
+        local type_id = batch_request_type[request[1]]
+        if type_id == nil then
+            error("Unknown batch request "..tostring(request[1]))
+        end
+        local space_id = request[2]
+        if type(space_id) ~= 'number' then
+            local space = self.space[space_id]
+            if space == nil then
+                box.error(box.error.NO_SUCH_SPACE, tostring(space_id))
+            end
+            space_id = space.id
+        end
+        encoded[i] = {type_id, space_id, 0, request[3], request[4]}
+    end
+    return self:_request('batch', opts, encoded, opts and opts.is_atomic)
+end
+
 function remote_methods:wait_state(state, timeout)
     check_remote_arg(self, 'wait_state')
     if timeout == nil then
@@ -1171,6 +1307,102 @@ function remote_methods:timeout(timeout)
     return self
 end
 
+--
+-- A stream is a sequence of requests sent over the connection
+-- which the server executes one by one, in a separate fiber,
+-- so that an interactive transaction can span several
+-- requests. The stream object has the same methods as the
+-- connection it was created from, but all requests, including
+-- ones sent through stream.space, belong to the stream.
+--
+local stream_methods = {}
+
+local function stream_install_schema(stream)
+    local conn = stream._conn
+    local sl, copies = {}, {}
+    for key, space in pairs(conn.space or {}) do
+        local s = copies[space]
+        if s == nil then
+            s = setmetatable({}, stream._space_mt)
+            for k, v in pairs(space) do
+                s[k] = v
+            end
+            s.connection = stream
+            s.index = {}
+            for index_key, index in pairs(space.index) do
+                local idx = copies[index]
+                if idx == nil then
+                    idx = setmetatable({}, stream._index_mt)
+                    for k, v in pairs(index) do
+                        idx[k] = v
+                    end
+                    idx.space = s
+                    copies[index] = idx
+                end
+                s.index[index_key] = idx
+            end
+            copies[space] = s
+        end
+        sl[key] = s
+    end
+    stream._space = sl
+    stream._schema_version = conn.schema_version
+end
+
+local stream_mt = {
+    __index = function(stream, key)
+        local method = stream_methods[key]
+        if method ~= nil then
+            return method
+        end
+        if key == 'space' then
+            -- Rebuild the space proxies after schema reload.
+            if rawget(stream, '_space') == nil or
+               rawget(stream, '_schema_version') ~=
+               stream._conn.schema_version then
+                stream_install_schema(stream)
+            end
+            return rawget(stream, '_space')
+        end
+        return stream._conn[key]
+    end,
+    __serialize = function(stream)
+        return {stream_id = stream._stream_id}
+    end,
+    __metatable = false
+}
+
+function stream_methods:begin(opts)
+    check_remote_arg(self, 'begin')
+    return self:_request('begin', opts)
+end
+
+function stream_methods:commit(opts)
+    check_remote_arg(self, 'commit')
+    return self:_request('commit', opts)
+end
+
+function stream_methods:rollback(opts)
+    check_remote_arg(self, 'rollback')
+    return self:_request('rollback', opts)
+end
+
+function stream_methods:new_stream()
+    check_remote_arg(self, 'new_stream')
+    return self._conn:new_stream()
+end
+
+function remote_methods:new_stream()
+    check_remote_arg(self, 'new_stream')
+    self._last_stream_id = self._last_stream_id + 1
+    local stream = setmetatable({
+        _stream_id = self._last_stream_id, _conn = self
+    }, stream_mt)
+    stream._space_mt = space_metatable(stream)
+    stream._index_mt = index_metatable(stream)
+    return stream
+end
+
 function remote_methods:_install_schema(schema_version, spaces, indices)
     local sl, space_mt, index_mt = {}, self._space_mt, self._index_mt
     for _, space in pairs(spaces) do
@@ -1283,10 +1515,11 @@ function console_methods:eval(line, timeout)
     end
     if self.protocol == 'Binary' then
         local loader = 'return require("console").eval(...)'
-        res, err = pr(timeout, nil, 'eval', nil, nil, loader, {line})
+        res, err = pr(timeout, nil, 'eval', nil, nil, nil, loader, {line})
     else
         assert(self.protocol == 'Lua console')
-        res, err = pr(timeout, nil, 'inject', nil, nil, line..'$EOF$\n')
+        res, err = pr(timeout, nil, 'inject', nil, nil, nil,
+                      line..'$EOF$\n')
     end
     if err then
         box.error(err)
@@ -1294,6 +1527,65 @@ function console_methods:eval(line, timeout)
     return res[1] or res
 end
 
+--
+-- A server-side cursor created by index:cursor(). The first
+-- cursor:fetch() sends SELECT which leaves the index iterator
+-- open on the server, the next ones continue reading from it,
+-- so that paging through a large result doesn't re-position
+-- the iterator for each page. The server closes the cursor
+-- when it is exhausted, or when it is idle for longer than
+-- box.cfg.net_cursor_timeout.
+--
+local cursor_methods = {}
+
+local cursor_mt = {
+    __index = cursor_methods,
+    __serialize = function(cursor)
+        return {cursor_id = cursor._cursor_id, is_eof = cursor._is_eof}
+    end,
+    __metatable = false
+}
+
+local function check_cursor_opts(opts)
+    if opts and (opts.buffer or opts.is_async) then
+        error("cursor:fetch() supports only `timeout` option")
+    end
+end
+
+function cursor_methods:fetch(limit, opts)
+    check_remote_arg(self, 'fetch')
+    check_cursor_opts(opts)
+    limit = limit or DEFAULT_FETCH_LIMIT
+    if type(limit) ~= 'number' or limit < 1 then
+        error("Usage: cursor:fetch([limit, opts])")
+    end
+    if self._is_eof then
+        return {}
+    end
+    local res
+    if self._cursor_id == nil then
+        res = self._remote:_request('open_cursor', opts, self._space_id,
+                                    self._index_id, self._iterator,
+                                    self._offset, limit, self._key, true)
+    else
+        res = self._remote:_request('fetch', opts, self._cursor_id, limit)
+    end
+    self._cursor_id = res.cursor_id
+    self._is_eof = res.cursor_id == nil
+    return res.rows
+end
+
+function cursor_methods:close(opts)
+    check_remote_arg(self, 'close')
+    check_cursor_opts(opts)
+    if self._cursor_id ~= nil then
+        -- FETCH with zero limit closes the cursor.
+        self._remote:_request('fetch', opts, self._cursor_id, 0)
+        self._cursor_id = nil
+    end
+    self._is_eof = true
+end
+
 local function nothing_or_data(value)
     if value ~= nil then
         return value
@@ -1334,6 +1626,11 @@ space_metatable = function(remote)
                                                oplist))
     end
 
+    function methods:cursor(key, opts)
+        check_space_arg(self, 'cursor')
+        return check_primary_index(self):cursor(key, opts)
+    end
+
     function methods:get(key, opts)
         check_space_arg(self, 'get')
         return check_primary_index(self):get(key, opts)
@@ -1364,6 +1661,19 @@ index_metatable = function(remote)
                                 iterator, offset, limit, key))
     end
 
+    function methods:cursor(key, opts)
+        check_index_arg(self, 'cursor')
+        local key_is_nil = (key == nil or
+                            (type(key) == 'table' and #key == 0))
+        local iterator = check_iterator_type(opts, key_is_nil)
+        local offset = tonumber(opts and opts.offset) or 0
+        return setmetatable({
+            _remote = remote, _space_id = self.space.id, _index_id = self.id,
+            _iterator = iterator, _offset = offset, _key = key,
+            _cursor_id = nil, _is_eof = false
+        }, cursor_mt)
+    end
+
     function methods:get(key, opts)
         check_index_arg(self, 'get')
         if opts and opts.buffer then
@@ -1418,12 +1728,106 @@ index_metatable = function(remote)
     return { __index = methods, __metatable = false }
 end
 
+--
+-- Wait until any or all of the futures are ready. A single
+-- condition variable is signaled by every request of the set,
+-- so a fan-out to many connections costs one sleep per
+-- completed response instead of one wait_result() per future.
+--
+local function wait_futures(futures, wait_all, timeout, usage)
+    if type(futures) ~= 'table' then
+        error(usage)
+    end
+    if timeout then
+        if type(timeout) ~= 'number' or timeout < 0 then
+            error(usage)
+        end
+    else
+        timeout = TIMEOUT_INFINITY
+    end
+    local deadline = fiber_clock() + timeout
+    local cond, ready
+    while true do
+        local is_pending = false
+        for k, future in pairs(futures) do
+            if not future:is_ready() then
+                is_pending = true
+            elseif not wait_all then
+                ready = k
+                break
+            end
+        end
+        if ready ~= nil or not is_pending then
+            break
+        end
+        timeout = deadline - fiber_clock()
+        if timeout <= 0 then
+            break
+        end
+        if cond == nil then
+            cond = fiber.cond()
+            for _, future in pairs(futures) do
+                local waiters = future.waiters
+                if waiters == nil then
+                    waiters = {}
+                    future.waiters = waiters
+                end
+                waiters[cond] = true
+            end
+        end
+        cond:wait(timeout)
+    end
+    if cond ~= nil then
+        for _, future in pairs(futures) do
+            future.waiters[cond] = nil
+        end
+    end
+    if wait_all then
+        for _, future in pairs(futures) do
+            if not future:is_ready() then
+                return nil, box.error.new(E_TIMEOUT)
+            end
+        end
+        return true
+    end
+    if ready == nil then
+        return nil, box.error.new(E_TIMEOUT)
+    end
+    return ready, futures[ready]
+end
+
+--
+-- Wait until at least one of the futures is ready.
+-- @param futures Table of futures.
+-- @param timeout Max seconds to wait.
+-- @retval key, future A ready future and its key in the table.
+-- @retval nil, error Timeout or the table is empty.
+--
+local function wait_any(futures, timeout)
+    return wait_futures(futures, false, timeout,
+                        'Usage: net_box.wait_any(futures, timeout)')
+end
+
+--
+-- Wait until all the futures are ready.
+-- @param futures Table of futures.
+-- @param timeout Max seconds to wait.
+-- @retval true All the futures are ready.
+-- @retval nil, error Timeout.
+--
+local function wait_all(futures, timeout)
+    return wait_futures(futures, true, timeout,
+                        'Usage: net_box.wait_all(futures, timeout)')
+end
+
 local this_module = {
     create_transport = create_transport,
     connect = connect,
     new = connect, -- Tarantool < 1.7.1 compatibility,
     wrap = wrap,
     establish_connection = establish_connection,
+    wait_any = wait_any,
+    wait_all = wait_all,
 }
 
 function this_module.timeout(timeout, ...)
@@ -42,6 +42,7 @@
 #include "box/user.h"
 #include "box/schema.h"
 #include "box/port.h"
+#include "box/iproto.h"
 
 static const char *sessionlib_name = "box.session";
 
@@ -272,6 +273,32 @@ lbox_session_peer(struct lua_State *L)
 	return 1;
 }
 
+/**
+ * box.session.priority([class]) - get or set the priority
+ * class of the requests of the current binary session.
+ */
+static int
+lbox_session_priority(struct lua_State *L)
+{
+	struct session *session = current_session();
+	if (session->type != SESSION_TYPE_BINARY)
+		luaL_error(L, "session.priority(): not a binary session");
+	if (lua_gettop(L) == 0) {
+		enum iproto_priority priority =
+			iproto_session_priority(session);
+		lua_pushstring(L, iproto_priority_strs[priority]);
+		return 1;
+	}
+	const char *name = luaL_checkstring(L, 1);
+	enum iproto_priority priority = STR2ENUM(iproto_priority, name);
+	if (priority == iproto_priority_MAX) {
+		luaL_error(L, "session.priority(): unknown priority "
+			   "class '%s'", name);
+	}
+	iproto_session_set_priority(session, priority);
+	return 0;
+}
+
 /**
  * run on_connect|on_disconnect trigger
  */
@@ -468,6 +495,7 @@ box_lua_session_init(struct lua_State *L)
 		{"fd", lbox_session_fd},
 		{"exists", lbox_session_exists},
 		{"peer", lbox_session_peer},
+		{"priority", lbox_session_priority},
 		{"on_connect", lbox_session_on_connect},
 		{"on_disconnect", lbox_session_on_disconnect},
 		{"on_auth", lbox_session_on_auth},
@@ -6,6 +6,7 @@
 #include <info.h>
 #include "lua/info.h"
 #include "lua/utils.h"
+#include "lua/error.h"
 
 static void
 lua_push_column_names(struct lua_State *L, struct sqlite3_stmt *stmt)
@@ -110,6 +111,154 @@ sqlerror:
 	return lua_error(L);
 }
 
+/**
+ * Turn an array on top of the stack into a result set in
+ * box.sql.execute() format: set its metatable and put column
+ * names at index 0.
+ */
+static void
+lua_push_result_names(struct lua_State *L, const char **names, int count)
+{
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_setmetatable(L, -2);
+	lua_createtable(L, count, 0);
+	for (int i = 0; i < count; i++) {
+		lua_pushstring(L, names[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_rawseti(L, -2, 0);
+}
+
+/** Push a new row of a result set. */
+static void
+lua_push_result_row(struct lua_State *L, int column_count)
+{
+	lua_createtable(L, column_count, 0);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, luaL_array_metatable_ref);
+	lua_setmetatable(L, -2);
+}
+
+static void
+lua_push_string_or_nil(struct lua_State *L, const char *str)
+{
+	if (str != NULL)
+		lua_pushstring(L, str);
+	else
+		lua_rawgeti(L, LUA_REGISTRYINDEX, luaL_nil_ref);
+}
+
+static void
+lua_push_op_stats(struct lua_State *L, struct sqlite3_stmt *stmt)
+{
+	static const char *names[] = {
+		"addr", "opcode", "p1", "p2", "p3", "executions", "time",
+	};
+	int op_count = sql_stmt_op_count(stmt);
+	lua_createtable(L, op_count, 1);
+	lua_push_result_names(L, names, lengthof(names));
+	for (int i = 0; i < op_count; i++) {
+		struct sql_op_stat stat;
+		sql_stmt_op_stat(stmt, i, &stat);
+		lua_push_result_row(L, lengthof(names));
+		lua_pushinteger(L, i);
+		lua_rawseti(L, -2, 1);
+		lua_pushstring(L, stat.opcode);
+		lua_rawseti(L, -2, 2);
+		lua_pushinteger(L, stat.p1);
+		lua_rawseti(L, -2, 3);
+		lua_pushinteger(L, stat.p2);
+		lua_rawseti(L, -2, 4);
+		lua_pushinteger(L, stat.p3);
+		lua_rawseti(L, -2, 5);
+		luaL_pushuint64(L, stat.exec_count);
+		lua_rawseti(L, -2, 6);
+		luaL_pushuint64(L, stat.time);
+		lua_rawseti(L, -2, 7);
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
+static void
+lua_push_loop_stats(struct lua_State *L, struct sqlite3_stmt *stmt)
+{
+	static const char *names[] = {
+		"addr", "table", "index", "loops", "rows", "estimate",
+	};
+	int loop_count = sql_stmt_loop_count(stmt);
+	lua_createtable(L, loop_count, 1);
+	lua_push_result_names(L, names, lengthof(names));
+	for (int i = 0; i < loop_count; i++) {
+		struct sql_loop_stat stat;
+		sql_stmt_loop_stat(stmt, i, &stat);
+		lua_push_result_row(L, lengthof(names));
+		lua_pushinteger(L, stat.addr);
+		lua_rawseti(L, -2, 1);
+		lua_push_string_or_nil(L, stat.table);
+		lua_rawseti(L, -2, 2);
+		lua_push_string_or_nil(L, stat.index);
+		lua_rawseti(L, -2, 3);
+		luaL_pushuint64(L, stat.loop_count);
+		lua_rawseti(L, -2, 4);
+		luaL_pushuint64(L, stat.row_count);
+		lua_rawseti(L, -2, 5);
+		luaL_pushuint64(L, stat.row_estimate);
+		lua_rawseti(L, -2, 6);
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
+/**
+ * Execute a statement with profiling and return its execution
+ * statistics instead of its result:
+ * {
+ *     rows = <number of result rows>,
+ *     opcodes = <executions and time of each VDBE instruction>,
+ *     loops = <starts and fetched tuples of each table loop>,
+ * }
+ * Addresses of instructions are the same as in EXPLAIN output.
+ */
+static int
+lua_sql_profile(struct lua_State *L)
+{
+	sqlite3 *db = sql_get();
+	if (db == NULL)
+		return luaL_error(L, "not ready");
+
+	size_t length;
+	const char *sql = lua_tolstring(L, 1, &length);
+	if (sql == NULL)
+		return luaL_error(L, "usage: box.sql.profile(sqlstring)");
+
+	struct sqlite3_stmt *stmt;
+	if (sql_prepare_profiled(db, sql, length, &stmt) != SQLITE_OK)
+		goto sqlerror;
+	assert(stmt != NULL);
+	if (sql_stmt_profile_start(stmt) != 0) {
+		sqlite3_finalize(stmt);
+		return luaT_error(L);
+	}
+	uint64_t row_count = 0;
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		row_count++;
+	if (rc != SQLITE_OK && rc != SQLITE_DONE)
+		goto sqlerror;
+
+	lua_createtable(L, 0, 3);
+	luaL_pushuint64(L, row_count);
+	lua_setfield(L, -2, "rows");
+	lua_push_op_stats(L, stmt);
+	lua_setfield(L, -2, "opcodes");
+	lua_push_loop_stats(L, stmt);
+	lua_setfield(L, -2, "loops");
+	sqlite3_finalize(stmt);
+	return 1;
+sqlerror:
+	lua_pushstring(L, sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	return lua_error(L);
+}
+
 static int
 lua_sql_debug(struct lua_State *L)
 {
@@ -124,6 +273,7 @@ box_lua_sqlite_init(struct lua_State *L)
 {
 	static const struct luaL_Reg module_funcs [] = {
 		{"execute", lua_sql_execute},
+		{"profile", lua_sql_profile},
 		{"debug", lua_sql_debug},
 		{NULL, NULL}
 	};
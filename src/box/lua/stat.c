@@ -42,6 +42,7 @@
 #include "box/iproto.h"
 #include "box/engine.h"
 #include "box/vinyl.h"
+#include "box/sql_stmt_cache.h"
 #include <info.h>
 #include "lua/info.h"
 #include "lua/utils.h"
@@ -127,6 +128,24 @@ lbox_stat_vinyl(struct lua_State *L)
 	return 1;
 }
 
+static int
+lbox_stat_latency(struct lua_State *L)
+{
+	struct info_handler h;
+	luaT_info_handler_create(&h, L);
+	iproto_latency_stat(&h);
+	return 1;
+}
+
+static int
+lbox_stat_sql(struct lua_State *L)
+{
+	struct info_handler h;
+	luaT_info_handler_create(&h, L);
+	sql_stmt_cache_stat(&h);
+	return 1;
+}
+
 static int
 lbox_stat_reset(struct lua_State *L)
 {
@@ -136,10 +155,41 @@ lbox_stat_reset(struct lua_State *L)
 	return 0;
 }
 
+/**
+ * Push a table with statistics of the iproto priority
+ * classes, keyed by the class name.
+ */
+static void
+lbox_stat_net_push_priority(struct lua_State *L)
+{
+	lua_newtable(L);
+	for (int i = 0; i < iproto_priority_MAX; i++) {
+		struct iproto_priority_stat stat;
+		iproto_priority_stat(i, &stat);
+		lua_pushstring(L, iproto_priority_strs[i]);
+		lua_newtable(L);
+		lua_pushnumber(L, stat.queue);
+		lua_setfield(L, -2, "queue");
+		lua_pushnumber(L, stat.in_flight);
+		lua_setfield(L, -2, "in_flight");
+		lua_pushnumber(L, stat.total);
+		lua_setfield(L, -2, "total");
+		lua_pushnumber(L, stat.wait);
+		lua_setfield(L, -2, "wait");
+		lua_pushnumber(L, stat.latency);
+		lua_setfield(L, -2, "latency");
+		lua_settable(L, -3);
+	}
+}
+
 static int
 lbox_stat_net_index(struct lua_State *L)
 {
-	luaL_checkstring(L, -1);
+	const char *key = luaL_checkstring(L, -1);
+	if (strcmp(key, "PRIORITY") == 0) {
+		lbox_stat_net_push_priority(L);
+		return 1;
+	}
 	return rmean_foreach(rmean_net, seek_stat_item, L);
 }
 
@@ -148,6 +198,8 @@ lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
 	rmean_foreach(rmean_net, set_stat_item, L);
+	lbox_stat_net_push_priority(L);
+	lua_setfield(L, -2, "PRIORITY");
 	return 1;
 }
 
@@ -169,6 +221,8 @@ box_lua_stat_init(struct lua_State *L)
 {
 	static const struct luaL_Reg statlib [] = {
 		{"vinyl", lbox_stat_vinyl},
+		{"sql", lbox_stat_sql},
+		{"latency", lbox_stat_latency},
 		{"reset", lbox_stat_reset},
 		{NULL, NULL}
 	};
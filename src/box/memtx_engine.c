@@ -1083,6 +1083,7 @@ memtx_engine_new(const char *snap_dirname, bool force_recovery,
 
 	memtx->base.vtab = &memtx_engine_vtab;
 	memtx->base.name = "memtx";
+	memtx->base.flags = ENGINE_TXN_ABORT_ON_YIELD;
 
 	fiber_start(memtx->gc_fiber, memtx);
 	return memtx;
@@ -653,6 +653,91 @@ memtx_tree_index_create_snapshot_iterator(struct index *base)
 	return (struct snapshot_iterator *) it;
 }
 
+struct tree_range_iterator {
+	struct snapshot_iterator base;
+	struct memtx_tree *tree;
+	struct memtx_tree_iterator tree_iterator;
+	/** The first tuple past the range or NULL. */
+	struct tuple *end;
+};
+
+static void
+tree_range_iterator_free(struct snapshot_iterator *iterator)
+{
+	assert(iterator->free == tree_range_iterator_free);
+	free(iterator);
+}
+
+static const char *
+tree_range_iterator_next(struct snapshot_iterator *iterator, uint32_t *size)
+{
+	assert(iterator->free == tree_range_iterator_free);
+	struct tree_range_iterator *it =
+		(struct tree_range_iterator *)iterator;
+	struct tuple **res = memtx_tree_iterator_get_elem(it->tree,
+						&it->tree_iterator);
+	if (res == NULL || *res == it->end)
+		return NULL;
+	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
+	return tuple_data_range(*res, size);
+}
+
+int
+memtx_tree_index_create_range_iterators(struct index *base, uint32_t count,
+					struct snapshot_iterator **iterators)
+{
+	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
+	struct memtx_tree *tree = &index->tree;
+	assert(count > 0);
+	size_t size = sizeof(struct tuple *) * count;
+	struct tuple **bounds =
+		(struct tuple **)region_alloc(&fiber()->gc, size);
+	if (bounds == NULL) {
+		diag_set(OutOfMemory, size, "region", "bounds");
+		return -1;
+	}
+	/* Split the index at random tuples. */
+	uint32_t bound_count = 0;
+	for (uint32_t i = 1; i < count; i++) {
+		struct tuple **res = memtx_tree_random(tree, rand());
+		if (res != NULL)
+			bounds[bound_count++] = *res;
+	}
+	qsort_arg(bounds, bound_count, sizeof(struct tuple *),
+		  memtx_tree_qcompare, memtx_tree_index_cmp_def(index));
+	uint32_t unique_count = 0;
+	for (uint32_t i = 0; i < bound_count; i++) {
+		if (unique_count == 0 || bounds[unique_count - 1] != bounds[i])
+			bounds[unique_count++] = bounds[i];
+	}
+	bound_count = unique_count;
+	/* Range i spans [bounds[i - 1], bounds[i]). */
+	for (uint32_t i = 0; i <= bound_count; i++) {
+		struct tree_range_iterator *it =
+			(struct tree_range_iterator *)malloc(sizeof(*it));
+		if (it == NULL) {
+			diag_set(OutOfMemory, sizeof(*it),
+				 "memtx_tree_index", "range iterator");
+			for (uint32_t j = 0; j < i; j++)
+				iterators[j]->free(iterators[j]);
+			return -1;
+		}
+		it->base.free = tree_range_iterator_free;
+		it->base.next = tree_range_iterator_next;
+		it->tree = tree;
+		if (i == 0) {
+			it->tree_iterator = memtx_tree_iterator_first(tree);
+		} else {
+			it->tree_iterator =
+				memtx_tree_lower_bound_elem(tree, bounds[i - 1],
+							    NULL);
+		}
+		it->end = i < bound_count ? bounds[i] : NULL;
+		iterators[i] = &it->base;
+	}
+	return bound_count + 1;
+}
+
 static const struct index_vtab memtx_tree_index_vtab = {
 	/* .destroy = */ memtx_tree_index_destroy,
 	/* .commit_create = */ generic_index_commit_create,
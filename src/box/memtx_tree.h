@@ -104,6 +104,24 @@ struct memtx_tree_index {
 struct memtx_tree_index *
 memtx_tree_index_new(struct memtx_engine *memtx, struct index_def *def);
 
+/**
+ * Split a tree index into ranges of approximately equal size
+ * at random tuples and create an iterator over each of them.
+ * The iterators don't reference tuples and don't create read
+ * views, so they may be used by other threads only as long as
+ * the TX thread doesn't modify the index.
+ *
+ * @param index Tree index to split.
+ * @param count Maximal number of ranges.
+ * @param[out] iterators Array of at least @a count iterators,
+ *             must be destroyed with snapshot_iterator::free.
+ *
+ * @retval Number of created iterators, -1 on error.
+ */
+int
+memtx_tree_index_create_range_iterators(struct index *index, uint32_t count,
+					struct snapshot_iterator **iterators);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
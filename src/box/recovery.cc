@@ -168,6 +168,8 @@ recovery_open_log(struct recovery *r, const struct vclock *vclock)
 	recovery_close_log(r);
 
 	xdir_open_cursor_xc(&r->wal_dir, vclock_sum(vclock), &r->cursor);
+	/* Skip rows that have already been recovered, if possible. */
+	xlog_cursor_seek(&r->cursor, &r->vclock);
 
 	if (state == XLOG_CURSOR_NEW &&
 	    vclock_compare(vclock, &r->vclock) > 0) {
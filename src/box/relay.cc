@@ -30,6 +30,10 @@
  */
 #include "relay.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "trivia/config.h"
 #include "trivia/util.h"
 #include "scoped_guard.h"
@@ -293,6 +297,109 @@ relay_initial_join(int fd, uint64_t sync, struct vclock *vclock)
 	engine_join_xc(vclock, &relay->stream);
 }
 
+enum {
+	/** Size of a piece a checkpoint file is sent in. */
+	RELAY_FILE_CHUNK_SIZE = 1024 * 1024,
+};
+
+/** Used to pass arguments to relay_initial_join_files_f. */
+struct relay_join_files_arg {
+	struct relay *relay;
+	const struct relay_file *files;
+	int file_count;
+};
+
+/**
+ * Send a checkpoint file to the replica, chunk by chunk.
+ * Checkpoint files are immutable so we don't have to care
+ * about concurrent modifications.
+ */
+static void
+relay_send_file(struct relay *relay, const struct relay_file *file,
+		char *buf)
+{
+	int fd = open(file->path, O_RDONLY);
+	if (fd < 0) {
+		diag_set(SystemError, "failed to open file '%s'", file->path);
+		diag_raise();
+	}
+	auto fd_guard = make_scoped_guard([=] { close(fd); });
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		diag_set(SystemError, "failed to stat file '%s'", file->path);
+		diag_raise();
+	}
+	say_verbose("sending file '%s'", file->path);
+
+	struct file_chunk chunk;
+	chunk.name = file->name;
+	chunk.name_len = strlen(file->name);
+	chunk.file_size = st.st_size;
+	uint64_t offset = 0;
+	do {
+		ssize_t n = read(fd, buf, RELAY_FILE_CHUNK_SIZE);
+		if (n < 0 || (n == 0 && offset < chunk.file_size)) {
+			diag_set(SystemError, "failed to read file '%s'",
+				 file->path);
+			diag_raise();
+		}
+		chunk.data = buf;
+		chunk.data_len = n;
+		struct xrow_header row;
+		xrow_encode_file_chunk_xc(&row, &chunk);
+		relay_send(relay, &row);
+		offset += n;
+	} while (offset < chunk.file_size);
+}
+
+static int
+relay_initial_join_files_f(va_list ap)
+{
+	struct relay_join_files_arg *arg =
+		va_arg(ap, struct relay_join_files_arg *);
+	struct relay *relay = arg->relay;
+
+	coio_enable();
+	relay_set_cord_name(relay->io.fd);
+
+	char *buf = (char *) malloc(RELAY_FILE_CHUNK_SIZE);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, RELAY_FILE_CHUNK_SIZE, "malloc", "buf");
+		diag_raise();
+	}
+	auto buf_guard = make_scoped_guard([=] { free(buf); });
+	for (int i = 0; i < arg->file_count; i++)
+		relay_send_file(relay, &arg->files[i], buf);
+	return 0;
+}
+
+void
+relay_initial_join_files(int fd, uint64_t sync,
+			 const struct relay_file *files, int file_count)
+{
+	struct relay *relay = relay_new(NULL);
+	if (relay == NULL)
+		diag_raise();
+
+	relay_start(relay, fd, sync, relay_send_initial_join_row);
+	auto relay_guard = make_scoped_guard([=] {
+		relay_stop(relay);
+		relay_delete(relay);
+	});
+
+	/*
+	 * Reading files may block, so do it in a separate
+	 * thread to not stall tx.
+	 */
+	struct relay_join_files_arg arg = { relay, files, file_count };
+	int rc = cord_costart(&relay->cord, "join_files",
+			      relay_initial_join_files_f, &arg);
+	if (rc == 0)
+		rc = cord_cojoin(&relay->cord);
+	if (rc != 0)
+		diag_raise();
+}
+
 int
 relay_final_join_f(va_list ap)
 {
@@ -99,6 +99,30 @@ relay_vclock(const struct relay *relay);
 void
 relay_initial_join(int fd, uint64_t sync, struct vclock *vclock);
 
+/** A checkpoint file sent to the replica by file-level JOIN. */
+struct relay_file {
+	/** Path to the file on the local disk. */
+	const char *path;
+	/**
+	 * Name under which the file is sent: engine name followed
+	 * by the path relative to the engine directory.
+	 */
+	const char *name;
+};
+
+/**
+ * Send initial JOIN data to the replica as raw checkpoint
+ * files rather than rows.
+ *
+ * @param fd         client connection
+ * @param sync       sync from incoming JOIN request
+ * @param files      checkpoint files to send
+ * @param file_count number of files
+ */
+void
+relay_initial_join_files(int fd, uint64_t sync,
+			 const struct relay_file *files, int file_count);
+
 /**
  * Send final JOIN rows to the replica.
  *
@@ -137,6 +137,12 @@ extern double replication_sync_timeout;
  */
 extern bool replication_skip_conflict;
 
+/**
+ * Ask the master to send initial JOIN data as raw checkpoint
+ * files instead of rows.
+ */
+extern bool replication_join_files;
+
 /**
  * Wait for the given period of time before trying to reconnect
  * to a master.
@@ -200,6 +200,11 @@ struct space {
 	 * of parent constraints as well as child ones.
 	 */
 	uint64_t fkey_mask;
+	/**
+	 * Number of statements changed the space since SQL
+	 * statistics on it were collected last time.
+	 */
+	uint64_t change_count;
 };
 
 /** Initialize a base space instance. */
@@ -29,8 +29,10 @@
  * SUCH DAMAGE.
  */
 #include <assert.h>
+#include <unistd.h>
 #include "field_def.h"
 #include "sql.h"
+#include "sql_stmt_cache.h"
 #include "sql/sqliteInt.h"
 #include "sql/tarantoolInt.h"
 #include "sql/vdbeInt.h"
@@ -43,10 +45,13 @@
 #include "txn.h"
 #include "space.h"
 #include "memtx_space.h"
+#include "memtx_tree.h"
 #include "space_def.h"
 #include "index_def.h"
 #include "tuple.h"
 #include "fiber.h"
+#include "coio_task.h"
+#include "tt_pthread.h"
 #include "small/region.h"
 #include "session.h"
 #include "xrow.h"
@@ -74,6 +79,9 @@ sql_init()
 		panic("failed to initialize SQL subsystem");
 
 	assert(db != NULL);
+
+	if (sql_stmt_cache_init() != 0)
+		panic("failed to initialize SQL statement cache");
 }
 
 void
@@ -103,6 +111,7 @@ sql_load_schema()
 void
 sql_free()
 {
+	sql_stmt_cache_destroy();
 	sqlite3_close(db); db = NULL;
 }
 
@@ -281,6 +290,12 @@ int tarantoolSqlite3MovetoUnpacked(BtCursor *pCur, UnpackedRecord *pIdxKey,
 		return SQL_TARANTOOL_ERROR;
 	memcpy(pCur->key, tuple, tuple_size);
 	region_truncate(region, used);
+	/*
+	 * A filter is only valid for a scan started by
+	 * OP_Rewind or OP_Last. A seek may look for a tuple
+	 * which does not satisfy it.
+	 */
+	pCur->filter = NULL;
 
 	int rc, res_success;
 	switch (pIdxKey->opcode) {
@@ -934,6 +949,580 @@ cursor_seek(BtCursor *pCur, int *pRes)
 	return cursor_advance(pCur, pRes);
 }
 
+/**
+ * Compare a tuple field with a value of a cursor filter.
+ *
+ * @param field MsgPack field of a tuple, not NULL.
+ * @param value MsgPack integer or string to compare with.
+ * @param[out] cmp Result of comparison: < 0, 0 or > 0 if the
+ *             field is less than, equal or greater than the
+ *             value.
+ *
+ * @retval 0 on success.
+ * @retval -1 if the field is not of the value's type.
+ */
+static int
+cursor_filter_compare(const char *field, const char *value, int *cmp)
+{
+	enum mp_type field_type = mp_typeof(*field);
+	switch (mp_typeof(*value)) {
+	case MP_UINT:
+	case MP_INT: {
+		if (field_type != MP_UINT && field_type != MP_INT)
+			return -1;
+		int64_t rhs = mp_typeof(*value) == MP_UINT ?
+			      (int64_t) mp_decode_uint(&value) :
+			      mp_decode_int(&value);
+		if (field_type == MP_UINT) {
+			uint64_t lhs = mp_decode_uint(&field);
+			if (rhs < 0 || lhs > (uint64_t) rhs)
+				*cmp = 1;
+			else
+				*cmp = lhs < (uint64_t) rhs ? -1 : 0;
+		} else {
+			int64_t lhs = mp_decode_int(&field);
+			*cmp = lhs < rhs ? -1 : lhs > rhs;
+		}
+		return 0;
+	}
+	case MP_STR: {
+		if (field_type != MP_STR)
+			return -1;
+		uint32_t lhs_len, rhs_len;
+		const char *lhs = mp_decode_str(&field, &lhs_len);
+		const char *rhs = mp_decode_str(&value, &rhs_len);
+		*cmp = memcmp(lhs, rhs, MIN(lhs_len, rhs_len));
+		if (*cmp == 0)
+			*cmp = lhs_len < rhs_len ? -1 : lhs_len > rhs_len;
+		return 0;
+	}
+	default:
+		unreachable();
+		return -1;
+	}
+}
+
+/**
+ * Check a single condition of a cursor filter.
+ *
+ * @param field Field of a tuple or NULL if it is absent.
+ * @param op Comparison: TK_EQ, TK_LT, TK_LE, TK_GT or TK_GE.
+ * @param value Value to compare with.
+ *
+ * @retval false if the condition is false or NULL.
+ */
+static bool
+cursor_filter_check(const char *field, int op, const char *value)
+{
+	if (field == NULL || mp_typeof(*field) == MP_NIL)
+		return false;
+	int cmp;
+	if (cursor_filter_compare(field, value, &cmp) != 0)
+		return true;
+	switch (op) {
+	case TK_EQ: return cmp == 0;
+	case TK_LT: return cmp < 0;
+	case TK_LE: return cmp <= 0;
+	case TK_GT: return cmp > 0;
+	default:
+		assert(op == TK_GE);
+		return cmp >= 0;
+	}
+}
+
+/**
+ * Check if a tuple satisfies the filter of a cursor. The filter
+ * is a MsgPack array of [field number, comparison, value]
+ * triples, where comparison is one of TK_EQ, TK_LT, TK_LE,
+ * TK_GT, TK_GE and value is an integer or a string. A tuple is
+ * rejected only if some condition is false or NULL for it: the
+ * VDBE checks all conditions of returned tuples anyway.
+ *
+ * @param filter Cursor filter.
+ * @param tuple Tuple to check.
+ *
+ * @retval true if the tuple should be returned by the cursor.
+ */
+static bool
+cursor_filter_match(const char *filter, struct tuple *tuple)
+{
+	uint32_t count = mp_decode_array(&filter);
+	for (uint32_t i = 0; i < count; i++) {
+		MAYBE_UNUSED uint32_t len = mp_decode_array(&filter);
+		assert(len == 3);
+		uint32_t fieldno = mp_decode_uint(&filter);
+		int op = mp_decode_uint(&filter);
+		const char *value = filter;
+		mp_next(&filter);
+		if (!cursor_filter_check(tuple_field(tuple, fieldno), op,
+					 value))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Minimal size of an index scanned by sql_cursor_aggregate()
+ * in several threads.
+ */
+enum { SQL_CURSOR_AGG_PARALLEL_MIN = 64 * 1024 };
+
+/**
+ * Number of threads scanning an index, the TX thread included,
+ * see sql_aggregate_threads.
+ */
+static int cursor_agg_threads = 4;
+
+/**
+ * Number of aggregation tasks in the worker pool. Tasks of a
+ * finished aggregation stay there until they are scheduled, so
+ * they are counted against cursor_agg_threads too.
+ */
+static int cursor_agg_task_count = 0;
+
+/** Range of an index aggregated by a thread. */
+struct sql_cursor_agg_range {
+	/** Filter or NULL. */
+	const char *filter;
+	/** Array of [type, field number, register] triples. */
+	const char *funcs;
+	/** Number of aggregate functions. */
+	uint32_t func_count;
+	/** Number of the first fields needed. */
+	uint32_t field_count;
+	/** Iterator over the range. */
+	struct snapshot_iterator *iterator;
+	/** Partial results, one per function. */
+	struct sql_cursor_agg *aggs;
+	/** Fields of the current tuple. */
+	const char **fields;
+};
+
+/**
+ * Parallel aggregation, shared by the TX thread and the tasks
+ * it submits to the worker pool. Each thread takes unscanned
+ * ranges one by one until none is left, so the TX thread never
+ * waits for a task which is still queued.
+ */
+struct cursor_agg_job {
+	/** Protects the counters below. */
+	pthread_mutex_t mutex;
+	/** Signaled when all ranges are scanned. */
+	pthread_cond_t cond;
+	/** Ranges to scan. */
+	struct sql_cursor_agg_range *ranges;
+	/** Number of ranges. */
+	uint32_t range_count;
+	/** Number of ranges taken by threads. */
+	uint32_t taken_count;
+	/** Number of scanned ranges. */
+	uint32_t done_count;
+	/**
+	 * The TX thread and the tasks which are not finished
+	 * yet. Changed in the TX thread only.
+	 */
+	int refs;
+};
+
+/**
+ * Check if a tuple decoded into @a fields satisfies a cursor
+ * filter. Unlike cursor_filter_match(), it is the only check of
+ * the conditions, which must have the type of the value.
+ */
+static bool
+cursor_agg_filter_match(const char *filter, const char **fields)
+{
+	uint32_t count = mp_decode_array(&filter);
+	for (uint32_t i = 0; i < count; i++) {
+		MAYBE_UNUSED uint32_t len = mp_decode_array(&filter);
+		assert(len == 3);
+		uint32_t fieldno = mp_decode_uint(&filter);
+		int op = mp_decode_uint(&filter);
+		const char *value = filter;
+		mp_next(&filter);
+		if (!cursor_filter_check(fields[fieldno], op, value))
+			return false;
+	}
+	return true;
+}
+
+/** Add a value to the partial result of a function. */
+static void
+cursor_agg_step(struct sql_cursor_agg *agg, int type, const char *field)
+{
+	if (type == SQL_CURSOR_AGG_COUNT_ALL) {
+		agg->count++;
+		return;
+	}
+	if (field == NULL || mp_typeof(*field) == MP_NIL)
+		return;
+	if (type == SQL_CURSOR_AGG_COUNT) {
+		agg->count++;
+		return;
+	}
+	bool is_int = true;
+	int64_t ival = 0;
+	double rval = 0;
+	switch (mp_typeof(*field)) {
+	case MP_UINT: {
+		uint64_t u = mp_decode_uint(&field);
+		if (u > INT64_MAX) {
+			is_int = false;
+			rval = u;
+		} else {
+			ival = u;
+		}
+		break;
+	}
+	case MP_INT:
+		ival = mp_decode_int(&field);
+		break;
+	case MP_FLOAT:
+		is_int = false;
+		rval = mp_decode_float(&field);
+		break;
+	case MP_DOUBLE:
+		is_int = false;
+		rval = mp_decode_double(&field);
+		break;
+	default:
+		/* Only numeric fields are aggregated. */
+		unreachable();
+		return;
+	}
+	if (is_int)
+		rval = ival;
+	if (type == SQL_CURSOR_AGG_MIN || type == SQL_CURSOR_AGG_MAX) {
+		if (agg->count++ > 0) {
+			int cmp;
+			if (is_int && agg->is_int)
+				cmp = ival < agg->int_value ? -1 :
+				      ival > agg->int_value;
+			else
+				cmp = rval < agg->value ? -1 :
+				      rval > agg->value;
+			if (type == SQL_CURSOR_AGG_MIN ? cmp >= 0 : cmp <= 0)
+				return;
+		}
+		agg->is_int = is_int;
+		agg->int_value = ival;
+		agg->value = rval;
+		return;
+	}
+	/* See sumStep(). */
+	agg->count++;
+	agg->sum += rval;
+	if (!is_int)
+		agg->is_approx = true;
+	else if (!agg->is_approx && !agg->is_overflow &&
+		 sqlite3AddInt64(&agg->int_sum, ival) != 0)
+		agg->is_overflow = true;
+}
+
+/** Merge a partial result of a function into another one. */
+static void
+cursor_agg_merge(struct sql_cursor_agg *agg, int type,
+		 const struct sql_cursor_agg *other)
+{
+	switch (type) {
+	case SQL_CURSOR_AGG_COUNT_ALL:
+	case SQL_CURSOR_AGG_COUNT:
+		agg->count += other->count;
+		break;
+	case SQL_CURSOR_AGG_MIN:
+	case SQL_CURSOR_AGG_MAX:
+		if (other->count == 0)
+			break;
+		if (agg->count > 0) {
+			int cmp;
+			if (other->is_int && agg->is_int)
+				cmp = other->int_value < agg->int_value ? -1 :
+				      other->int_value > agg->int_value;
+			else
+				cmp = other->value < agg->value ? -1 :
+				      other->value > agg->value;
+			if (type == SQL_CURSOR_AGG_MIN ? cmp >= 0 : cmp <= 0) {
+				agg->count += other->count;
+				break;
+			}
+		}
+		agg->count += other->count;
+		agg->is_int = other->is_int;
+		agg->int_value = other->int_value;
+		agg->value = other->value;
+		break;
+	default:
+		agg->count += other->count;
+		agg->sum += other->sum;
+		agg->is_approx |= other->is_approx;
+		agg->is_overflow |= other->is_overflow;
+		if (!agg->is_approx && !agg->is_overflow &&
+		    sqlite3AddInt64(&agg->int_sum, other->int_sum) != 0)
+			agg->is_overflow = true;
+		break;
+	}
+}
+
+/** Aggregate a tuple into partial results of a range. */
+static void
+cursor_agg_range_step(struct sql_cursor_agg_range *range, const char *data)
+{
+	const char **fields = range->fields;
+	uint32_t count = mp_decode_array(&data);
+	for (uint32_t i = 0; i < range->field_count; i++) {
+		if (i < count) {
+			fields[i] = data;
+			mp_next(&data);
+		} else {
+			fields[i] = NULL;
+		}
+	}
+	if (range->filter != NULL &&
+	    !cursor_agg_filter_match(range->filter, fields))
+		return;
+	const char *func = range->funcs;
+	for (uint32_t i = 0; i < range->func_count; i++) {
+		mp_decode_array(&func);
+		int type = mp_decode_uint(&func);
+		uint32_t fieldno = mp_decode_uint(&func);
+		mp_next(&func);
+		cursor_agg_step(&range->aggs[i], type,
+				type == SQL_CURSOR_AGG_COUNT_ALL ? NULL :
+				fields[fieldno]);
+	}
+}
+
+/**
+ * Aggregate a range. It doesn't touch anything but the tuple
+ * data, which the TX thread doesn't change meanwhile, so it
+ * can be called by a worker thread.
+ */
+static void
+cursor_agg_range_scan(struct sql_cursor_agg_range *range)
+{
+	const char *data;
+	uint32_t size;
+	while ((data = range->iterator->next(range->iterator, &size)) != NULL)
+		cursor_agg_range_step(range, data);
+}
+
+/**
+ * Take a range of a job and scan it.
+ * @retval false No range is left.
+ */
+static bool
+cursor_agg_job_scan_next(struct cursor_agg_job *job)
+{
+	tt_pthread_mutex_lock(&job->mutex);
+	uint32_t i = job->taken_count;
+	if (i < job->range_count)
+		job->taken_count++;
+	tt_pthread_mutex_unlock(&job->mutex);
+	if (i >= job->range_count)
+		return false;
+	cursor_agg_range_scan(&job->ranges[i]);
+	tt_pthread_mutex_lock(&job->mutex);
+	if (++job->done_count == job->range_count)
+		tt_pthread_cond_signal(&job->cond);
+	tt_pthread_mutex_unlock(&job->mutex);
+	return true;
+}
+
+static void
+cursor_agg_job_unref(struct cursor_agg_job *job)
+{
+	assert(job->refs > 0);
+	if (--job->refs > 0)
+		return;
+	tt_pthread_cond_destroy(&job->cond);
+	tt_pthread_mutex_destroy(&job->mutex);
+	free(job);
+}
+
+/** Worker pool callback scanning ranges of a job. */
+static void
+cursor_agg_task_f(eio_req *req)
+{
+	struct cursor_agg_job *job = (struct cursor_agg_job *) req->data;
+	while (cursor_agg_job_scan_next(job)) {
+	}
+}
+
+/** Called in the TX thread when a task is finished. */
+static int
+cursor_agg_task_done(eio_req *req)
+{
+	assert(cursor_agg_task_count > 0);
+	cursor_agg_task_count--;
+	cursor_agg_job_unref((struct cursor_agg_job *) req->data);
+	return 0;
+}
+
+/**
+ * Aggregate a memtx tree index in several threads. The ranges
+ * are scanned by tasks of the worker pool and by the TX
+ * thread, which then waits for the ranges taken by the tasks
+ * without yielding, so the index doesn't change.
+ */
+static int
+cursor_agg_parallel(struct sql_cursor_agg_range *ranges, uint32_t count,
+		    struct index *index)
+{
+	struct snapshot_iterator *iterators[SQL_AGGREGATE_THREADS_MAX];
+	struct cursor_agg_job *job =
+		(struct cursor_agg_job *) malloc(sizeof(*job));
+	if (job == NULL) {
+		diag_set(OutOfMemory, sizeof(*job), "malloc", "job");
+		return -1;
+	}
+	int rc = memtx_tree_index_create_range_iterators(index, count,
+							 iterators);
+	if (rc < 0) {
+		free(job);
+		return -1;
+	}
+	count = rc;
+	for (uint32_t i = 0; i < count; i++)
+		ranges[i].iterator = iterators[i];
+	tt_pthread_mutex_init(&job->mutex, NULL);
+	tt_pthread_cond_init(&job->cond, NULL);
+	job->ranges = ranges;
+	job->range_count = count;
+	job->taken_count = 0;
+	job->done_count = 0;
+	job->refs = 1;
+	for (uint32_t i = 1; i < count; i++) {
+		/* The TX thread scans the range otherwise. */
+		if (eio_custom(cursor_agg_task_f, 0, cursor_agg_task_done,
+			       job) == NULL)
+			break;
+		job->refs++;
+		cursor_agg_task_count++;
+	}
+	while (cursor_agg_job_scan_next(job)) {
+	}
+	tt_pthread_mutex_lock(&job->mutex);
+	while (job->done_count < job->range_count)
+		tt_pthread_cond_wait(&job->cond, &job->mutex);
+	tt_pthread_mutex_unlock(&job->mutex);
+	cursor_agg_job_unref(job);
+	for (uint32_t i = 0; i < count; i++)
+		ranges[i].iterator->free(ranges[i].iterator);
+	return count;
+}
+
+void
+sql_aggregate_set_threads(int count)
+{
+	assert(count >= 1 && count <= SQL_AGGREGATE_THREADS_MAX);
+	cursor_agg_threads = count;
+}
+
+int
+sql_cursor_aggregate(struct BtCursor *cursor, const char *spec,
+		     struct sql_cursor_agg *aggs)
+{
+	assert(cursor->curFlags & BTCF_TaCursor);
+	struct index *index = cursor->index;
+	MAYBE_UNUSED uint32_t len = mp_decode_array(&spec);
+	assert(len == 2);
+	struct sql_cursor_agg_range range;
+	memset(&range, 0, sizeof(range));
+	if (mp_typeof(*spec) == MP_NIL) {
+		mp_next(&spec);
+	} else {
+		range.filter = spec;
+		mp_next(&spec);
+		/* Filter fields are needed too. */
+		const char *filter = range.filter;
+		uint32_t count = mp_decode_array(&filter);
+		for (uint32_t i = 0; i < count; i++) {
+			mp_decode_array(&filter);
+			uint32_t fieldno = mp_decode_uint(&filter);
+			range.field_count = MAX(range.field_count, fieldno + 1);
+			mp_next(&filter);
+			mp_next(&filter);
+		}
+	}
+	range.func_count = mp_decode_array(&spec);
+	range.funcs = spec;
+	for (uint32_t i = 0; i < range.func_count; i++) {
+		mp_decode_array(&spec);
+		mp_next(&spec);
+		uint32_t fieldno = mp_decode_uint(&spec);
+		range.field_count = MAX(range.field_count, fieldno + 1);
+		mp_next(&spec);
+	}
+	uint32_t thread_count = 1;
+	ssize_t size = index_size(index);
+	if (space_is_memtx(cursor->space) && index->def->type == TREE &&
+	    size >= SQL_CURSOR_AGG_PARALLEL_MIN) {
+		long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+		int task_count = MIN(MAX(cpu_count, 1), cursor_agg_threads) - 1;
+		task_count = MIN(task_count, cursor_agg_threads - 1 -
+					     cursor_agg_task_count);
+		thread_count = 1 + MAX(task_count, 0);
+	}
+	size_t aggs_size = sizeof(struct sql_cursor_agg) * range.func_count;
+	size_t alloc_size = (sizeof(struct sql_cursor_agg_range) + aggs_size +
+			     sizeof(const char *) * range.field_count) *
+			    thread_count;
+	struct sql_cursor_agg_range *ranges =
+		region_aligned_alloc(&fiber()->gc, alloc_size,
+				     alignof(struct sql_cursor_agg_range));
+	if (ranges == NULL) {
+		diag_set(OutOfMemory, alloc_size, "region", "ranges");
+		return SQL_TARANTOOL_ERROR;
+	}
+	memset(ranges, 0, alloc_size);
+	char *pos = (char *) (ranges + thread_count);
+	for (uint32_t i = 0; i < thread_count; i++) {
+		ranges[i] = range;
+		ranges[i].aggs = (struct sql_cursor_agg *) pos;
+		pos += aggs_size;
+	}
+	for (uint32_t i = 0; i < thread_count; i++) {
+		ranges[i].fields = (const char **) pos;
+		pos += sizeof(const char *) * range.field_count;
+	}
+	memset(aggs, 0, aggs_size);
+	if (thread_count > 1) {
+		int count = cursor_agg_parallel(ranges, thread_count, index);
+		if (count < 0)
+			return SQL_TARANTOOL_ERROR;
+		const char *func = range.funcs;
+		for (uint32_t i = 0; i < range.func_count; i++) {
+			mp_decode_array(&func);
+			int type = mp_decode_uint(&func);
+			mp_next(&func);
+			mp_next(&func);
+			for (int j = 0; j < count; j++)
+				cursor_agg_merge(&aggs[i], type,
+						 &ranges[j].aggs[i]);
+		}
+		return SQLITE_OK;
+	}
+	struct iterator *it = index_create_iterator(index, ITER_ALL, NULL, 0);
+	if (it == NULL)
+		return SQL_TARANTOOL_ERROR;
+	ranges[0].aggs = aggs;
+	struct tuple *tuple;
+	int rc = SQLITE_OK;
+	while (true) {
+		if (iterator_next(it, &tuple) != 0) {
+			rc = SQL_TARANTOOL_ERROR;
+			break;
+		}
+		if (tuple == NULL)
+			break;
+		uint32_t tuple_size;
+		cursor_agg_range_step(&ranges[0],
+				      tuple_data_range(tuple, &tuple_size));
+	}
+	iterator_delete(it);
+	return rc;
+}
+
 /*
  * Move cursor to the next entry in space.
  * New tuple is refed and saved in cursor.
@@ -950,8 +1539,11 @@ cursor_advance(BtCursor *pCur, int *pRes)
 	assert(pCur->iter != NULL);
 
 	struct tuple *tuple;
-	if (iterator_next(pCur->iter, &tuple) != 0)
-		return SQL_TARANTOOL_ITERATOR_FAIL;
+	do {
+		if (iterator_next(pCur->iter, &tuple) != 0)
+			return SQL_TARANTOOL_ITERATOR_FAIL;
+	} while (tuple != NULL && pCur->filter != NULL &&
+		 !cursor_filter_match(pCur->filter, tuple));
 	if (pCur->last_tuple)
 		box_tuple_unref(pCur->last_tuple);
 	if (tuple) {
@@ -62,11 +62,41 @@ sql_free();
 struct sqlite3 *
 sql_get();
 
+/**
+ * Set the amount of memory an SQL sorter may use before it
+ * spills sorted runs to temporary files.
+ * @param size Memory limit in bytes.
+ */
+void
+sql_sorter_set_memory(int64_t size);
+
+/** Maximal number of threads computing an SQL aggregate. */
+enum { SQL_AGGREGATE_THREADS_MAX = 8 };
+
+/**
+ * Set the number of threads, the TX thread included, which
+ * compute an aggregate over a large memtx table. Threads other
+ * than TX are taken from the worker pool.
+ * @param count Number of threads, 1 disables parallel scans.
+ */
+void
+sql_aggregate_set_threads(int count);
+
+/**
+ * Enable or disable background collection of statistics of
+ * spaces which have been modified enough since they were
+ * analyzed last time.
+ * @param enabled True to collect statistics automatically.
+ */
+void
+sql_auto_analyze_set(bool enabled);
+
 struct Expr;
 struct Parse;
 struct Select;
 struct Table;
 struct sql_trigger;
+struct region;
 
 /**
  * Perform parsing of provided expression. This is done by
@@ -105,6 +135,47 @@ sql_view_compile(struct sqlite3 *db, const char *view_stmt);
 struct sql_trigger *
 sql_trigger_compile(struct sqlite3 *db, const char *sql);
 
+/** A literal replaced with a parameter marker by sql_normalize(). */
+struct sql_literal {
+	/** TK_INTEGER, TK_FLOAT or TK_STRING. */
+	int type;
+	union {
+		int64_t i64;
+		double d;
+		/** Unquoted string, zero terminated. */
+		struct {
+			const char *s;
+			uint32_t len;
+		};
+	};
+};
+
+/**
+ * Replace literals of a query or a DML statement with parameter
+ * markers, so that statements which differ only in constants
+ * have the same text and can share a compiled program. Spaces
+ * and comments are collapsed into a single space, and only the
+ * first statement of the text is kept. A literal stays in place
+ * if a marker would change the statement: in the result list of
+ * SELECT, whose column names are made of the expression text,
+ * and as a column number in ORDER BY and GROUP BY.
+ *
+ * @param region Region to allocate the text and the literals.
+ * @param sql Zero terminated SQL text.
+ * @param[out] norm_sql Zero terminated normalized text.
+ * @param[out] norm_len Length of @a norm_sql.
+ * @param[out] literals Replaced literals in the order of
+ *             parameter markers.
+ *
+ * @retval >0 Number of replaced literals.
+ * @retval 0 There is nothing to replace, or the statement is
+ *         not a query or DML, or it has parameters of its own.
+ * @retval -1 Memory error.
+ */
+int
+sql_normalize(struct region *region, const char *sql, char **norm_sql,
+	      uint32_t *norm_len, struct sql_literal **literals);
+
 /**
  * Free AST pointed by trigger.
  * @param db SQL handle.
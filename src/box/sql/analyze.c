@@ -110,6 +110,10 @@
 #include "box/key_def.h"
 #include "box/tuple_compare.h"
 #include "box/schema.h"
+#include "box/session.h"
+#include "box/sql.h"
+#include "box/tuple.h"
+#include "fiber.h"
 #include "third_party/qsort_arg.h"
 
 #include "sqliteInt.h"
@@ -1769,3 +1773,479 @@ fail:
 	box_txn_rollback();
 	return SQL_TARANTOOL_ERROR;
 }
+
+/*
+ * Automatic statistics collection.
+ *
+ * A background fiber looks for spaces which have been modified
+ * enough since their statistics were collected, and rebuilds
+ * _sql_stat1 and _sql_stat4 entries of their TREE indexes from
+ * a uniform sample of tuples rather than from a full scan.
+ */
+
+/** Number of tuples sampled from an index. */
+#define SQL_AUTO_ANALYZE_SAMPLE_SIZE 1024
+/** Number of tuples read between two yields. */
+#define SQL_AUTO_ANALYZE_BATCH 128
+/** Pause made by the fiber on each yield, in seconds. */
+#define SQL_AUTO_ANALYZE_DELAY 0.001
+/** Period of modification counters check, in seconds. */
+#define SQL_AUTO_ANALYZE_PERIOD 1.0
+/** Minimal number of changes making a space analyzed. */
+#define SQL_AUTO_ANALYZE_MIN_CHANGES 1000
+
+/** True if automatic statistics collection is enabled. */
+static bool sql_auto_analyze_enabled = false;
+/** Fiber collecting statistics, created on demand. */
+static struct fiber *sql_auto_analyze_fiber = NULL;
+
+/**
+ * Yield to other fibers between two sampling batches.
+ * @param version Space cache version sampling started with.
+ * @retval 0 Sampling can be continued.
+ * @retval -1 Schema was changed or the fiber was cancelled.
+ */
+static int
+sql_auto_analyze_yield(uint32_t version)
+{
+	fiber_sleep(SQL_AUTO_ANALYZE_DELAY);
+	if (fiber_is_cancelled()) {
+		diag_set(FiberIsCancelled);
+		return -1;
+	}
+	return version == space_cache_version ? 0 : -1;
+}
+
+/**
+ * Collect a uniform sample of tuples of an index. An index
+ * supporting random access (memtx tree) is sampled by
+ * index_random() if it is much larger than the sample, so
+ * that the cost doesn't depend on the index size. Otherwise
+ * the index is scanned with reservoir sampling. The fiber
+ * yields every SQL_AUTO_ANALYZE_BATCH tuples.
+ *
+ * @param index Index to sample.
+ * @param[out] sample Array of referenced tuples.
+ * @param[out] sample_count Number of tuples in @a sample.
+ * @param[out] row_count Number of tuples in the index.
+ * @retval 0 Success.
+ * @retval -1 Error or schema change, nothing is referenced.
+ */
+static int
+sql_auto_analyze_sample(struct index *index, struct tuple **sample,
+			uint32_t *sample_count, uint64_t *row_count)
+{
+	uint32_t version = space_cache_version;
+	uint32_t count = 0;
+	struct tuple *tuple;
+	ssize_t size = index_size(index);
+	if (size < 0)
+		return -1;
+	if (index->vtab->random != generic_index_random &&
+	    (uint64_t) size > 4 * SQL_AUTO_ANALYZE_SAMPLE_SIZE) {
+		/*
+		 * Picks are made with replacement, but when
+		 * the index is large repeats are rare and are
+		 * dropped after sorting.
+		 */
+		for (uint32_t i = 0; i < SQL_AUTO_ANALYZE_SAMPLE_SIZE; ++i) {
+			if (i > 0 && i % SQL_AUTO_ANALYZE_BATCH == 0 &&
+			    sql_auto_analyze_yield(version) != 0)
+				goto fail;
+			if (index_random(index, rand(), &tuple) != 0)
+				goto fail;
+			if (tuple == NULL)
+				break;
+			tuple_ref(tuple);
+			sample[count++] = tuple;
+		}
+		*row_count = index_size(index);
+		*sample_count = count;
+		return 0;
+	}
+	struct iterator *it = index_create_iterator(index, ITER_ALL, NULL, 0);
+	if (it == NULL)
+		return -1;
+	uint64_t seen = 0;
+	while (true) {
+		if (seen > 0 && seen % SQL_AUTO_ANALYZE_BATCH == 0 &&
+		    sql_auto_analyze_yield(version) != 0)
+			goto fail_iterator;
+		if (iterator_next(it, &tuple) != 0)
+			goto fail_iterator;
+		if (tuple == NULL)
+			break;
+		if (seen < SQL_AUTO_ANALYZE_SAMPLE_SIZE) {
+			tuple_ref(tuple);
+			sample[count++] = tuple;
+		} else {
+			uint64_t j = (((uint64_t) rand() << 31) | rand()) %
+				     (seen + 1);
+			if (j < SQL_AUTO_ANALYZE_SAMPLE_SIZE) {
+				tuple_unref(sample[j]);
+				tuple_ref(tuple);
+				sample[j] = tuple;
+			}
+		}
+		seen++;
+	}
+	iterator_delete(it);
+	*row_count = seen;
+	*sample_count = count;
+	return 0;
+fail_iterator:
+	iterator_delete(it);
+fail:
+	for (uint32_t i = 0; i < count; ++i)
+		tuple_unref(sample[i]);
+	return -1;
+}
+
+/** qsort_arg() comparator of tuple pointers. */
+static int
+sample_tuple_compare(const void *a, const void *b, void *arg)
+{
+	return tuple_compare(*(struct tuple **) a, *(struct tuple **) b,
+			     (struct key_def *) arg);
+}
+
+/**
+ * Print an array of numbers into a stat string, separated by
+ * spaces.
+ * @retval Formatted string allocated on region or NULL.
+ */
+static char *
+sql_stat_string(const uint64_t *values, uint32_t count)
+{
+	size_t size = count * 25;
+	char *str = region_alloc(&fiber()->gc, size);
+	if (str == NULL) {
+		diag_set(OutOfMemory, size, "region", "stat string");
+		return NULL;
+	}
+	char *pos = str;
+	for (uint32_t i = 0; i < count; ++i) {
+		sqlite3_snprintf(24, pos, i == 0 ? "%llu" : " %llu",
+				 (unsigned long long) values[i]);
+		pos += strlen(pos);
+	}
+	return str;
+}
+
+/**
+ * Execute a statement writing statistics of an index.
+ * The first two parameters are the space and index names,
+ * the rest are strings of @a args, and an optional blob.
+ */
+static int
+sql_stat_write(struct sqlite3 *db, const char *sql, const char *space_name,
+	       const char *index_name, char **args, int arg_count,
+	       const char *blob, uint32_t blob_size)
+{
+	struct sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+		goto error;
+	int n = 1;
+	sqlite3_bind_text(stmt, n++, space_name, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, n++, index_name, -1, SQLITE_STATIC);
+	for (int i = 0; i < arg_count; ++i)
+		sqlite3_bind_text(stmt, n++, args[i], -1, SQLITE_STATIC);
+	if (blob != NULL)
+		sqlite3_bind_blob(stmt, n++, blob, blob_size, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc == SQLITE_DONE)
+		return 0;
+error:
+	if (diag_is_empty(diag_get()))
+		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
+	return -1;
+}
+
+/**
+ * Estimate statistics of an index from a sorted sample and
+ * replace its _sql_stat1 and _sql_stat4 entries.
+ *
+ * The number of distinct values of each key prefix is
+ * estimated with the Duj1 estimator of Haas and Stokes:
+ * D = n * d / (n - f1 + f1 * n / N), where n is the sample
+ * size, d is the number of distinct prefixes in the sample,
+ * f1 is the number of prefixes met in the sample exactly once
+ * and N is the number of tuples. If the sample contains the
+ * whole index the estimate is exact.
+ */
+static int
+sql_auto_analyze_write(struct sqlite3 *db, struct space *space,
+		       struct index *index, struct tuple **sample,
+		       uint32_t sample_count, uint64_t row_count)
+{
+	struct key_def *key_def = index->def->key_def;
+	uint32_t part_count = key_def->part_count;
+	size_t size = sizeof(uint64_t) * (part_count + 1) * 4 +
+		      sizeof(double) * part_count +
+		      sizeof(uint32_t) * sample_count;
+	uint64_t *stat1 = region_aligned_alloc(&fiber()->gc, size,
+					       alignof(uint64_t));
+	if (stat1 == NULL) {
+		diag_set(OutOfMemory, size, "region", "stat");
+		return -1;
+	}
+	uint64_t *neq = stat1 + part_count + 1;
+	uint64_t *nlt = neq + part_count + 1;
+	uint64_t *ndlt = nlt + part_count + 1;
+	double *distinct = (double *) (ndlt + part_count + 1);
+	uint32_t *common = (uint32_t *) (distinct + part_count);
+	/* Number of the first parts equal to the previous tuple. */
+	common[0] = 0;
+	for (uint32_t i = 1; i < sample_count; ++i) {
+		common[i] = tuple_common_key_parts(sample[i - 1], sample[i],
+						   key_def);
+	}
+	stat1[0] = row_count;
+	double n = sample_count;
+	for (uint32_t k = 0; k < part_count; ++k) {
+		uint32_t d = 0, f1 = 0, start = 0;
+		for (uint32_t i = 0; i <= sample_count; ++i) {
+			if (i < sample_count && (i == 0 || common[i] > k))
+				continue;
+			if (i > 0 && i - start == 1)
+				f1++;
+			start = i;
+			d++;
+		}
+		/* The loop counts a group past the last tuple. */
+		d--;
+		double est = d;
+		if (row_count > sample_count)
+			est = n * d / (n - f1 + f1 * n / row_count);
+		if (k == part_count - 1 && index->def->opts.is_unique)
+			est = row_count;
+		est = MIN(MAX(est, d), row_count);
+		distinct[k] = est;
+		stat1[k + 1] = (row_count + (uint64_t) est - 1) /
+			       (uint64_t) est;
+	}
+	char *stat1_str = sql_stat_string(stat1, part_count + 1);
+	if (stat1_str == NULL)
+		return -1;
+	const char *space_name = space->def->name;
+	/* See vdbe_emit_analyze_space() for the naming. */
+	const char *index_name = index->def->iid == 0 ? space_name :
+				 index->def->name;
+	if (box_txn_begin() != 0)
+		return -1;
+	if (sql_stat_write(db, "DELETE FROM \"_sql_stat4\" WHERE "
+			   "\"tbl\" = ? AND \"idx\" = ?", space_name,
+			   index_name, NULL, 0, NULL, 0) != 0 ||
+	    sql_stat_write(db, "REPLACE INTO \"_sql_stat1\" VALUES "
+			   "(?, ?, ?)", space_name, index_name, &stat1_str, 1,
+			   NULL, 0) != 0)
+		goto fail;
+	double rows_per_tuple = row_count / n;
+	uint32_t samples = MIN(SQL_STAT4_SAMPLES, sample_count);
+	for (uint32_t j = 0; j < samples; ++j) {
+		uint32_t p = (2 * j + 1) * sample_count / (2 * samples);
+		for (uint32_t k = 0; k < part_count; ++k) {
+			uint32_t first = p, last = p + 1, groups = 0;
+			while (first > 0 && common[first] > k)
+				first--;
+			while (last < sample_count && common[last] > k)
+				last++;
+			for (uint32_t i = 1; i <= first; ++i)
+				groups += common[i] <= k;
+			if (last - first == 1) {
+				neq[k] = (row_count + (uint64_t) distinct[k] -
+					  1) / (uint64_t) distinct[k];
+			} else {
+				neq[k] = (last - first) * rows_per_tuple;
+			}
+			nlt[k] = first * rows_per_tuple;
+			uint32_t d = groups + 1;
+			for (uint32_t i = last; i < sample_count; ++i)
+				d += common[i] <= k;
+			ndlt[k] = groups * distinct[k] / d;
+		}
+		char *args[3];
+		args[0] = sql_stat_string(neq, part_count);
+		args[1] = sql_stat_string(nlt, part_count);
+		args[2] = sql_stat_string(ndlt, part_count);
+		uint32_t key_size;
+		const char *key = tuple_extract_key(sample[p], key_def,
+						    &key_size);
+		if (args[0] == NULL || args[1] == NULL || args[2] == NULL ||
+		    key == NULL)
+			goto fail;
+		if (sql_stat_write(db, "INSERT INTO \"_sql_stat4\" VALUES "
+				   "(?, ?, ?, ?, ?, ?)", space_name,
+				   index_name, args, 3, key, key_size) != 0)
+			goto fail;
+	}
+	return box_txn_commit();
+fail:
+	box_txn_rollback();
+	return -1;
+}
+
+/**
+ * Sample an index and update its statistics.
+ * @retval 0 Success or the index was changed meanwhile.
+ * @retval -1 Error.
+ */
+static int
+sql_auto_analyze_index(struct sqlite3 *db, struct space *space,
+		       struct index *index)
+{
+	size_t size = sizeof(struct tuple *) * SQL_AUTO_ANALYZE_SAMPLE_SIZE;
+	struct tuple **sample = malloc(size);
+	if (sample == NULL) {
+		diag_set(OutOfMemory, size, "malloc", "sample");
+		return -1;
+	}
+	uint32_t sample_count;
+	uint64_t row_count;
+	uint32_t version = space_cache_version;
+	int rc = sql_auto_analyze_sample(index, sample, &sample_count,
+					 &row_count);
+	if (rc != 0) {
+		free(sample);
+		return version != space_cache_version ? 0 : -1;
+	}
+	/*
+	 * The sort is by the comparison definition, which
+	 * includes the primary key parts, so repeated picks of
+	 * a tuple are neighbours.
+	 */
+	qsort_arg(sample, sample_count, sizeof(struct tuple *),
+		  sample_tuple_compare, index->def->cmp_def);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < sample_count; ++i) {
+		if (count > 0 && sample[count - 1] == sample[i])
+			tuple_unref(sample[i]);
+		else
+			sample[count++] = sample[i];
+	}
+	if (count > 0) {
+		rc = sql_auto_analyze_write(db, space, index, sample, count,
+					    row_count);
+	}
+	for (uint32_t i = 0; i < count; ++i)
+		tuple_unref(sample[i]);
+	free(sample);
+	return rc;
+}
+
+/**
+ * Collect statistics of all TREE indexes of a space. The
+ * space and its indexes are looked up again after each index
+ * because sampling yields.
+ */
+static void
+sql_auto_analyze_space(struct sqlite3 *db, uint32_t space_id)
+{
+	struct space *space = space_by_id(space_id);
+	if (space == NULL)
+		return;
+	space->change_count = 0;
+	uint32_t index_id_max = space->index_id_max;
+	for (uint32_t iid = 0; iid <= index_id_max; ++iid) {
+		space = space_by_id(space_id);
+		if (space == NULL)
+			return;
+		struct index *index = space_index(space, iid);
+		if (index == NULL || index->def->type != TREE)
+			continue;
+		size_t used = region_used(&fiber()->gc);
+		if (sql_auto_analyze_index(db, space, index) != 0)
+			diag_log();
+		region_truncate(&fiber()->gc, used);
+	}
+}
+
+/**
+ * space_foreach() callback adding the id of a space to be
+ * analyzed to the array on region.
+ */
+static int
+sql_auto_analyze_check_space(struct space *space, void *data)
+{
+	uint32_t *count = (uint32_t *) data;
+	if (space_is_system(space) || space_is_temporary(space) ||
+	    space->def->opts.is_view || space_index(space, 0) == NULL)
+		return 0;
+	struct index_stat *stat = space_index(space, 0)->def->opts.stat;
+	uint64_t row_count = stat != NULL ? stat->tuple_stat1[0] : 0;
+	if (space->change_count < MAX(SQL_AUTO_ANALYZE_MIN_CHANGES,
+				      row_count / 10))
+		return 0;
+	uint32_t *id = region_alloc(&fiber()->gc, sizeof(*id));
+	if (id == NULL) {
+		diag_set(OutOfMemory, sizeof(*id), "region", "space id");
+		return -1;
+	}
+	*id = space_id(space);
+	++*count;
+	return 0;
+}
+
+static int
+sql_auto_analyze_f(va_list ap)
+{
+	(void) ap;
+	fiber_set_user(fiber(), &admin_credentials);
+	struct sqlite3 *db = sql_get();
+	while (!fiber_is_cancelled()) {
+		if (!sql_auto_analyze_enabled) {
+			fiber_yield();
+			continue;
+		}
+		fiber_sleep(SQL_AUTO_ANALYZE_PERIOD);
+		if (!sql_auto_analyze_enabled || !box_is_configured() ||
+		    box_is_ro())
+			continue;
+		/*
+		 * The space cache can't be iterated across yields,
+		 * so candidates are collected beforehand.
+		 */
+		uint32_t count = 0;
+		if (space_foreach(sql_auto_analyze_check_space, &count) != 0)
+			goto next;
+		if (count == 0)
+			continue;
+		size_t size = sizeof(uint32_t) * count;
+		uint32_t *ids = region_join(&fiber()->gc, size);
+		if (ids == NULL) {
+			diag_set(OutOfMemory, size, "region", "space ids");
+			goto next;
+		}
+		for (uint32_t i = 0; i < count; ++i)
+			sql_auto_analyze_space(db, ids[i]);
+		/* Install new statistics and re-plan statements. */
+		if (sql_analysis_load(db) != SQLITE_OK)
+			goto next;
+		sqlite3ExpirePreparedStatements(db);
+		fiber_gc();
+		continue;
+next:
+		diag_log();
+		fiber_gc();
+	}
+	return 0;
+}
+
+void
+sql_auto_analyze_set(bool enabled)
+{
+	sql_auto_analyze_enabled = enabled;
+	if (sql_auto_analyze_fiber == NULL && enabled) {
+		sql_auto_analyze_fiber = fiber_new("sql_analyze",
+						   sql_auto_analyze_f);
+		if (sql_auto_analyze_fiber == NULL) {
+			diag_log();
+			return;
+		}
+		fiber_start(sql_auto_analyze_fiber);
+		return;
+	}
+	if (sql_auto_analyze_fiber != NULL)
+		fiber_wakeup(sql_auto_analyze_fiber);
+}
@@ -50,6 +50,13 @@ struct BtCursor {
 	enum iterator_type iter_type;
 	struct tuple *last_tuple;
 	char *key;		/* Saved key that was cursor last known position */
+	/**
+	 * Conditions on fields of tuples the cursor returns,
+	 * set by OP_CursorFilter. Tuples which do not satisfy
+	 * them are skipped while the cursor is advanced. NULL
+	 * if there are none. Cleared on a seek by key.
+	 */
+	const char *filter;
 };
 
 void sqlite3CursorZero(BtCursor *);
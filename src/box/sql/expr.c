@@ -396,6 +396,44 @@ sql_binary_compare_coll_seq(Parse *parser, Expr *left, Expr *right,
 	return *coll_id == rhs_coll_id ? rhs_coll : lhs_coll;;
 }
 
+/**
+ * Check if the value of an expression is known at compile time
+ * to be an integer or NULL: an integer literal, a column of an
+ * integer field or integer arithmetic over them. Such operands
+ * are handled by the integer opcodes, see OP_LtInt and OP_AddInt.
+ * Those fall back to generic ones at runtime if the guess is
+ * wrong, e.g. if an integer overflows into a real.
+ *
+ * @param expr Expression to check.
+ * @retval true if the expression is an integer.
+ */
+static bool
+expr_is_integer(struct Expr *expr)
+{
+	expr = sqlite3ExprSkipCollate(expr);
+	switch (expr->op) {
+	case TK_INTEGER:
+		return true;
+	case TK_COLUMN:
+	case TK_AGG_COLUMN: {
+		struct space_def *def = expr->space_def;
+		if (def == NULL || expr->iColumn < 0 ||
+		    expr->iColumn >= (int)def->field_count)
+			return false;
+		enum field_type type = def->fields[expr->iColumn].type;
+		return type == FIELD_TYPE_INTEGER ||
+		       type == FIELD_TYPE_UNSIGNED;
+	}
+	case TK_PLUS:
+	case TK_MINUS:
+	case TK_STAR:
+		return expr_is_integer(expr->pLeft) &&
+		       expr_is_integer(expr->pRight);
+	default:
+		return false;
+	}
+}
+
 /*
  * Generate code for a comparison operator.
  */
@@ -413,6 +451,17 @@ codeCompare(Parse * pParse,	/* The parsing (and code generating) context */
 	struct coll *p4 =
 		sql_binary_compare_coll_seq(pParse, pLeft, pRight, &id);
 	int p5 = binaryCompareP5(pLeft, pRight, jumpIfNull);
+	if ((p5 & (SQLITE_STOREP2 | SQLITE_NULLEQ)) == 0 &&
+	    expr_is_integer(pLeft) && expr_is_integer(pRight)) {
+		switch (opcode) {
+		case OP_Eq: opcode = OP_EqInt; break;
+		case OP_Ne: opcode = OP_NeInt; break;
+		case OP_Lt: opcode = OP_LtInt; break;
+		case OP_Le: opcode = OP_LeInt; break;
+		case OP_Gt: opcode = OP_GtInt; break;
+		case OP_Ge: opcode = OP_GeInt; break;
+		}
+	}
 	int addr = sqlite3VdbeAddOp4(pParse->pVdbe, opcode, in2, dest, in1,
 				     (void *)p4, P4_COLLSEQ);
 	sqlite3VdbeChangeP5(pParse->pVdbe, (u8) p5);
@@ -3877,6 +3926,15 @@ sqlite3ExprCodeTarget(Parse * pParse, Expr * pExpr, int target)
 						 &regFree1);
 			r2 = sqlite3ExprCodeTemp(pParse, pExpr->pRight,
 						 &regFree2);
+			if ((op == TK_PLUS || op == TK_MINUS ||
+			     op == TK_STAR) && expr_is_integer(pExpr)) {
+				if (op == TK_PLUS)
+					op = OP_AddInt;
+				else if (op == TK_MINUS)
+					op = OP_SubtractInt;
+				else
+					op = OP_MultiplyInt;
+			}
 			sqlite3VdbeAddOp3(v, op, r2, r1, target);
 			testcase(regFree1 == 0);
 			testcase(regFree2 == 0);
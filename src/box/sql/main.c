@@ -1111,6 +1111,7 @@ static const int aHardLimit[] = {
 	SQLITE_MAX_LIKE_PATTERN_LENGTH,
 	SQLITE_MAX_TRIGGER_DEPTH,
 	SQLITE_MAX_WORKER_THREADS,
+	SQL_MAX_AUTO_INDEX_ROWS,
 };
 
 /*
@@ -1193,7 +1194,9 @@ sqlite3_limit(sqlite3 * db, int limitId, int newLimit)
 	       SQLITE_MAX_TRIGGER_DEPTH);
 	assert(aHardLimit[SQLITE_LIMIT_WORKER_THREADS] ==
 	       SQLITE_MAX_WORKER_THREADS);
-	assert(SQLITE_LIMIT_WORKER_THREADS == (SQLITE_N_LIMIT - 1));
+	assert(aHardLimit[SQL_LIMIT_AUTO_INDEX_ROWS] ==
+	       SQL_MAX_AUTO_INDEX_ROWS);
+	assert(SQL_LIMIT_AUTO_INDEX_ROWS == (SQLITE_N_LIMIT - 1));
 
 	if (limitId < 0 || limitId >= SQLITE_N_LIMIT) {
 		return -1;
@@ -1535,6 +1538,7 @@ sql_init_db(sqlite3 **out_db)
 	memcpy(db->aLimit, aHardLimit, sizeof(db->aLimit));
 	db->aLimit[SQLITE_LIMIT_WORKER_THREADS] = SQLITE_DEFAULT_WORKER_THREADS;
 	db->aLimit[SQL_LIMIT_COMPOUND_SELECT] = SQL_DEFAULT_COMPOUND_SELECT;
+	db->aLimit[SQL_LIMIT_AUTO_INDEX_ROWS] = SQL_DEFAULT_AUTO_INDEX_ROWS;
 	db->szMmap = sqlite3GlobalConfig.szMmap;
 	db->nMaxSorterMmap = 0x7FFFFFFF;
 
@@ -47,6 +47,7 @@ sqlite3Prepare(sqlite3 * db,	/* Database handle. */
 	       const char *zSql,	/* UTF-8 encoded SQL statement. */
 	       int nBytes,	/* Length of zSql in bytes. */
 	       int saveSqlFlag,	/* True to copy SQL text into the sqlite3_stmt */
+	       bool is_profiled,	/* True to record table loops */
 	       Vdbe * pReprepare,	/* VM being reprepared */
 	       sqlite3_stmt ** ppStmt,	/* OUT: A pointer to the prepared statement */
 	       const char **pzTail	/* OUT: End of parsed string */
@@ -58,6 +59,7 @@ sqlite3Prepare(sqlite3 * db,	/* Database handle. */
 	Parse sParse;		/* Parsing context */
 	sql_parser_create(&sParse, db);
 	sParse.pReprepare = pReprepare;
+	sParse.is_profiled = is_profiled;
 	assert(ppStmt && *ppStmt == 0);
 	/* assert( !db->mallocFailed ); // not true with SQLITE_USE_ALLOCA */
 
@@ -172,6 +174,7 @@ sqlite3LockAndPrepare(sqlite3 * db,		/* Database handle. */
 		      const char *zSql,		/* UTF-8 encoded SQL statement. */
 		      int nBytes,		/* Length of zSql in bytes. */
 		      int saveSqlFlag,		/* True to copy SQL text into the sqlite3_stmt */
+		      bool is_profiled,		/* True to record table loops */
 		      Vdbe * pOld,		/* VM being reprepared */
 		      sqlite3_stmt ** ppStmt,	/* OUT: A pointer to the prepared statement */
 		      const char **pzTail)	/* OUT: End of parsed string */
@@ -186,12 +189,12 @@ sqlite3LockAndPrepare(sqlite3 * db,		/* Database handle. */
 	if (!sqlite3SafetyCheckOk(db) || zSql == 0) {
 		return SQLITE_MISUSE_BKPT;
 	}
-	rc = sqlite3Prepare(db, zSql, nBytes, saveSqlFlag, pOld, ppStmt,
-			    pzTail);
+	rc = sqlite3Prepare(db, zSql, nBytes, saveSqlFlag, is_profiled, pOld,
+			    ppStmt, pzTail);
 	if (rc == SQLITE_SCHEMA) {
 		sqlite3_finalize(*ppStmt);
-		rc = sqlite3Prepare(db, zSql, nBytes, saveSqlFlag, pOld, ppStmt,
-				    pzTail);
+		rc = sqlite3Prepare(db, zSql, nBytes, saveSqlFlag, is_profiled,
+				    pOld, ppStmt, pzTail);
 	}
 	assert(rc == SQLITE_OK || *ppStmt == 0);
 	return rc;
@@ -216,7 +219,7 @@ sqlite3Reprepare(Vdbe * p)
 	zSql = sqlite3_sql((sqlite3_stmt *) p);
 	assert(zSql != 0);	/* Reprepare only called for prepare_v2() statements */
 	db = sqlite3VdbeDb(p);
-	rc = sqlite3LockAndPrepare(db, zSql, -1, 0, p, &pNew, 0);
+	rc = sqlite3LockAndPrepare(db, zSql, -1, 0, false, p, &pNew, 0);
 	if (rc) {
 		if (rc == SQLITE_NOMEM) {
 			sqlite3OomFault(db);
@@ -249,7 +252,8 @@ sqlite3_prepare(sqlite3 * db,		/* Database handle. */
 		const char **pzTail)	/* OUT: End of parsed string */
 {
 	int rc;
-	rc = sqlite3LockAndPrepare(db, zSql, nBytes, 0, 0, ppStmt, pzTail);
+	rc = sqlite3LockAndPrepare(db, zSql, nBytes, 0, false, 0, ppStmt,
+				   pzTail);
 	assert(rc == SQLITE_OK || ppStmt == 0 || *ppStmt == 0);	/* VERIFY: F13021 */
 	return rc;
 }
@@ -263,11 +267,21 @@ sqlite3_prepare_v2(sqlite3 * db,	/* Database handle. */
     )
 {
 	int rc;
-	rc = sqlite3LockAndPrepare(db, zSql, nBytes, 1, 0, ppStmt, pzTail);
+	rc = sqlite3LockAndPrepare(db, zSql, nBytes, 1, false, 0, ppStmt,
+				   pzTail);
 	assert(rc == SQLITE_OK || ppStmt == 0 || *ppStmt == 0);	/* VERIFY: F13021 */
 	return rc;
 }
 
+int
+sql_prepare_profiled(sqlite3 *db, const char *sql, int length,
+		     struct sqlite3_stmt **stmt)
+{
+	int rc = sqlite3LockAndPrepare(db, sql, length, 1, true, 0, stmt, 0);
+	assert(rc == SQLITE_OK || *stmt == 0);
+	return rc;
+}
+
 void
 sql_parser_create(struct Parse *parser, sqlite3 *db)
 {
@@ -38,9 +38,11 @@
 #include "tarantoolInt.h"
 #include "vdbeInt.h"
 #include "box/box.h"
+#include "box/coll_id.h"
 #include "box/coll_id_cache.h"
 #include "box/schema.h"
 #include "box/session.h"
+#include "msgpuck/msgpuck.h"
 
 /*
  * Trace output macros
@@ -1478,6 +1480,25 @@ explainTempTable(Parse * pParse, const char *zUsage)
 	}
 }
 
+/**
+ * Add an EQP row "USE GROUP TABLE FOR xxx", where xxx is
+ * "GROUP BY" or "DISTINCT", for a GROUP BY processed without
+ * sorting the rows.
+ *
+ * @param parse Parsing context.
+ * @param usage Clause the table is used for.
+ */
+static void
+explain_group_table(struct Parse *parse, const char *usage)
+{
+	if (parse->explain == 2) {
+		char *msg = sqlite3MPrintf(parse->db,
+					   "USE GROUP TABLE FOR %s", usage);
+		sqlite3VdbeAddOp4(parse->pVdbe, OP_Explain, parse->iSelectId,
+				  0, 0, msg, P4_DYNAMIC);
+	}
+}
+
 #if !defined(SQLITE_OMIT_COMPOUND_SELECT)
 /*
  * Unless an "EXPLAIN QUERY PLAN" command is being processed, this function
@@ -1582,6 +1603,15 @@ generateSortTail(Parse * pParse,	/* Parsing context */
 		if (addrOnce)
 			sqlite3VdbeJumpHere(v, addrOnce);
 		addr = 1 + sqlite3VdbeAddOp2(v, OP_SorterSort, iTab, addrBreak);
+		/*
+		 * The final sort of a top-level SELECT runs when
+		 * its scan is over, so it may release the space
+		 * cursors and yield. A partial sort (labelBkOut)
+		 * is flushed from inside the scan loop.
+		 */
+		if (eDest == SRT_Output && pSort->labelBkOut == 0 &&
+		    pParse->pToplevel == NULL)
+			sqlite3VdbeChangeP5(v, OPFLAG_MAY_YIELD);
 		VdbeCoverage(v);
 		codeOffset(v, p->iOffset, addrContinue);
 		sqlite3VdbeAddOp3(v, OP_SorterData, iTab, regSortOut, iSortTab);
@@ -4381,6 +4411,305 @@ is_simple_count(struct Select *select, struct AggInfo *agg_info)
 	return space;
 }
 
+/**
+ * Check if a column is the first part of an index of a space,
+ * so the planner may look it up instead of a full scan.
+ */
+static bool
+space_column_is_indexed(struct space *space, uint32_t fieldno)
+{
+	for (uint32_t i = 0; i < space->index_count; ++i) {
+		if (space->index[i]->def->key_def->parts[0].fieldno == fieldno)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Check if a WHERE term compares a column of a space with a
+ * constant in a way the Tarantool cursor checks exactly, see
+ * OP_CursorFilter: an integer column with an integer, or a
+ * binary string column with a string.
+ *
+ * @param expr WHERE term.
+ * @param cursor Cursor of the space.
+ * @param def Space definition.
+ * @param[out] fieldno Field number of the column.
+ * @param[out] op Comparison with the column on the left.
+ * @param[out] value Constant.
+ * @retval true if the term can be checked by a cursor.
+ */
+static bool
+cursor_aggregate_filter_term(struct Expr *expr, int cursor,
+			     struct space_def *def, uint32_t *fieldno,
+			     int *op, struct Expr **value)
+{
+	int commuted;
+	switch (expr->op) {
+	case TK_EQ: commuted = TK_EQ; break;
+	case TK_LT: commuted = TK_GT; break;
+	case TK_LE: commuted = TK_GE; break;
+	case TK_GT: commuted = TK_LT; break;
+	case TK_GE: commuted = TK_LE; break;
+	default: return false;
+	}
+	if (ExprHasProperty(expr, EP_Collate | EP_FromJoin))
+		return false;
+	struct Expr *column = expr->pLeft;
+	*value = expr->pRight;
+	*op = expr->op;
+	if (column->op != TK_COLUMN) {
+		column = expr->pRight;
+		*value = expr->pLeft;
+		*op = commuted;
+	}
+	if (column->op != TK_COLUMN || column->iTable != cursor ||
+	    column->iColumn < 0 || column->iColumn >= (int)def->field_count)
+		return false;
+	*fieldno = column->iColumn;
+	struct field_def *field = &def->fields[column->iColumn];
+	int unused;
+	switch (field->type) {
+	case FIELD_TYPE_INTEGER:
+	case FIELD_TYPE_UNSIGNED:
+		return sqlite3ExprIsInteger(*value, &unused) != 0;
+	case FIELD_TYPE_STRING:
+		return (*value)->op == TK_STRING && field->coll_id == COLL_NONE;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Check if every conjunct of WHERE can be checked by a cursor
+ * and count them.
+ * @retval -1 if some term can't be checked by a cursor.
+ */
+static int
+cursor_aggregate_filter_count(struct Expr *expr, int cursor,
+			      struct space *space)
+{
+	if (expr == NULL)
+		return 0;
+	if (expr->op == TK_AND) {
+		int left = cursor_aggregate_filter_count(expr->pLeft, cursor,
+							 space);
+		int right = cursor_aggregate_filter_count(expr->pRight, cursor,
+							  space);
+		return left < 0 || right < 0 ? -1 : left + right;
+	}
+	uint32_t fieldno;
+	int op;
+	struct Expr *value;
+	if (!cursor_aggregate_filter_term(expr, cursor, space->def, &fieldno,
+					  &op, &value) ||
+	    space_column_is_indexed(space, fieldno))
+		return -1;
+	return 1;
+}
+
+/** Get total length of string constants of a filter. */
+static size_t
+cursor_aggregate_filter_strlen(struct Expr *expr)
+{
+	if (expr == NULL)
+		return 0;
+	if (expr->op == TK_AND) {
+		return cursor_aggregate_filter_strlen(expr->pLeft) +
+		       cursor_aggregate_filter_strlen(expr->pRight);
+	}
+	struct Expr *value = expr->pRight->op == TK_COLUMN ?
+			     expr->pLeft : expr->pRight;
+	if (value->op != TK_STRING)
+		return 0;
+	return mp_sizeof_str(strlen(value->u.zToken));
+}
+
+/** Encode conjuncts of WHERE into a filter of a cursor. */
+static char *
+cursor_aggregate_filter_encode(char *pos, struct Expr *expr, int cursor,
+			       struct space_def *def)
+{
+	if (expr == NULL)
+		return pos;
+	if (expr->op == TK_AND) {
+		pos = cursor_aggregate_filter_encode(pos, expr->pLeft, cursor,
+						     def);
+		return cursor_aggregate_filter_encode(pos, expr->pRight,
+						      cursor, def);
+	}
+	uint32_t fieldno;
+	int op, value;
+	struct Expr *constant;
+	MAYBE_UNUSED bool ok =
+		cursor_aggregate_filter_term(expr, cursor, def, &fieldno, &op,
+					     &constant);
+	assert(ok);
+	pos = mp_encode_array(pos, 3);
+	pos = mp_encode_uint(pos, fieldno);
+	pos = mp_encode_uint(pos, op);
+	if (sqlite3ExprIsInteger(constant, &value)) {
+		return value >= 0 ? mp_encode_uint(pos, value) :
+		       mp_encode_int(pos, value);
+	}
+	return mp_encode_str(pos, constant->u.zToken,
+			     strlen(constant->u.zToken));
+}
+
+/**
+ * Get the type of an aggregate function computed by a cursor,
+ * see sql_cursor_aggregate().
+ * @retval -1 if the function is not supported.
+ */
+static int
+cursor_aggregate_type(struct AggInfo_func *func, int cursor,
+		      struct space *space, uint32_t *fieldno)
+{
+	static const char *names[] = {
+		[SQL_CURSOR_AGG_COUNT] = "count", [SQL_CURSOR_AGG_SUM] = "sum",
+		[SQL_CURSOR_AGG_TOTAL] = "total", [SQL_CURSOR_AGG_AVG] = "avg",
+		[SQL_CURSOR_AGG_MIN] = "min", [SQL_CURSOR_AGG_MAX] = "max",
+	};
+	if (func->pFunc == NULL || func->iDistinct >= 0 ||
+	    ExprHasProperty(func->pExpr, EP_Distinct))
+		return -1;
+	int type = SQL_CURSOR_AGG_COUNT;
+	for (; type <= SQL_CURSOR_AGG_MAX; ++type) {
+		if (strcmp(func->pFunc->zName, names[type]) == 0)
+			break;
+	}
+	if (type > SQL_CURSOR_AGG_MAX)
+		return -1;
+	struct ExprList *args = func->pExpr->x.pList;
+	*fieldno = 0;
+	if (args == NULL || args->nExpr == 0)
+		return type == SQL_CURSOR_AGG_COUNT ?
+		       SQL_CURSOR_AGG_COUNT_ALL : -1;
+	if (args->nExpr != 1)
+		return -1;
+	struct Expr *arg = args->a[0].pExpr;
+	if ((arg->op != TK_COLUMN && arg->op != TK_AGG_COLUMN) ||
+	    arg->iTable != cursor || arg->iColumn < 0 ||
+	    arg->iColumn >= (int)space->def->field_count)
+		return -1;
+	*fieldno = arg->iColumn;
+	if (type == SQL_CURSOR_AGG_COUNT)
+		return type;
+	switch (space->def->fields[arg->iColumn].type) {
+	case FIELD_TYPE_INTEGER:
+	case FIELD_TYPE_UNSIGNED:
+	case FIELD_TYPE_NUMBER:
+		break;
+	default:
+		return -1;
+	}
+	/* min() and max() of an indexed column take a lookup. */
+	if ((type == SQL_CURSOR_AGG_MIN || type == SQL_CURSOR_AGG_MAX) &&
+	    space_column_is_indexed(space, *fieldno))
+		return -1;
+	return type;
+}
+
+/**
+ * Check if the aggregate query is of the form:
+ *
+ *   SELECT agg(x), ... FROM <tbl> WHERE <filter>
+ *
+ * where every result column is count(), sum(), total(), avg(),
+ * min() or max() of a numeric column, and <filter> is a
+ * conjunction of comparisons of not indexed columns with
+ * constants. Such a query is a full scan anyway, so it is
+ * computed by OP_CursorAggregate without the VDBE loop.
+ *
+ * @param select The select statement in form of aggregate query.
+ * @param agg_info The associated aggregate-info object.
+ * @retval Pointer to space representing the table,
+ *         if the query matches this pattern. NULL otherwise.
+ */
+static struct space *
+is_cursor_aggregate(struct Select *select, struct AggInfo *agg_info)
+{
+	assert(select->pGroupBy == NULL);
+	if (select->pHaving != NULL || select->pSrc->nSrc != 1 ||
+	    select->pSrc->a[0].pSelect != NULL || agg_info->nFunc == 0)
+		return NULL;
+	struct space *space = space_by_id(select->pSrc->a[0].pTab->def->id);
+	if (space == NULL || space->def->opts.is_view ||
+	    space_index(space, 0) == NULL)
+		return NULL;
+	struct ExprList *list = select->pEList;
+	for (int i = 0; i < list->nExpr; ++i) {
+		if (list->a[i].pExpr->op != TK_AGG_FUNCTION)
+			return NULL;
+	}
+	int cursor = select->pSrc->a[0].iCursor;
+	uint32_t fieldno;
+	for (int i = 0; i < agg_info->nFunc; ++i) {
+		if (cursor_aggregate_type(&agg_info->aFunc[i], cursor, space,
+					  &fieldno) < 0)
+			return NULL;
+	}
+	if (cursor_aggregate_filter_count(select->pWhere, cursor, space) < 0)
+		return NULL;
+	return space;
+}
+
+/**
+ * Generate code computing aggregate functions of a query for
+ * which is_cursor_aggregate() is true with OP_CursorAggregate.
+ */
+static void
+vdbe_emit_cursor_aggregate(struct Parse *parse, struct Select *select,
+			   struct AggInfo *agg_info, struct space *space)
+{
+	struct Vdbe *v = parse->pVdbe;
+	int cursor = select->pSrc->a[0].iCursor;
+	struct Expr *where = select->pWhere;
+	int filter_count = cursor_aggregate_filter_count(where, cursor, space);
+	assert(filter_count >= 0);
+	/*
+	 * A triple of integers takes no more than 1 + 3 * 9
+	 * bytes; string constants are accounted separately.
+	 */
+	size_t size = mp_sizeof_array(2) + mp_sizeof_array(filter_count) +
+		      mp_sizeof_array(agg_info->nFunc) +
+		      (filter_count + agg_info->nFunc) * 28 +
+		      cursor_aggregate_filter_strlen(where);
+	struct sqlite3 *db = parse->db;
+	char *spec = sqlite3DbMallocRawNN(db, size);
+	if (spec == NULL)
+		return;
+	char *pos = mp_encode_array(spec, 2);
+	if (filter_count == 0) {
+		pos = mp_encode_nil(pos);
+	} else {
+		pos = mp_encode_array(pos, filter_count);
+		pos = cursor_aggregate_filter_encode(pos, where, cursor,
+						     space->def);
+	}
+	pos = mp_encode_array(pos, agg_info->nFunc);
+	for (int i = 0; i < agg_info->nFunc; ++i) {
+		uint32_t fieldno;
+		int type = cursor_aggregate_type(&agg_info->aFunc[i], cursor,
+						 space, &fieldno);
+		pos = mp_encode_array(pos, 3);
+		pos = mp_encode_uint(pos, type);
+		pos = mp_encode_uint(pos, fieldno);
+		pos = mp_encode_uint(pos, agg_info->aFunc[i].iMem);
+	}
+	assert(pos <= spec + size);
+	struct Mem *mem = sqlite3ValueNew(db);
+	if (mem == NULL) {
+		sqlite3DbFree(db, spec);
+		return;
+	}
+	sqlite3VdbeMemSetStr(mem, spec, pos - spec, 0, SQLITE_DYNAMIC);
+	vdbe_emit_open_cursor(parse, cursor, 0, space);
+	sqlite3VdbeAddOp4(v, OP_CursorAggregate, cursor, 0, 0, (char *)mem,
+			  P4_MEM);
+	sqlite3VdbeAddOp1(v, OP_Close, cursor);
+}
+
 /*
  * If the source-list item passed as an argument was augmented with an
  * INDEXED BY clause, then try to locate the specified index. If there
@@ -5393,6 +5722,98 @@ explain_simple_count(struct Parse *parse_context, const char *table_name)
 	}
 }
 
+/**
+ * Add a single OP_Explain instruction to the VDBE to explain
+ * aggregates computed by a cursor scan of a table, see
+ * is_cursor_aggregate().
+ *
+ * @param parse_context Current parsing context.
+ * @param table_name Name of table being queried.
+ */
+static void
+explain_cursor_aggregate(struct Parse *parse_context, const char *table_name)
+{
+	if (parse_context->explain == 2) {
+		char *zEqp = sqlite3MPrintf(parse_context->db,
+					    "AGGREGATE TABLE %s", table_name);
+		sqlite3VdbeAddOp4(parse_context->pVdbe, OP_Explain,
+				  parse_context->iSelectId, 0, 0, zEqp,
+				  P4_DYNAMIC);
+	}
+}
+
+/**
+ * Check if GROUP BY of a query is expected to make few groups
+ * of many rows each. Only GROUP BY on columns of one space is
+ * considered. The estimate is taken from the statistics,
+ * collected by ANALYZE, of an index whose leading parts are
+ * exactly the GROUP BY columns.
+ *
+ * Few groups can be aggregated at once as the rows come, in
+ * any order, which is cheaper than sorting all the rows.
+ *
+ * @param select Query with GROUP BY.
+ * @param agg_info Aggregates of the query.
+ * @retval true if the groups can be aggregated unsorted.
+ */
+static bool
+select_has_few_groups(struct Select *select, struct AggInfo *agg_info)
+{
+	for (int i = 0; i < agg_info->nFunc; i++) {
+		/* Each group would need its own DISTINCT set. */
+		if (agg_info->aFunc[i].iDistinct >= 0)
+			return false;
+	}
+	struct SrcList *src = select->pSrc;
+	if (src->nSrc != 1 || src->a[0].pSelect != NULL)
+		return false;
+	struct space *space = space_by_id(src->a[0].pTab->def->id);
+	if (space == NULL)
+		return false;
+	struct ExprList *group_by = select->pGroupBy;
+	uint64_t columns = 0;
+	uint32_t column_count = 0;
+	for (int i = 0; i < group_by->nExpr; i++) {
+		struct Expr *expr =
+			sqlite3ExprSkipCollate(group_by->a[i].pExpr);
+		if ((expr->op != TK_COLUMN && expr->op != TK_AGG_COLUMN) ||
+		    expr->iTable != src->a[0].iCursor ||
+		    expr->iColumn < 0 || expr->iColumn >= 64)
+			return false;
+		uint64_t bit = (uint64_t) 1 << expr->iColumn;
+		if ((columns & bit) == 0) {
+			columns |= bit;
+			column_count++;
+		}
+	}
+	for (uint32_t i = 0; i < space->index_count; i++) {
+		struct index_def *def = space->index[i]->def;
+		if (def->opts.stat == NULL ||
+		    def->key_def->part_count < column_count)
+			continue;
+		uint64_t parts = 0;
+		for (uint32_t j = 0; j < column_count; j++) {
+			uint32_t fieldno = def->key_def->parts[j].fieldno;
+			if (fieldno < 64)
+				parts |= (uint64_t) 1 << fieldno;
+		}
+		if (parts != columns)
+			continue;
+		/*
+		 * TUNING: at least 10 rows per group on average,
+		 * and no more than 100000 groups to keep memory
+		 * for the accumulators bounded.
+		 */
+		assert(sqlite3LogEst(10) == 33);
+		assert(sqlite3LogEst(100000) == 166);
+		log_est_t group_size = index_field_tuple_est(def, column_count);
+		log_est_t row_count = index_field_tuple_est(def, 0);
+		if (group_size >= 33 && row_count - group_size <= 166)
+			return true;
+	}
+	return false;
+}
+
 /**
  * Generate VDBE code that HALT program when subselect returned
  * more than one row (determined as LIMIT 1 overflow).
@@ -5900,6 +6321,12 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 		int sortPTab = 0;	/* Pseudotable used to decode sorting results */
 		int sortOut = 0;	/* Output register from the sorter */
 		int orderByGrp = 0;	/* True if the GROUP BY and ORDER BY are the same */
+		int groupByTable = 0;	/* Groups are aggregated unsorted */
+		int regGroups = 0;	/* Saved accumulators of the groups */
+		int regGroup = 0;	/* Number of the current group */
+		int regGroupCount = 0;	/* Number of groups seen so far */
+		int groupTab = 0;	/* Cursor on the group numbers by key */
+		int regGroupTab = 0;	/* Ephemeral space of group numbers */
 
 		/* Remove any and all aliases between the result set and the
 		 * GROUP BY clause.
@@ -6022,6 +6449,35 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 			 * in the right order to begin with.
 			 */
 			sqlite3VdbeAddOp2(v, OP_Gosub, regReset, addrReset);
+
+			/* If there are few groups, they are numbered by
+			 * their keys in an ephemeral space, which also
+			 * yields them in GROUP BY order at the end. The
+			 * space is not needed and cancelled if the rows
+			 * come in GROUP BY order anyway.
+			 */
+			int addrGroupTab = -1;
+			if (select_has_few_groups(p, &sAggInfo)) {
+				regGroups = ++pParse->nMem;
+				regGroup = ++pParse->nMem;
+				regGroupCount = ++pParse->nMem;
+				regGroupTab = ++pParse->nMem;
+				groupTab = pParse->nTab++;
+				addrGroupTab =
+					sqlite3VdbeAddOp2(v, OP_Null, 0,
+							  regGroups);
+				sqlite3VdbeAddOp2(v, OP_Null, 0, regGroup);
+				sqlite3VdbeAddOp2(v, OP_Integer, 0,
+						  regGroupCount);
+				sqlite3VdbeAddOp4(v, OP_OpenTEphemeral,
+						  regGroupTab,
+						  pGroupBy->nExpr + 1, 0,
+						  (char *)sql_key_info_ref(key_info),
+						  P4_KEYINFO);
+				sqlite3VdbeAddOp3(v, OP_IteratorOpen, groupTab,
+						  0, regGroupTab);
+				VdbeComment((v, "GROUP BY groups"));
+			}
 			pWInfo =
 			    sqlite3WhereBegin(pParse, pTabList, pWhere,
 					      pGroupBy, 0,
@@ -6036,6 +6492,25 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 				 * cancelled later because we still need to use the key_info
 				 */
 				groupBySort = 0;
+				if (addrGroupTab >= 0) {
+					for (int k = 0; k < 5; k++) {
+						sqlite3VdbeChangeToNoop(v,
+							addrGroupTab + k);
+					}
+				}
+			} else if (addrGroupTab >= 0) {
+				/* There are few groups, so rather than sort
+				 * the rows keep accumulators of all the groups
+				 * and switch to the group of each row as it
+				 * comes.
+				 */
+				explain_group_table(pParse,
+						    (sDistinct.isTnct
+						     && (p->selFlags &
+							 SF_Distinct) == 0) ?
+						    "DISTINCT" : "GROUP BY");
+				groupBySort = 0;
+				groupByTable = 1;
 			} else {
 				/* Rows are coming out in undetermined order.  We have to push
 				 * each row into a sorting index, terminate the first loop,
@@ -6113,7 +6588,8 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 			 */
 			if (orderByGrp
 			    && OptimizationEnabled(db, SQLITE_GroupByOrder)
-			    && (groupBySort || sqlite3WhereIsSorted(pWInfo))
+			    && (groupBySort || groupByTable ||
+				sqlite3WhereIsSorted(pWInfo))
 			    ) {
 				sSort.pOrderBy = 0;
 				sqlite3VdbeChangeToNoop(v, sSort.addrSortIndex);
@@ -6144,6 +6620,15 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 							iBMem + j);
 				}
 			}
+			/* With the group table, the first row has no
+			 * previous group to compare with.
+			 */
+			int addrFirstRow = -1;
+			if (groupByTable) {
+				addrFirstRow = sqlite3VdbeAddOp1(v, OP_IsNull,
+								 regGroup);
+				VdbeCoverage(v);
+			}
 			sqlite3VdbeAddOp4(v, OP_Compare, iAMem, iBMem,
 					  pGroupBy->nExpr,
 					  (char*)sql_key_info_ref(key_info),
@@ -6151,6 +6636,8 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 			addr1 = sqlite3VdbeCurrentAddr(v);
 			sqlite3VdbeAddOp3(v, OP_Jump, addr1 + 1, 0, addr1 + 1);
 			VdbeCoverage(v);
+			if (addrFirstRow >= 0)
+				sqlite3VdbeJumpHere(v, addrFirstRow);
 
 			/* Generate code that runs whenever the GROUP BY changes.
 			 * Changes in the GROUP BY are detected by the previous code
@@ -6163,14 +6650,62 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 			 */
 			sqlite3ExprCodeMove(pParse, iBMem, iAMem,
 					    pGroupBy->nExpr);
-			sqlite3VdbeAddOp2(v, OP_Gosub, regOutputRow,
-					  addrOutputRow);
-			VdbeComment((v, "output one row"));
-			sqlite3VdbeAddOp2(v, OP_IfPos, iAbortFlag, addrEnd);
-			VdbeCoverage(v);
-			VdbeComment((v, "check abort flag"));
-			sqlite3VdbeAddOp2(v, OP_Gosub, regReset, addrReset);
-			VdbeComment((v, "reset accumulator"));
+			int nAccumulatorReg = sAggInfo.mxReg - sAggInfo.mnReg + 1;
+			if (groupByTable) {
+				/* Look the group number up by the key, or
+				 * assign the next one to a new group. Then
+				 * switch the accumulators to that group.
+				 */
+				int nKey = pGroupBy->nExpr;
+				int addrFound =
+					sqlite3VdbeAddOp4Int(v, OP_Found,
+							     groupTab, 0,
+							     iAMem, nKey);
+				VdbeCoverage(v);
+				int regKey = sqlite3GetTempRange(pParse,
+								 nKey + 1);
+				int regRecord = sqlite3GetTempReg(pParse);
+				sqlite3VdbeAddOp3(v, OP_Copy, iAMem, regKey,
+						  nKey - 1);
+				sqlite3VdbeAddOp2(v, OP_Copy, regGroupCount,
+						  regKey + nKey);
+				sqlite3VdbeAddOp3(v, OP_MakeRecord, regKey,
+						  nKey + 1, regRecord);
+				sqlite3VdbeAddOp2(v, OP_IdxInsert, regRecord,
+						  regGroupTab);
+				sqlite3VdbeAddOp2(v, OP_Copy, regGroupCount,
+						  regGroup);
+				sqlite3VdbeAddOp2(v, OP_AddImm, regGroupCount,
+						  1);
+				VdbeComment((v, "new group"));
+				sqlite3ReleaseTempReg(pParse, regRecord);
+				sqlite3ReleaseTempRange(pParse, regKey,
+							nKey + 1);
+				int addrSwap = sqlite3VdbeAddOp0(v, OP_Goto);
+				sqlite3VdbeJumpHere(v, addrFound);
+				sqlite3VdbeAddOp3(v, OP_Column, groupTab, nKey,
+						  regGroup);
+				sqlite3VdbeJumpHere(v, addrSwap);
+				if (nAccumulatorReg > 0) {
+					sqlite3VdbeAddOp4Int(v, OP_AggSwap,
+							     regGroups,
+							     sAggInfo.mnReg,
+							     regGroup,
+							     nAccumulatorReg);
+				}
+				sqlite3ExprCacheClear(pParse);
+			} else {
+				sqlite3VdbeAddOp2(v, OP_Gosub, regOutputRow,
+						  addrOutputRow);
+				VdbeComment((v, "output one row"));
+				sqlite3VdbeAddOp2(v, OP_IfPos, iAbortFlag,
+						  addrEnd);
+				VdbeCoverage(v);
+				VdbeComment((v, "check abort flag"));
+				sqlite3VdbeAddOp2(v, OP_Gosub, regReset,
+						  addrReset);
+				VdbeComment((v, "reset accumulator"));
+			}
 
 			/* Update the aggregate accumulators based on the content of
 			 * the current row
@@ -6194,9 +6729,35 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 
 			/* Output the final row of result
 			 */
-			sqlite3VdbeAddOp2(v, OP_Gosub, regOutputRow,
-					  addrOutputRow);
-			VdbeComment((v, "output final row"));
+			if (groupByTable) {
+				/* Output all the groups in GROUP BY order. */
+				int addrGroupLoop =
+					sqlite3VdbeAddOp2(v, OP_Rewind,
+							  groupTab, addrEnd);
+				VdbeCoverage(v);
+				sqlite3VdbeAddOp3(v, OP_Column, groupTab,
+						  pGroupBy->nExpr, regGroup);
+				if (nAccumulatorReg > 0) {
+					sqlite3VdbeAddOp4Int(v, OP_AggSwap,
+							     regGroups,
+							     sAggInfo.mnReg,
+							     regGroup,
+							     nAccumulatorReg);
+				}
+				sqlite3VdbeAddOp2(v, OP_Gosub, regOutputRow,
+						  addrOutputRow);
+				VdbeComment((v, "output one group"));
+				sqlite3VdbeAddOp2(v, OP_IfPos, iAbortFlag,
+						  addrEnd);
+				VdbeCoverage(v);
+				sqlite3VdbeAddOp2(v, OP_Next, groupTab,
+						  addrGroupLoop + 1);
+				VdbeCoverage(v);
+			} else {
+				sqlite3VdbeAddOp2(v, OP_Gosub, regOutputRow,
+						  addrOutputRow);
+				VdbeComment((v, "output final row"));
+			}
 
 			/* Jump over the subroutines
 			 */
@@ -6262,6 +6823,18 @@ sqlite3Select(Parse * pParse,		/* The parser context */
 						  sAggInfo.aFunc[0].iMem);
 				sqlite3VdbeAddOp1(v, OP_Close, cursor);
 				explain_simple_count(pParse, space->def->name);
+			} else if ((space = is_cursor_aggregate(p, &sAggInfo))
+				   != NULL) {
+				/*
+				 * The query is a full scan computing
+				 * simple aggregates: compute them
+				 * without the VDBE loop, possibly in
+				 * several threads.
+				 */
+				vdbe_emit_cursor_aggregate(pParse, p, &sAggInfo,
+							   space);
+				explain_cursor_aggregate(pParse,
+							 space->def->name);
 			} else
 			{
 				/* Check if the query is of one of the following forms:
@@ -355,6 +355,7 @@ struct sqlite3_vfs {
 #define SQLITE_LIMIT_LIKE_PATTERN_LENGTH       8
 #define SQLITE_LIMIT_TRIGGER_DEPTH             9
 #define SQLITE_LIMIT_WORKER_THREADS           10
+#define SQL_LIMIT_AUTO_INDEX_ROWS             11
 
 enum sql_ret_code {
 	/** Result of a routine is ok. */
@@ -450,6 +451,97 @@ sqlite3_value_int(sqlite3_value *);
 enum sql_subtype
 sql_column_subtype(struct sqlite3_stmt *stmt, int i);
 
+/** Execution statistics of a VDBE instruction. */
+struct sql_op_stat {
+	/** Name of the opcode. */
+	const char *opcode;
+	/** Operands of the instruction, as shown by EXPLAIN. */
+	int p1;
+	int p2;
+	int p3;
+	/** Number of times the instruction was executed. */
+	uint64_t exec_count;
+	/** Time spent in the instruction, in nanoseconds. */
+	uint64_t time;
+};
+
+/** Execution statistics of a loop over a table. */
+struct sql_loop_stat {
+	/** Address of the first instruction of the loop body. */
+	int addr;
+	/** Name of the table or NULL for a subquery. */
+	const char *table;
+	/** Name of the index used by the loop or NULL. */
+	const char *index;
+	/** Number of times the loop was started. */
+	uint64_t loop_count;
+	/** Number of tuples fetched by the loop in total. */
+	uint64_t row_count;
+	/** Planner estimate of tuples fetched per start. */
+	uint64_t row_estimate;
+};
+
+/**
+ * Compile a statement to be profiled. Unlike
+ * sqlite3_prepare_v2(), table loops of the statement are
+ * recorded for sql_stmt_loop_stat().
+ * @param db Database handle.
+ * @param sql SQL statement text.
+ * @param length Length of @a sql.
+ * @param[out] stmt Compiled statement.
+ *
+ * @retval SQLITE_OK Success.
+ * @retval Error code otherwise.
+ */
+int
+sql_prepare_profiled(sqlite3 *db, const char *sql, int length,
+		     struct sqlite3_stmt **stmt);
+
+/**
+ * Start profiling of a statement: count executions of each
+ * instruction and time spent in it by the next executions of
+ * the statement. Counters of a profiled statement are reset.
+ * @param stmt Statement, not being executed.
+ *
+ * @retval 0 Success.
+ * @retval -1 Memory error.
+ */
+int
+sql_stmt_profile_start(struct sqlite3_stmt *stmt);
+
+/** Get the number of instructions of a statement. */
+int
+sql_stmt_op_count(struct sqlite3_stmt *stmt);
+
+/**
+ * Get execution statistics of an instruction of a statement.
+ * Counters are zero unless the statement is profiled.
+ * @param stmt Statement.
+ * @param addr Address of the instruction.
+ * @param[out] stat Statistics.
+ */
+void
+sql_stmt_op_stat(struct sqlite3_stmt *stmt, int addr,
+		 struct sql_op_stat *stat);
+
+/**
+ * Get the number of table loops of a statement. The loops are
+ * recorded only by sql_prepare_profiled().
+ */
+int
+sql_stmt_loop_count(struct sqlite3_stmt *stmt);
+
+/**
+ * Get execution statistics of a table loop of a statement.
+ * Counters are zero unless the statement is profiled.
+ * @param stmt Statement.
+ * @param idx Number of the loop.
+ * @param[out] stat Statistics.
+ */
+void
+sql_stmt_loop_stat(struct sqlite3_stmt *stmt, int idx,
+		   struct sql_loop_stat *stat);
+
 sqlite3_int64
 sqlite3_value_int64(sqlite3_value *);
 
@@ -594,6 +686,12 @@ sqlite3_column_value(sqlite3_stmt *,
 int
 sqlite3_finalize(sqlite3_stmt * pStmt);
 
+int
+sqlite3_reset(sqlite3_stmt * pStmt);
+
+int
+sqlite3_clear_bindings(sqlite3_stmt * pStmt);
+
 int
 sqlite3_exec(sqlite3 *,	/* An open database */
 	     const char *sql,	/* SQL to be evaluated */
@@ -1035,6 +1133,14 @@ sqlite3_bind_parameter_lindex(sqlite3_stmt * pStmt, const char *zName,
 #define SQL_DEFAULT_COMPOUND_SELECT 30
 #endif
 
+/*
+ * Default maximal number of rows in an automatic index. A join
+ * with a bigger inner table is executed with a nested loop.
+ */
+#ifndef SQL_DEFAULT_AUTO_INDEX_ROWS
+#define SQL_DEFAULT_AUTO_INDEX_ROWS 100000
+#endif
+
 /*
  * The default initial allocation for the pagecache when using separate
  * pagecaches for each database connection.  A positive number is the
@@ -1449,7 +1555,7 @@ typedef int VList;
  * The number of different kinds of things that can be limited
  * using the sqlite3_limit() interface.
  */
-#define SQLITE_N_LIMIT (SQLITE_LIMIT_WORKER_THREADS+1)
+#define SQLITE_N_LIMIT (SQL_LIMIT_AUTO_INDEX_ROWS+1)
 
 /*
  * Lookaside malloc is a set of fixed-size buffers that can be used
@@ -2800,6 +2906,11 @@ struct Parse {
 	bool is_new_table_autoinc;
 	/** If set - do not emit byte code at all, just parse.  */
 	bool parse_only;
+	/**
+	 * If set - record table loops of the statement for
+	 * sql_stmt_loop_stat().
+	 */
+	bool is_profiled;
 	/** Type of parsed_ast member. */
 	enum ast_type parsed_ast_type;
 	/**
@@ -2837,6 +2948,7 @@ struct Parse {
 #define OPFLAG_PERMUTE       0x01	/* OP_Compare: use the permutation */
 #define OPFLAG_SAVEPOSITION  0x02	/* OP_Delete: keep cursor position */
 #define OPFLAG_AUXDELETE     0x04	/* OP_Delete: index in a DELETE op */
+#define OPFLAG_MAY_YIELD     0x01	/* OP_SorterSort: sort may yield */
 
 #define OPFLAG_SAME_FRAME    0x01	/* OP_FCopy: use same frame for source
 					 * register
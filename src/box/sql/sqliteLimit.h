@@ -121,6 +121,14 @@ enum {
 #define SQL_MAX_COMPOUND_SELECT 50
 #endif
 
+/*
+ * The maximum number of rows an automatic index may be built
+ * for, see PRAGMA sql_automatic_index_limit.
+ */
+#ifndef SQL_MAX_AUTO_INDEX_ROWS
+#define SQL_MAX_AUTO_INDEX_ROWS 0x7fffffff
+#endif
+
 /*
  * The maximum number of opcodes in a VDBE program.
  * Not currently enforced.
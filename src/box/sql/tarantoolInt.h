@@ -37,6 +37,57 @@ int tarantoolSqlite3Previous(BtCursor * pCur, int *pRes);
 int tarantoolSqlite3MovetoUnpacked(BtCursor * pCur, UnpackedRecord * pIdxKey,
 				   int *pRes);
 int tarantoolSqlite3Count(BtCursor * pCur, i64 * pnEntry);
+
+/** Aggregate functions computed by sql_cursor_aggregate(). */
+enum sql_cursor_agg_type {
+	/** count(*) */
+	SQL_CURSOR_AGG_COUNT_ALL,
+	SQL_CURSOR_AGG_COUNT,
+	SQL_CURSOR_AGG_SUM,
+	SQL_CURSOR_AGG_TOTAL,
+	SQL_CURSOR_AGG_AVG,
+	SQL_CURSOR_AGG_MIN,
+	SQL_CURSOR_AGG_MAX,
+};
+
+/** Result of an aggregate function computed over a cursor. */
+struct sql_cursor_agg {
+	/** Number of aggregated values. */
+	int64_t count;
+	/** Integer sum, valid unless is_approx or is_overflow. */
+	int64_t int_sum;
+	/** Floating point sum. */
+	double sum;
+	/** True if a floating point value was summed. */
+	bool is_approx;
+	/** True if the integer sum overflowed. */
+	bool is_overflow;
+	/** True if the minimum or maximum is an integer. */
+	bool is_int;
+	/** Integer minimum or maximum. */
+	int64_t int_value;
+	/** Floating point minimum or maximum. */
+	double value;
+};
+
+/**
+ * Compute aggregate functions over the index of a cursor, see
+ * OP_CursorAggregate. A large memtx tree index is split into
+ * ranges which are scanned by the TX thread and the worker
+ * pool, while the TX thread waits for them without yielding, so
+ * that all of them see the same state of the index.
+ *
+ * @param cursor Cursor to scan.
+ * @param spec MsgPack array of a filter in the format of
+ *        OP_CursorFilter or nil, and an array of [type, field
+ *        number, register] triples, one per function.
+ * @param[out] aggs Results, one per function.
+ *
+ * @retval SQLITE_OK on success, SQL_TARANTOOL_ERROR otherwise.
+ */
+int
+sql_cursor_aggregate(struct BtCursor *cursor, const char *spec,
+		     struct sql_cursor_agg *aggs);
 int tarantoolSqlite3Insert(struct space *space, const char *tuple,
 			   const char *tuple_end);
 int tarantoolSqlite3Replace(struct space *space, const char *tuple,
@@ -616,3 +616,193 @@ sql_trigger_compile(struct sqlite3 *db, const char *sql)
 	sql_parser_destroy(&parser);
 	return trigger;
 }
+
+/**
+ * Check if a token at the nesting level of SELECT ends its
+ * result list.
+ */
+static inline bool
+sql_token_ends_result_list(int type)
+{
+	switch (type) {
+	case TK_FROM:
+	case TK_WHERE:
+	case TK_GROUP:
+	case TK_ORDER:
+	case TK_LIMIT:
+	case TK_UNION:
+	case TK_EXCEPT:
+	case TK_INTERSECT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Convert a literal token into a value to bind.
+ * @retval 0 Success.
+ * @retval 1 The value doesn't fit a parameter and the literal
+ *         must be kept in the text.
+ * @retval -1 Memory error.
+ */
+static int
+sql_literal_create(struct region *region, const char *z, int n, int type,
+		   struct sql_literal *literal)
+{
+	literal->type = type;
+	switch (type) {
+	case TK_INTEGER: {
+		char buf[32];
+		if (n >= (int)sizeof(buf))
+			return 1;
+		memcpy(buf, z, n);
+		buf[n] = '\0';
+		return sql_dec_or_hex_to_i64(buf, &literal->i64) == 0 ? 0 : 1;
+	}
+	case TK_FLOAT:
+		return sqlite3AtoF(z, &literal->d, n) ? 0 : 1;
+	default: {
+		assert(type == TK_STRING);
+		char *s = (char *)region_alloc(region, n + 1);
+		if (s == NULL) {
+			diag_set(OutOfMemory, n + 1, "region_alloc", "s");
+			return -1;
+		}
+		memcpy(s, z, n);
+		s[n] = '\0';
+		sqlite3Dequote(s);
+		literal->s = s;
+		literal->len = strlen(s);
+		return 0;
+	}
+	}
+}
+
+/** Double capacity of an array of literals on a region. */
+static int
+sql_literals_grow(struct region *region, struct sql_literal **literals,
+		  int count, int *capacity)
+{
+	*capacity = *capacity == 0 ? 8 : 2 * *capacity;
+	size_t size = *capacity * sizeof(struct sql_literal);
+	struct sql_literal *new_literals = (struct sql_literal *)
+		region_aligned_alloc(region, size, alignof(struct sql_literal));
+	if (new_literals == NULL) {
+		diag_set(OutOfMemory, size, "region_aligned_alloc",
+			 "new_literals");
+		return -1;
+	}
+	if (count > 0)
+		memcpy(new_literals, *literals, count * sizeof(**literals));
+	*literals = new_literals;
+	return 0;
+}
+
+int
+sql_normalize(struct region *region, const char *sql, char **norm_sql,
+	      uint32_t *norm_len, struct sql_literal **literals)
+{
+	size_t len = strlen(sql);
+	/* Markers and spaces are never longer than what they replace. */
+	char *out = (char *)region_alloc(region, len + 1);
+	if (out == NULL) {
+		diag_set(OutOfMemory, len + 1, "region_alloc", "out");
+		return -1;
+	}
+	char *pos = out;
+	struct sql_literal *lits = NULL;
+	int count = 0, capacity = 0;
+	/* Nesting level of parentheses. */
+	int depth = 0;
+	/* Level of the outermost SELECT result list or -1. */
+	int result_depth = -1;
+	/* Level of the current ORDER BY or GROUP BY list or -1. */
+	int by_depth = -1;
+	int prev = 0;
+	while (*sql != 0) {
+		int type;
+		bool is_reserved;
+		int n = sql_token(sql, &type, &is_reserved);
+		const char *z = sql;
+		sql += n;
+		if (type == TK_SPACE) {
+			if (pos > out && pos[-1] != ' ')
+				*pos++ = ' ';
+			continue;
+		}
+		if (prev == 0 && type != TK_SELECT && type != TK_WITH &&
+		    type != TK_INSERT && type != TK_REPLACE &&
+		    type != TK_UPDATE && type != TK_DELETE)
+			return 0;
+		switch (type) {
+		case TK_ILLEGAL:
+		case TK_VARIABLE:
+		/* A marker can't be a length of a type. */
+		case TK_CAST:
+			return 0;
+		case TK_LP:
+			++depth;
+			break;
+		case TK_RP:
+			--depth;
+			if (depth < result_depth)
+				result_depth = -1;
+			if (depth < by_depth)
+				by_depth = -1;
+			break;
+		case TK_SELECT:
+			if (result_depth < 0)
+				result_depth = depth;
+			break;
+		case TK_BY:
+			by_depth = depth;
+			break;
+		case TK_INTEGER:
+		case TK_FLOAT:
+		case TK_STRING: {
+			if (result_depth >= 0)
+				break;
+			if (type == TK_INTEGER && (prev == TK_BY ||
+			    (prev == TK_COMMA && by_depth == depth)))
+				break;
+			if (count == SQL_BIND_PARAMETER_MAX)
+				return 0;
+			if (count == capacity &&
+			    sql_literals_grow(region, &lits, count,
+					      &capacity) != 0)
+				return -1;
+			int rc = sql_literal_create(region, z, n, type,
+						    &lits[count]);
+			if (rc < 0)
+				return -1;
+			if (rc > 0)
+				break;
+			++count;
+			*pos++ = '?';
+			prev = type;
+			continue;
+		}
+		default:
+			if (depth == result_depth &&
+			    sql_token_ends_result_list(type))
+				result_depth = -1;
+			if (depth == by_depth && (type == TK_HAVING ||
+			    sql_token_ends_result_list(type)))
+				by_depth = -1;
+			break;
+		}
+		if (type == TK_SEMI)
+			break;
+		memcpy(pos, z, n);
+		pos += n;
+		prev = type;
+	}
+	if (pos > out && pos[-1] == ' ')
+		--pos;
+	*pos = '\0';
+	*norm_sql = out;
+	*norm_len = pos - out;
+	*literals = lits;
+	return count;
+}
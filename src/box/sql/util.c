@@ -1453,9 +1453,6 @@ sqlite3LogEst(u64 x)
 
 /*
  * Convert a LogEst into an integer.
- *
- * Note that this routine is only used when one or more of various
- * non-standard compile-time options is enabled.
  */
 u64
 sqlite3LogEstToInt(LogEst x)
@@ -1467,16 +1464,8 @@ sqlite3LogEstToInt(LogEst x)
 		n -= 2;
 	else if (n >= 1)
 		n -= 1;
-#if defined(SQLITE_ENABLE_STMT_SCANSTATUS) || \
-    defined(SQLITE_EXPLAIN_ESTIMATED_ROWS)
 	if (x > 60)
 		return (u64) LARGEST_INT64;
-#else
-	/* The largest input possible to this routine is 310,
-	 * resulting in a maximum x of 31
-	 */
-	assert(x <= 60);
-#endif
 	return x >= 3 ? (n + 8) << (x - 3) : (n + 8) >> (3 - x);
 }
 
@@ -49,6 +49,7 @@
 #include "tarantoolInt.h"
 
 #include "msgpuck/msgpuck.h"
+#include "clock.h"
 #include "mpstream.h"
 
 #include "box/schema.h"
@@ -605,6 +606,12 @@ vdbe_autoinc_id_list(struct Vdbe *vdbe)
 	return &vdbe->autoinc_id_list;
 }
 
+uint32_t
+vdbe_schema_version(struct Vdbe *vdbe)
+{
+	return vdbe->schema_ver;
+}
+
 int
 vdbe_add_new_autoinc_id(struct Vdbe *vdbe, int64_t id)
 {
@@ -621,6 +628,65 @@ vdbe_add_new_autoinc_id(struct Vdbe *vdbe, int64_t id)
 	return 0;
 }
 
+/**
+ * Saved aggregate accumulators of groups, see OP_AggSwap.
+ * Kept in a register as a MEM_Dyn blob, so it is freed
+ * together with the register.
+ */
+struct agg_groups {
+	/** Database connection. */
+	struct sqlite3 *db;
+	/** Number of accumulator registers of a group. */
+	int reg_count;
+	/** Number of groups the array has room for. */
+	int group_count;
+	/** Group which is in the registers now, or -1. */
+	int current;
+	/** Saved accumulators, reg_count per group. */
+	struct Mem *accumulators;
+};
+
+static void
+agg_groups_delete(void *ptr)
+{
+	struct agg_groups *groups = (struct agg_groups *) ptr;
+	int count = groups->group_count * groups->reg_count;
+	for (int i = 0; i < count; i++)
+		sqlite3VdbeMemRelease(&groups->accumulators[i]);
+	sqlite3DbFree(groups->db, groups->accumulators);
+	sqlite3DbFree(groups->db, groups);
+}
+
+/**
+ * Make room for accumulators of groups [0, @a group_count).
+ * @retval 0 Success.
+ * @retval -1 Memory error.
+ */
+static int
+agg_groups_reserve(struct agg_groups *groups, int group_count)
+{
+	if (group_count <= groups->group_count)
+		return 0;
+	int new_count = MAX(groups->group_count * 2, 16);
+	while (new_count < group_count)
+		new_count *= 2;
+	int reg_count = groups->reg_count;
+	struct Mem *accumulators =
+		sqlite3DbRealloc(groups->db, groups->accumulators,
+				 new_count * reg_count * sizeof(struct Mem));
+	if (accumulators == NULL)
+		return -1;
+	for (int i = groups->group_count * reg_count;
+	     i < new_count * reg_count; i++) {
+		memset(&accumulators[i], 0, sizeof(struct Mem));
+		accumulators[i].flags = MEM_Null;
+		accumulators[i].db = groups->db;
+	}
+	groups->accumulators = accumulators;
+	groups->group_count = new_count;
+	return 0;
+}
+
 /*
  * Execute as much of a VDBE program as we can.
  * This is the core of sqlite3_step().
@@ -651,6 +717,8 @@ int sqlite3VdbeExec(Vdbe *p)
 #ifdef VDBE_PROFILE
 	u64 start;                 /* CPU clock count at start of opcode */
 #endif
+	int iProfOp = -1;          /* Address of op being timed, if profiled */
+	u64 profStart = 0;         /* Time when iProfOp started */
 	struct session *user_session = current_session();
 	/*** INSERT STACK UNION HERE ***/
 
@@ -715,9 +783,19 @@ int sqlite3VdbeExec(Vdbe *p)
 		start = sqlite3Hwtime();
 #endif
 		nVmStep++;
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-		if (p->anExec) p->anExec[(int)(pOp-aOp)]++;
-#endif
+		if (p->anExec) {
+			/*
+			 * An op lasts until the next one starts, so
+			 * jumps and time spent in the op body are
+			 * accounted without a hook at every exit.
+			 */
+			u64 now = clock_monotonic64();
+			if (iProfOp >= 0)
+				p->anTime[iProfOp] += now - profStart;
+			iProfOp = (int)(pOp-aOp);
+			profStart = now;
+			p->anExec[(int)(pOp-aOp)]++;
+		}
 
 		/* Only allow tracing if SQLITE_DEBUG is defined.
 		 */
@@ -1605,6 +1683,7 @@ case OP_Remainder: {           /* same as TK_REM, in1, in2, out3 */
 	double rA;      /* Real value of left operand */
 	double rB;      /* Real value of right operand */
 
+			arithmetic_generic:
 	pIn1 = &aMem[pOp->p1];
 	type1 = numericType(pIn1);
 	pIn2 = &aMem[pOp->p2];
@@ -1699,6 +1778,65 @@ division_by_zero:
 	goto abort_due_to_error;
 }
 
+/* Opcode: AddInt P1 P2 P3 * *
+ * Synopsis: r[P3]=r[P1]+r[P2]
+ *
+ * Same as Add, for operands the code generator knows to be
+ * integers. If an operand turns out not to be an integer, or the
+ * result overflows, the opcode is replaced with Add for good and
+ * the sum is computed the way Add does it.
+ */
+/* Opcode: SubtractInt P1 P2 P3 * *
+ * Synopsis: r[P3]=r[P2]-r[P1]
+ *
+ * Same as Subtract, for integer operands. See AddInt.
+ */
+/* Opcode: MultiplyInt P1 P2 P3 * *
+ * Synopsis: r[P3]=r[P1]*r[P2]
+ *
+ * Same as Multiply, for integer operands. See AddInt.
+ */
+case OP_AddInt:                /* in1, in2, out3 */
+case OP_SubtractInt:           /* in1, in2, out3 */
+case OP_MultiplyInt: {         /* in1, in2, out3 */
+	i64 iA;         /* Integer value of left operand */
+	i64 iB;         /* Integer value of right operand */
+	int overflow;   /* True if the result does not fit i64 */
+
+	pIn1 = &aMem[pOp->p1];
+	pIn2 = &aMem[pOp->p2];
+	pOut = &aMem[pOp->p3];
+	if ((pIn1->flags & pIn2->flags & MEM_Int) != 0) {
+		iA = pIn1->u.i;
+		iB = pIn2->u.i;
+		switch (pOp->opcode) {
+		case OP_AddInt:
+			overflow = sqlite3AddInt64(&iB, iA);
+			break;
+		case OP_SubtractInt:
+			overflow = sqlite3SubInt64(&iB, iA);
+			break;
+		default:
+			overflow = sqlite3MulInt64(&iB, iA);
+			break;
+		}
+		if (!overflow) {
+			pOut->u.i = iB;
+			MemSetTypeFlag(pOut, MEM_Int);
+			break;
+		}
+	} else if (((pIn1->flags | pIn2->flags) & MEM_Null) != 0) {
+		sqlite3VdbeMemSetNull(pOut);
+		break;
+	}
+	switch (pOp->opcode) {
+	case OP_AddInt:      pOp->opcode = OP_Add;       break;
+	case OP_SubtractInt: pOp->opcode = OP_Subtract;  break;
+	default:             pOp->opcode = OP_Multiply;  break;
+	}
+	goto arithmetic_generic;
+}
+
 /* Opcode: CollSeq P1 * * P4
  *
  * P4 is a pointer to a CollSeq struct. If the next call to a user function
@@ -2131,6 +2269,7 @@ case OP_Ge: {             /* same as TK_GE, jump, in1, in3 */
 	u32 flags1;         /* Copy of initial value of pIn1->flags */
 	u32 flags3;         /* Copy of initial value of pIn3->flags */
 
+			compare_generic:
 	pIn1 = &aMem[pOp->p1];
 	pIn3 = &aMem[pOp->p3];
 	flags1 = pIn1->flags;
@@ -2272,6 +2411,90 @@ case OP_Ge: {             /* same as TK_GE, jump, in1, in3 */
 	break;
 }
 
+/* Opcode: EqInt P1 P2 P3 * P5
+ * Synopsis: IF r[P3]==r[P1]
+ *
+ * Same as Eq, for operands the code generator knows to be
+ * integers. Jump to P2 if the values in registers P1 and P3 are
+ * equal. If either operand is NULL, the jump is taken only if the
+ * SQLITE_JUMPIFNULL bit of P5 is set. The result is never stored
+ * in a register.
+ *
+ * If an operand turns out to be neither an integer nor NULL, the
+ * opcode is replaced with Eq for good and the values are compared
+ * the way Eq does it.
+ */
+/* Opcode: NeInt P1 P2 P3 * P5
+ * Synopsis: IF r[P3]!=r[P1]
+ *
+ * Same as Ne, for integer operands. See EqInt.
+ */
+/* Opcode: LtInt P1 P2 P3 * P5
+ * Synopsis: IF r[P3]<r[P1]
+ *
+ * Same as Lt, for integer operands. See EqInt.
+ */
+/* Opcode: LeInt P1 P2 P3 * P5
+ * Synopsis: IF r[P3]<=r[P1]
+ *
+ * Same as Le, for integer operands. See EqInt.
+ */
+/* Opcode: GtInt P1 P2 P3 * P5
+ * Synopsis: IF r[P3]>r[P1]
+ *
+ * Same as Gt, for integer operands. See EqInt.
+ */
+/* Opcode: GeInt P1 P2 P3 * P5
+ * Synopsis: IF r[P3]>=r[P1]
+ *
+ * Same as Ge, for integer operands. See EqInt.
+ */
+case OP_EqInt:            /* jump, in1, in3 */
+case OP_NeInt:            /* jump, in1, in3 */
+case OP_LtInt:            /* jump, in1, in3 */
+case OP_LeInt:            /* jump, in1, in3 */
+case OP_GtInt:            /* jump, in1, in3 */
+case OP_GeInt: {          /* jump, in1, in3 */
+	i64 lhs;            /* Integer value of r[P3] */
+	i64 rhs;            /* Integer value of r[P1] */
+	int taken;          /* True if the jump is taken */
+
+	assert((pOp->p5 & (SQLITE_STOREP2 | SQLITE_NULLEQ)) == 0);
+	pIn1 = &aMem[pOp->p1];
+	pIn3 = &aMem[pOp->p3];
+	if ((pIn1->flags & pIn3->flags & MEM_Int) == 0) {
+		if (((pIn1->flags | pIn3->flags) & MEM_Null) != 0) {
+			VdbeBranchTaken(2,3);
+			if (pOp->p5 & SQLITE_JUMPIFNULL)
+				goto jump_to_p2;
+			break;
+		}
+		switch (pOp->opcode) {
+		case OP_EqInt: pOp->opcode = OP_Eq; break;
+		case OP_NeInt: pOp->opcode = OP_Ne; break;
+		case OP_LtInt: pOp->opcode = OP_Lt; break;
+		case OP_LeInt: pOp->opcode = OP_Le; break;
+		case OP_GtInt: pOp->opcode = OP_Gt; break;
+		default:       pOp->opcode = OP_Ge; break;
+		}
+		goto compare_generic;
+	}
+	lhs = pIn3->u.i;
+	rhs = pIn1->u.i;
+	switch (pOp->opcode) {
+	case OP_EqInt: taken = lhs == rhs; break;
+	case OP_NeInt: taken = lhs != rhs; break;
+	case OP_LtInt: taken = lhs < rhs;  break;
+	case OP_LeInt: taken = lhs <= rhs; break;
+	case OP_GtInt: taken = lhs > rhs;  break;
+	default:       taken = lhs >= rhs; break;
+	}
+	VdbeBranchTaken(taken != 0, 3);
+	if (taken)
+		goto jump_to_p2;
+	break;
+}
+
 /* Opcode: ElseNotEq * P2 * * *
  *
  * This opcode must immediately follow an OP_Lt or OP_Gt comparison operator.
@@ -2635,6 +2858,7 @@ case OP_Column: {
 	const u8 *zParse;  /* Next unparsed byte of the row */
 	Mem *pReg;         /* PseudoTable input register */
 
+			op_column_start:
 	pC = p->apCsr[pOp->p1];
 	p2 = pOp->p2;
 
@@ -2648,6 +2872,8 @@ case OP_Column: {
 	assert(pC->eCurType!=CURTYPE_PSEUDO || pC->nullRow);
 	assert(pC->eCurType!=CURTYPE_SORTER);
 
+	if (pC->eCurType == CURTYPE_TARANTOOL && !pC->nullRow)
+		pCrsr = pC->uc.pCursor;
 	if (pC->cacheStatus!=p->cacheCtr) {                /*OPTIMIZATION-IF-FALSE*/
 		if (pC->nullRow) {
 			if (pC->eCurType==CURTYPE_PSEUDO) {
@@ -2662,7 +2888,6 @@ case OP_Column: {
 				goto op_column_out;
 			}
 		} else {
-			pCrsr = pC->uc.pCursor;
 			assert(pC->eCurType==CURTYPE_TARANTOOL);
 			assert(pCrsr);
 			assert(sqlite3CursorIsValid(pCrsr));
@@ -2789,6 +3014,21 @@ case OP_Column: {
 			op_column_out:
 	UPDATE_MAX_BLOBSIZE(pDest);
 	REGISTER_TRACE(pOp->p3, pDest);
+	/*
+	 * Columns of a row are usually read by a run of
+	 * OP_Column on the same cursor. Handle the whole run
+	 * here: the row is already fetched and its parsed
+	 * offsets are valid, so the next column costs only the
+	 * decoding of its value. A profiled statement dispatches
+	 * each op, so that its count and time are accounted.
+	 */
+	if (pOp[1].opcode == OP_Column && pOp[1].p1 == pOp->p1 &&
+	    pC->cacheStatus == p->cacheCtr && p->anExec == NULL) {
+		pOp++;
+		nVmStep++;
+		pCrsr = NULL;
+		goto op_column_start;
+	}
 	break;
 
 			op_column_error:
@@ -2969,6 +3209,85 @@ case OP_Count: {         /* out2 */
 	break;
 }
 
+/* Opcode: CursorAggregate P1 * * P4 *
+ *
+ * Compute aggregate functions over all tuples of the table opened
+ * by Tarantool cursor P1 which satisfy a filter, and store their
+ * final values in registers. Blob P4 is a MsgPack array of the
+ * filter in the format of OP_CursorFilter or nil, and an array
+ * of [function, field number, register] triples, see
+ * sql_cursor_aggregate(). A large memtx table is scanned by
+ * several threads.
+ */
+case OP_CursorAggregate: {
+	BtCursor *pCrsr;
+	struct sql_cursor_agg *aggs;
+	const char *spec;
+	u32 nFunc;
+
+	assert(p->apCsr[pOp->p1]->eCurType==CURTYPE_TARANTOOL);
+	assert(pOp->p4type == P4_MEM);
+	pCrsr = p->apCsr[pOp->p1]->uc.pCursor;
+	assert(pCrsr);
+	spec = pOp->p4.pMem->z;
+	mp_decode_array(&spec);
+	mp_next(&spec);
+	nFunc = mp_decode_array(&spec);
+	aggs = sqlite3DbMallocRawNN(db, sizeof(*aggs) * nFunc);
+	if (aggs == NULL) goto no_mem;
+	rc = sql_cursor_aggregate(pCrsr, pOp->p4.pMem->z, aggs);
+	if (rc) {
+		sqlite3DbFree(db, aggs);
+		goto abort_due_to_error;
+	}
+	for (u32 i = 0; i < nFunc; i++) {
+		struct sql_cursor_agg *agg = &aggs[i];
+		mp_decode_array(&spec);
+		int type = mp_decode_uint(&spec);
+		mp_next(&spec);
+		pOut = &aMem[mp_decode_uint(&spec)];
+		memAboutToChange(p, pOut);
+		switch (type) {
+		case SQL_CURSOR_AGG_COUNT_ALL:
+		case SQL_CURSOR_AGG_COUNT:
+			sqlite3VdbeMemSetInt64(pOut, agg->count);
+			break;
+		case SQL_CURSOR_AGG_TOTAL:
+			sqlite3VdbeMemSetDouble(pOut, agg->sum);
+			break;
+		default:
+			/* See sumFinalize(), avgFinalize(), minMaxFinalize(). */
+			if (agg->count == 0) {
+				sqlite3VdbeMemSetNull(pOut);
+			} else if (type == SQL_CURSOR_AGG_AVG) {
+				sqlite3VdbeMemSetDouble(pOut,
+							agg->sum / agg->count);
+			} else if (type == SQL_CURSOR_AGG_MIN ||
+				   type == SQL_CURSOR_AGG_MAX) {
+				if (agg->is_int)
+					sqlite3VdbeMemSetInt64(pOut,
+							       agg->int_value);
+				else
+					sqlite3VdbeMemSetDouble(pOut,
+								agg->value);
+			} else if (agg->is_overflow) {
+				sqlite3DbFree(db, aggs);
+				sqlite3VdbeError(p, "integer overflow");
+				rc = SQLITE_ERROR;
+				goto abort_due_to_error;
+			} else if (agg->is_approx) {
+				sqlite3VdbeMemSetDouble(pOut, agg->sum);
+			} else {
+				sqlite3VdbeMemSetInt64(pOut, agg->int_sum);
+			}
+			break;
+		}
+		REGISTER_TRACE((int)(pOut - aMem), pOut);
+	}
+	sqlite3DbFree(db, aggs);
+	break;
+}
+
 /* Opcode: Savepoint P1 * * P4 *
  *
  * Open, release or rollback the savepoint named by parameter P4, depending
@@ -4128,6 +4447,26 @@ case OP_NullRow: {
 	break;
 }
 
+/* Opcode: CursorFilter P1 * * P4 *
+ *
+ * Make Tarantool cursor P1 skip tuples which do not satisfy the
+ * conditions encoded in blob P4, see BtCursor.filter. This
+ * affects the scan started by the next Rewind or Last on P1, so
+ * rejected tuples never reach registers.
+ */
+case OP_CursorFilter: {
+	VdbeCursor *pC;
+
+	assert(pOp->p1>=0 && pOp->p1<p->nCursor);
+	assert(pOp->p4type == P4_MEM);
+	assert((pOp->p4.pMem->flags & MEM_Blob) != 0);
+	pC = p->apCsr[pOp->p1];
+	assert(pC != NULL);
+	if (pC->eCurType == CURTYPE_TARANTOOL)
+		pC->uc.pCursor->filter = pOp->p4.pMem->z;
+	break;
+}
+
 /* Opcode: Last P1 P2 P3 * *
  *
  * The next use of the Column or Prev instruction for P1
@@ -4199,6 +4538,11 @@ case OP_Last: {        /* jump */
  * rewinding so that the global variable will be incremented and
  * regression tests can determine whether or not the optimizer is
  * correctly optimizing out sorts.
+ *
+ * If P5 of OP_SorterSort has OPFLAG_MAY_YIELD set, the scan that
+ * filled the sorter is over and no space is read afterwards. All
+ * cursors on spaces are closed then, and the sort may yield the
+ * fiber while a worker thread sorts large runs.
  */
 case OP_SorterSort:    /* jump */
 case OP_Sort: {        /* jump */
@@ -4207,6 +4551,20 @@ case OP_Sort: {        /* jump */
 			sql_search_count--;
 #endif
 			p->aCounter[SQLITE_STMTSTATUS_SORT]++;
+			if ((pOp->p5 & OPFLAG_MAY_YIELD) != 0) {
+				assert(pOp->opcode == OP_SorterSort);
+				for (int i = 0; i < p->nCursor; i++) {
+					VdbeCursor *pCx = p->apCsr[i];
+					if (pCx == NULL ||
+					    pCx->eCurType != CURTYPE_TARANTOOL ||
+					    (pCx->uc.pCursor->curFlags &
+					     BTCF_TaCursor) == 0)
+						continue;
+					sqlite3VdbeFreeCursor(p, pCx);
+					p->apCsr[i] = NULL;
+				}
+				sqlite3VdbeSorterMayYield(p->apCsr[pOp->p1]);
+			}
 			/* Fall through into OP_Rewind */
 			FALLTHROUGH;
 		}
@@ -4968,9 +5326,8 @@ case OP_Program: {        /* jump */
 		pFrame->aOp = p->aOp;
 		pFrame->nOp = p->nOp;
 		pFrame->token = pProgram->token;
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 		pFrame->anExec = p->anExec;
-#endif
+		pFrame->anTime = p->anTime;
 
 		pEnd = &VdbeFrameMem(pFrame)[pFrame->nChildMem];
 		for(pMem=VdbeFrameMem(pFrame); pMem!=pEnd; pMem++) {
@@ -5000,9 +5357,8 @@ case OP_Program: {        /* jump */
 	p->apCsr = (VdbeCursor **)&aMem[p->nMem];
 	p->aOp = aOp = pProgram->aOp;
 	p->nOp = pProgram->nOp;
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 	p->anExec = 0;
-#endif
+	p->anTime = 0;
 	pOp = &aOp[-1];
 
 	break;
@@ -5305,6 +5661,64 @@ case OP_AggFinal: {
 	break;
 }
 
+/* Opcode: AggSwap P1 P2 P3 P4 *
+ * Synopsis: accum=r[P2@P4] group=r[P3]
+ *
+ * Switch the aggregate accumulators r[P2@P4] to the group
+ * number r[P3]. The accumulators of the group being processed
+ * so far are saved in the register P1, and the ones of the
+ * new group are loaded from there. A group which is seen for
+ * the first time gets NULLs, i.e. empty accumulators.
+ *
+ * This allows to aggregate rows which come in an arbitrary
+ * order of groups, without sorting them.
+ */
+case OP_AggSwap: {
+	assert(pOp->p4type == P4_INT32 && pOp->p4.i > 0);
+	int reg_count = pOp->p4.i;
+	Mem *groups_mem = &aMem[pOp->p1];
+	if ((groups_mem->flags & MEM_Dyn) == 0 ||
+	    groups_mem->xDel != agg_groups_delete) {
+		struct agg_groups *groups =
+			sqlite3DbMallocZero(db, sizeof(*groups));
+		if (groups == NULL)
+			goto no_mem;
+		groups->db = db;
+		groups->reg_count = reg_count;
+		groups->current = -1;
+		sqlite3VdbeMemSetNull(groups_mem);
+		groups_mem->z = (char *) groups;
+		groups_mem->n = 0;
+		groups_mem->flags = MEM_Blob | MEM_Dyn;
+		groups_mem->xDel = agg_groups_delete;
+	}
+	struct agg_groups *groups = (struct agg_groups *) groups_mem->z;
+	assert(groups->reg_count == reg_count);
+	pIn3 = &aMem[pOp->p3];
+	assert((pIn3->flags & MEM_Int) != 0 && pIn3->u.i >= 0);
+	int group = (int) pIn3->u.i;
+	if (group == groups->current)
+		break;
+	if (agg_groups_reserve(groups, group + 1) != 0)
+		goto no_mem;
+	Mem *accumulators = &aMem[pOp->p2];
+	if (groups->current >= 0) {
+		Mem *saved = &groups->accumulators[groups->current *
+						   reg_count];
+		for (int i = 0; i < reg_count; i++) {
+			memAboutToChange(p, &accumulators[i]);
+			sqlite3VdbeMemMove(&saved[i], &accumulators[i]);
+		}
+	}
+	Mem *loaded = &groups->accumulators[group * reg_count];
+	for (int i = 0; i < reg_count; i++) {
+		memAboutToChange(p, &accumulators[i]);
+		sqlite3VdbeMemMove(&accumulators[i], &loaded[i]);
+	}
+	groups->current = group;
+	break;
+}
+
 /* Opcode: Expire P1 * * * *
  *
  * Cause precompiled statements to expire.  When an expired statement
@@ -5498,6 +5912,13 @@ abort_due_to_error:
 
 	/* This is the only way out of this procedure. */
 vdbe_return:
+	/*
+	 * Only the main program is profiled, and its counters are
+	 * restored by sqlite3VdbeHalt() when a trigger program
+	 * fails, while aOp may still point at the trigger program.
+	 */
+	if (p->anTime != NULL && iProfOp >= 0)
+		p->anTime[iProfOp] += clock_monotonic64() - profStart;
 	testcase( nVmStep>0);
 	p->aCounter[SQLITE_STMTSTATUS_VM_STEP] += (int)nVmStep;
 	assert(rc!=SQLITE_OK || nExtraDelete==0
@@ -203,6 +203,15 @@ sql_vdbe_prepare(struct Vdbe *vdbe);
 struct stailq *
 vdbe_autoinc_id_list(struct Vdbe *vdbe);
 
+/**
+ * Return the schema version the VDBE was compiled at.
+ *
+ * @param vdbe VDBE to get schema version of.
+ * @retval Schema version.
+ */
+uint32_t
+vdbe_schema_version(struct Vdbe *vdbe);
+
 int sqlite3VdbeAddOp0(Vdbe *, int);
 int sqlite3VdbeAddOp1(Vdbe *, int, int);
 int sqlite3VdbeAddOp2(Vdbe *, int, int, int);
@@ -347,10 +356,7 @@ void sqlite3VdbeSetLineNumber(Vdbe *, int);
 #define VDBE_OFFSET_LINENO(x) 0
 #endif
 
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-void sqlite3VdbeScanStatus(Vdbe *, int, int, int, LogEst, const char *);
-#else
-#define sqlite3VdbeScanStatus(a,b,c,d,e)
-#endif
+void sqlite3VdbeScanStatus(Vdbe *, int, int, int, LogEst, const char *,
+			   const char *);
 
 #endif				/* SQLITE_VDBE_H */
@@ -158,6 +158,7 @@ struct VdbeFrame {
 	VdbeFrame *pParent;	/* Parent of this frame, or NULL if parent is main */
 	Op *aOp;		/* Program instructions for parent frame */
 	i64 *anExec;		/* Event counters from parent frame */
+	u64 *anTime;		/* Op timers from parent frame */
 	Mem *aMem;		/* Array of memory cells for parent frame */
 	VdbeCursor **apCsr;	/* Array of Vdbe cursors for parent frame */
 	void *token;		/* Copy of SubProgram.token */
@@ -328,7 +329,8 @@ struct ScanStatus {
 	int addrVisit;		/* Address of "rows visited" counter */
 	int iSelectID;		/* The "Select-ID" for this loop */
 	LogEst nEst;		/* Estimated output rows per loop */
-	char *zName;		/* Name of table or index */
+	char *zName;		/* Name of table */
+	char *zIndex;		/* Name of index or NULL */
 };
 
 /*
@@ -420,11 +422,16 @@ struct Vdbe {
 	AuxData *pAuxData;	/* Linked list of auxdata allocations */
 	/* Anonymous savepoint for aborts only */
 	Savepoint *anonymous_savepoint;
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-	i64 *anExec;		/* Number of times each op has been executed */
+	/*
+	 * Number of times each op has been executed, or NULL
+	 * if the statement is not profiled, see
+	 * sql_stmt_profile_start().
+	 */
+	i64 *anExec;
+	/* Nanoseconds spent in each op, if profiled. */
+	u64 *anTime;
 	int nScan;		/* Entries in aScan[] */
-	ScanStatus *aScan;	/* Scan definitions for sqlite3_stmt_scanstatus() */
-#endif
+	ScanStatus *aScan;	/* Loops of the program, see sql_stmt_loop_stat() */
 };
 
 /*
@@ -501,6 +508,7 @@ void sqlite3VdbeSorterClose(sqlite3 *, VdbeCursor *);
 int sqlite3VdbeSorterRowkey(const VdbeCursor *, Mem *);
 int sqlite3VdbeSorterNext(sqlite3 *, const VdbeCursor *, int *);
 int sqlite3VdbeSorterRewind(const VdbeCursor *, int *);
+void sqlite3VdbeSorterMayYield(const VdbeCursor *);
 int sqlite3VdbeSorterWrite(const VdbeCursor *, Mem *);
 int sqlite3VdbeSorterCompare(const VdbeCursor *, Mem *, int, int *);
 
@@ -1637,76 +1637,72 @@ sqlite3_expanded_sql(sqlite3_stmt * pStmt)
 #endif
 }
 
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-/*
- * Return status data for a single loop within query pStmt.
- */
 int
-sqlite3_stmt_scanstatus(sqlite3_stmt * pStmt,	/* Prepared statement being queried */
-			int idx,	/* Index of loop to report on */
-			int iScanStatusOp,	/* Which metric to return */
-			void *pOut	/* OUT: Write the answer here */
-    )
-{
-	Vdbe *p = (Vdbe *) pStmt;
-	ScanStatus *pScan;
-	if (idx < 0 || idx >= p->nScan)
-		return 1;
-	pScan = &p->aScan[idx];
-	switch (iScanStatusOp) {
-	case SQLITE_SCANSTAT_NLOOP:{
-			*(sqlite3_int64 *) pOut = p->anExec[pScan->addrLoop];
-			break;
-		}
-	case SQLITE_SCANSTAT_NVISIT:{
-			*(sqlite3_int64 *) pOut = p->anExec[pScan->addrVisit];
-			break;
-		}
-	case SQLITE_SCANSTAT_EST:{
-			double r = 1.0;
-			LogEst x = pScan->nEst;
-			while (x < 100) {
-				x += 10;
-				r *= 0.5;
-			}
-			*(double *)pOut = r * sqlite3LogEstToInt(x);
-			break;
-		}
-	case SQLITE_SCANSTAT_NAME:{
-			*(const char **)pOut = pScan->zName;
-			break;
-		}
-	case SQLITE_SCANSTAT_EXPLAIN:{
-			if (pScan->addrExplain) {
-				*(const char **)pOut =
-				    p->aOp[pScan->addrExplain].p4.z;
-			} else {
-				*(const char **)pOut = 0;
-			}
-			break;
-		}
-	case SQLITE_SCANSTAT_SELECTID:{
-			if (pScan->addrExplain) {
-				*(int *)pOut = p->aOp[pScan->addrExplain].p1;
-			} else {
-				*(int *)pOut = -1;
-			}
-			break;
-		}
-	default:{
-			return 1;
+sql_stmt_profile_start(struct sqlite3_stmt *stmt)
+{
+	Vdbe *p = (Vdbe *) stmt;
+	size_t size = p->nOp * sizeof(i64);
+	if (p->anExec == NULL) {
+		p->anExec = sqlite3DbMallocRawNN(p->db, size);
+		p->anTime = sqlite3DbMallocRawNN(p->db, size);
+		if (p->anExec == NULL || p->anTime == NULL) {
+			sqlite3DbFree(p->db, p->anExec);
+			sqlite3DbFree(p->db, p->anTime);
+			p->anExec = NULL;
+			p->anTime = NULL;
+			diag_set(OutOfMemory, size, "sqlite3DbMallocRawNN",
+				 "anExec");
+			return -1;
 		}
 	}
+	memset(p->anExec, 0, size);
+	memset(p->anTime, 0, size);
 	return 0;
 }
 
-/*
- * Zero all counters associated with the sqlite3_stmt_scanstatus() data.
- */
+int
+sql_stmt_op_count(struct sqlite3_stmt *stmt)
+{
+	return ((Vdbe *) stmt)->nOp;
+}
+
 void
-sqlite3_stmt_scanstatus_reset(sqlite3_stmt * pStmt)
+sql_stmt_op_stat(struct sqlite3_stmt *stmt, int addr,
+		 struct sql_op_stat *stat)
 {
-	Vdbe *p = (Vdbe *) pStmt;
-	memset(p->anExec, 0, p->nOp * sizeof(i64));
+	Vdbe *p = (Vdbe *) stmt;
+	assert(addr >= 0 && addr < p->nOp);
+	Op *op = &p->aOp[addr];
+	stat->opcode = sqlite3OpcodeName(op->opcode);
+	stat->p1 = op->p1;
+	stat->p2 = op->p2;
+	stat->p3 = op->p3;
+	stat->exec_count = p->anExec != NULL ? p->anExec[addr] : 0;
+	stat->time = p->anTime != NULL ? p->anTime[addr] : 0;
+}
+
+int
+sql_stmt_loop_count(struct sqlite3_stmt *stmt)
+{
+	return ((Vdbe *) stmt)->nScan;
+}
+
+void
+sql_stmt_loop_stat(struct sqlite3_stmt *stmt, int idx,
+		   struct sql_loop_stat *stat)
+{
+	Vdbe *p = (Vdbe *) stmt;
+	assert(idx >= 0 && idx < p->nScan);
+	ScanStatus *scan = &p->aScan[idx];
+	stat->addr = scan->addrLoop;
+	stat->table = scan->zName;
+	stat->index = scan->zIndex;
+	stat->loop_count = 0;
+	stat->row_count = 0;
+	if (p->anExec != NULL) {
+		stat->loop_count = p->anExec[scan->addrLoop];
+		stat->row_count = p->anExec[scan->addrVisit];
+	}
+	stat->row_estimate = scan->nEst > 0 ?
+			     sqlite3LogEstToInt(scan->nEst) : 1;
 }
-#endif				/* SQLITE_ENABLE_STMT_SCANSTATUS */
@@ -746,9 +746,8 @@ sqlite3VdbeTakeOpArray(Vdbe * p, int *pnOp, int *pnMaxArg)
 	return aOp;
 }
 
-#if defined(SQLITE_ENABLE_STMT_SCANSTATUS)
 /*
- * Add an entry to the array of counters managed by sqlite3_stmt_scanstatus().
+ * Add an entry to the array of loops reported by sql_stmt_loop_stat().
  */
 void
 sqlite3VdbeScanStatus(Vdbe * p,			/* VM to add scanstatus() to */
@@ -756,7 +755,8 @@ sqlite3VdbeScanStatus(Vdbe * p,			/* VM to add scanstatus() to */
 		      int addrLoop,		/* Address of loop counter */
 		      int addrVisit,		/* Address of rows visited counter */
 		      LogEst nEst,		/* Estimated number of output rows */
-		      const char *zName)	/* Name of table or index being scanned */
+		      const char *zName,	/* Name of table being scanned */
+		      const char *zIndex)	/* Name of index or NULL */
 {
 	int nByte = (p->nScan + 1) * sizeof(ScanStatus);
 	ScanStatus *aNew;
@@ -768,10 +768,10 @@ sqlite3VdbeScanStatus(Vdbe * p,			/* VM to add scanstatus() to */
 		pNew->addrVisit = addrVisit;
 		pNew->nEst = nEst;
 		pNew->zName = sqlite3DbStrDup(p->db, zName);
+		pNew->zIndex = sqlite3DbStrDup(p->db, zIndex);
 		p->aScan = aNew;
 	}
 }
-#endif
 
 /*
  * Change the value of the opcode, or P1, P2, P3, or P5 operands
@@ -1948,9 +1948,6 @@ sqlite3VdbeMakeReady(Vdbe * p,	/* The VDBE */
 		p->apArg = allocSpace(&x, p->apArg, nArg * sizeof(Mem *));
 		p->apCsr =
 		    allocSpace(&x, p->apCsr, nCursor * sizeof(VdbeCursor *));
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-		p->anExec = allocSpace(&x, p->anExec, p->nOp * sizeof(i64));
-#endif
 		if (x.nNeeded == 0)
 			break;
 		x.pSpace = p->pFree = sqlite3DbMallocRawNN(db, x.nNeeded);
@@ -1971,9 +1968,6 @@ sqlite3VdbeMakeReady(Vdbe * p,	/* The VDBE */
 		p->nMem = nMem;
 		initMemArray(p->aMem, nMem, db, MEM_Undefined);
 		memset(p->apCsr, 0, nCursor * sizeof(VdbeCursor *));
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-		memset(p->anExec, 0, p->nOp * sizeof(i64));
-#endif
 	}
 	sqlite3VdbeRewind(p);
 }
@@ -2029,9 +2023,8 @@ sqlite3VdbeFrameRestore(VdbeFrame * pFrame)
 {
 	Vdbe *v = pFrame->v;
 	closeCursorsInFrame(v);
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 	v->anExec = pFrame->anExec;
-#endif
+	v->anTime = pFrame->anTime;
 	v->aOp = pFrame->aOp;
 	v->nOp = pFrame->nOp;
 	v->aMem = pFrame->aMem;
@@ -2741,15 +2734,13 @@ sqlite3VdbeClearObject(sqlite3 * db, Vdbe * p)
 	vdbeFreeOpArray(db, p->aOp, p->nOp);
 	sqlite3DbFree(db, p->aColName);
 	sqlite3DbFree(db, p->zSql);
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
-	{
-		int i;
-		for (i = 0; i < p->nScan; i++) {
-			sqlite3DbFree(db, p->aScan[i].zName);
-		}
-		sqlite3DbFree(db, p->aScan);
+	for (int i = 0; i < p->nScan; i++) {
+		sqlite3DbFree(db, p->aScan[i].zName);
+		sqlite3DbFree(db, p->aScan[i].zIndex);
 	}
-#endif
+	sqlite3DbFree(db, p->aScan);
+	sqlite3DbFree(db, p->anExec);
+	sqlite3DbFree(db, p->anTime);
 }
 
 /*
@@ -158,6 +158,11 @@
  */
 #include "sqliteInt.h"
 #include "vdbeInt.h"
+#include "box/sql.h"
+#include "box/txn.h"
+#include "coio_task.h"
+#include "coll.h"
+#include "fiber.h"
 
 /*
  * If SQLITE_DEBUG_SORTER_THREADS is defined, this module outputs various
@@ -175,6 +180,20 @@
  */
 #define SQLITE_MAX_PMASZ    (1<<29)
 
+/*
+ * Minimum size of an in-memory list of records, in bytes, which
+ * is sorted in a coio worker thread rather than in the TX thread.
+ * Smaller lists are sorted faster than a thread can be woken up.
+ */
+#define SORTER_OFFLOAD_SIZE (64 * 1024)
+
+/*
+ * Amount of memory a sorter may accumulate before it flushes
+ * a level 0 PMA to a temporary file. Set by box.cfg
+ * sql_sorter_memory, see sql_sorter_set_memory().
+ */
+static i64 sorter_memory = 2 * 1024 * 1024;
+
 /*
  * Private objects used by the sorter
  */
@@ -353,6 +372,7 @@ struct VdbeSorter {
 	u8 iPrev;		/* Previous thread used to flush PMA */
 	u8 nTask;		/* Size of aTask[] array */
 	u8 typeMask;
+	u8 bMayYield;		/* True if a sort may yield the fiber */
 	SortSubtask aTask[1];	/* One or more subtasks */
 };
 
@@ -899,9 +919,7 @@ sqlite3VdbeSorterInit(sqlite3 * db,	/* Database connection (for malloc()) */
 			u32 szPma = sqlite3GlobalConfig.szPma;
 			pSorter->mnPmaSize = szPma * pgsz;
 
-			mxCache = SQLITE_DEFAULT_CACHE_SIZE;
-			mxCache = mxCache * -1024;
-			mxCache = MIN(mxCache, SQLITE_MAX_PMASZ);
+			mxCache = MIN(sorter_memory, SQLITE_MAX_PMASZ);
 			pSorter->mxPmaSize =
 			    MAX(pSorter->mnPmaSize, (int)mxCache);
 
@@ -1182,6 +1200,7 @@ sqlite3VdbeSorterReset(sqlite3 * db, VdbeSorter * pSorter)
 	pSorter->list.pList = 0;
 	pSorter->list.szPMA = 0;
 	pSorter->bUsePMA = 0;
+	pSorter->bMayYield = 0;
 	pSorter->iMemory = 0;
 	pSorter->mxKeysize = 0;
 	sqlite3DbFree(db, pSorter->pUnpacked);
@@ -1334,30 +1353,17 @@ vdbeSorterGetCompare(VdbeSorter * p)
 }
 
 /*
- * Sort the linked list of records headed at pTask->pList. Return
- * SQLITE_OK if successful, or an SQLite error code (i.e. SQLITE_NOMEM) if
- * an error occurs.
+ * Merge sort the linked list of records headed at pList->pList
+ * using 64 slots of aSlot as temporary storage. Neither allocates
+ * memory nor touches any global state, so may be run in any
+ * thread.
  */
-static int
-vdbeSorterSort(SortSubtask * pTask, SorterList * pList)
+static void
+vdbeSorterSortList(SortSubtask * pTask, SorterList * pList,
+		   SorterRecord ** aSlot)
 {
 	int i;
-	SorterRecord **aSlot;
-	SorterRecord *p;
-	int rc;
-
-	rc = vdbeSortAllocUnpacked(pTask);
-	if (rc != SQLITE_OK)
-		return rc;
-
-	p = pList->pList;
-	pTask->xCompare = vdbeSorterGetCompare(pTask->pSorter);
-
-	aSlot =
-	    (SorterRecord **) sqlite3MallocZero(64 * sizeof(SorterRecord *));
-	if (!aSlot) {
-		return SQLITE_NOMEM_BKPT;
-	}
+	SorterRecord *p = pList->pList;
 
 	while (p) {
 		SorterRecord *pNext;
@@ -1391,6 +1397,81 @@ vdbeSorterSort(SortSubtask * pTask, SorterList * pList)
 		p = p ? vdbeSorterMerge(pTask, p, aSlot[i]) : aSlot[i];
 	}
 	pList->pList = p;
+}
+
+static ssize_t
+vdbeSorterSortList_f(va_list ap)
+{
+	SortSubtask *pTask = va_arg(ap, SortSubtask *);
+	SorterList *pList = va_arg(ap, SorterList *);
+	SorterRecord **aSlot = va_arg(ap, SorterRecord **);
+	vdbeSorterSortList(pTask, pList, aSlot);
+	return 0;
+}
+
+/*
+ * Sort the list in a coio worker thread, so that other fibers
+ * can run meanwhile. Return false if the list must be sorted
+ * in place: it is too small to be worth a thread switch, or the
+ * current fiber may not yield. A yield aborts an active memtx
+ * transaction, and it is only allowed once the statement has
+ * released its space cursors, see sqlite3VdbeSorterMayYield().
+ * A run flushed in the middle of a scan is always sorted in
+ * place.
+ */
+static bool
+vdbeSorterSortListInPool(SortSubtask * pTask, SorterList * pList,
+			 SorterRecord ** aSlot)
+{
+	if (pList->szPMA < SORTER_OFFLOAD_SIZE || !cord_is_main() ||
+	    !pTask->pSorter->bMayYield || in_txn() != NULL)
+		return false;
+	/*
+	 * A collation can be dropped while the fiber is waiting
+	 * for the worker, keep it alive until the sort is done.
+	 */
+	struct key_def *def = pTask->pSorter->key_def;
+	for (uint32_t i = 0; i < def->part_count; i++) {
+		if (def->parts[i].coll != NULL)
+			coll_ref(def->parts[i].coll);
+	}
+	ssize_t rc = coio_call(vdbeSorterSortList_f, pTask, pList, aSlot);
+	for (uint32_t i = 0; i < def->part_count; i++) {
+		if (def->parts[i].coll != NULL)
+			coll_unref(def->parts[i].coll);
+	}
+	/*
+	 * coio_call() fails only if it can't create a task, in
+	 * which case the list is left intact.
+	 */
+	return rc == 0;
+}
+
+/*
+ * Sort the linked list of records headed at pTask->pList. Return
+ * SQLITE_OK if successful, or an SQLite error code (i.e. SQLITE_NOMEM) if
+ * an error occurs.
+ */
+static int
+vdbeSorterSort(SortSubtask * pTask, SorterList * pList)
+{
+	SorterRecord **aSlot;
+	int rc;
+
+	rc = vdbeSortAllocUnpacked(pTask);
+	if (rc != SQLITE_OK)
+		return rc;
+
+	pTask->xCompare = vdbeSorterGetCompare(pTask->pSorter);
+
+	aSlot =
+	    (SorterRecord **) sqlite3MallocZero(64 * sizeof(SorterRecord *));
+	if (!aSlot) {
+		return SQLITE_NOMEM_BKPT;
+	}
+
+	if (!vdbeSorterSortListInPool(pTask, pList, aSlot))
+		vdbeSorterSortList(pTask, pList, aSlot);
 
 	sqlite3_free(aSlot);
 	assert(pTask->pUnpacked->errCode == SQLITE_OK
@@ -1398,6 +1479,12 @@ vdbeSorterSort(SortSubtask * pTask, SorterList * pList)
 	return pTask->pUnpacked->errCode;
 }
 
+void
+sql_sorter_set_memory(int64_t size)
+{
+	sorter_memory = size;
+}
+
 /*
  * Initialize a PMA-writer object.
  */
@@ -2638,6 +2725,19 @@ vdbeSorterSetupMerge(VdbeSorter * pSorter)
 	return rc;
 }
 
+/*
+ * Allow the sorter to yield the fiber while it sorts the runs
+ * of the following sqlite3VdbeSorterRewind(). The caller must
+ * not hold cursors on spaces, since a concurrent DML or DDL can
+ * change or drop the space during the yield.
+ */
+void
+sqlite3VdbeSorterMayYield(const VdbeCursor * pCsr)
+{
+	assert(pCsr->eCurType == CURTYPE_SORTER);
+	pCsr->uc.pSorter->bMayYield = 1;
+}
+
 /*
  * Once the sorter has been populated by calls to sqlite3VdbeSorterWrite,
  * this function is called to prepare for iterating through the records
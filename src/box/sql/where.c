@@ -701,7 +701,7 @@ termCanDriveIndex(WhereTerm * pTerm,	/* WHERE clause term to check */
 		return 0;
 	if (pTerm->u.leftColumn < 0)
 		return 0;
-	aff = pSrc->pTab->aCol[pTerm->u.leftColumn].affinity;
+	aff = pSrc->pTab->def->fields[pTerm->u.leftColumn].affinity;
 	if (!sqlite3IndexAffinityOk(pTerm->pExpr, aff))
 		return 0;
 	return 1;
@@ -709,193 +709,153 @@ termCanDriveIndex(WhereTerm * pTerm,	/* WHERE clause term to check */
 #endif
 
 #ifndef SQLITE_OMIT_AUTOMATIC_INDEX
-/*
- * Generate code to construct the Index object for an automatic index
- * and to set up the WhereLevel object pLevel so that the code generator
- * makes use of the automatic index.
+void
+where_emit_auto_index_row(struct Parse *parse, struct WhereLevel *level,
+			  struct SrcList_item *src)
+{
+	struct Vdbe *v = parse->pVdbe;
+	struct WhereLoop *loop = level->pWLoop;
+	struct space_def *def = src->pTab->def;
+	int key_count = loop->nEq;
+	uint32_t field_count = key_count + def->field_count + 1;
+	int reg_base = sqlite3GetTempRange(parse, field_count);
+	int reg_record = sqlite3GetTempReg(parse);
+	for (uint32_t i = 0; i < def->field_count; i++) {
+		int reg = reg_base + key_count + i;
+		Bitmask mask = i >= BMS ? MASKBIT(BMS - 1) : MASKBIT(i);
+		if ((src->colUsed & mask) != 0)
+			sqlite3VdbeAddOp3(v, OP_Column, level->iTabCur, i, reg);
+		else
+			sqlite3VdbeAddOp2(v, OP_Null, 0, reg);
+	}
+	for (int i = 0; i < key_count; i++) {
+		int column = loop->aLTerm[i]->u.leftColumn;
+		sqlite3VdbeAddOp2(v, OP_SCopy, reg_base + key_count + column,
+				  reg_base + i);
+	}
+	sqlite3VdbeAddOp2(v, OP_Sequence, level->iIdxCur,
+			  reg_base + field_count - 1);
+	sqlite3VdbeAddOp3(v, OP_MakeRecord, reg_base, field_count,
+			  reg_record);
+	sqlite3VdbeAddOp2(v, OP_IdxInsert, reg_record, level->regAutoIdx);
+	sqlite3ReleaseTempReg(parse, reg_record);
+	sqlite3ReleaseTempRange(parse, reg_base, field_count);
+}
+
+/**
+ * Generate code to build an automatic index for an equi-join on
+ * columns of @a src which have no usable index, and set up
+ * @a level to look rows up in it.
+ *
+ * The index is an ephemeral space filled with the rows of the
+ * table once, on the first iteration of the outer loops. Each
+ * stored tuple is
+ *
+ *     [key column 1, ..., key column N, table columns..., seq]
+ *
+ * so the ephemeral primary key, which covers fields in order,
+ * is ordered by the join key first. The sequence number keeps
+ * duplicate rows apart. Columns the query doesn't use are
+ * stored as NULLs. The loop body reads the index cursor only:
+ * sqlite3WhereEnd() redirects its column reads to the index
+ * cursor, shifted by N.
+ *
+ * So instead of a full scan of the table per row of the outer
+ * loops, the join costs one scan plus a lookup per outer row.
+ *
+ * The index holds at most PRAGMA sql_automatic_index_limit
+ * rows. If the table has more, the index is emptied and a flag
+ * register is set, and the loop falls back to a nested loop
+ * scan of the table: see sqlite3WhereCodeOneLoopStart().
+ *
+ * @param parse Parsing context.
+ * @param wc The WHERE clause.
+ * @param src The FROM clause term to build the index for.
+ * @param not_ready Mask of cursors that are not available.
+ * @param level The loop to make use of the index.
  */
 static void
-constructAutomaticIndex(Parse * pParse,			/* The parsing context */
-			WhereClause * pWC,		/* The WHERE clause */
-			struct SrcList_item *pSrc,	/* The FROM clause term to get the next index */
-			Bitmask notReady,		/* Mask of cursors that are not available */
-			WhereLevel * pLevel)		/* Write new index here */
+where_emit_auto_index(struct Parse *parse, struct WhereClause *wc,
+		      struct SrcList_item *src, Bitmask not_ready,
+		      struct WhereLevel *level)
 {
-	int nKeyCol;		/* Number of columns in the constructed index */
-	WhereTerm *pTerm;	/* A single term of the WHERE clause */
-	WhereTerm *pWCEnd;	/* End of pWC->a[] */
-	Index *pIdx;		/* Object describing the transient index */
-	Vdbe *v;		/* Prepared statement under construction */
-	int addrInit;		/* Address of the initialization bypass jump */
-	Table *pTable;		/* The table being indexed */
-	int addrTop;		/* Top of the index fill loop */
-	int regRecord;		/* Register holding an index record */
-	int n;			/* Column counter */
-	int i;			/* Loop counter */
-	int mxBitCol;		/* Maximum column in pSrc->colUsed */
-	struct coll *pColl;		/* Collating sequence to on a column */
-	WhereLoop *pLoop;	/* The Loop object */
-	char *zNotUsed;		/* Extra space on the end of pIdx */
-	Bitmask idxCols;	/* Bitmap of columns used for indexing */
-	Bitmask extraCols;	/* Bitmap of additional columns */
-	u8 sentWarning = 0;	/* True if a warnning has been issued */
-	int iContinue = 0;	/* Jump here to skip excluded rows */
-	struct SrcList_item *pTabItem;	/* FROM clause term being indexed */
-	int addrCounter = 0;	/* Address where integer counter is initialized */
-	int regBase;		/* Array of registers where record is assembled */
-
-	/* Generate code to skip over the creation and initialization of the
-	 * transient index on 2nd and subsequent iterations of the loop.
-	 */
-	v = pParse->pVdbe;
-	assert(v != 0);
-	addrInit = sqlite3VdbeAddOp0(v, OP_Once);
-	VdbeCoverage(v);
-
-	/* Count the number of columns that will be added to the index
-	 * and used to match WHERE clause constraints
+	struct Vdbe *v = parse->pVdbe;
+	assert(v != NULL);
+	struct WhereLoop *loop = level->pWLoop;
+	struct space_def *def = src->pTab->def;
+	/*
+	 * Use all the equality terms available at this level,
+	 * not only the one the planner has costed the loop by.
 	 */
-	nKeyCol = 0;
-	pTable = pSrc->pTab;
-	pWCEnd = &pWC->a[pWC->nTerm];
-	pLoop = pLevel->pWLoop;
-	idxCols = 0;
-	for (pTerm = pWC->a; pTerm < pWCEnd; pTerm++) {
-		if (termCanDriveIndex(pTerm, pSrc, notReady)) {
-			int iCol = pTerm->u.leftColumn;
-			Bitmask cMask =
-			    iCol >= BMS ? MASKBIT(BMS - 1) : MASKBIT(iCol);
-			testcase(iCol == BMS);
-			testcase(iCol == BMS - 1);
-			if (!sentWarning) {
-				sqlite3_log(SQLITE_WARNING_AUTOINDEX,
-					    "automatic index on %s(%s)",
-					    pTable->def->name,
-					    pTable->aCol[iCol].zName);
-				sentWarning = 1;
-			}
-			if ((idxCols & cMask) == 0) {
-				if (whereLoopResize
-				    (pParse->db, pLoop, nKeyCol + 1)) {
-					goto end_auto_index_create;
-				}
-				pLoop->aLTerm[nKeyCol++] = pTerm;
-				idxCols |= cMask;
-			}
+	int key_count = 0;
+	struct WhereTerm *term_end = &wc->a[wc->nTerm];
+	for (struct WhereTerm *term = wc->a; term < term_end; term++) {
+		if (!termCanDriveIndex(term, src, not_ready))
+			continue;
+		int i;
+		for (i = 0; i < key_count; i++) {
+			if (loop->aLTerm[i]->u.leftColumn ==
+			    term->u.leftColumn)
+				break;
 		}
+		if (i < key_count)
+			continue;
+		if (whereLoopResize(parse->db, loop, key_count + 1) != 0)
+			return;
+		loop->aLTerm[key_count++] = term;
 	}
-	assert(nKeyCol > 0);
-	pLoop->nEq = pLoop->nLTerm = nKeyCol;
-	pLoop->wsFlags = WHERE_COLUMN_EQ | WHERE_IDX_ONLY | WHERE_INDEXED
-	    | WHERE_AUTO_INDEX;
-
-	/* Count the number of additional columns needed to create a
-	 * covering index.  A "covering index" is an index that contains all
-	 * columns that are needed by the query.  With a covering index, the
-	 * original table never needs to be accessed.  Automatic indices must
-	 * be a covering index because the index will not be updated if the
-	 * original table changes and the index and table cannot both be used
-	 * if they go out of sync.
-	 */
-	extraCols = pSrc->colUsed & (~idxCols | MASKBIT(BMS - 1));
-	mxBitCol = MIN(BMS - 1, pTable->def->field_count);
-	testcase(pTable->def->field_count == BMS - 1);
-	testcase(pTable->def->field_count == BMS - 2);
-	for (i = 0; i < mxBitCol; i++) {
-		if (extraCols & MASKBIT(i))
-			nKeyCol++;
-	}
-	if (pSrc->colUsed & MASKBIT(BMS - 1)) {
-		nKeyCol += pTable->def->field_count - BMS + 1;
-	}
+	assert(key_count > 0);
+	loop->nEq = loop->nLTerm = key_count;
+	loop->nSkip = 0;
 
-	/* Construct the Index object to describe this index */
-	pIdx = sqlite3DbMallocZero(pParse->db, sizeof(*pIdx));
-	if (pIdx == 0)
-		goto end_auto_index_create;
-	pLoop->pIndex = pIdx;
-	pIdx->zName = "auto-index";
-	pIdx->pTable = pTable;
-	n = 0;
-	idxCols = 0;
-	for (pTerm = pWC->a; pTerm < pWCEnd; pTerm++) {
-		if (termCanDriveIndex(pTerm, pSrc, notReady)) {
-			int iCol = pTerm->u.leftColumn;
-			Bitmask cMask =
-			    iCol >= BMS ? MASKBIT(BMS - 1) : MASKBIT(iCol);
-			testcase(iCol == BMS - 1);
-			testcase(iCol == BMS);
-			if ((idxCols & cMask) == 0) {
-				Expr *pX = pTerm->pExpr;
-				idxCols |= cMask;
-				pIdx->aiColumn[n] = pTerm->u.leftColumn;
-				n++;
-			}
-		}
+	struct sql_key_info *key_info =
+		sql_key_info_new(parse->db, key_count);
+	if (key_info == NULL)
+		return;
+	for (int i = 0; i < key_count; i++) {
+		struct Expr *expr = loop->aLTerm[i]->pExpr;
+		sql_binary_compare_coll_seq(parse, expr->pLeft, expr->pRight,
+					    &key_info->parts[i].coll_id);
 	}
-	assert((u32) n == pLoop->nEq);
 
-	/* Add additional columns needed to make the automatic index into
-	 * a covering index
-	 */
-	for (i = 0; i < mxBitCol; i++) {
-		if (extraCols & MASKBIT(i)) {
-			pIdx->aiColumn[n] = i;
-			n++;
-		}
-	}
-	if (pSrc->colUsed & MASKBIT(BMS - 1)) {
-		for (i = BMS - 1; i < (int)pTable->def->field_count; i++) {
-			pIdx->aiColumn[n] = i;
-			n++;
-		}
-	}
-	assert(n == nKeyCol);
-	pIdx->aiColumn[n] = XN_ROWID;
-
-	/* Create the automatic index */
-	assert(pLevel->iIdxCur >= 0);
-	pLevel->iIdxCur = pParse->nTab++;
-	sqlite3VdbeAddOp2(v, OP_OpenAutoindex, pLevel->iIdxCur, nKeyCol + 1);
-	sql_vdbe_set_p4_key_def(pParse, pIdx->key_def);
-	VdbeComment((v, "for %s", pTable->def->name));
-
-	/* Fill the automatic index with content */
-	sqlite3ExprCachePush(pParse);
-	pTabItem = &pWC->pWInfo->pTabList->a[pLevel->iFrom];
-	if (pTabItem->fg.viaCoroutine) {
-		int regYield = pTabItem->regReturn;
-		addrCounter = sqlite3VdbeAddOp2(v, OP_Integer, 0, 0);
-		sqlite3VdbeAddOp3(v, OP_InitCoroutine, regYield, 0,
-				  pTabItem->addrFillSub);
-		addrTop = sqlite3VdbeAddOp1(v, OP_Yield, regYield);
-		VdbeCoverage(v);
-		VdbeComment((v, "next row of \"%s\"", pTabItem->pTab->zName));
-	} else {
-		addrTop = sqlite3VdbeAddOp1(v, OP_Rewind, pLevel->iTabCur);
-		VdbeCoverage(v);
-	}
-	regRecord = sqlite3GetTempReg(pParse);
-	regBase = sql_generate_index_key(pParse, pIdx, pLevel->iTabCur,
-					 regRecord, NULL, 0);
-	sqlite3VdbeAddOp2(v, OP_IdxInsert, pLevel->iIdxCur, regRecord);
-	if (pTabItem->fg.viaCoroutine) {
-		sqlite3VdbeChangeP2(v, addrCounter, regBase + n);
-		translateColumnToCopy(v, addrTop, pLevel->iTabCur,
-				      pTabItem->regResult, 1);
-		sqlite3VdbeGoto(v, addrTop);
-		pTabItem->fg.viaCoroutine = 0;
-	} else {
-		sqlite3VdbeAddOp2(v, OP_Next, pLevel->iTabCur, addrTop + 1);
-		VdbeCoverage(v);
-	}
+	/* Build the index only once per statement execution. */
+	int addr_once = sqlite3VdbeAddOp0(v, OP_Once);
+	VdbeCoverage(v);
+	uint32_t field_count = key_count + def->field_count + 1;
+	level->regAutoIdx = ++parse->nMem;
+	level->regAutoIdxOver = ++parse->nMem;
+	sqlite3VdbeAddOp4(v, OP_OpenTEphemeral, level->regAutoIdx,
+			  field_count, 0, (char *) key_info, P4_KEYINFO);
+	VdbeComment((v, "automatic index on %s", def->name));
+	level->iIdxCur = parse->nTab++;
+	sqlite3VdbeAddOp3(v, OP_IteratorOpen, level->iIdxCur, 0,
+			  level->regAutoIdx);
+	sqlite3VdbeChangeP5(v, OPFLAG_SEEKEQ);
+
+	int reg_budget = ++parse->nMem;
+	sqlite3VdbeAddOp2(v, OP_Integer, 0, level->regAutoIdxOver);
+	sqlite3VdbeAddOp2(v, OP_Integer,
+			  parse->db->aLimit[SQL_LIMIT_AUTO_INDEX_ROWS],
+			  reg_budget);
+	sqlite3ExprCachePush(parse);
+	int addr_top = sqlite3VdbeAddOp1(v, OP_Rewind, level->iTabCur);
+	VdbeCoverage(v);
+	int addr_fill = sqlite3VdbeAddOp3(v, OP_IfPos, reg_budget, 0, 1);
+	VdbeCoverage(v);
+	/* The table is too big: drop the index built so far. */
+	sqlite3VdbeAddOp1(v, OP_ResetSorter, level->iIdxCur);
+	sqlite3VdbeAddOp2(v, OP_Integer, 1, level->regAutoIdxOver);
+	int addr_over = sqlite3VdbeAddOp0(v, OP_Goto);
+	sqlite3VdbeJumpHere(v, addr_fill);
+	where_emit_auto_index_row(parse, level, src);
+	sqlite3VdbeAddOp2(v, OP_Next, level->iTabCur, addr_top + 1);
+	VdbeCoverage(v);
 	sqlite3VdbeChangeP5(v, SQLITE_STMTSTATUS_AUTOINDEX);
-	sqlite3VdbeJumpHere(v, addrTop);
-	sqlite3ReleaseTempReg(pParse, regRecord);
-	sqlite3ExprCachePop(pParse);
+	sqlite3VdbeJumpHere(v, addr_top);
+	sqlite3VdbeJumpHere(v, addr_over);
+	sqlite3ExprCachePop(parse);
 
-	/* Jump here when skipping the initialization */
-	sqlite3VdbeJumpHere(v, addrInit);
+	sqlite3VdbeJumpHere(v, addr_once);
 }
 #endif				/* SQLITE_OMIT_AUTOMATIC_INDEX */
 
@@ -1741,7 +1701,7 @@ whereLoopInit(WhereLoop * p)
 static void
 whereLoopClearUnion(WhereLoop * p)
 {
-	if ((p->wsFlags & WHERE_AUTO_INDEX) != 0) {
+	if ((p->wsFlags & WHERE_AUTO_INDEX) != 0 && p->index_def != NULL) {
 		index_def_delete(p->index_def);
 		p->index_def = NULL;
 	}
@@ -2842,15 +2802,28 @@ tnt_error:
 	}
 
 #ifndef SQLITE_OMIT_AUTOMATIC_INDEX
-	/* Automatic indexes */
-	LogEst rSize = pTab->nRowLogEst;
+	/*
+	 * Automatic indexes. Only persistent spaces with a
+	 * format are considered: the index is filled by a scan
+	 * of the table cursor, which is not opened for views
+	 * and subqueries.
+	 */
+	rSize = sql_space_tuple_log_count(pTab);
 	LogEst rLogSize = estLog(rSize);
 	struct session *user_session = current_session();
+	int auto_index_limit =
+		pWInfo->pParse->db->aLimit[SQL_LIMIT_AUTO_INDEX_ROWS];
 	if (!pBuilder->pOrSet	/* Not part of an OR optimization */
-	    && (pWInfo->wctrlFlags & WHERE_OR_SUBCLAUSE) == 0 && (user_session->sql_flags & SQLITE_AutoIndex) != 0 && pSrc->pIBIndex == 0	/* Has no INDEXED BY clause */
+	    && (pWInfo->wctrlFlags & WHERE_OR_SUBCLAUSE) == 0
+	    && (user_session->sql_flags & SQLITE_AutoIndex) != 0
+	    /* The table fits into the automatic index. */
+	    && rSize <= sqlite3LogEst(auto_index_limit)
+	    && pSrc->pIBIndex == 0	/* Has no INDEXED BY clause */
 	    && !pSrc->fg.notIndexed	/* Has no NOT INDEXED clause */
-	    && HasRowid(pTab)	/* Not WITHOUT ROWID table. (FIXME: Why not?) */
-	    &&!pSrc->fg.isCorrelated	/* Not a correlated subquery */
+	    && pTab->def->id != 0 && !pTab->def->opts.is_view
+	    && pTab->def->field_count > 0
+	    && !pSrc->fg.viaCoroutine
+	    && !pSrc->fg.isCorrelated	/* Not a correlated subquery */
 	    && !pSrc->fg.isRecursive	/* Not a recursive common table expression. */
 	    ) {
 		/* Generate auto-index WhereLoops */
@@ -2862,22 +2835,14 @@ tnt_error:
 			if (termCanDriveIndex(pTerm, pSrc, 0)) {
 				pNew->nEq = 1;
 				pNew->nSkip = 0;
-				pNew->pIndex = 0;
+				pNew->index_def = NULL;
 				pNew->nLTerm = 1;
 				pNew->aLTerm[0] = pTerm;
 				/* TUNING: One-time cost for computing the automatic index is
 				 * estimated to be X*N*log2(N) where N is the number of rows in
-				 * the table being indexed and where X is 7 (LogEst=28) for normal
-				 * tables or 1.375 (LogEst=4) for views and subqueries.  The value
-				 * of X is smaller for views and subqueries so that the query planner
-				 * will be more aggressive about generating automatic indexes for
-				 * those objects, since there is no opportunity to add schema
-				 * indexes on subqueries and views.
+				 * the table being indexed and where X is 7 (LogEst=28).
 				 */
-				pNew->rSetup = rLogSize + rSize + 4;
-				if (!pTab->def->opts.is_view &&
-				    pTab->def->id == 0)
-					pNew->rSetup += 24;
+				pNew->rSetup = rLogSize + rSize + 4 + 24;
 				if (pNew->rSetup < 0)
 					pNew->rSetup = 0;
 				/* TUNING: Each index lookup yields 20 rows in the table.  This
@@ -4700,9 +4665,9 @@ sqlite3WhereBegin(Parse * pParse,	/* The parser context */
 		wsFlags = pLevel->pWLoop->wsFlags;
 #ifndef SQLITE_OMIT_AUTOMATIC_INDEX
 		if ((pLevel->pWLoop->wsFlags & WHERE_AUTO_INDEX) != 0) {
-			constructAutomaticIndex(pParse, &pWInfo->sWC,
-						&pTabList->a[pLevel->iFrom],
-						notReady, pLevel);
+			where_emit_auto_index(pParse, &pWInfo->sWC,
+					      &pTabList->a[pLevel->iFrom],
+					      notReady, pLevel);
 			if (db->mallocFailed)
 				goto whereBeginError;
 		}
@@ -4713,7 +4678,7 @@ sqlite3WhereBegin(Parse * pParse,	/* The parser context */
 		pLevel->addrBody = sqlite3VdbeCurrentAddr(v);
 		notReady = sqlite3WhereCodeOneLoopStart(pWInfo, ii, notReady);
 		pWInfo->iContinue = pLevel->addrCont;
-		if ((wsFlags & WHERE_MULTI_OR) == 0
+		if (pParse->is_profiled && (wsFlags & WHERE_MULTI_OR) == 0
 		    && (wctrlFlags & WHERE_OR_SUBCLAUSE) == 0) {
 			sqlite3WhereAddScanStatus(v, pTabList, pLevel,
 						  addrExplain);
@@ -4810,7 +4775,7 @@ sqlite3WhereEnd(WhereInfo * pWInfo)
 				sqlite3VdbeAddOp1(v, OP_NullRow,
 						  pTabList->a[i].iCursor);
 			}
-			if ((ws & WHERE_INDEXED)
+			if ((ws & (WHERE_INDEXED | WHERE_AUTO_INDEX))
 			    || ((ws & WHERE_MULTI_OR) && pLevel->u.pCovidx)
 			    ) {
 				sqlite3VdbeAddOp1(v, OP_NullRow,
@@ -4853,6 +4818,28 @@ sqlite3WhereEnd(WhereInfo * pWInfo)
 			continue;
 		}
 
+		/* An automatic index stores the key columns ahead of
+		 * the table columns, see where_emit_auto_index().
+		 */
+		if ((pLoop->wsFlags & WHERE_AUTO_INDEX) != 0 &&
+		    !db->mallocFailed) {
+			last = sqlite3VdbeCurrentAddr(v);
+			/*
+			 * The loop start reads the table cursor to
+			 * fill the index, leave it alone.
+			 */
+			k = pLevel->addrVisit;
+			pOp = sqlite3VdbeGetOp(v, k);
+			for (; k < last; k++, pOp++) {
+				if (pOp->p1 == pLevel->iTabCur &&
+				    pOp->opcode == OP_Column) {
+					pOp->p1 = pLevel->iIdxCur;
+					pOp->p2 += pLoop->nEq;
+				}
+			}
+			continue;
+		}
+
 		/* If this scan uses an index, make VDBE code substitutions to read data
 		 * from the index instead of from the table where possible.  In some cases
 		 * this optimization prevents the table from ever being read, which can
@@ -106,9 +106,9 @@ struct WhereLevel {
 	} u;
 	struct WhereLoop *pWLoop;	/* The selected WhereLoop object */
 	Bitmask notReady;	/* FROM entries not usable at this level */
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 	int addrVisit;		/* Address at which row is visited */
-#endif
+	int regAutoIdx;		/* Ephemeral space of an automatic index */
+	int regAutoIdxOver;	/* True if the table didn't fit the index */
 };
 
 /*
@@ -452,6 +452,19 @@ WhereTerm *sqlite3WhereFindTerm(WhereClause * pWC,	/* The WHERE clause to be sea
 				Bitmask notReady,	/* RHS must not overlap with this mask */
 				u32 op,	/* Mask of WO_xx values describing operator */
 				struct index_def *idx_def);
+#ifndef SQLITE_OMIT_AUTOMATIC_INDEX
+/**
+ * Generate code to put the current row of the table cursor of
+ * @a level into its automatic index.
+ *
+ * @param parse Parsing context.
+ * @param level The loop which uses an automatic index.
+ * @param src The FROM clause term of the loop.
+ */
+void
+where_emit_auto_index_row(struct Parse *parse, struct WhereLevel *level,
+			  struct SrcList_item *src);
+#endif
 
 /* wherecode.c: */
 int sqlite3WhereExplainOneScan(Parse * pParse,	/* Parse context */
@@ -461,15 +474,11 @@ int sqlite3WhereExplainOneScan(Parse * pParse,	/* Parse context */
 			       int iFrom,	/* Value for "from" column of output */
 			       u16 wctrlFlags	/* Flags passed to sqlite3WhereBegin() */
     );
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 void sqlite3WhereAddScanStatus(Vdbe * v,	/* Vdbe to add scanstatus entry to */
 			       SrcList * pSrclist,	/* FROM clause pLvl reads data from */
 			       WhereLevel * pLvl,	/* Level to add scanstatus() entry for */
 			       int addrExplain	/* Address of OP_Explain (or 0) */
     );
-#else
-#define sqlite3WhereAddScanStatus(a, b, c, d) ((void)d)
-#endif
 Bitmask sqlite3WhereCodeOneLoopStart(WhereInfo * pWInfo,	/* Complete information about the WHERE clause */
 				     int iLevel,	/* Which level of pWInfo->a[] should be coded */
 				     Bitmask notReady	/* Which tables are currently available */
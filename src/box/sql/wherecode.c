@@ -38,8 +38,11 @@
  * that actually generate the bulk of the WHERE loop code.  The original where.c
  * file retains the code that does query planning and analysis.
  */
+#include "box/coll_id.h"
 #include "box/schema.h"
+#include "msgpuck/msgpuck.h"
 #include "sqliteInt.h"
+#include "vdbeInt.h"
 #include "whereInt.h"
 
 /*
@@ -158,9 +161,9 @@ explainIndexRange(StrAccum * pStr, WhereLoop * pLoop)
 
 /*
  * This function is a no-op unless currently processing an EXPLAIN QUERY PLAN
- * command, or if either SQLITE_DEBUG or SQLITE_ENABLE_STMT_SCANSTATUS was
- * defined at compile-time. If it is not a no-op, a single OP_Explain opcode
- * is added to the output to describe the table scan strategy in pLevel.
+ * command, or if SQLITE_DEBUG was defined at compile-time. If it is not a
+ * no-op, a single OP_Explain opcode is added to the output to describe the
+ * table scan strategy in pLevel.
  *
  * If an OP_Explain opcode is added to the VM, its address is returned.
  * Otherwise, if no OP_Explain is coded, zero is returned.
@@ -174,7 +177,7 @@ sqlite3WhereExplainOneScan(Parse * pParse,	/* Parse context */
 			   u16 wctrlFlags)	/* Flags passed to sqlite3WhereBegin() */
 {
 	int ret = 0;
-#if !defined(SQLITE_DEBUG) && !defined(SQLITE_ENABLE_STMT_SCANSTATUS)
+#ifndef SQLITE_DEBUG
 	if (pParse->explain == 2)
 #endif
 	{
@@ -211,20 +214,28 @@ sqlite3WhereExplainOneScan(Parse * pParse,	/* Parse context */
 		if (pItem->zAlias) {
 			sqlite3XPrintf(&str, " AS %s", pItem->zAlias);
 		}
-		if ((flags & WHERE_IPK) == 0) {
+		if ((flags & WHERE_AUTO_INDEX) != 0) {
+			struct space_def *def = pItem->pTab->def;
+			sqlite3StrAccumAppendAll(&str,
+						 " USING AUTOMATIC INDEX (");
+			for (int i = 0; i < pLoop->nEq; i++) {
+				int column = pLoop->aLTerm[i]->u.leftColumn;
+				if (i > 0)
+					sqlite3StrAccumAppend(&str, " AND ", 5);
+				sqlite3XPrintf(&str, "%s=?",
+					       def->fields[column].name);
+			}
+			sqlite3StrAccumAppend(&str, ")", 1);
+		} else if ((flags & WHERE_IPK) == 0) {
 			const char *zFmt = 0;
 			struct index_def *idx_def = pLoop->index_def;
 			if (idx_def == NULL)
 				return 0;
 
-			assert(!(flags & WHERE_AUTO_INDEX)
-			       || (flags & WHERE_IDX_ONLY));
 			if (idx_def->iid == 0) {
 				if (isSearch) {
 					zFmt = "PRIMARY KEY";
 				}
-			} else if (flags & WHERE_AUTO_INDEX) {
-				zFmt = "AUTOMATIC COVERING INDEX";
 			} else if (flags & WHERE_IDX_ONLY) {
 				zFmt = "COVERING INDEX %s";
 			} else {
@@ -269,10 +280,9 @@ sqlite3WhereExplainOneScan(Parse * pParse,	/* Parse context */
 	return ret;
 }
 
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 /*
- * Configure the VM passed as the first argument with an
- * sqlite3_stmt_scanstatus() entry corresponding to the scan used to
+ * Configure the VM passed as the first argument with a
+ * sql_stmt_loop_stat() entry corresponding to the scan used to
  * implement level pLvl. Argument pSrclist is a pointer to the FROM
  * clause that the scan reads data from.
  *
@@ -285,17 +295,15 @@ sqlite3WhereAddScanStatus(Vdbe * v,		/* Vdbe to add scanstatus entry to */
 			  WhereLevel * pLvl,	/* Level to add scanstatus() entry for */
 			  int addrExplain)	/* Address of OP_Explain (or 0) */
 {
-	const char *zObj = 0;
 	WhereLoop *pLoop = pLvl->pWLoop;
-	if (pLoop->pIndex != 0) {
-		zObj = pLoop->pIndex->zName;
-	} else {
-		zObj = pSrclist->a[pLvl->iFrom].zName;
-	}
+	const char *index_name = NULL;
+	if ((pLoop->wsFlags & WHERE_AUTO_INDEX) == 0 &&
+	    pLoop->index_def != NULL)
+		index_name = pLoop->index_def->name;
 	sqlite3VdbeScanStatus(v, addrExplain, pLvl->addrBody, pLvl->addrVisit,
-			      pLoop->nOut, zObj);
+			      pLoop->nOut, pSrclist->a[pLvl->iFrom].zName,
+			      index_name);
 }
-#endif
 
 /*
  * Disable a term in the WHERE clause.  Except, do not disable the term
@@ -863,6 +871,134 @@ codeExprOrVector(Parse * pParse, Expr * p, int iReg, int nReg)
 	}
 }
 
+/**
+ * Check if a WHERE term can be checked by a Tarantool cursor
+ * scanning the table: it compares a column of the table with an
+ * integer literal for an integer field or with a string literal
+ * for a string field with no collation.
+ *
+ * @param term WHERE term.
+ * @param cursor Cursor of the table.
+ * @param def Definition of the table.
+ * @param[out] token Comparison, one of TK_EQ, TK_LT, TK_LE,
+ *             TK_GT, TK_GE, as the column is on the left.
+ *
+ * @retval true if the term can be pushed down to the cursor.
+ */
+static bool
+where_term_is_cursor_filter(struct WhereTerm *term, int cursor,
+			    struct space_def *def, int *token)
+{
+	if ((term->wtFlags & (TERM_CODED | TERM_LIKEOPT | TERM_VNULL)) != 0 ||
+	    term->leftCursor != cursor || term->prereqRight != 0)
+		return false;
+	switch (term->eOperator & (WO_EQ | WO_LT | WO_LE | WO_GT | WO_GE)) {
+	case WO_EQ: *token = TK_EQ; break;
+	case WO_LT: *token = TK_LT; break;
+	case WO_LE: *token = TK_LE; break;
+	case WO_GT: *token = TK_GT; break;
+	case WO_GE: *token = TK_GE; break;
+	default:
+		return false;
+	}
+	struct Expr *expr = term->pExpr;
+	if (ExprHasProperty(expr, EP_FromJoin | EP_Collate))
+		return false;
+	struct Expr *left = expr->pLeft;
+	struct Expr *right = expr->pRight;
+	if (left->op != TK_COLUMN || left->iTable != cursor ||
+	    left->iColumn != term->u.leftColumn ||
+	    left->iColumn >= (int)def->field_count)
+		return false;
+	struct field_def *field = &def->fields[left->iColumn];
+	int value;
+	switch (field->type) {
+	case FIELD_TYPE_INTEGER:
+	case FIELD_TYPE_UNSIGNED:
+		return sqlite3ExprIsInteger(right, &value) != 0;
+	case FIELD_TYPE_STRING:
+		return right->op == TK_STRING && field->coll_id == COLL_NONE;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Push WHERE terms comparing a column of a fully scanned table
+ * with a constant down to its Tarantool cursor, see
+ * OP_CursorFilter. The cursor skips tuples for which any of them
+ * is false or NULL, so they never get to the VDBE. The terms are
+ * still checked by the loop, since the cursor drops its filter
+ * on a seek.
+ *
+ * @param winfo WHERE clause being coded.
+ * @param level Level of the loop scanning the table.
+ * @param cursor Cursor of the table.
+ */
+static void
+where_emit_cursor_filter(struct WhereInfo *winfo, struct WhereLevel *level,
+			 int cursor)
+{
+	struct Parse *parse = winfo->pParse;
+	struct WhereClause *wc = &winfo->sWC;
+	struct Table *table = winfo->pTabList->a[level->iFrom].pTab;
+	if (level->iLeftJoin != 0 || table == NULL || table->def == NULL)
+		return;
+	struct space_def *def = table->def;
+	uint32_t count = 0;
+	size_t size = 0;
+	int token, value;
+	struct WhereTerm *term = wc->a;
+	for (int i = 0; i < wc->nTerm; i++, term++) {
+		if (!where_term_is_cursor_filter(term, cursor, def, &token))
+			continue;
+		struct Expr *right = term->pExpr->pRight;
+		size += mp_sizeof_array(3) +
+			mp_sizeof_uint(term->u.leftColumn) +
+			mp_sizeof_uint(token);
+		if (sqlite3ExprIsInteger(right, &value)) {
+			size += value >= 0 ? mp_sizeof_uint(value) :
+				mp_sizeof_int(value);
+		} else {
+			size += mp_sizeof_str(strlen(right->u.zToken));
+		}
+		count++;
+	}
+	if (count == 0)
+		return;
+	size += mp_sizeof_array(count);
+	struct sqlite3 *db = parse->db;
+	char *filter = sqlite3DbMallocRawNN(db, size);
+	if (filter == NULL)
+		return;
+	char *pos = mp_encode_array(filter, count);
+	term = wc->a;
+	for (int i = 0; i < wc->nTerm; i++, term++) {
+		if (!where_term_is_cursor_filter(term, cursor, def, &token))
+			continue;
+		struct Expr *right = term->pExpr->pRight;
+		pos = mp_encode_array(pos, 3);
+		pos = mp_encode_uint(pos, term->u.leftColumn);
+		pos = mp_encode_uint(pos, token);
+		if (sqlite3ExprIsInteger(right, &value)) {
+			pos = value >= 0 ? mp_encode_uint(pos, value) :
+			      mp_encode_int(pos, value);
+		} else {
+			const char *str = right->u.zToken;
+			pos = mp_encode_str(pos, str, strlen(str));
+		}
+	}
+	assert(pos == filter + size);
+	struct Mem *mem = sqlite3ValueNew(db);
+	if (mem == NULL) {
+		sqlite3DbFree(db, filter);
+		return;
+	}
+	sqlite3VdbeMemSetStr(mem, filter, size, 0, SQLITE_DYNAMIC);
+	sqlite3VdbeAddOp4(parse->pVdbe, OP_CursorFilter, cursor, 0, 0,
+			  (char *)mem, P4_MEM);
+}
+
 /*
  * Generate code for the start of the iLevel-th loop in the WHERE clause
  * implementation described by pWInfo.
@@ -936,6 +1072,86 @@ sqlite3WhereCodeOneLoopStart(WhereInfo * pWInfo,	/* Complete information about t
 		VdbeCoverage(v);
 		VdbeComment((v, "next row of \"%s\"", pTabItem->pTab->def->name));
 		pLevel->op = OP_Goto;
+	} else if (pLoop->wsFlags & WHERE_AUTO_INDEX) {
+		/* Case 3: A lookup in an automatic index.
+		 *
+		 *         The index is built by where_emit_auto_index()
+		 *         on the columns of N equality terms, which
+		 *         refer to the outer loops only. Evaluate the
+		 *         right-hand sides and visit the index entries
+		 *         with the same key. The terms themselves are
+		 *         left enabled and checked against each row,
+		 *         the same way as for a full scan.
+		 *
+		 *         If the table didn't fit the index, scan the
+		 *         table instead and put each row alone into
+		 *         the emptied index, so that the loop body,
+		 *         which reads the index cursor, sees it.
+		 */
+		int nEq = pLoop->nEq;
+		int iIdxCur = pLevel->iIdxCur;
+		struct space_def *def = pTabItem->pTab->def;
+		int regBase = pParse->nMem + 1;
+		pParse->nMem += nEq;
+		char *zAff = sqlite3DbMallocRaw(db, nEq + 1);
+		addrNxt = pLevel->addrNxt;
+		for (j = 0; j < nEq; j++) {
+			pTerm = pLoop->aLTerm[j];
+			Expr *pRight = pTerm->pExpr->pRight;
+			sqlite3ExprCode(pParse, pRight, regBase + j);
+			/* NULL never matches, skip the lookup. */
+			if (sqlite3ExprCanBeNull(pRight)) {
+				sqlite3VdbeAddOp2(v, OP_IsNull, regBase + j,
+						  addrNxt);
+				VdbeCoverage(v);
+			}
+			if (zAff == NULL)
+				continue;
+			enum affinity_type aff =
+				def->fields[pTerm->u.leftColumn].affinity;
+			if (sql_affinity_result(sqlite3ExprAffinity(pRight),
+						aff) == AFFINITY_BLOB ||
+			    sqlite3ExprNeedsNoAffinityChange(pRight, aff))
+				aff = AFFINITY_BLOB;
+			zAff[j] = aff;
+		}
+		if (zAff != NULL)
+			zAff[nEq] = 0;
+		codeApplyAffinity(pParse, regBase, nEq, zAff);
+		sqlite3DbFree(db, zAff);
+		int regOver = pLevel->regAutoIdxOver;
+		int addrScan = sqlite3VdbeAddOp1(v, OP_If, regOver);
+		VdbeCoverage(v);
+		sqlite3VdbeAddOp4Int(v, OP_SeekGE, iIdxCur, addrNxt, regBase,
+				     nEq);
+		VdbeCoverage(v);
+		int addrCheck =
+			sqlite3VdbeAddOp4Int(v, OP_IdxGT, iIdxCur, addrNxt,
+					     regBase, nEq);
+		VdbeCoverage(v);
+		int addrRow = sqlite3VdbeAddOp0(v, OP_Goto);
+		/* The loop ends with a jump here. */
+		pLevel->op = OP_Goto;
+		pLevel->p2 = sqlite3VdbeCurrentAddr(v);
+		int addrScanNext = sqlite3VdbeAddOp1(v, OP_If, regOver);
+		VdbeCoverage(v);
+		sqlite3VdbeAddOp2(v, OP_Next, iIdxCur, addrCheck);
+		VdbeCoverage(v);
+		sqlite3VdbeGoto(v, addrNxt);
+		sqlite3VdbeJumpHere(v, addrScanNext);
+		int addrScanTop = sqlite3VdbeCurrentAddr(v) + 3;
+		sqlite3VdbeAddOp2(v, OP_Next, iCur, addrScanTop);
+		VdbeCoverage(v);
+		sqlite3VdbeGoto(v, addrNxt);
+		sqlite3VdbeJumpHere(v, addrScan);
+		sqlite3VdbeAddOp2(v, OP_Rewind, iCur, addrNxt);
+		VdbeCoverage(v);
+		assert(sqlite3VdbeCurrentAddr(v) == addrScanTop);
+		sqlite3VdbeAddOp1(v, OP_ResetSorter, iIdxCur);
+		where_emit_auto_index_row(pParse, pLevel, pTabItem);
+		sqlite3VdbeAddOp2(v, OP_Rewind, iIdxCur, addrNxt);
+		VdbeCoverage(v);
+		sqlite3VdbeJumpHere(v, addrRow);
 	} else if (pLoop->wsFlags & WHERE_INDEXED) {
 		/* Case 4: A scan using an index.
 		 *
@@ -1493,9 +1709,12 @@ sqlite3WhereCodeOneLoopStart(WhereInfo * pWInfo,	/* Complete information about t
 								       iLevel,
 								       pLevel->iFrom,
 								       0);
-					sqlite3WhereAddScanStatus(v, pOrTab,
-								  &pSubWInfo->a[0],
-								  addrExplain);
+					if (pParse->is_profiled) {
+						sqlite3WhereAddScanStatus(v,
+									  pOrTab,
+									  &pSubWInfo->a[0],
+									  addrExplain);
+					}
 
 					/* This is the sub-WHERE clause body.  First skip over
 					 * duplicate rows from prior sub-WHERE clauses, and record the
@@ -1640,6 +1859,7 @@ sqlite3WhereCodeOneLoopStart(WhereInfo * pWInfo,	/* Complete information about t
 		} else {
 			pLevel->op = aStep[bRev];
 			pLevel->p1 = iCur;
+			where_emit_cursor_filter(pWInfo, pLevel, iCur);
 			pLevel->p2 =
 			    1 + sqlite3VdbeAddOp2(v, aStart[bRev], iCur,
 						  addrBrk);
@@ -1649,9 +1869,7 @@ sqlite3WhereCodeOneLoopStart(WhereInfo * pWInfo,	/* Complete information about t
 		}
 	}
 
-#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
 	pLevel->addrVisit = sqlite3VdbeCurrentAddr(v);
-#endif
 
 	/* Insert code to test every subexpression that can be completely
 	 * computed using the current set of tables.
@@ -0,0 +1,438 @@
+/*
+ * Copyright 2010-2018, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "sql_stmt_cache.h"
+
+#include "assoc.h"
+#include "diag.h"
+#include "errcode.h"
+#include <info.h>
+#include "schema.h"
+#include "small/rlist.h"
+#include "sql.h"
+#include "sql/sqliteInt.h"
+#include "sql/vdbe.h"
+
+/** A cached prepared statement. */
+struct sql_stmt_entry {
+	/** Statement id, 0 if the text fails to compile. */
+	uint32_t id;
+	/**
+	 * Compiled statement ready for execution or NULL if
+	 * it is being executed or was evicted by a schema
+	 * change.
+	 */
+	struct sqlite3_stmt *stmt;
+	/**
+	 * Schema version the text failed to compile with. The
+	 * text isn't compiled for execution again until the
+	 * schema changes.
+	 */
+	uint32_t schema_version;
+	/**
+	 * True if the statement was prepared by a client,
+	 * false if it was added by the plan cache only.
+	 */
+	bool is_prepared;
+	/** Link in sql_stmt_cache::prepared or ::plans. */
+	struct rlist in_lru;
+	/** Length of the statement text. */
+	uint32_t sql_len;
+	/** Zero terminated statement text. */
+	char sql[0];
+};
+
+static struct sql_stmt_cache {
+	/** mhash table (id -> entry) */
+	struct mh_i32ptr_t *by_id;
+	/** mhash table (SQL text, len -> entry) */
+	struct mh_strnptr_t *by_sql;
+	/**
+	 * Entries of statements prepared by clients, most
+	 * recently used first. They are evicted only by other
+	 * prepared statements, so that the plan cache doesn't
+	 * invalidate ids known to clients.
+	 */
+	struct rlist prepared;
+	/** Number of entries in the prepared list. */
+	uint32_t prepared_count;
+	/** Entries added by the plan cache only. */
+	struct rlist plans;
+	/** Number of entries in the plans list. */
+	uint32_t plan_count;
+	/** Id of the last added statement. */
+	uint32_t last_id;
+	/** Number of lookups that found a compiled statement. */
+	uint64_t hit;
+	/** Number of lookups that required compilation. */
+	uint64_t miss;
+} cache;
+
+int
+sql_stmt_cache_init(void)
+{
+	cache.by_id = mh_i32ptr_new();
+	if (cache.by_id == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache.by_id), "malloc",
+			 "cache.by_id");
+		return -1;
+	}
+	cache.by_sql = mh_strnptr_new();
+	if (cache.by_sql == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache.by_sql), "malloc",
+			 "cache.by_sql");
+		mh_i32ptr_delete(cache.by_id);
+		return -1;
+	}
+	rlist_create(&cache.prepared);
+	rlist_create(&cache.plans);
+	cache.prepared_count = cache.plan_count = 0;
+	cache.last_id = 0;
+	cache.hit = cache.miss = 0;
+	return 0;
+}
+
+/** Remove an entry from the cache and free it. */
+static void
+sql_stmt_cache_delete(struct sql_stmt_entry *entry)
+{
+	mh_int_t pos;
+	if (entry->id != 0) {
+		pos = mh_i32ptr_find(cache.by_id, entry->id, NULL);
+		assert(pos != mh_end(cache.by_id));
+		mh_i32ptr_del(cache.by_id, pos, NULL);
+	}
+	pos = mh_strnptr_find_inp(cache.by_sql, entry->sql, entry->sql_len);
+	assert(pos != mh_end(cache.by_sql));
+	mh_strnptr_del(cache.by_sql, pos, NULL);
+	rlist_del_entry(entry, in_lru);
+	if (entry->is_prepared)
+		cache.prepared_count--;
+	else
+		cache.plan_count--;
+	sqlite3_finalize(entry->stmt);
+	free(entry);
+}
+
+void
+sql_stmt_cache_destroy(void)
+{
+	struct sql_stmt_entry *entry, *tmp;
+	rlist_foreach_entry_safe(entry, &cache.prepared, in_lru, tmp)
+		sql_stmt_cache_delete(entry);
+	rlist_foreach_entry_safe(entry, &cache.plans, in_lru, tmp)
+		sql_stmt_cache_delete(entry);
+	mh_strnptr_delete(cache.by_sql);
+	mh_i32ptr_delete(cache.by_id);
+}
+
+/** Compile an SQL statement. */
+static struct sqlite3_stmt *
+sql_stmt_compile(const char *sql, uint32_t len)
+{
+	sqlite3 *db = sql_get();
+	if (db == NULL) {
+		diag_set(ClientError, ER_LOADING);
+		return NULL;
+	}
+	struct sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(db, sql, len, &stmt, NULL) != SQLITE_OK) {
+		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
+		return NULL;
+	}
+	assert(stmt != NULL);
+	return stmt;
+}
+
+/** Return an entry by statement id or NULL. */
+static struct sql_stmt_entry *
+sql_stmt_cache_find(uint32_t stmt_id)
+{
+	mh_int_t pos = mh_i32ptr_find(cache.by_id, stmt_id, NULL);
+	if (pos == mh_end(cache.by_id))
+		return NULL;
+	return (struct sql_stmt_entry *) mh_i32ptr_node(cache.by_id, pos)->val;
+}
+
+/** Generate an id not used by any cached statement. */
+static uint32_t
+sql_stmt_cache_next_id(void)
+{
+	do {
+		/* Zero means "no statement id" in requests. */
+		if (++cache.last_id == 0)
+			++cache.last_id;
+	} while (sql_stmt_cache_find(cache.last_id) != NULL);
+	return cache.last_id;
+}
+
+/** Return the LRU list of an entry. */
+static struct rlist *
+sql_stmt_entry_lru(struct sql_stmt_entry *entry)
+{
+	return entry->is_prepared ? &cache.prepared : &cache.plans;
+}
+
+/**
+ * Evict least recently used entries of the prepared or of the
+ * plan list if it is over the limit.
+ */
+static void
+sql_stmt_cache_trim(bool is_prepared)
+{
+	struct rlist *lru = is_prepared ? &cache.prepared : &cache.plans;
+	uint32_t *count = is_prepared ? &cache.prepared_count :
+			  &cache.plan_count;
+	uint32_t max_count = is_prepared ? SQL_STMT_CACHE_SIZE :
+			     SQL_PLAN_CACHE_SIZE;
+	while (*count > max_count) {
+		/*
+		 * Statements being executed are not affected:
+		 * sql_stmt_cache_release() finalizes statements
+		 * of evicted entries.
+		 */
+		sql_stmt_cache_delete(rlist_last_entry(lru,
+						       struct sql_stmt_entry,
+						       in_lru));
+	}
+}
+
+/**
+ * Add an entry for a statement text. The entry gets an id
+ * when the text compiles.
+ */
+static struct sql_stmt_entry *
+sql_stmt_cache_new(const char *sql, uint32_t len, bool is_prepared)
+{
+	size_t size = sizeof(struct sql_stmt_entry) + len + 1;
+	struct sql_stmt_entry *entry = (struct sql_stmt_entry *) malloc(size);
+	if (entry == NULL) {
+		diag_set(OutOfMemory, size, "malloc", "entry");
+		return NULL;
+	}
+	entry->id = 0;
+	entry->stmt = NULL;
+	entry->schema_version = 0;
+	entry->is_prepared = is_prepared;
+	entry->sql_len = len;
+	memcpy(entry->sql, sql, len);
+	entry->sql[len] = '\0';
+
+	uint32_t hash = mh_strn_hash(entry->sql, len);
+	const struct mh_strnptr_node_t sql_node =
+		{ entry->sql, len, hash, entry };
+	if (mh_strnptr_put(cache.by_sql, &sql_node, NULL,
+			   NULL) == mh_end(cache.by_sql)) {
+		diag_set(OutOfMemory, sizeof(sql_node), "malloc",
+			 "cache.by_sql");
+		free(entry);
+		return NULL;
+	}
+	rlist_add_entry(sql_stmt_entry_lru(entry), entry, in_lru);
+	if (is_prepared)
+		cache.prepared_count++;
+	else
+		cache.plan_count++;
+	sql_stmt_cache_trim(is_prepared);
+	return entry;
+}
+
+/**
+ * Find the entry of a statement text, add it if the text is
+ * not in the cache. An entry of the plan cache prepared by a
+ * client is moved to the prepared list.
+ */
+static struct sql_stmt_entry *
+sql_stmt_cache_get(const char *sql, uint32_t len, bool is_prepared)
+{
+	mh_int_t pos = mh_strnptr_find_inp(cache.by_sql, sql, len);
+	if (pos == mh_end(cache.by_sql))
+		return sql_stmt_cache_new(sql, len, is_prepared);
+	struct sql_stmt_entry *entry = (struct sql_stmt_entry *)
+		mh_strnptr_node(cache.by_sql, pos)->val;
+	if (is_prepared && !entry->is_prepared) {
+		entry->is_prepared = true;
+		cache.plan_count--;
+		cache.prepared_count++;
+		rlist_move_entry(&cache.prepared, entry, in_lru);
+		sql_stmt_cache_trim(true);
+		return entry;
+	}
+	rlist_move_entry(sql_stmt_entry_lru(entry), entry, in_lru);
+	return entry;
+}
+
+/**
+ * Compile the text of an entry without an id. The entry gets
+ * an id if the text compiles, otherwise it remembers the
+ * schema version the text failed to compile with.
+ */
+static struct sqlite3_stmt *
+sql_stmt_entry_compile(struct sql_stmt_entry *entry)
+{
+	assert(entry->id == 0);
+	struct sqlite3_stmt *stmt = sql_stmt_compile(entry->sql,
+						     entry->sql_len);
+	if (stmt == NULL) {
+		entry->schema_version = box_schema_version();
+		return NULL;
+	}
+	uint32_t id = sql_stmt_cache_next_id();
+	const struct mh_i32ptr_node_t id_node = { id, entry };
+	if (mh_i32ptr_put(cache.by_id, &id_node, NULL,
+			  NULL) == mh_end(cache.by_id)) {
+		diag_set(OutOfMemory, sizeof(id_node), "malloc",
+			 "cache.by_id");
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+	entry->id = id;
+	return stmt;
+}
+
+/**
+ * Take the compiled statement of an entry or compile a new
+ * one, see sql_stmt_cache_acquire().
+ */
+static struct sqlite3_stmt *
+sql_stmt_entry_acquire(struct sql_stmt_entry *entry)
+{
+	assert(entry->id != 0);
+	struct sqlite3_stmt *stmt = entry->stmt;
+	entry->stmt = NULL;
+	if (stmt != NULL &&
+	    vdbe_schema_version((struct Vdbe *) stmt) == box_schema_version()) {
+		cache.hit++;
+		return stmt;
+	}
+	/*
+	 * The cached program is either being executed by
+	 * another fiber or refers to an old schema.
+	 */
+	sqlite3_finalize(stmt);
+	cache.miss++;
+	return sql_stmt_compile(entry->sql, entry->sql_len);
+}
+
+int
+sql_stmt_cache_prepare(const char *sql, uint32_t len, uint32_t *stmt_id)
+{
+	struct sql_stmt_entry *entry = sql_stmt_cache_get(sql, len, true);
+	if (entry == NULL)
+		return -1;
+	if (entry->id != 0) {
+		cache.hit++;
+		*stmt_id = entry->id;
+		return 0;
+	}
+	/*
+	 * A text which failed to compile is compiled again
+	 * to report the error to the client.
+	 */
+	cache.miss++;
+	struct sqlite3_stmt *stmt = sql_stmt_entry_compile(entry);
+	if (stmt == NULL)
+		return -1;
+	entry->stmt = stmt;
+	*stmt_id = entry->id;
+	return 0;
+}
+
+struct sqlite3_stmt *
+sql_stmt_cache_acquire(uint32_t stmt_id)
+{
+	struct sql_stmt_entry *entry = sql_stmt_cache_find(stmt_id);
+	if (entry == NULL) {
+		diag_set(ClientError, ER_WRONG_QUERY_ID, stmt_id);
+		return NULL;
+	}
+	rlist_move_entry(sql_stmt_entry_lru(entry), entry, in_lru);
+	return sql_stmt_entry_acquire(entry);
+}
+
+int
+sql_stmt_cache_prepare_acquire(const char *sql, uint32_t len,
+			       uint32_t *stmt_id, struct sqlite3_stmt **stmt)
+{
+	struct sql_stmt_entry *entry = sql_stmt_cache_get(sql, len, false);
+	if (entry == NULL)
+		return -1;
+	if (entry->id != 0) {
+		*stmt = sql_stmt_entry_acquire(entry);
+		if (*stmt == NULL)
+			return -1;
+		*stmt_id = entry->id;
+		return 0;
+	}
+	cache.miss++;
+	if (entry->schema_version == box_schema_version())
+		return 1;
+	/*
+	 * The compiled program is owned by the caller, and
+	 * is kept in the entry when it is released.
+	 */
+	*stmt = sql_stmt_entry_compile(entry);
+	if (*stmt == NULL)
+		return 1;
+	*stmt_id = entry->id;
+	return 0;
+}
+
+void
+sql_stmt_cache_release(uint32_t stmt_id, struct sqlite3_stmt *stmt)
+{
+	struct sql_stmt_entry *entry = sql_stmt_cache_find(stmt_id);
+	if (entry == NULL || entry->stmt != NULL ||
+	    vdbe_schema_version((struct Vdbe *) stmt) != box_schema_version()) {
+		sqlite3_finalize(stmt);
+		return;
+	}
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	entry->stmt = stmt;
+}
+
+void
+sql_stmt_cache_stat(struct info_handler *h)
+{
+	info_begin(h);
+	info_table_begin(h, "cache");
+	info_append_int(h, "size", mh_size(cache.by_id));
+	info_append_int(h, "hit", cache.hit);
+	info_append_int(h, "miss", cache.miss);
+	info_table_end(h);
+	info_end(h);
+}
+
+void
+sql_stmt_cache_reset_stat(void)
+{
+	cache.hit = cache.miss = 0;
+}
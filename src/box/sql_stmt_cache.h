@@ -0,0 +1,144 @@
+#ifndef TARANTOOL_BOX_SQL_STMT_CACHE_H_INCLUDED
+#define TARANTOOL_BOX_SQL_STMT_CACHE_H_INCLUDED
+/*
+ * Copyright 2010-2018, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct sqlite3_stmt;
+struct info_handler;
+
+/**
+ * Prepared statement cache. The cache maps SQL text of a
+ * statement to an id, unique within the instance, and the id
+ * to a compiled VDBE program, so that a statement prepared
+ * once can be executed by id without being parsed and planned
+ * again. The cache is global, and a statement compiled before
+ * a schema change is recompiled on the next execution.
+ *
+ * Statements prepared by clients and statements added by the
+ * plan cache (sql_stmt_cache_prepare_acquire()) are kept in
+ * separate LRU lists, each evicting its least recently used
+ * statements when it is full. So the plan cache never evicts
+ * a statement whose id a client holds.
+ */
+enum {
+	/** Max number of statements prepared by clients. */
+	SQL_STMT_CACHE_SIZE = 1024,
+	/** Max number of statements added by the plan cache. */
+	SQL_PLAN_CACHE_SIZE = 1024,
+};
+
+/**
+ * Create the cache.
+ * @retval 0 Success.
+ * @retval -1 Memory error.
+ */
+int
+sql_stmt_cache_init(void);
+
+/** Delete the cache and finalize all cached statements. */
+void
+sql_stmt_cache_destroy(void);
+
+/**
+ * Compile a statement and add it to the cache, unless a
+ * statement with the same text is already there.
+ * @param sql SQL statement text.
+ * @param len Length of @a sql.
+ * @param[out] stmt_id Id of the statement.
+ *
+ * @retval 0 Success.
+ * @retval -1 Client or memory error.
+ */
+int
+sql_stmt_cache_prepare(const char *sql, uint32_t len, uint32_t *stmt_id);
+
+/**
+ * Get a compiled statement ready for execution. The statement
+ * is owned by the caller until it is returned with
+ * sql_stmt_cache_release(). If the cached program is already
+ * being executed or is out of date, a new one is compiled.
+ * @param stmt_id Id of the statement.
+ *
+ * @retval not NULL Statement.
+ * @retval NULL Unknown id, client or memory error.
+ */
+struct sqlite3_stmt *
+sql_stmt_cache_acquire(uint32_t stmt_id);
+
+/**
+ * Get a compiled statement by its text, adding it to the cache
+ * unless a statement with the same text is already there. The
+ * statement is owned by the caller until it is returned with
+ * sql_stmt_cache_release(). A text which fails to compile is
+ * remembered, and isn't compiled again until the schema
+ * changes.
+ * @param sql SQL statement text.
+ * @param len Length of @a sql.
+ * @param[out] stmt_id Id of the statement.
+ * @param[out] stmt Statement.
+ *
+ * @retval 0 Success.
+ * @retval -1 Client or memory error.
+ * @retval 1 The text fails to compile.
+ */
+int
+sql_stmt_cache_prepare_acquire(const char *sql, uint32_t len,
+			       uint32_t *stmt_id, struct sqlite3_stmt **stmt);
+
+/**
+ * Return an executed statement to the cache. The statement is
+ * reset and kept for the next execution if the cache has no
+ * other compiled program for the id, otherwise it is finalized.
+ * @param stmt_id Id of the statement.
+ * @param stmt Statement returned by sql_stmt_cache_acquire().
+ */
+void
+sql_stmt_cache_release(uint32_t stmt_id, struct sqlite3_stmt *stmt);
+
+/** Fill box.stat.sql() with cache statistics. */
+void
+sql_stmt_cache_stat(struct info_handler *h);
+
+/** Reset cache hit and miss counters. */
+void
+sql_stmt_cache_reset_stat(void);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_SQL_STMT_CACHE_H_INCLUDED */
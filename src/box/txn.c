@@ -65,6 +65,7 @@ txn_add_redo(struct txn_stmt *stmt, struct request *request)
 	row->lsn = 0;
 	row->sync = 0;
 	row->tm = 0;
+	row->stream_id = 0;
 	row->bodycnt = xrow_encode_dml(request, row->body);
 	if (row->bodycnt < 0)
 		return -1;
@@ -235,6 +236,8 @@ txn_commit_stmt(struct txn *txn, struct request *request)
 			goto fail;
 		++txn->n_rows;
 	}
+	if (stmt->space != NULL)
+		++stmt->space->change_count;
 	/*
 	 * If there are triggers, and they are not disabled, and
 	 * the statement found any rows, run triggers.
@@ -283,6 +286,8 @@ txn_write_to_wal(struct txn *txn)
 	ev_tstamp start = ev_monotonic_now(loop());
 	int64_t res = journal_write(req);
 	ev_tstamp stop = ev_monotonic_now(loop());
+	/* Accounted in the request latency, see iproto.cc. */
+	fiber()->storage.net.wal_wait += stop - start;
 
 	if (res < 0) {
 		/* Cascading rollback. */
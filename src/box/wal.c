@@ -32,6 +32,7 @@
 
 #include "vclock.h"
 #include "fiber.h"
+#include "fiber_cond.h"
 #include "fio.h"
 #include "errinj.h"
 #include "error.h"
@@ -54,6 +55,18 @@ enum {
 	 * latency. 1 MB seems to be a well balanced choice.
 	 */
 	WAL_FALLOCATE_LEN = 1024 * 1024,
+	/**
+	 * Max number of WAL files deleted by garbage collection
+	 * to keep for reuse in the fsync mode, see xdir::recycle_max.
+	 */
+	WAL_RECYCLE_MAX = 4,
+	/**
+	 * Distance in bytes between WAL positions saved in
+	 * the WAL index, see xdir::index_step. Recovery and
+	 * relays read at most that much of a WAL before
+	 * they reach the first row they need.
+	 */
+	WAL_INDEX_STEP = 1024 * 1024,
 };
 
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
@@ -158,6 +171,22 @@ struct wal_writer
 	 * Used for replication relays.
 	 */
 	struct rlist watchers;
+	/**
+	 * In the fsync mode, batches that have been written to
+	 * the current WAL, but haven't been synced yet. They wait
+	 * here until the next fdatasync() is started.
+	 */
+	struct stailq sync_queue;
+	/**
+	 * Batches covered by the fdatasync() that is currently
+	 * in progress. They are passed to TX as soon as it
+	 * completes.
+	 */
+	struct stailq sync_inflight;
+	/** Set while an asynchronous fdatasync() is in progress. */
+	bool sync_in_progress;
+	/** Signalled when an asynchronous fdatasync() completes. */
+	struct fiber_cond sync_cond;
 };
 
 struct wal_msg {
@@ -171,6 +200,8 @@ struct wal_msg {
 	 * be rolled back.
 	 */
 	struct stailq rollback;
+	/** Link in wal_writer::sync_queue or sync_inflight. */
+	struct stailq_entry in_sync;
 };
 
 /**
@@ -194,11 +225,19 @@ wal_mode()
 static void
 wal_write_to_disk(struct cmsg *msg);
 
+static void
+wal_sync_drain(struct wal_writer *writer);
+
 static void
 tx_schedule_commit(struct cmsg *msg);
 
+/*
+ * Note, the WAL thread forwards a batch to TX explicitly with
+ * wal_msg_complete(), because in the fsync mode it may have to
+ * wait for fdatasync() to complete after the batch was written.
+ */
 static struct cmsg_hop wal_request_route[] = {
-	{wal_write_to_disk, &wal_thread.tx_prio_pipe},
+	{wal_write_to_disk, NULL},
 	{tx_schedule_commit, NULL},
 };
 
@@ -357,8 +396,17 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 
 	xdir_create(&writer->wal_dir, wal_dirname, XLOG, instance_uuid);
 	xlog_clear(&writer->current_wal);
-	if (wal_mode == WAL_FSYNC)
-		writer->wal_dir.open_wflags |= O_SYNC;
+	if (wal_mode == WAL_FSYNC) {
+		/*
+		 * Preallocate WAL files by writing zeros and
+		 * reuse old files, so that writes don't change
+		 * file size and fdatasync() doesn't need to
+		 * flush file system metadata.
+		 */
+		writer->wal_dir.zero_fill = true;
+		writer->wal_dir.recycle_max = WAL_RECYCLE_MAX;
+	}
+	writer->wal_dir.index_step = WAL_INDEX_STEP;
 
 	stailq_create(&writer->rollback);
 	cmsg_init(&writer->in_rollback, NULL);
@@ -371,6 +419,11 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 	vclock_copy(&writer->checkpoint_vclock, checkpoint_vclock);
 	rlist_create(&writer->watchers);
 
+	stailq_create(&writer->sync_queue);
+	stailq_create(&writer->sync_inflight);
+	writer->sync_in_progress = false;
+	fiber_cond_create(&writer->sync_cond);
+
 	writer->on_garbage_collection = on_garbage_collection;
 	writer->on_checkpoint_threshold = on_checkpoint_threshold;
 }
@@ -380,6 +433,7 @@ static void
 wal_writer_destroy(struct wal_writer *writer)
 {
 	xdir_destroy(&writer->wal_dir);
+	fiber_cond_destroy(&writer->sync_cond);
 }
 
 /** WAL thread routine. */
@@ -409,6 +463,26 @@ wal_open_f(struct cbus_call_msg *msg)
 	return xlog_open(&writer->current_wal, path);
 }
 
+/**
+ * Cut off the zeros left at the end of the last WAL file if
+ * it was being written to preallocated space when the instance
+ * crashed (see xlog::zero_fill). Readers treat such zeros as
+ * corruption in any file but the last one.
+ */
+static void
+wal_truncate_last(struct wal_writer *writer)
+{
+	struct vclock *last = vclockset_last(&writer->wal_dir.index);
+	if (last == NULL)
+		return;
+	const char *path = xdir_format_filename(&writer->wal_dir,
+						vclock_sum(last), NONE);
+	if (xlog_truncate_zeros(path) != 0) {
+		say_warn("failed to truncate %s", path);
+		diag_log();
+	}
+}
+
 /**
  * Try to open the current WAL file for appending if it exists.
  */
@@ -419,7 +493,11 @@ wal_open(struct wal_writer *writer)
 				vclock_sum(&writer->vclock), NONE);
 	if (access(path, F_OK) != 0) {
 		if (errno == ENOENT) {
-			/* No WAL, nothing to do. */
+			/*
+			 * No WAL, a new one will be created after
+			 * the last one.
+			 */
+			wal_truncate_last(writer);
 			return 0;
 		}
 		diag_set(SystemError, "failed to access %s", path);
@@ -522,13 +600,32 @@ wal_thread_stop()
 		wal_writer_destroy(&wal_writer_singleton);
 }
 
+static int
+wal_sync_f(struct cbus_call_msg *msg)
+{
+	(void)msg;
+	/*
+	 * Batches may still be waiting for fdatasync() to
+	 * complete. Since the reply to this message travels
+	 * through the same pipe, flushing them here guarantees
+	 * all of them are processed by TX before wal_sync()
+	 * returns.
+	 */
+	wal_sync_drain(&wal_writer_singleton);
+	return 0;
+}
+
 void
 wal_sync(void)
 {
 	struct wal_writer *writer = &wal_writer_singleton;
 	if (writer->wal_mode == WAL_NONE)
 		return;
-	cbus_flush(&wal_thread.wal_pipe, &wal_thread.tx_prio_pipe, NULL);
+	struct cbus_call_msg msg;
+	bool cancellable = fiber_set_cancellable(false);
+	cbus_call(&wal_thread.wal_pipe, &wal_thread.tx_prio_pipe, &msg,
+		  wal_sync_f, NULL, TIMEOUT_INFINITY);
+	fiber_set_cancellable(cancellable);
 }
 
 static int
@@ -552,6 +649,7 @@ wal_begin_checkpoint_f(struct cbus_call_msg *data)
 	    vclock_sum(&writer->current_wal.meta.vclock) !=
 	    vclock_sum(&writer->vclock)) {
 
+		wal_sync_drain(writer);
 		xlog_close(&writer->current_wal, false);
 		/*
 		 * The next WAL will be created on the first write.
@@ -687,7 +785,8 @@ wal_collect_garbage_f(struct cbus_call_msg *data)
 		vclock = vclockset_psearch(&writer->wal_dir.index, vclock);
 	}
 	if (vclock != NULL)
-		xdir_collect_garbage(&writer->wal_dir, vclock_sum(vclock), 0);
+		xdir_collect_garbage(&writer->wal_dir, vclock_sum(vclock),
+				     XDIR_GC_RECYCLE);
 
 	return 0;
 }
@@ -709,6 +808,119 @@ wal_collect_garbage(const struct vclock *vclock)
 static void
 wal_notify_watchers(struct wal_writer *writer, unsigned events);
 
+/**
+ * Pass a processed batch to TX. The batch must not be
+ * accessed after this function returns.
+ */
+static void
+wal_msg_complete(struct wal_msg *batch)
+{
+	/* Advance to tx_schedule_commit, see wal_request_route. */
+	batch->base.hop++;
+	cpipe_push(&wal_thread.tx_prio_pipe, &batch->base);
+}
+
+/**
+ * Pass all batches from the given sync queue to TX in the order
+ * they were written and let relays know they can be sent to
+ * replicas.
+ */
+static void
+wal_sync_complete(struct wal_writer *writer, struct stailq *queue)
+{
+	if (stailq_empty(queue))
+		return;
+	while (!stailq_empty(queue)) {
+		struct wal_msg *batch = stailq_shift_entry(queue,
+						struct wal_msg, in_sync);
+		wal_msg_complete(batch);
+	}
+	wal_notify_watchers(writer, WAL_EVENT_WRITE);
+}
+
+static void
+wal_sync_start(struct wal_writer *writer);
+
+static int
+wal_sync_cb(eio_req *req)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	int fd = (intptr_t) req->data;
+	if (req->result) {
+		/*
+		 * We can't tell which of the written rows reached
+		 * the disk, and other batches have already been
+		 * appended to the file, so there is no way to roll
+		 * back. See also "fsyncgate".
+		 */
+		errno = req->errorno;
+		panic_syserror("WAL writer: fdatasync() failed");
+	}
+	close(fd);
+	writer->sync_in_progress = false;
+	fiber_cond_broadcast(&writer->sync_cond);
+	/*
+	 * The in-flight queue may have been flushed by
+	 * wal_sync_drain() while the sync was running.
+	 */
+	wal_sync_complete(writer, &writer->sync_inflight);
+	/* Sync batches written while we were waiting. */
+	if (!stailq_empty(&writer->sync_queue))
+		wal_sync_start(writer);
+	return 0;
+}
+
+/**
+ * Start fdatasync() of the current WAL in a coio thread so that
+ * the WAL thread can proceed to writing the next batch while
+ * the disk is busy. All batches queued so far are acknowledged
+ * when the sync completes. Batches written in the meantime will
+ * be synced by the next call, which effectively makes up a group
+ * commit.
+ */
+static void
+wal_sync_start(struct wal_writer *writer)
+{
+	assert(!writer->sync_in_progress);
+	assert(stailq_empty(&writer->sync_inflight));
+	assert(xlog_is_open(&writer->current_wal));
+	/*
+	 * Sync a duplicate of the file descriptor, because
+	 * the WAL may be closed before the sync completes.
+	 */
+	int fd = dup(writer->current_wal.fd);
+	if (fd < 0) {
+		say_syserror("%s: dup() failed",
+			     writer->current_wal.filename);
+		wal_sync_drain(writer);
+		return;
+	}
+	stailq_concat(&writer->sync_inflight, &writer->sync_queue);
+	writer->sync_in_progress = true;
+	eio_fdatasync(fd, 0, wal_sync_cb, (void *) (intptr_t) fd);
+}
+
+/**
+ * Synchronously sync the current WAL and pass all batches
+ * waiting for fdatasync(), including those covered by the
+ * sync that is still in progress, to TX. Must be called
+ * before the current WAL is closed and before passing
+ * a batch to TX bypassing the sync queue, to preserve
+ * the order of acknowledgements.
+ */
+static void
+wal_sync_drain(struct wal_writer *writer)
+{
+	if (stailq_empty(&writer->sync_queue) &&
+	    stailq_empty(&writer->sync_inflight))
+		return;
+	assert(xlog_is_open(&writer->current_wal));
+	if (fdatasync(writer->current_wal.fd) < 0)
+		panic_syserror("WAL writer: fdatasync() failed");
+	stailq_concat(&writer->sync_inflight, &writer->sync_queue);
+	wal_sync_complete(writer, &writer->sync_inflight);
+}
+
 /**
  * If there is no current WAL, try to open it, and close the
  * previous WAL. We close the previous WAL only after opening
@@ -738,6 +950,7 @@ wal_opt_rotate(struct wal_writer *writer)
 		 * failure in any reasonable way.
 		 * A warning is written to the error log.
 		 */
+		wal_sync_drain(writer);
 		xlog_close(&writer->current_wal, false);
 	}
 
@@ -929,19 +1142,23 @@ wal_write_to_disk(struct cmsg *msg)
 	if (writer->in_rollback.route != NULL) {
 		/* We're rolling back a failed write. */
 		stailq_concat(&wal_msg->rollback, &wal_msg->commit);
-		return;
+		goto complete;
 	}
 
 	/* Xlog is only rotated between queue processing  */
 	if (wal_opt_rotate(writer) != 0) {
 		stailq_concat(&wal_msg->rollback, &wal_msg->commit);
-		return wal_writer_begin_rollback(writer);
+		wal_sync_drain(writer);
+		wal_writer_begin_rollback(writer);
+		goto complete;
 	}
 
 	/* Ensure there's enough disk space before writing anything. */
 	if (wal_fallocate(writer, wal_msg->approx_len) != 0) {
 		stailq_concat(&wal_msg->rollback, &wal_msg->commit);
-		return wal_writer_begin_rollback(writer);
+		wal_sync_drain(writer);
+		wal_writer_begin_rollback(writer);
+		goto complete;
 	}
 
 	/*
@@ -1040,7 +1257,30 @@ done:
 		wal_writer_begin_rollback(writer);
 	}
 	fiber_gc();
+	if (writer->wal_mode == WAL_FSYNC && last_committed != NULL) {
+		/*
+		 * Don't acknowledge the batch until its rows reach
+		 * the disk, but don't wait for that either: proceed
+		 * to the next batch while fdatasync() is running.
+		 */
+		stailq_add_tail_entry(&writer->sync_queue, wal_msg, in_sync);
+		if (!stailq_empty(&wal_msg->rollback)) {
+			/*
+			 * TX must append the rollback list to the
+			 * writer before the rollback message reaches
+			 * tx_schedule_rollback(), so flush the batch
+			 * right away.
+			 */
+			wal_sync_drain(writer);
+		} else if (!writer->sync_in_progress) {
+			wal_sync_start(writer);
+		}
+		return;
+	}
 	wal_notify_watchers(writer, WAL_EVENT_WRITE);
+complete:
+	wal_sync_drain(writer);
+	wal_msg_complete(wal_msg);
 }
 
 /** WAL thread main loop.  */
@@ -1065,6 +1305,15 @@ wal_thread_f(va_list ap)
 
 	struct wal_writer *writer = &wal_writer_singleton;
 
+	/*
+	 * Acknowledge all pending writes and wait for the
+	 * asynchronous fdatasync(), if any, to release
+	 * the file descriptor.
+	 */
+	wal_sync_drain(writer);
+	while (writer->sync_in_progress)
+		fiber_cond_wait(&writer->sync_cond);
+
 	/*
 	 * Create a new empty WAL on shutdown so that we don't
 	 * have to rescan the last WAL to find the instance vclock.
@@ -321,6 +321,44 @@ xlog_meta_parse(struct xlog_meta *meta, const char **data,
 	return 0;
 }
 
+int
+xlog_meta_set_instance_uuid(char *data, size_t size,
+			    const struct tt_uuid *instance_uuid)
+{
+	char *end = (char *)memmem(data, size, "\n\n", 2);
+	if (end == NULL) {
+		diag_set(XlogError, "failed to find xlog meta");
+		return -1;
+	}
+	/* Skip filetype and version strings. */
+	char *pos = data;
+	for (int i = 0; i < 2 && pos < end; i++)
+		pos = (char *)memchr(pos, '\n', end + 1 - pos) + 1;
+	while (pos < end) {
+		char *eol = (char *)memchr(pos, '\n', end + 1 - pos);
+		assert(eol != NULL);
+		char *key_end = (char *)memchr(pos, ':', eol - pos);
+		if (key_end != NULL &&
+		    (xlog_meta_key_equal(pos, key_end, INSTANCE_UUID_KEY) ||
+		     xlog_meta_key_equal(pos, key_end,
+					 INSTANCE_UUID_KEY_V12))) {
+			char *val = key_end + 1;
+			while (*val == ' ' || *val == '\t')
+				++val;
+			if (eol - val != UUID_STR_LEN) {
+				diag_set(XlogError,
+					 "can't parse instance UUID");
+				return -1;
+			}
+			memcpy(val, tt_uuid_str(instance_uuid), UUID_STR_LEN);
+			return 0;
+		}
+		pos = eol + 1;
+	}
+	diag_set(XlogError, "xlog meta has no instance UUID");
+	return -1;
+}
+
 /* struct xlog }}} */
 
 /* {{{ struct xdir */
@@ -476,6 +514,14 @@ xdir_open_cursor(struct xdir *dir, int64_t signature,
 		diag_set(XlogError, "%s: signature check failed", filename);
 		return -1;
 	}
+	/*
+	 * Only the last WAL may be being written to now. Older
+	 * files are either closed properly or have had their
+	 * preallocated zeros cut off, see xlog_truncate_zeros().
+	 */
+	struct vclock *last = vclockset_last(&dir->index);
+	cursor->zero_tail = dir->type == XLOG &&
+			    (last == NULL || vclock_sum(last) == signature);
 	return 0;
 }
 
@@ -663,6 +709,78 @@ xdir_format_filename(struct xdir *dir, int64_t signature,
 	return filename;
 }
 
+/**
+ * Suffix of files kept for reuse, see xdir::recycle_max.
+ */
+static const char recycled_suffix[] = ".recycled";
+
+/**
+ * Return the number of files kept for reuse in the given
+ * directory. If @path is not NULL, copy the path of one
+ * of them to it.
+ */
+static int
+xdir_count_recycled(struct xdir *dir, char *path, size_t size)
+{
+	DIR *dh = opendir(dir->dirname);
+	if (dh == NULL) {
+		say_syserror("error reading directory '%s'", dir->dirname);
+		return 0;
+	}
+	size_t ext_len = strlen(dir->filename_ext);
+	int count = 0;
+	struct dirent *dent;
+	while ((dent = readdir(dh)) != NULL) {
+		char *ext = strrchr(dent->d_name, '.');
+		if (ext == NULL || strcmp(ext, recycled_suffix) != 0)
+			continue;
+		if (ext - dent->d_name < (ptrdiff_t)ext_len ||
+		    memcmp(ext - ext_len, dir->filename_ext, ext_len) != 0)
+			continue;
+		if (path != NULL && count == 0)
+			snprintf(path, size, "%s/%s", dir->dirname,
+				 dent->d_name);
+		count++;
+	}
+	closedir(dh);
+	return count;
+}
+
+/**
+ * Suffix of index files, see xlog::index_step.
+ */
+static const char index_suffix[] = ".index";
+
+/**
+ * Remove the index file of a log removed from the directory.
+ */
+static void
+xdir_remove_index(const char *filename, unsigned flags)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s%s", filename, index_suffix);
+	int rc;
+	if (flags & XDIR_GC_USE_COIO)
+		rc = coio_unlink(path);
+	else
+		rc = unlink(path);
+	if (rc < 0 && errno != ENOENT)
+		say_syserror("error while removing %s", path);
+}
+
+/**
+ * Rename a file removed from the directory so that it
+ * can be reused by xdir_create_xlog().
+ */
+static int
+xdir_recycle_file(const char *filename)
+{
+	char new_filename[PATH_MAX];
+	snprintf(new_filename, sizeof(new_filename), "%s%s",
+		 filename, recycled_suffix);
+	return rename(filename, new_filename);
+}
+
 int
 xdir_collect_garbage(struct xdir *dir, int64_t signature, unsigned flags)
 {
@@ -671,8 +789,12 @@ xdir_collect_garbage(struct xdir *dir, int64_t signature, unsigned flags)
 	       vclock_sum(vclock) < signature) {
 		char *filename = xdir_format_filename(dir, vclock_sum(vclock),
 						      NONE);
+		bool recycle = (flags & XDIR_GC_RECYCLE) != 0 &&
+			xdir_count_recycled(dir, NULL, 0) < dir->recycle_max;
 		int rc;
-		if (flags & XDIR_GC_USE_COIO)
+		if (recycle)
+			rc = xdir_recycle_file(filename);
+		else if (flags & XDIR_GC_USE_COIO)
 			rc = coio_unlink(filename);
 		else
 			rc = unlink(filename);
@@ -685,14 +807,32 @@ xdir_collect_garbage(struct xdir *dir, int64_t signature, unsigned flags)
 					 filename);
 				return -1;
 			}
-		} else
+		} else if (recycle)
+			say_info("recycled %s", filename);
+		else
 			say_info("removed %s", filename);
+		if (dir->type == XLOG)
+			xdir_remove_index(filename, flags);
 		vclockset_remove(&dir->index, vclock);
 		free(vclock);
 
 		if (flags & XDIR_GC_REMOVE_ONE)
 			break;
 	}
+	/*
+	 * Remove files kept for reuse in excess of the limit,
+	 * e.g. if recycling was turned off.
+	 */
+	char path[PATH_MAX];
+	while ((flags & XDIR_GC_RECYCLE) != 0 &&
+	       xdir_count_recycled(dir, path, sizeof(path)) >
+	       dir->recycle_max) {
+		if (unlink(path) < 0) {
+			say_syserror("error while removing %s", path);
+			break;
+		}
+		say_info("removed %s", path);
+	}
 	return 0;
 }
 
@@ -800,9 +940,13 @@ xlog_destroy(struct xlog *xlog)
 	xlog->fd = -1;
 }
 
-int
-xlog_create(struct xlog *xlog, const char *name, int flags,
-	    const struct xlog_meta *meta)
+/**
+ * Create a new xlog file. If @recycled is not NULL, reuse
+ * the given file instead of creating a new one.
+ */
+static int
+xlog_create_or_recycle(struct xlog *xlog, const char *name, int flags,
+		       const struct xlog_meta *meta, const char *recycled)
 {
 	char meta_buf[XLOG_META_LEN_MAX];
 	int meta_len;
@@ -824,7 +968,16 @@ xlog_create(struct xlog *xlog, const char *name, int flags,
 	xlog->is_inprogress = true;
 	snprintf(xlog->filename, PATH_MAX, "%s%s", name, inprogress_suffix);
 
-	flags |= O_RDWR | O_CREAT | O_EXCL;
+	if (recycled != NULL && rename(recycled, xlog->filename) != 0) {
+		say_syserror("can't rename %s to %s",
+			     recycled, xlog->filename);
+		/* Not critical, create a new file. */
+		recycled = NULL;
+	}
+	if (recycled != NULL)
+		flags |= O_RDWR;
+	else
+		flags |= O_RDWR | O_CREAT | O_EXCL;
 
 	/*
 	 * Open the <lsn>.<suffix>.inprogress file.
@@ -859,6 +1012,29 @@ xlog_create(struct xlog *xlog, const char *name, int flags,
 	}
 
 	xlog->offset = meta_len; /* first log starts after meta */
+
+	if (recycled != NULL) {
+		/*
+		 * The file still stores rows and the EOF marker of
+		 * the log it was recycled from. Zero all of it
+		 * and make sure the zeros reach the disk before
+		 * the file is renamed, so that neither readers nor
+		 * recovery mistake old rows for rows of this file.
+		 * The zeroed space is preallocated for new rows.
+		 */
+		struct stat st;
+		if (fstat(xlog->fd, &st) != 0) {
+			diag_set(SystemError, "%s: failed to stat file",
+				 xlog->filename);
+			goto err_write;
+		}
+		size_t len = XLOG_FIXHEADER_SIZE;
+		if (st.st_size > meta_len + (off_t)len)
+			len = st.st_size - meta_len;
+		xlog->zero_fill = true;
+		if (xlog_fallocate(xlog, len) != 0)
+			goto err_write;
+	}
 	return 0;
 err_write:
 	close(xlog->fd);
@@ -869,6 +1045,93 @@ err:
 	return -1;
 }
 
+int
+xlog_create(struct xlog *xlog, const char *name, int flags,
+	    const struct xlog_meta *meta)
+{
+	return xlog_create_or_recycle(xlog, name, flags, meta, NULL);
+}
+
+/**
+ * Find the end of data written to a file preallocated with
+ * zeros (see xlog::zero_fill).
+ * @retval >= 0 offset of the end of data
+ * @retval -1 error, check diag
+ */
+static off_t
+xlog_zero_filled_data_end(int fd, const char *name)
+{
+	struct xlog_cursor cursor;
+	if (xlog_cursor_openfd(&cursor, fd, name) != 0)
+		return -1;
+	cursor.zero_tail = true;
+	struct xrow_header row;
+	int rc;
+	while ((rc = xlog_cursor_next(&cursor, &row, false)) == 0)
+		;
+	off_t offset = xlog_cursor_pos(&cursor);
+	xlog_cursor_close(&cursor, true);
+	return rc < 0 ? -1 : offset;
+}
+
+/**
+ * Position a file preallocated with zeros (see xlog::zero_fill)
+ * at the end of written data so that new data is appended
+ * right after it. @size is the file size.
+ */
+static int
+xlog_open_zero_filled(struct xlog *xlog, off_t size)
+{
+	off_t offset = xlog_zero_filled_data_end(xlog->fd, xlog->filename);
+	if (offset < 0)
+		return -1;
+	if (fio_lseek(xlog->fd, offset, SEEK_SET) < 0) {
+		diag_set(SystemError, "failed to seek file '%s'",
+			 xlog->filename);
+		return -1;
+	}
+	xlog->offset = offset;
+	xlog->allocated = size - offset;
+	xlog->zero_fill = true;
+	return 0;
+}
+
+int
+xlog_truncate_zeros(const char *name)
+{
+	int fd = open(name, O_RDWR);
+	if (fd < 0) {
+		diag_set(SystemError, "failed to open file '%s'", name);
+		return -1;
+	}
+	char magic[sizeof(log_magic_t)];
+	off_t size = fio_lseek(fd, 0, SEEK_END);
+	if (size < (off_t)sizeof(magic))
+		goto out;
+	ssize_t rc = fio_pread(fd, magic, sizeof(magic),
+			       size - sizeof(magic));
+	if (rc < 0) {
+		diag_set(SystemError, "failed to read file '%s'", name);
+		goto fail;
+	}
+	if (rc != sizeof(magic) || load_u32(magic) != 0)
+		goto out;
+	off_t offset = xlog_zero_filled_data_end(fd, name);
+	if (offset < 0)
+		goto fail;
+	say_info("truncating preallocated space of `%s'", name);
+	if (ftruncate(fd, offset) != 0 || fdatasync(fd) != 0) {
+		diag_set(SystemError, "failed to truncate file '%s'", name);
+		goto fail;
+	}
+out:
+	close(fd);
+	return 0;
+fail:
+	close(fd);
+	return -1;
+}
+
 int
 xlog_open(struct xlog *xlog, const char *name)
 {
@@ -923,6 +1186,14 @@ no_eof:
 				 xlog->filename);
 			goto err_read;
 		}
+		/*
+		 * The file wasn't closed properly. If it ends with
+		 * zeros, it was preallocated, so look for the real
+		 * end of data.
+		 */
+		if (rc == sizeof(magic) && load_u32(magic) == 0 &&
+		    xlog_open_zero_filled(xlog, xlog->offset) != 0)
+			goto err_read;
 	} else {
 		/* Truncate the file to erase the EOF marker. */
 		if (ftruncate(xlog->fd, xlog->offset) != 0) {
@@ -960,6 +1231,44 @@ xdir_touch_xlog(struct xdir *dir, const struct vclock *vclock)
 	return 0;
 }
 
+/**
+ * Start indexing a new log, see xlog::index_step. Failures are
+ * not critical, because readers can do without the index, so
+ * they are only logged.
+ *
+ * The index file is a sequence of MsgPack values: the signature
+ * of the log, which lets readers detect an index left from
+ * another log with the same name, followed by entries appended
+ * as the log grows:
+ *
+ *   signature [offset, {replica_id: lsn}] [offset, {...}] ...
+ */
+static void
+xlog_index_create(struct xlog *log, uint64_t step,
+		  const struct vclock *vclock)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s%s", log->filename, index_suffix);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (fd < 0) {
+		say_syserror("%s: failed to create index", log->filename);
+		return;
+	}
+	char buf[9];
+	char *data = mp_encode_uint(buf, vclock_sum(vclock));
+	if (fio_writen(fd, buf, data - buf) < 0) {
+		say_syserror("%s: failed to write index", log->filename);
+		close(fd);
+		unlink(path);
+		return;
+	}
+	log->index_fd = fd;
+	log->index_step = step;
+	log->index_offset = 0;
+	vclock_copy(&log->index_vclock, vclock);
+	vclock_copy(&log->index_tx_vclock, vclock);
+}
+
 /**
  * In case of error, writes a message to the error log
  * and sets errno.
@@ -985,10 +1294,18 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 			 vclock, prev_vclock);
 
 	char *filename = xdir_format_filename(dir, signature, NONE);
-	if (xlog_create(xlog, filename, dir->open_wflags, &meta) != 0)
+	char recycled_buf[PATH_MAX];
+	const char *recycled = NULL;
+	if (dir->recycle_max > 0 &&
+	    xdir_count_recycled(dir, recycled_buf, sizeof(recycled_buf)) > 0)
+		recycled = recycled_buf;
+	if (xlog_create_or_recycle(xlog, filename, dir->open_wflags,
+				   &meta, recycled) != 0)
 		return -1;
 
 	/* Inherit xdir settings. */
+	if (dir->zero_fill)
+		xlog->zero_fill = true;
 	xlog->sync_is_async = dir->sync_is_async;
 	xlog->sync_interval = dir->sync_interval;
 
@@ -1004,12 +1321,51 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 		return -1;
 	}
 
+	if (dir->index_step > 0 && !xlog->is_inprogress)
+		xlog_index_create(xlog, dir->index_step, vclock);
+
+	return 0;
+}
+
+/**
+ * Fill @len bytes of a file starting at @offset with zeros.
+ */
+static int
+xlog_write_zeros(int fd, off_t offset, size_t len)
+{
+	static const char zeros[64 * 1024];
+	while (len > 0) {
+		ssize_t rc = pwrite(fd, zeros, MIN(len, sizeof(zeros)),
+				    offset);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		offset += rc;
+		len -= rc;
+	}
 	return 0;
 }
 
 ssize_t
 xlog_fallocate(struct xlog *log, size_t len)
 {
+	if (log->zero_fill) {
+		/*
+		 * Sync the zeros right away: data written past
+		 * them later must never be followed by garbage on
+		 * disk, even after a crash.
+		 */
+		if (xlog_write_zeros(log->fd, log->offset + log->allocated,
+				     len) != 0 || fdatasync(log->fd) != 0) {
+			diag_set(SystemError, "%s: can't allocate disk space",
+				 log->filename);
+			return -1;
+		}
+		log->allocated += len;
+		return 0;
+	}
 #ifdef HAVE_FALLOCATE
 	static bool fallocate_not_supported = false;
 	if (fallocate_not_supported)
@@ -1201,6 +1557,59 @@ error:
 #define SYNC_ROUND_DOWN(size)	((size) & ~(4096 - 1))
 #define SYNC_ROUND_UP(size)	(SYNC_ROUND_DOWN(size + SYNC_MASK))
 
+enum {
+	/**
+	 * Max size of an index entry encoded as MsgPack
+	 * [offset, {replica_id: lsn}], see xlog_index_create().
+	 */
+	XLOG_INDEX_ENTRY_MAX = 1 + 9 + 3 + VCLOCK_MAX * (5 + 9),
+};
+
+/**
+ * Stop indexing a log, e.g. because the index can't be written.
+ * Readers can do without the index, so it isn't an error.
+ */
+static void
+xlog_index_disable(struct xlog *log)
+{
+	if (log->index_step == 0)
+		return;
+	close(log->index_fd);
+	log->index_fd = -1;
+	log->index_step = 0;
+}
+
+/**
+ * Add an index entry for a tx written at @offset unless the
+ * previous entry is less than xlog::index_step bytes behind.
+ * The entry is appended to the index file right away, so that
+ * readers of the log can use it while the log is being written.
+ */
+static void
+xlog_index_add(struct xlog *log, off_t offset)
+{
+	if (offset < log->index_offset + (off_t)log->index_step)
+		return;
+	char buf[XLOG_INDEX_ENTRY_MAX];
+	char *data = buf;
+	data = mp_encode_array(data, 2);
+	data = mp_encode_uint(data, offset);
+	data = mp_encode_map(data, vclock_size(&log->index_tx_vclock));
+	struct vclock_iterator it;
+	vclock_iterator_init(&it, &log->index_tx_vclock);
+	vclock_foreach(&it, replica) {
+		data = mp_encode_uint(data, replica.id);
+		data = mp_encode_uint(data, replica.lsn);
+	}
+	assert(data <= buf + sizeof(buf));
+	if (fio_writen(log->index_fd, buf, data - buf) < 0) {
+		say_syserror("%s: failed to write index", log->filename);
+		xlog_index_disable(log);
+		return;
+	}
+	log->index_offset = offset;
+}
+
 /**
  * Writes xlog batch to file
  */
@@ -1210,8 +1619,20 @@ xlog_tx_write(struct xlog *log)
 	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
 		return 0;
 	ssize_t written;
+	off_t tx_offset = log->offset;
 
-	if (obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+	/*
+	 * Readers of a zero-filled file rely on the data being
+	 * followed by zeros, so make sure there's enough zeroed
+	 * space for the worst case, including the magic of the
+	 * next tx.
+	 */
+	size_t zero_len = ZSTD_compressBound(obuf_size(&log->obuf)) +
+			  sizeof(log_magic_t);
+	if (log->zero_fill && log->allocated < zero_len &&
+	    xlog_fallocate(log, zero_len - log->allocated) != 0) {
+		written = -1;
+	} else if (obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
 		written = xlog_tx_write_zstd(log);
 	} else {
 		written = xlog_tx_write_plain(log);
@@ -1241,6 +1662,8 @@ xlog_tx_write(struct xlog *log)
 	log->offset += written;
 	log->rows += log->tx_rows;
 	log->tx_rows = 0;
+	if (log->index_step > 0)
+		xlog_index_add(log, tx_offset);
 	if ((log->sync_interval && log->offset >=
 	    (off_t)(log->synced_size + log->sync_interval)) ||
 	    (log->rate_limit && log->offset >=
@@ -1302,7 +1725,19 @@ xlog_write_row(struct xlog *log, const struct xrow_header *packet)
 				  "runtime arena", "xlog tx output buffer");
 			return -1;
 		}
+		if (log->index_step > 0)
+			vclock_copy(&log->index_tx_vclock,
+				    &log->index_vclock);
 	}
+	/*
+	 * Rows of a rolled back tx are accounted too, which is
+	 * fine: an index entry may only overestimate the vclock
+	 * of rows preceding it.
+	 */
+	if (log->index_step > 0 && packet->replica_id < VCLOCK_MAX &&
+	    packet->lsn > vclock_get(&log->index_vclock, packet->replica_id))
+		vclock_follow(&log->index_vclock, packet->replica_id,
+			      packet->lsn);
 
 	struct obuf_svp svp = obuf_create_svp(&log->obuf);
 	size_t page_offset = obuf_size(&log->obuf);
@@ -1441,7 +1876,8 @@ xlog_write_eof(struct xlog *l)
 	 * Don't write the eof marker if this fails, otherwise
 	 * we'll get "data after eof marker" error on recovery.
 	 */
-	if (l->allocated > 0 && ftruncate(l->fd, l->offset) < 0) {
+	if ((l->allocated > 0 || l->zero_fill) &&
+	    ftruncate(l->fd, l->offset) < 0) {
 		diag_set(SystemError, "ftruncate() failed");
 		return -1;
 	}
@@ -1460,6 +1896,7 @@ xlog_close(struct xlog *l, bool reuse_fd)
 	if (rc < 0)
 		say_error("%s: failed to write EOF marker: %s", l->filename,
 			  diag_last_error(diag_get())->errmsg);
+	xlog_index_disable(l);
 
 	/*
 	 * Sync the file before closing, since
@@ -1493,6 +1930,10 @@ xlog_atfork(struct xlog *xlog)
 	 */
 	close(xlog->fd);
 	xlog->fd = -1;
+	if (xlog->index_step > 0) {
+		close(xlog->index_fd);
+		xlog->index_step = 0;
+	}
 }
 
 /* }}} */
@@ -1850,6 +2291,46 @@ xlog_cursor_find_tx_magic(struct xlog_cursor *i)
 	return 0;
 }
 
+/**
+ * Check that the read buffer contains only zeros starting
+ * from @a pos, reading some more data from the file first.
+ * Since the writer keeps the data it appends to a zero-filled
+ * file followed by zeros, anything else means corruption.
+ */
+static bool
+xlog_cursor_rest_is_zero(struct xlog_cursor *i, size_t pos)
+{
+	if (xlog_cursor_ensure(i, pos + XLOG_FIXHEADER_SIZE) < 0)
+		return false;
+	for (const char *p = i->rbuf.rpos + pos; p < i->rbuf.wpos; p++) {
+		if (*p != 0)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Check if the tx at the cursor position failed to decode,
+ * because it is being written to a zero-filled file right
+ * now: pages are filled in order, so the tail of a partially
+ * written tx is still zeroed, and so is everything after it.
+ */
+static bool
+xlog_cursor_tx_is_partial(struct xlog_cursor *i)
+{
+	struct xlog_fixheader fixheader;
+	const char *pos = i->rbuf.rpos;
+	const char *end = i->rbuf.wpos;
+	if (xlog_fixheader_decode(&fixheader, &pos, end) != 0)
+		return false;
+	if (fixheader.len == 0 || end - pos < (ptrdiff_t)fixheader.len)
+		return false;
+	if (pos[fixheader.len - 1] != 0)
+		return false;
+	return xlog_cursor_rest_is_zero(i, pos + fixheader.len -
+					   i->rbuf.rpos);
+}
+
 int
 xlog_cursor_next_tx(struct xlog_cursor *i)
 {
@@ -1866,6 +2347,14 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		/* eof marker found */
 		goto eof_found;
 	}
+	if (load_u32(i->rbuf.rpos) == 0 && i->zero_tail &&
+	    xlog_cursor_rest_is_zero(i, 0)) {
+		/*
+		 * Zeros at a tx boundary: we've reached the space
+		 * preallocated by the writer, see xlog::zero_fill.
+		 */
+		goto not_written;
+	}
 
 	ssize_t to_load;
 	while ((to_load = xlog_tx_cursor_create(&i->tx_cursor,
@@ -1878,11 +2367,25 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		if (rc > 0)
 			return 1;
 	}
-	if (to_load < 0)
+	if (to_load < 0) {
+		if (i->zero_tail && xlog_cursor_tx_is_partial(i)) {
+			diag_clear(diag_get());
+			goto not_written;
+		}
 		return -1;
+	}
 
 	i->state = XLOG_CURSOR_TX;
 	return 0;
+not_written:
+	/*
+	 * Drop the read buffer, since it's filled with zeros,
+	 * so that we re-read the file from this position next
+	 * time, when the data may have been written.
+	 */
+	i->read_offset = xlog_cursor_pos(i);
+	ibuf_reset(&i->rbuf);
+	return 1;
 eof_found:
 	/*
 	 * A eof marker is read, check that there is no
@@ -2005,6 +2508,114 @@ xlog_cursor_open(struct xlog_cursor *i, const char *name)
 	return 0;
 }
 
+/**
+ * Decode a vclock stored in an index file as {replica_id: lsn}.
+ * Return -1 if the map is malformed.
+ */
+static int
+xlog_index_decode_vclock(const char **data, struct vclock *vclock)
+{
+	if (mp_typeof(**data) != MP_MAP)
+		return -1;
+	vclock_create(vclock);
+	uint32_t size = mp_decode_map(data);
+	for (uint32_t i = 0; i < size; i++) {
+		if (mp_typeof(**data) != MP_UINT)
+			return -1;
+		uint64_t id = mp_decode_uint(data);
+		if (mp_typeof(**data) != MP_UINT)
+			return -1;
+		uint64_t lsn = mp_decode_uint(data);
+		if (id >= VCLOCK_MAX || lsn == 0 || lsn > INT64_MAX ||
+		    vclock_get(vclock, id) != 0)
+			return -1;
+		vclock_follow(vclock, id, lsn);
+	}
+	return 0;
+}
+
+void
+xlog_cursor_seek(struct xlog_cursor *i, const struct vclock *vclock)
+{
+	assert(xlog_cursor_is_open(i));
+	if (i->fd < 0)
+		return;
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s%s", i->name, index_suffix);
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+	char *buf = NULL;
+	struct stat index_st, log_st;
+	if (fstat(fd, &index_st) < 0 || fstat(i->fd, &log_st) < 0 ||
+	    index_st.st_size == 0)
+		goto out;
+	buf = malloc(index_st.st_size);
+	if (buf == NULL)
+		goto out;
+	if (fio_read(fd, buf, index_st.st_size) != index_st.st_size)
+		goto out;
+
+	const char *data = buf;
+	const char *end = buf + index_st.st_size;
+	const char *next = data;
+	if (mp_check(&next, end) != 0 || mp_typeof(*data) != MP_UINT)
+		goto invalid;
+	/* The index belongs to another log with the same name. */
+	if (mp_decode_uint(&data) != (uint64_t)vclock_sum(&i->meta.vclock))
+		goto out;
+	off_t offset = 0;
+	while (data < end) {
+		/*
+		 * The log may be being written, in which case
+		 * the last entry may be being appended too.
+		 */
+		next = data;
+		if (mp_check(&next, end) != 0)
+			break;
+		if (mp_typeof(*data) != MP_ARRAY ||
+		    mp_decode_array(&data) != 2 ||
+		    mp_typeof(*data) != MP_UINT)
+			goto invalid;
+		uint64_t entry_offset = mp_decode_uint(&data);
+		struct vclock entry_vclock;
+		if (xlog_index_decode_vclock(&data, &entry_vclock) != 0 ||
+		    entry_offset <= (uint64_t)offset ||
+		    entry_offset >= (uint64_t)log_st.st_size)
+			goto invalid;
+		/*
+		 * Entries are sorted, stop at the first one
+		 * preceded by a row the caller needs.
+		 */
+		int cmp = vclock_compare(&entry_vclock, vclock);
+		if (cmp != 0 && cmp != -1)
+			break;
+		offset = entry_offset;
+	}
+	if (offset <= xlog_cursor_pos(i))
+		goto out;
+	/*
+	 * The index isn't synced with the log, so after a crash
+	 * it may point to data that was lost. Make sure there's
+	 * a tx at the offset.
+	 */
+	log_magic_t magic;
+	if (fio_pread(i->fd, &magic, sizeof(magic), offset) !=
+	    sizeof(magic) || (magic != row_marker && magic != zrow_marker))
+		goto invalid;
+	struct errinj *inj = errinj(ERRINJ_XLOG_INDEX_SKIP, ERRINJ_INT);
+	if (inj != NULL)
+		inj->iparam += offset - xlog_cursor_pos(i);
+	i->read_offset = offset;
+	ibuf_reset(&i->rbuf);
+	goto out;
+invalid:
+	say_warn("%s: invalid index file, ignored", i->name);
+out:
+	free(buf);
+	close(fd);
+}
+
 int
 xlog_cursor_openmem(struct xlog_cursor *i, const char *data, size_t size,
 		    const char *name)
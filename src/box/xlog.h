@@ -140,6 +140,25 @@ struct xdir {
 	 * corresponding file cache will be marked as free
 	 */
 	uint64_t sync_interval;
+	/**
+	 * Preallocate disk space for files created in this
+	 * directory by writing zeros, see xlog::zero_fill.
+	 */
+	bool zero_fill;
+	/**
+	 * Max number of files to keep for reuse when they are
+	 * removed with XDIR_GC_RECYCLE. A recycled file is picked
+	 * up by xdir_create_xlog() instead of creating a new one,
+	 * so the file system doesn't need to allocate disk blocks
+	 * for it anew. Requires zero_fill.
+	 */
+	int recycle_max;
+	/**
+	 * Index step in bytes for files created in this
+	 * directory, see xlog::index_step. Zero disables
+	 * indexing.
+	 */
+	uint64_t index_step;
 };
 
 /**
@@ -205,6 +224,11 @@ enum {
 	 * Return after removing a file.
 	 */
 	XDIR_GC_REMOVE_ONE = 1 << 1,
+	/**
+	 * Rename up to xdir::recycle_max files for reuse
+	 * instead of deleting them.
+	 */
+	XDIR_GC_RECYCLE = 1 << 2,
 };
 
 /**
@@ -300,6 +324,19 @@ xlog_meta_create(struct xlog_meta *meta, const char *filetype,
 		 const struct vclock *vclock,
 		 const struct vclock *prev_vclock);
 
+/**
+ * Overwrite the instance uuid stored in the text header of
+ * a file. @a data must point to the beginning of the file and
+ * contain the whole header. Used to adopt checkpoint files
+ * received from another instance.
+ *
+ * @retval 0 success
+ * @retval -1 error, check diag
+ */
+int
+xlog_meta_set_instance_uuid(char *data, size_t size,
+			    const struct tt_uuid *instance_uuid);
+
 /* }}} */
 
 /**
@@ -351,6 +388,17 @@ struct xlog {
 	 * xlog_fallocate().
 	 */
 	size_t allocated;
+	/**
+	 * If set, xlog_fallocate() preallocates disk space by
+	 * writing zeros and extending the file rather than with
+	 * fallocate(). Appending data to such a file changes
+	 * neither its size nor its block map, so fdatasync()
+	 * doesn't have to flush file system metadata. Readers
+	 * stop at zeros found at a tx boundary, as if the file
+	 * ended there, so the written data must always be
+	 * followed by zeros. The tail is truncated on close.
+	 */
+	bool zero_fill;
 	/**
 	 * Output buffer, works as row accumulator for
 	 * compression.
@@ -385,6 +433,24 @@ struct xlog {
 	uint64_t rate_limit;
 	/** Time when xlog wast synced last time */
 	double sync_time;
+	/**
+	 * If not 0, append an entry to the index file next to
+	 * the log every @index_step bytes written. An entry is
+	 * the offset of a tx and the vclock of all rows before
+	 * it, which lets readers skip rows they don't need, see
+	 * xlog_cursor_seek(). Entries are appended as the log
+	 * grows, so that the index can be used while the log
+	 * is still being written.
+	 */
+	uint64_t index_step;
+	/** Index file descriptor, valid if @index_step is set. */
+	int index_fd;
+	/** Offset of the tx of the last index entry. */
+	off_t index_offset;
+	/** Vclock of all rows added to the log so far. */
+	struct vclock index_vclock;
+	/** Value of @index_vclock before the current tx. */
+	struct vclock index_tx_vclock;
 };
 
 /**
@@ -444,6 +510,20 @@ xlog_create(struct xlog *xlog, const char *name, int flags,
 int
 xlog_open(struct xlog *xlog, const char *name);
 
+/**
+ * Cut off the zeros preallocated by a writer (see
+ * xlog::zero_fill) from a file that wasn't closed properly,
+ * so that it can be read as any other file once a newer
+ * file is created after it. Does nothing if the file
+ * doesn't end with zeros.
+ * @param name          file name
+ *
+ * @retval 0 success
+ * @retval -1 error
+ */
+int
+xlog_truncate_zeros(const char *name);
+
 
 /**
  * Reset an xlog object without opening it.
@@ -478,6 +558,9 @@ xlog_rename(struct xlog *l);
  * Returns -1 on fallocate error and sets both diag and errno
  * accordingly. On success returns 0. If the underlying OS
  * does not support fallocate, this function also returns 0.
+ *
+ * If xlog::zero_fill is set, the space is filled with zeros
+ * and synced to disk instead.
  */
 ssize_t
 xlog_fallocate(struct xlog *log, size_t size);
@@ -656,6 +739,15 @@ struct xlog_cursor
 	struct xlog_tx_cursor tx_cursor;
 	/** ZSTD context for decompression */
 	ZSTD_DStream *zdctx;
+	/**
+	 * The file may be a WAL that is being written to space
+	 * preallocated with zeros (see xlog::zero_fill). If set,
+	 * zeros that follow the data until the end of the file
+	 * are treated as data that hasn't been written yet rather
+	 * than as corruption. Set for the last file of a WAL
+	 * directory by xdir_open_cursor().
+	 */
+	bool zero_tail;
 };
 
 /**
@@ -787,6 +879,19 @@ xlog_cursor_tx_pos(struct xlog_cursor *cursor)
 {
 	return xlog_tx_cursor_pos(&cursor->tx_cursor);
 }
+
+/**
+ * Skip rows that are less than or equal to @vclock without
+ * reading them, using the index file written along with the
+ * log, see xlog::index_step. The cursor is positioned at the
+ * last indexed tx preceded only by such rows, so the caller
+ * may still need to skip a few rows. If the index file is
+ * missing or can't be used, the cursor stays where it is.
+ *
+ * Must be called right after the cursor is opened.
+ */
+void
+xlog_cursor_seek(struct xlog_cursor *cursor, const struct vclock *vclock);
 /* }}} */
 
 /** {{{ miscellaneous log io functions. */
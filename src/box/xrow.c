@@ -133,6 +133,9 @@ error:
 		case IPROTO_SCHEMA_VERSION:
 			header->schema_version = mp_decode_uint(pos);
 			break;
+		case IPROTO_STREAM_ID:
+			header->stream_id = mp_decode_uint(pos);
+			break;
 		default:
 			/* unknown header */
 			mp_next(pos);
@@ -481,9 +484,11 @@ error:
 	uint32_t map_size = mp_decode_map(&data);
 	request->sql_text = NULL;
 	request->bind = NULL;
+	request->stmt_id = 0;
 	for (uint32_t i = 0; i < map_size; ++i) {
 		uint8_t key = *data;
-		if (key != IPROTO_SQL_BIND && key != IPROTO_SQL_TEXT) {
+		if (key != IPROTO_SQL_BIND && key != IPROTO_SQL_TEXT &&
+		    key != IPROTO_STMT_ID) {
 			mp_check(&data, end);   /* skip the key */
 			mp_check(&data, end);   /* skip the value */
 			continue;
@@ -491,12 +496,23 @@ error:
 		const char *value = ++data;     /* skip the key */
 		if (mp_check(&data, end) != 0)  /* check the value */
 			goto error;
-		if (key == IPROTO_SQL_BIND)
+		if (key == IPROTO_SQL_BIND) {
 			request->bind = value;
-		else
+		} else if (key == IPROTO_SQL_TEXT) {
 			request->sql_text = value;
+		} else {
+			if (mp_typeof(*value) != MP_UINT)
+				goto error;
+			uint64_t stmt_id = mp_decode_uint(&value);
+			if (stmt_id == 0 || stmt_id > UINT32_MAX)
+				goto error;
+			request->stmt_id = stmt_id;
+		}
 	}
-	if (request->sql_text == NULL) {
+	if (request->stmt_id != 0 && row->type == IPROTO_EXECUTE) {
+		/* The statement text is not needed. */
+		request->sql_text = NULL;
+	} else if (request->sql_text == NULL) {
 		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
 			 iproto_key_name(IPROTO_SQL_TEXT));
 		return -1;
@@ -506,6 +522,133 @@ error:
 	return 0;
 }
 
+int
+xrow_decode_batch(const struct xrow_header *row,
+		  struct batch_request *request)
+{
+	if (row->bodycnt == 0) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "missing request body");
+		return -1;
+	}
+	assert(row->bodycnt == 1);
+	const char *data = (const char *) row->body[0].iov_base;
+	const char *end = data + row->body[0].iov_len;
+	assert((end - data) > 0);
+
+	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0) {
+error:
+		diag_set(ClientError, ER_INVALID_MSGPACK, "packet body");
+		return -1;
+	}
+
+	uint32_t map_size = mp_decode_map(&data);
+	request->requests = NULL;
+	request->requests_end = NULL;
+	request->count = 0;
+	request->is_atomic = false;
+	for (uint32_t i = 0; i < map_size; ++i) {
+		uint8_t key = *data;
+		if (key != IPROTO_BATCH_REQUESTS &&
+		    key != IPROTO_BATCH_IS_ATOMIC) {
+			mp_check(&data, end);   /* skip the key */
+			mp_check(&data, end);   /* skip the value */
+			continue;
+		}
+		const char *value = ++data;     /* skip the key */
+		if (mp_check(&data, end) != 0)  /* check the value */
+			goto error;
+		if (key == IPROTO_BATCH_IS_ATOMIC) {
+			if (mp_typeof(*value) != MP_BOOL)
+				goto error;
+			request->is_atomic = mp_decode_bool(&value);
+			continue;
+		}
+		if (mp_typeof(*value) != MP_ARRAY)
+			goto error;
+		request->requests = value;
+		request->requests_end = data;
+		request->count = mp_decode_array(&value);
+		for (uint32_t j = 0; j < request->count; ++j) {
+			if (mp_typeof(*value) != MP_ARRAY ||
+			    mp_decode_array(&value) != 2 ||
+			    mp_typeof(*value) != MP_UINT)
+				goto error;
+			mp_next(&value);
+			if (mp_typeof(*value) != MP_MAP)
+				goto error;
+			mp_next(&value);
+		}
+	}
+	if (request->requests == NULL) {
+		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
+			 iproto_key_name(IPROTO_BATCH_REQUESTS));
+		return -1;
+	}
+	if (data != end)
+		goto error;
+	return 0;
+}
+
+int
+xrow_decode_fetch(const struct xrow_header *row,
+		  struct fetch_request *request)
+{
+	if (row->bodycnt == 0) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "missing request body");
+		return -1;
+	}
+	assert(row->bodycnt == 1);
+	const char *data = (const char *) row->body[0].iov_base;
+	const char *end = data + row->body[0].iov_len;
+	assert((end - data) > 0);
+
+	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0) {
+error:
+		diag_set(ClientError, ER_INVALID_MSGPACK, "packet body");
+		return -1;
+	}
+
+	uint32_t map_size = mp_decode_map(&data);
+	bool has_limit = false;
+	request->cursor_id = 0;
+	request->limit = 0;
+	for (uint32_t i = 0; i < map_size; ++i) {
+		uint8_t key = *data;
+		if (key != IPROTO_CURSOR_ID && key != IPROTO_LIMIT) {
+			mp_check(&data, end);   /* skip the key */
+			mp_check(&data, end);   /* skip the value */
+			continue;
+		}
+		const char *value = ++data;     /* skip the key */
+		if (mp_check(&data, end) != 0)  /* check the value */
+			goto error;
+		if (mp_typeof(*value) != MP_UINT)
+			goto error;
+		if (key == IPROTO_CURSOR_ID) {
+			request->cursor_id = mp_decode_uint(&value);
+		} else {
+			uint64_t limit = mp_decode_uint(&value);
+			if (limit > UINT32_MAX)
+				goto error;
+			request->limit = limit;
+			has_limit = true;
+		}
+	}
+	if (request->cursor_id == 0) {
+		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
+			 iproto_key_name(IPROTO_CURSOR_ID));
+		return -1;
+	}
+	if (!has_limit) {
+		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
+			 iproto_key_name(IPROTO_LIMIT));
+		return -1;
+	}
+	if (data != end)
+		goto error;
+	return 0;
+}
+
 void
 iproto_reply_sql(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		 uint32_t schema_version, int keys)
@@ -605,6 +748,9 @@ error:
 			request->tuple_meta = value;
 			request->tuple_meta_end = data;
 			break;
+		case IPROTO_CURSOR:
+			request->is_cursor = mp_decode_bool(&value);
+			break;
 		default:
 			break;
 		}
@@ -1128,7 +1274,8 @@ xrow_decode_subscribe(struct xrow_header *row, struct tt_uuid *replicaset_uuid,
 }
 
 int
-xrow_encode_join(struct xrow_header *row, const struct tt_uuid *instance_uuid)
+xrow_encode_join(struct xrow_header *row, const struct tt_uuid *instance_uuid,
+		 bool join_files)
 {
 	memset(row, 0, sizeof(*row));
 
@@ -1139,10 +1286,18 @@ xrow_encode_join(struct xrow_header *row, const struct tt_uuid *instance_uuid)
 		return -1;
 	}
 	char *data = buf;
-	data = mp_encode_map(data, 1);
+	data = mp_encode_map(data, join_files ? 2 : 1);
 	data = mp_encode_uint(data, IPROTO_INSTANCE_UUID);
 	/* Greet the remote replica with our replica UUID */
 	data = xrow_encode_uuid(data, instance_uuid);
+	if (join_files) {
+		/*
+		 * Masters that don't support file-level JOIN
+		 * ignore this key and send rows as usual.
+		 */
+		data = mp_encode_uint(data, IPROTO_JOIN_FILES);
+		data = mp_encode_bool(data, true);
+	}
 	assert(data <= buf + size);
 
 	row->body[0].iov_base = buf;
@@ -1152,6 +1307,220 @@ xrow_encode_join(struct xrow_header *row, const struct tt_uuid *instance_uuid)
 	return 0;
 }
 
+/**
+ * Check that a replication request body is a valid MsgPack map
+ * and position @a pos at the first key. Return the map size.
+ */
+static int
+xrow_decode_replication_body(struct xrow_header *row, const char **pos,
+			     uint32_t *map_size)
+{
+	if (row->bodycnt == 0) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "request body");
+		return -1;
+	}
+	assert(row->bodycnt == 1);
+	const char *data = (const char *) row->body[0].iov_base;
+	const char *end = data + row->body[0].iov_len;
+	const char *d = data;
+	if (mp_check(&d, end) != 0 || mp_typeof(*data) != MP_MAP) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "request body");
+		return -1;
+	}
+	d = data;
+	*map_size = mp_decode_map(&d);
+	*pos = d;
+	return 0;
+}
+
+int
+xrow_decode_join(struct xrow_header *row, struct tt_uuid *instance_uuid,
+		 bool *join_files)
+{
+	*join_files = false;
+	const char *d;
+	uint32_t map_size;
+	if (xrow_decode_replication_body(row, &d, &map_size) != 0)
+		return -1;
+	for (uint32_t i = 0; i < map_size; i++) {
+		if (mp_typeof(*d) != MP_UINT) {
+			mp_next(&d); /* key */
+			mp_next(&d); /* value */
+			continue;
+		}
+		uint8_t key = mp_decode_uint(&d);
+		switch (key) {
+		case IPROTO_INSTANCE_UUID:
+			if (xrow_decode_uuid(&d, instance_uuid) != 0)
+				return -1;
+			break;
+		case IPROTO_JOIN_FILES:
+			if (mp_typeof(*d) != MP_BOOL) {
+				diag_set(ClientError, ER_INVALID_MSGPACK,
+					 "invalid JOIN_FILES");
+				return -1;
+			}
+			*join_files = mp_decode_bool(&d);
+			break;
+		default:
+			mp_next(&d); /* value */
+		}
+	}
+	return 0;
+}
+
+int
+xrow_encode_join_response(struct xrow_header *row, const struct vclock *vclock,
+			  bool join_files)
+{
+	memset(row, 0, sizeof(*row));
+
+	size_t size = 16 + mp_sizeof_vclock(vclock);
+	char *buf = (char *) region_alloc(&fiber()->gc, size);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, size, "region_alloc", "buf");
+		return -1;
+	}
+	char *data = buf;
+	data = mp_encode_map(data, join_files ? 2 : 1);
+	data = mp_encode_uint(data, IPROTO_VCLOCK);
+	data = mp_encode_vclock(data, vclock);
+	if (join_files) {
+		data = mp_encode_uint(data, IPROTO_JOIN_FILES);
+		data = mp_encode_bool(data, true);
+	}
+	assert(data <= buf + size);
+	row->body[0].iov_base = buf;
+	row->body[0].iov_len = (data - buf);
+	row->bodycnt = 1;
+	row->type = IPROTO_OK;
+	return 0;
+}
+
+int
+xrow_decode_join_response(struct xrow_header *row, struct vclock *vclock,
+			  bool *join_files)
+{
+	*join_files = false;
+	const char *d;
+	uint32_t map_size;
+	if (xrow_decode_replication_body(row, &d, &map_size) != 0)
+		return -1;
+	for (uint32_t i = 0; i < map_size; i++) {
+		if (mp_typeof(*d) != MP_UINT) {
+			mp_next(&d); /* key */
+			mp_next(&d); /* value */
+			continue;
+		}
+		uint8_t key = mp_decode_uint(&d);
+		switch (key) {
+		case IPROTO_VCLOCK:
+			if (mp_decode_vclock(&d, vclock) != 0) {
+				diag_set(ClientError, ER_INVALID_MSGPACK,
+					 "invalid VCLOCK");
+				return -1;
+			}
+			break;
+		case IPROTO_JOIN_FILES:
+			if (mp_typeof(*d) != MP_BOOL) {
+				diag_set(ClientError, ER_INVALID_MSGPACK,
+					 "invalid JOIN_FILES");
+				return -1;
+			}
+			*join_files = mp_decode_bool(&d);
+			break;
+		default:
+			mp_next(&d); /* value */
+		}
+	}
+	return 0;
+}
+
+int
+xrow_encode_file_chunk(struct xrow_header *row,
+		       const struct file_chunk *chunk)
+{
+	memset(row, 0, sizeof(*row));
+
+	size_t size = mp_sizeof_map(3) +
+		      mp_sizeof_uint(IPROTO_FILE_NAME) +
+		      mp_sizeof_str(chunk->name_len) +
+		      mp_sizeof_uint(IPROTO_FILE_SIZE) +
+		      mp_sizeof_uint(chunk->file_size) +
+		      mp_sizeof_uint(IPROTO_FILE_DATA) +
+		      mp_sizeof_binl(chunk->data_len);
+	char *buf = (char *) region_alloc(&fiber()->gc, size);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, size, "region_alloc", "buf");
+		return -1;
+	}
+	char *data = buf;
+	data = mp_encode_map(data, 3);
+	data = mp_encode_uint(data, IPROTO_FILE_NAME);
+	data = mp_encode_str(data, chunk->name, chunk->name_len);
+	data = mp_encode_uint(data, IPROTO_FILE_SIZE);
+	data = mp_encode_uint(data, chunk->file_size);
+	data = mp_encode_uint(data, IPROTO_FILE_DATA);
+	/* The chunk contents follow the header in a separate iovec. */
+	data = mp_encode_binl(data, chunk->data_len);
+	assert(data == buf + size);
+
+	row->body[0].iov_base = buf;
+	row->body[0].iov_len = (data - buf);
+	row->body[1].iov_base = (void *) chunk->data;
+	row->body[1].iov_len = chunk->data_len;
+	row->bodycnt = 2;
+	row->type = IPROTO_FILE_CHUNK;
+	return 0;
+}
+
+int
+xrow_decode_file_chunk(struct xrow_header *row, struct file_chunk *chunk)
+{
+	memset(chunk, 0, sizeof(*chunk));
+	const char *d;
+	uint32_t map_size;
+	if (xrow_decode_replication_body(row, &d, &map_size) != 0)
+		return -1;
+	uint64_t key_map = iproto_key_bit(IPROTO_FILE_NAME) |
+			   iproto_key_bit(IPROTO_FILE_SIZE) |
+			   iproto_key_bit(IPROTO_FILE_DATA);
+	for (uint32_t i = 0; i < map_size; i++) {
+		if (mp_typeof(*d) != MP_UINT) {
+			mp_next(&d); /* key */
+			mp_next(&d); /* value */
+			continue;
+		}
+		uint8_t key = mp_decode_uint(&d);
+		if (key >= IPROTO_KEY_MAX ||
+		    iproto_key_type[key] != mp_typeof(*d)) {
+			mp_next(&d); /* value */
+			continue;
+		}
+		switch (key) {
+		case IPROTO_FILE_NAME:
+			chunk->name = mp_decode_str(&d, &chunk->name_len);
+			break;
+		case IPROTO_FILE_SIZE:
+			chunk->file_size = mp_decode_uint(&d);
+			break;
+		case IPROTO_FILE_DATA:
+			chunk->data = mp_decode_bin(&d, &chunk->data_len);
+			break;
+		default:
+			mp_next(&d); /* value */
+			continue;
+		}
+		key_map &= ~iproto_key_bit(key);
+	}
+	if (key_map != 0) {
+		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
+			 iproto_key_name((enum iproto_key) bit_ctz_u64(key_map)));
+		return -1;
+	}
+	return 0;
+}
+
 int
 xrow_encode_vclock(struct xrow_header *row, const struct vclock *vclock)
 {
@@ -72,6 +72,12 @@ struct xrow_header {
 
 	int bodycnt;
 	uint32_t schema_version;
+	/**
+	 * Stream id of a client request, see IPROTO_STREAM_ID.
+	 * Not encoded, since it only matters to the server
+	 * processing the request.
+	 */
+	uint64_t stream_id;
 	struct iovec body[XROW_BODY_IOVMAX];
 };
 
@@ -153,6 +159,8 @@ struct request {
 	const char *tuple_meta_end;
 	/** Base field offset for UPDATE/UPSERT, e.g. 0 for C and 1 for Lua. */
 	int index_base;
+	/** SELECT: keep the iterator open, see IPROTO_FETCH. */
+	bool is_cursor;
 };
 
 /**
@@ -308,26 +316,96 @@ xrow_decode_subscribe(struct xrow_header *row, struct tt_uuid *replicaset_uuid,
  * Encode JOIN command.
  * @param[out] row Row to encode into.
  * @param instance_uuid.
+ * @param join_files Ask for file-level initial JOIN.
  *
  * @retval  0 Success.
  * @retval -1 Memory error.
  */
 int
-xrow_encode_join(struct xrow_header *row, const struct tt_uuid *instance_uuid);
+xrow_encode_join(struct xrow_header *row, const struct tt_uuid *instance_uuid,
+		 bool join_files);
 
 /**
  * Decode JOIN command.
  * @param row Row to decode.
  * @param[out] instance_uuid.
+ * @param[out] join_files Set if the replica asks for file-level
+ *                        initial JOIN.
  *
  * @retval  0 Success.
  * @retval -1 Memory or format error.
  */
-static inline int
-xrow_decode_join(struct xrow_header *row, struct tt_uuid *instance_uuid)
-{
-	return xrow_decode_subscribe(row, NULL, instance_uuid, NULL, NULL);
-}
+int
+xrow_decode_join(struct xrow_header *row, struct tt_uuid *instance_uuid,
+		 bool *join_files);
+
+/**
+ * Encode a response to JOIN command.
+ * @param[out] row Row to encode into.
+ * @param vclock Vclock of the checkpoint sent to the replica.
+ * @param join_files Set if the checkpoint is sent as files.
+ *
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+int
+xrow_encode_join_response(struct xrow_header *row, const struct vclock *vclock,
+			  bool join_files);
+
+/**
+ * Decode a response to JOIN command.
+ * @param row Row to decode.
+ * @param[out] vclock.
+ * @param[out] join_files Set if the master agreed to send
+ *                        the checkpoint as files.
+ *
+ * @retval  0 Success.
+ * @retval -1 Memory or format error.
+ */
+int
+xrow_decode_join_response(struct xrow_header *row, struct vclock *vclock,
+			  bool *join_files);
+
+/**
+ * A piece of a checkpoint file sent by file-level initial JOIN.
+ */
+struct file_chunk {
+	/**
+	 * File name: engine name followed by the path relative
+	 * to the engine directory, e.g. "vinyl/512/0/1.run".
+	 * Not null-terminated.
+	 */
+	const char *name;
+	uint32_t name_len;
+	/** Total size of the file. */
+	uint64_t file_size;
+	/** Chunk contents. */
+	const char *data;
+	uint32_t data_len;
+};
+
+/**
+ * Encode a file chunk. The chunk data isn't copied.
+ * @param[out] row Row to encode into.
+ * @param chunk Chunk to encode.
+ *
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+int
+xrow_encode_file_chunk(struct xrow_header *row,
+		       const struct file_chunk *chunk);
+
+/**
+ * Decode a file chunk. The decoded chunk points to the row body.
+ * @param row Row to decode.
+ * @param[out] chunk Decoded chunk.
+ *
+ * @retval  0 Success.
+ * @retval -1 Format error.
+ */
+int
+xrow_decode_file_chunk(struct xrow_header *row, struct file_chunk *chunk);
 
 /**
  * Encode end of stream command (a response to JOIN command).
@@ -468,14 +546,16 @@ iproto_reply_error(struct obuf *out, const struct error *e, uint64_t sync,
 
 /** EXECUTE request. */
 struct sql_request {
-	/** SQL statement text. */
+	/** SQL statement text. NULL if @a stmt_id is set. */
 	const char *sql_text;
 	/** MessagePack array of parameters. */
 	const char *bind;
+	/** Id of a prepared statement or 0. */
+	uint32_t stmt_id;
 };
 
 /**
- * Parse the EXECUTE request.
+ * Parse the EXECUTE or PREPARE request.
  * @param row Encoded data.
  * @param[out] request Request to decode to.
  *
@@ -485,6 +565,55 @@ struct sql_request {
 int
 xrow_decode_sql(const struct xrow_header *row, struct sql_request *request);
 
+/** BATCH request. */
+struct batch_request {
+	/**
+	 * MessagePack array of [type, body] pairs, one per
+	 * DML request of the batch.
+	 */
+	const char *requests;
+	/** End of the @a requests array. */
+	const char *requests_end;
+	/** Number of requests in the batch. */
+	uint32_t count;
+	/** True if the batch must be executed in one transaction. */
+	bool is_atomic;
+};
+
+/**
+ * Parse the BATCH request. Bodies of the batched requests are
+ * only checked to be maps, they are decoded one by one when
+ * the batch is executed.
+ * @param row Encoded data.
+ * @param[out] request Request to decode to.
+ *
+ * @retval  0 Sucess.
+ * @retval -1 Format error.
+ */
+int
+xrow_decode_batch(const struct xrow_header *row,
+		  struct batch_request *request);
+
+/** FETCH request. */
+struct fetch_request {
+	/** Id of the cursor to read from. */
+	uint64_t cursor_id;
+	/** Maximal number of tuples to read, 0 to close the cursor. */
+	uint32_t limit;
+};
+
+/**
+ * Parse the FETCH request.
+ * @param row Encoded data.
+ * @param[out] request Request to decode to.
+ *
+ * @retval  0 Sucess.
+ * @retval -1 Format error.
+ */
+int
+xrow_decode_fetch(const struct xrow_header *row,
+		  struct fetch_request *request);
+
 /**
  * Write the SQL header.
  * @param buf Out buffer.
@@ -736,17 +865,53 @@ xrow_decode_subscribe_xc(struct xrow_header *row,
 /** @copydoc xrow_encode_join. */
 static inline void
 xrow_encode_join_xc(struct xrow_header *row,
-		    const struct tt_uuid *instance_uuid)
+		    const struct tt_uuid *instance_uuid, bool join_files)
 {
-	if (xrow_encode_join(row, instance_uuid) != 0)
+	if (xrow_encode_join(row, instance_uuid, join_files) != 0)
 		diag_raise();
 }
 
 /** @copydoc xrow_decode_join. */
 static inline void
-xrow_decode_join_xc(struct xrow_header *row, struct tt_uuid *instance_uuid)
+xrow_decode_join_xc(struct xrow_header *row, struct tt_uuid *instance_uuid,
+		    bool *join_files)
+{
+	if (xrow_decode_join(row, instance_uuid, join_files) != 0)
+		diag_raise();
+}
+
+/** @copydoc xrow_encode_join_response. */
+static inline void
+xrow_encode_join_response_xc(struct xrow_header *row,
+			     const struct vclock *vclock, bool join_files)
+{
+	if (xrow_encode_join_response(row, vclock, join_files) != 0)
+		diag_raise();
+}
+
+/** @copydoc xrow_decode_join_response. */
+static inline void
+xrow_decode_join_response_xc(struct xrow_header *row, struct vclock *vclock,
+			     bool *join_files)
+{
+	if (xrow_decode_join_response(row, vclock, join_files) != 0)
+		diag_raise();
+}
+
+/** @copydoc xrow_encode_file_chunk. */
+static inline void
+xrow_encode_file_chunk_xc(struct xrow_header *row,
+			  const struct file_chunk *chunk)
+{
+	if (xrow_encode_file_chunk(row, chunk) != 0)
+		diag_raise();
+}
+
+/** @copydoc xrow_decode_file_chunk. */
+static inline void
+xrow_decode_file_chunk_xc(struct xrow_header *row, struct file_chunk *chunk)
 {
-	if (xrow_decode_join(row, instance_uuid) != 0)
+	if (xrow_decode_file_chunk(row, chunk) != 0)
 		diag_raise();
 }
 
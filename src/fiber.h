@@ -411,6 +411,11 @@ struct fiber {
 		 */
 		struct {
 			uint64_t sync;
+			/**
+			 * Time the current request has
+			 * waited for WAL, in seconds.
+			 */
+			double wal_wait;
 		} net;
 	} storage;
 	/** An object to wait for incoming message or a reader. */
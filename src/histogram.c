@@ -145,6 +145,20 @@ histogram_percentile(struct histogram *hist, int pct)
 	return hist->max;
 }
 
+int64_t
+histogram_permille(struct histogram *hist, int permille)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < hist->n_buckets; i++) {
+		struct histogram_bucket *bucket = &hist->buckets[i];
+		count += bucket->count;
+		if (count * 1000 > hist->total * permille)
+			return bucket->max;
+	}
+	return hist->max;
+}
+
 int64_t
 histogram_percentile_lower(struct histogram *hist, int pct)
 {
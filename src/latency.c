@@ -95,3 +95,10 @@ latency_get(struct latency *latency, int pct)
 	int64_t value_usec = histogram_percentile(latency->histogram, pct);
 	return (double)value_usec / USEC_PER_SEC;
 }
+
+double
+latency_get_permille(struct latency *latency, int permille)
+{
+	int64_t value_usec = histogram_permille(latency->histogram, permille);
+	return (double)value_usec / USEC_PER_SEC;
+}
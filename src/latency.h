@@ -77,4 +77,11 @@ latency_collect(struct latency *latency, double value);
 double
 latency_get(struct latency *latency, int pct);
 
+/**
+ * Same as latency_get(), but the percentile is given in
+ * thousandths, e.g. 999 stands for the 99.9th percentile.
+ */
+double
+latency_get_permille(struct latency *latency, int permille);
+
 #endif /* TARANTOOL_LATENCY_H_INCLUDED */
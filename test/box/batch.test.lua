@@ -0,0 +1,45 @@
+net_box = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+
+conn = net_box.connect(box.cfg.listen)
+
+-- Results are returned in the order of requests.
+conn:batch({{'insert', 'test', {1, 1}}, {'replace', s.id, {2, 2}}, {'update', 'test', {1}, {{'+', 2, 10}}}, {'upsert', 'test', {3, 3}, {{'+', 2, 1}}}, {'delete', 'test', {2}}})
+s:select{}
+
+-- A failed request of a non-atomic batch doesn't affect others.
+res = conn:batch({{'insert', 'test', {4}}, {'insert', 'test', {1}}, {'replace', 'test', {5}}})
+res[1], res[3]
+res[2].code == box.error.TUPLE_FOUND
+s:select{}
+
+-- An atomic batch is executed in one transaction.
+conn:batch({{'insert', 'test', {6}}, {'insert', 'test', {1}}}, {is_atomic = true})
+s:get{6}
+conn:batch({{'insert', 'test', {6}}, {'insert', 'test', {7}}}, {is_atomic = true})
+conn:batch({}, {is_atomic = true})
+
+-- Only DML requests can be batched.
+ok, err = pcall(conn.batch, conn, {{'select', 'test', {1}}})
+ok, err:match('Unknown batch request select') ~= nil
+
+-- A batch sent to a stream joins its transaction. A failed
+-- atomic batch is rolled back, the transaction stays open.
+v = box.schema.space.create('vtest', {engine = 'vinyl'})
+_ = v:create_index('primary')
+conn:reload_schema()
+stream = conn:new_stream()
+stream:begin()
+stream:batch({{'replace', 'vtest', {1}}, {'insert', 'vtest', {1}}}, {is_atomic = true})
+stream:batch({{'replace', 'vtest', {2}}, {'replace', 'vtest', {3}}}, {is_atomic = true})
+v:select{}
+stream:commit()
+v:select{}
+
+conn:close()
+s:drop()
+v:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,43 @@
+net_box = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+for i = 1, 10 do s:replace{i} end
+
+conn = net_box.connect(box.cfg.listen)
+
+-- Pages are read from the same iterator.
+c = conn.space.test.index.primary:cursor({3}, {iterator = 'GE', offset = 1})
+c:fetch(3)
+c._cursor_id
+c:fetch(3)
+c._is_eof
+c:fetch(3)
+c._is_eof
+c:fetch(3)
+
+-- An exhausted cursor is closed by the server.
+conn:_request('fetch', nil, 1, 1)
+
+-- A cursor can be closed explicitly.
+c = conn.space.test:cursor()
+c:fetch(2)
+id = c._cursor_id
+c:close()
+c:fetch(2)
+conn:_request('fetch', nil, id, 1)
+
+-- An idle cursor expires.
+box.cfg{net_cursor_timeout = 0.1}
+c = conn.space.test:cursor(nil, {iterator = 'LT'})
+c:fetch(1)
+fiber.sleep(0.3)
+c:fetch(1)
+box.cfg{net_cursor_timeout = 0}
+box.cfg{net_cursor_timeout = 60}
+
+conn:close()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,46 @@
+net_box = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'read,write,execute,create', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+conn = net_box.connect(box.cfg.listen)
+
+-- Pipelined requests are matched to their futures by sync.
+futures = {}
+for i = 1, 100 do futures[i] = conn.space.test:insert({i}, {is_async = true}) end
+ok = true
+for i = 100, 1, -1 do local t = futures[i]:wait_result() if t[1] ~= i then ok = false end end
+ok
+s:count()
+
+-- A future nobody waits for is completed too.
+f = conn:call('tostring', {42}, {is_async = true})
+while not f:is_ready() do fiber.sleep(0.001) end
+f:result()
+
+-- Error responses.
+f = conn.space.test:insert({1}, {is_async = true})
+f:wait_result()
+conn:call('error', {'test error'})
+
+-- Pushes and the final response.
+function push() for i = 1, 3 do box.session.push(i) end return 'done' end
+f = conn:call('push', {}, {is_async = true})
+res = {}
+for _, v in f:pairs() do table.insert(res, v) end
+res
+
+-- Schema version in the response header triggers a reload.
+_ = box.schema.space.create('test2')
+conn:ping()
+conn.space.test2 ~= nil
+
+-- Waiters of a closed connection are woken up.
+f = conn:call('fiber.sleep', {10}, {is_async = true})
+_ = fiber.create(function() fiber.sleep(0.01) conn:close() end)
+f:wait_result()
+
+box.space.test2:drop()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute,create', 'universe')
@@ -0,0 +1,56 @@
+net_box = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'execute', 'universe')
+function sleep(t, v) fiber.sleep(t) return v end
+conns = {}
+for i = 1, 3 do conns[i] = net_box.connect(box.cfg.listen) end
+
+-- wait_any() returns the first completed future of the set.
+futures = {}
+for i = 1, 3 do futures[i] = conns[i]:call('sleep', {0.3 / i, i}, {is_async = true}) end
+k, f = net_box.wait_any(futures)
+k, f:result()
+
+-- wait_all() waits for every future of the set.
+net_box.wait_all(futures)
+results = {}
+for i = 1, 3 do results[i] = futures[i]:result()[1] end
+results
+
+-- Timeouts.
+f = conns[1]:call('sleep', {10}, {is_async = true})
+net_box.wait_any({f}, 0.01)
+net_box.wait_all({f, futures[1]}, 0.01)
+f:discard()
+net_box.wait_any({})
+net_box.wait_all({})
+net_box.wait_any(1)
+
+-- Completion callbacks are called from the connection fiber.
+completed = {}
+err = nil
+function on_complete(f) table.insert(completed, {f:result()}) end
+for i = 1, 3 do conns[i]:call('sleep', {0, i}, {is_async = true}):on_complete(on_complete) end
+f = conns[1]:call('error', {'test error'}, {is_async = true})
+f:on_complete(function(f) local _, e = f:result() err = tostring(e) end)
+while #completed < 3 or err == nil do fiber.sleep(0.01) end
+table.sort(completed, function(a, b) return a[1][1] < b[1][1] end)
+completed
+
+-- A finished future calls the callback at once.
+f = conns[1]:call('sleep', {0, 'ready'}, {is_async = true})
+f:wait_result()
+res = nil
+f:on_complete(function(f) res = f:result() end)
+res
+f:on_complete()
+
+-- An error in a callback does not break the connection.
+f = conns[1]:call('sleep', {0}, {is_async = true})
+f:on_complete(function() error('callback error') end)
+f:wait_result()
+conns[1]:ping()
+
+for i = 1, 3 do conns[i]:close() end
+box.schema.user.revoke('guest', 'execute', 'universe')
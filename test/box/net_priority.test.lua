@@ -0,0 +1,86 @@
+net_box = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+
+-- Only binary sessions have a priority class.
+box.session.priority()
+
+conn = net_box.connect(box.cfg.listen)
+conn:eval('return box.session.priority()')
+conn:eval('box.session.priority("low")')
+conn:eval('return box.session.priority()')
+conn:eval('box.session.priority("urgent")')
+conn:eval('return box.session.priority()')
+
+-- The priority may be assigned when a user connects.
+box.schema.user.create('batch', {password = 'batch'})
+box.schema.user.grant('batch', 'read,write,execute', 'universe')
+function on_auth(user) if user == 'batch' then box.session.priority('low') end end
+_ = box.session.on_auth(on_auth)
+batch = net_box.connect('batch:batch@' .. box.cfg.listen)
+batch:eval('return box.session.priority()')
+box.session.on_auth(nil, on_auth)
+
+-- Requests are accounted in the class of the connection.
+conn:eval('box.session.priority("normal")')
+box.stat.reset()
+for i = 1, 10 do batch.space.test:replace{i} end
+for i = 1, 5 do conn.space.test:select{i} end
+stat = box.stat.net().PRIORITY
+stat.low.total >= 10
+stat.normal.total >= 5
+stat.high.total
+stat.low.latency >= stat.low.wait
+stat.low.queue
+
+-- Requests of all classes are served when tx is loaded.
+done = 0
+function load(c) for i = 1, 20 do c:call('fiber.sleep', {0.001}) end done = done + 1 end
+for i = 1, 5 do fiber.create(load, batch) fiber.create(load, conn) end
+while done < 10 do fiber.sleep(0.01) end
+box.stat.net.PRIORITY.low.in_flight
+
+-- A request of a high priority overtakes the queued requests
+-- of a low priority. The calls spin without yielding, so they
+-- occupy the tx window until they complete.
+box.cfg{net_msg_max = 20}
+clock = require('clock')
+order = {}
+function spin(class) local t = clock.monotonic() + 0.01 while clock.monotonic() < t do end table.insert(order, class) end
+conn:eval('box.session.priority("high")')
+futures = {}
+for i = 1, 15 do table.insert(futures, batch:call('spin', {'low'}, {is_async = true})) end
+while box.stat.net.PRIORITY.low.queue == 0 do fiber.sleep(0.001) end
+high = conn:call('spin', {'high'}, {is_async = true})
+_ = high:wait_result()
+for _, f in ipairs(futures) do f:wait_result() end
+#order
+pos = nil
+for i, class in ipairs(order) do if class == 'high' then pos = i end end
+pos < 10
+-- Requests queued in a stream behind a long call don't hold
+-- the tx window, so other connections are served meanwhile.
+test_run = require('test_run').new()
+cond = fiber.cond()
+function block() cond:wait() end
+stream_conn = net_box.connect(box.cfg.listen)
+stream = stream_conn:new_stream()
+blocked = stream:call('block', {}, {is_async = true})
+futures = {}
+for i = 1, 10 do table.insert(futures, stream:call('tostring', {i}, {is_async = true})) end
+test_run:wait_cond(function() return box.stat.net.PRIORITY.normal.in_flight == 11 end, 10)
+conn:call('tostring', {1}, {timeout = 10})
+cond:signal()
+_ = blocked:wait_result()
+for _, f in ipairs(futures) do f:wait_result() end
+stream_conn:close()
+box.cfg{net_msg_max = 768}
+
+batch:close()
+conn:close()
+box.schema.user.drop('batch')
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
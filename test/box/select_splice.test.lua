@@ -0,0 +1,28 @@
+net_box = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+-- Mix small tuples, which are copied to the output buffer, and
+-- large ones, which are written from the tuple memory.
+for i = 1, 20 do s:replace{i, string.rep(string.char(64 + i), i % 3 == 0 and 20000 or 10)} end
+
+conn = net_box.connect(box.cfg.listen)
+
+function equal(a, b) if #a ~= #b then return false end for i = 1, #a do if a[i][1] ~= b[i][1] or a[i][2] ~= b[i][2] then return false end end return true end
+equal(conn.space.test:select{}, s:select{})
+equal(conn.space.test:select({}, {iterator = 'GE', offset = 2, limit = 5}), s:select({}, {iterator = 'GE', offset = 2, limit = 5}))
+#conn.space.test:get{3}[2]
+
+-- Replies of concurrent requests are not mixed up.
+ok = true
+done = 0
+function check() for i = 1, 10 do if not equal(conn.space.test:select{}, s:select{}) then ok = false end end done = done + 1 end
+for i = 1, 10 do fiber.create(check) end
+while done < 10 do fiber.sleep(0.01) end
+ok
+
+conn:close()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
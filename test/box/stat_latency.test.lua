@@ -0,0 +1,51 @@
+net_box = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+function slow() require('fiber').sleep(0.01) end
+
+conn = net_box.connect(box.cfg.listen)
+box.stat.reset()
+box.stat.latency()
+
+for i = 1, 10 do conn.space.test:replace{i} end
+for i = 1, 5 do conn.space.test:select{i} end
+for i = 1, 3 do conn:call('slow') end
+stat = box.stat.latency()
+stat.REPLACE.count
+stat.SELECT.count
+stat.CALL.count
+stat.functions.slow.count
+-- Each stage has its own histogram.
+t = {} for k in pairs(stat.REPLACE) do table.insert(t, k) end table.sort(t) t
+t = {} for k in pairs(stat.REPLACE.tx) do table.insert(t, k) end table.sort(t) t
+stat.functions.slow.tx.p50 >= 0.01
+stat.REPLACE.wal.p99 <= stat.REPLACE.tx.p99
+stat.SELECT.wal.p999
+
+-- Statistics are reset along with the others.
+box.stat.reset()
+box.stat.latency()
+
+-- A call in progress is accounted after a reset.
+fiber = require('fiber')
+cond = fiber.cond()
+started = false
+function wait() started = true cond:wait() end
+future = conn:call('wait', {}, {is_async = true})
+while not started do fiber.sleep(0.001) end
+box.stat.reset()
+cond:signal()
+_ = future:wait_result()
+box.stat.latency().functions.wait.count
+box.stat.latency().functions.slow
+
+-- Names that don't resolve to a function get no histogram.
+for i = 1, 3 do pcall(conn.call, conn, 'bogus' .. i) end
+box.stat.latency().CALL.count
+t = {} for k in pairs(box.stat.latency().functions) do table.insert(t, k) end table.sort(t) t
+
+conn:close()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
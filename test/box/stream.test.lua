@@ -0,0 +1,79 @@
+net_box = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+-- Vinyl transactions survive yields between requests.
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('primary')
+
+conn = net_box.connect(box.cfg.listen)
+stream = conn:new_stream()
+stream2 = conn:new_stream()
+stream._stream_id ~= stream2._stream_id
+stream:ping()
+
+-- Transaction control requests are allowed only in a stream.
+conn:_request('begin', nil)
+conn:_request('commit', nil)
+
+-- Changes are visible only inside the stream until commit.
+stream:begin()
+stream.space.test:replace({1})
+stream.space.test:select{}
+stream2.space.test:select{}
+conn.space.test:select{}
+stream:commit()
+conn.space.test:select{}
+
+stream:begin()
+stream.space.test:replace({2})
+stream.space.test:delete({1})
+stream:rollback()
+conn.space.test:select{}
+
+stream:begin()
+stream:begin()
+stream:rollback()
+
+-- Calls and evals join the transaction of the stream.
+stream:begin()
+stream:call('box.space.test:replace', {{3}})
+stream:eval('box.space.test:replace({4})')
+s:select{}
+stream:commit()
+s:select{}
+
+-- Requests of a stream are pipelined.
+stream:begin({is_async = true}):discard()
+f = stream.space.test:replace({5}, {is_async = true})
+stream:commit({is_async = true}):wait_result()
+f:result()
+s:get{5}
+
+-- A memtx transaction can't wait for the next request, so it
+-- is aborted as soon as the stream runs out of requests, and
+-- the following requests fail until the transaction ends.
+m = box.schema.space.create('memtx_test')
+_ = m:create_index('primary')
+stream:begin()
+stream.space.memtx_test:replace({1})
+stream.space.memtx_test:replace({2})
+stream:ping()
+stream:commit()
+m:select{}
+stream:begin()
+stream.space.memtx_test:replace({1})
+stream.space.memtx_test:select{}
+stream:rollback()
+stream:begin()
+stream:rollback()
+m:select{}
+m:drop()
+
+-- An unfinished transaction is rolled back on disconnect.
+stream:begin()
+stream.space.test:replace({6})
+conn:close()
+s:get{6}
+
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,45 @@
+env = require('test_run')
+test_run = env.new()
+engine = test_run:get_cfg('engine')
+
+--
+-- File-level initial join: the master sends the files of
+-- the last checkpoint instead of rows.
+--
+box.schema.user.grant('guest', 'replication')
+s = box.schema.space.create('test', {engine = engine})
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'unsigned'}})
+for i = 1, 100 do s:insert{i, i * 10} end
+box.snapshot()
+-- Rows written after the checkpoint are sent by final join.
+for i = 101, 200 do s:insert{i, i * 10} end
+
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica_join_files.lua'")
+test_run:cmd("start server replica")
+test_run:cmd("switch replica")
+box.cfg.replication_join_files
+box.space.test:count()
+box.space.test.index.sk:get(2000)
+box.info.replication[1].upstream.status
+
+test_run:cmd("switch default")
+for i = 201, 300 do s:insert{i, i * 10} end
+vclock = test_run:get_vclock('default')
+_ = test_run:wait_vclock('replica', vclock)
+test_run:cmd("switch replica")
+box.space.test:count()
+
+-- The received files are adopted by the replica, so it
+-- must be able to restart from them.
+test_run:cmd("restart server replica")
+box.space.test:count()
+box.space.test.index.sk:get(3000)
+
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+test_run:cmd("delete server replica")
+test_run:cleanup_cluster()
+box.schema.user.revoke('guest', 'replication')
+s:drop()
@@ -0,0 +1,43 @@
+test_run = require('test_run').new()
+fio = require('fio')
+
+--
+-- Check that a relay uses the index of the WAL file being
+-- written to skip rows a replica already has and still sends
+-- all rows it doesn't have.
+--
+box.schema.user.grant('guest', 'replication')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+pad = string.rep('x', 1024)
+
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+
+for i = 1, 2000 do s:replace{i, pad} end
+test_run:wait_lsn('replica', 'default')
+test_run:cmd("stop server replica")
+
+-- The index is appended to as the WAL grows.
+function index_size() local files = fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog.index')) return fio.stat(files[#files]).size end
+size = index_size()
+for i = 2001, 4000 do s:replace{i, pad} end
+index_size() > size
+
+-- The relay doesn't read the rows the replica already has.
+errinj = box.error.injection
+errinj.set('ERRINJ_XLOG_INDEX_SKIP', 0)
+test_run:cmd("start server replica")
+test_run:wait_lsn('replica', 'default')
+errinj.info()['ERRINJ_XLOG_INDEX_SKIP'].state > 1000000
+test_run:cmd("switch replica")
+box.space.test:count()
+box.space.test:get(2000)[1]
+box.space.test:get(2001)[1]
+test_run:cmd("switch default")
+
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+test_run:cmd("delete server replica")
+s:drop()
+box.schema.user.revoke('guest', 'replication')
@@ -52,6 +52,7 @@ testprefix = "whereF"
 test:do_execsql_test(
     1.0,
     [[
+        PRAGMA automatic_index = 0;
         CREATE TABLE t1(a INT PRIMARY KEY, b INT, c INT);
         CREATE TABLE t2(d INT PRIMARY KEY, e INT, f INT);
     ]], {
@@ -0,0 +1,25 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- With sql_auto_analyze enabled statistics of a space are
+-- collected in background once it has been changed enough.
+--
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, a INT)")
+box.sql.execute("CREATE INDEX ta ON t(a)")
+box.cfg{sql_auto_analyze = true}
+box.begin() for i = 1, 2000 do box.space.T:insert{i, i % 10} end box.commit()
+test_run:wait_cond(function() return box.space._sql_stat1:get{'T', 'TA'} ~= nil end)
+box.space._sql_stat1:select{'T'}
+box.space._sql_stat4.index[0]:count{'T', 'TA'}
+box.sql.execute("SELECT count(*) FROM t WHERE a = 1")
+
+-- Statistics follow the data.
+box.begin() for i = 1, 2000 do box.space.T:replace{i, i} end box.commit()
+test_run:wait_cond(function() return box.space._sql_stat1:get{'T', 'TA'}[3] == '2000 1' end)
+box.space._sql_stat1:select{'T'}
+box.sql.execute("SELECT count(*) FROM t WHERE a = 1")
+
+box.cfg{sql_auto_analyze = false}
+box.sql.execute("DROP TABLE t")
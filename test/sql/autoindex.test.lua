@@ -0,0 +1,45 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- An equi-join on columns without an index is executed with
+-- an automatic index built on the fly on the inner table.
+--
+box.sql.execute("CREATE TABLE t1(id INT PRIMARY KEY, a INT, s TEXT)")
+box.sql.execute("CREATE TABLE t2(id INT PRIMARY KEY, b INT, t TEXT)")
+box.sql.execute("INSERT INTO t1 VALUES (1, 1, 'a'), (2, 2, 'b'), (3, 2, 'c'), (4, NULL, 'd'), (5, 5, 'e')")
+box.sql.execute("INSERT INTO t2 VALUES (1, 2, 'x'), (2, 1, 'y'), (3, 2, 'z'), (4, NULL, 'w'), (5, 3, 'v')")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT s, t FROM t1, t2 WHERE a = b")
+-- Duplicate keys on both sides, NULLs never match.
+box.sql.execute("SELECT t1.id, t2.id, s, t FROM t1, t2 WHERE a = b ORDER BY t1.id, t2.id")
+box.sql.execute("SELECT t1.id, t2.id FROM t1 LEFT JOIN t2 ON a = b ORDER BY t1.id, t2.id")
+-- Other conditions are checked against each matching row.
+box.sql.execute("SELECT t1.id, t2.id FROM t1, t2 WHERE a = b AND t > 'x' ORDER BY t1.id, t2.id")
+box.sql.execute("SELECT t1.id, t2.id FROM t1, t2 WHERE a = b AND t1.id = t2.id ORDER BY t1.id")
+-- The automatic index can be disabled.
+box.sql.execute("PRAGMA automatic_index = 0")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT s, t FROM t1, t2 WHERE a = b")
+box.sql.execute("SELECT t1.id, t2.id FROM t1, t2 WHERE a = b ORDER BY t1.id, t2.id")
+box.sql.execute("PRAGMA automatic_index = 1")
+-- The automatic index is bounded. A bigger table is joined
+-- with a nested loop.
+box.sql.execute("PRAGMA sql_automatic_index_limit")
+box.sql.execute("PRAGMA sql_automatic_index_limit = 4")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT s, t FROM t1, t2 WHERE a = b")
+box.sql.execute("SELECT t1.id, t2.id FROM t1, t2 WHERE a = b ORDER BY t1.id, t2.id")
+-- A table which has outgrown the limit since the statement
+-- was compiled is joined with a nested loop too.
+box.sql.execute("PRAGMA sql_automatic_index_limit = 5")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT s, t FROM t1, t2 WHERE a = b")
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+cn = require('net.box').connect(box.cfg.listen)
+stmt = cn:prepare("SELECT t1.id, t2.id FROM t1, t2 WHERE a = b ORDER BY t1.id, t2.id")
+cn:execute(stmt.stmt_id).rows
+box.sql.execute("INSERT INTO t2 VALUES (6, 5, 'u'), (7, 2, 't')")
+cn:execute(stmt.stmt_id).rows
+cn:close()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
+box.sql.execute("PRAGMA sql_automatic_index_limit = 100000")
+box.sql.execute("DROP TABLE t1")
+box.sql.execute("DROP TABLE t2")
@@ -0,0 +1,55 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- Simple aggregates of a full scan are computed by the cursor,
+-- without the VDBE loop.
+--
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, a INT, b REAL, s TEXT)")
+box.sql.execute("INSERT INTO t VALUES (1, 1, 0.5, 'a'), (2, 2, 1.5, 'b'), (3, NULL, NULL, 'a'), (4, 5, 2.0, 'c')")
+test_run:cmd("setopt delimiter ';'")
+function cursor_aggregates(sql)
+    local n = 0
+    for _, row in ipairs(box.sql.execute("EXPLAIN " .. sql)) do
+        if row[2] == 'CursorAggregate' then
+            n = n + 1
+        end
+    end
+    return n
+end;
+test_run:cmd("setopt delimiter ''");
+cursor_aggregates("SELECT count(*), count(a), sum(a), min(a), max(a) FROM t")
+cursor_aggregates("SELECT count(a), max(b) FROM t WHERE s = 'a'")
+cursor_aggregates("SELECT max(id) FROM t")
+cursor_aggregates("SELECT sum(a) FROM t WHERE id > 1")
+cursor_aggregates("SELECT sum(a) FROM t GROUP BY s")
+cursor_aggregates("SELECT count(DISTINCT a) FROM t")
+cursor_aggregates("SELECT sum(a) + 1 FROM t")
+cursor_aggregates("SELECT max(s) FROM t")
+box.sql.execute("SELECT count(*), count(a), sum(a), min(a), max(a) FROM t")
+box.sql.execute("SELECT sum(b), total(b), avg(b) FROM t WHERE a > 1")
+box.sql.execute("SELECT count(*), sum(a) FROM t WHERE s = 'a'")
+box.sql.execute("SELECT count(*), sum(a), total(a), avg(a), min(a) FROM t WHERE a > 10")
+box.sql.execute("INSERT INTO t VALUES (5, 9223372036854775807, NULL, NULL)")
+box.sql.execute("SELECT sum(a) FROM t")
+box.sql.execute("SELECT total(a) > 0 FROM t")
+box.sql.execute("DROP TABLE t")
+
+-- Large spaces are scanned in several threads.
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, a INT)")
+box.begin() for i = 1, 100000 do box.space.T:insert{i, i % 100} end box.commit()
+box.sql.execute("SELECT count(*), count(a), sum(a), min(a), max(a) FROM t WHERE a >= 50")
+box.sql.execute("SELECT count(*), sum(a) FROM t WHERE a < 50 AND a > 48")
+-- The threads are taken from the worker pool, their number is
+-- set by sql_aggregate_threads.
+box.cfg{sql_aggregate_threads = 0}
+box.cfg{sql_aggregate_threads = 9}
+box.cfg{sql_aggregate_threads = 1}
+box.sql.execute("SELECT count(*), sum(a) FROM t WHERE a < 50 AND a > 48")
+box.cfg{sql_aggregate_threads = 8}
+res = {} for i = 1, 20 do res[i] = box.sql.execute("SELECT count(*), sum(a) FROM t WHERE a >= 50")[1] end
+ok = true for i = 1, 20 do if res[i][1] ~= 50000 or res[i][2] ~= 3725000 then ok = false end end
+ok
+box.cfg{sql_aggregate_threads = 4}
+box.sql.execute("DROP TABLE t")
@@ -0,0 +1,39 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- Comparisons of columns with constants are checked by the
+-- cursor of a full scan, before tuples get to the VDBE.
+--
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, a INT, s TEXT, c TEXT COLLATE \"unicode_ci\")")
+box.sql.execute("INSERT INTO t VALUES (1, 1, 'a', 'a'), (2, 2, 'b', 'B'), (3, NULL, NULL, NULL), (4, -5, 'ab', 'b')")
+test_run:cmd("setopt delimiter ';'")
+function cursor_filters(sql)
+    local n = 0
+    for _, row in ipairs(box.sql.execute("EXPLAIN " .. sql)) do
+        if row[2] == 'CursorFilter' then
+            n = n + 1
+        end
+    end
+    return n
+end;
+test_run:cmd("setopt delimiter ''");
+cursor_filters("SELECT id FROM t WHERE a = 2")
+cursor_filters("SELECT id FROM t WHERE 2 = a")
+cursor_filters("SELECT id FROM t WHERE a > -10 AND s >= 'ab'")
+cursor_filters("SELECT id FROM t WHERE c = 'b'")
+cursor_filters("SELECT id FROM t WHERE a + 1 = 2")
+cursor_filters("SELECT id FROM t WHERE a = '2'")
+box.sql.execute("SELECT id FROM t WHERE a = 2")
+box.sql.execute("SELECT id FROM t WHERE 2 = a")
+box.sql.execute("SELECT id FROM t WHERE a > -10 AND s >= 'ab'")
+box.sql.execute("SELECT id FROM t WHERE a <= 1")
+box.sql.execute("SELECT id FROM t WHERE c = 'b'")
+box.sql.execute("SELECT id FROM t WHERE a BETWEEN 0 AND 1 OR s = 'ab'")
+-- Conditions of an outer join are not pushed down.
+box.sql.execute("SELECT t1.id, t2.id FROM t t1 LEFT JOIN t t2 ON t1.a = 1 AND t2.a = 2")
+box.sql.execute("UPDATE t SET a = a + 10 WHERE a < 2")
+box.sql.execute("SELECT id, a FROM t")
+
+box.sql.execute("DROP TABLE t")
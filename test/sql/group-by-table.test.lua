@@ -0,0 +1,23 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- GROUP BY with few groups, according to statistics,
+-- aggregates rows as they come instead of sorting them.
+--
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, g INT, v INT)")
+box.sql.execute("CREATE INDEX tg ON t(g)")
+box.sql.execute("WITH RECURSIVE cnt(x) AS (VALUES(1) UNION ALL SELECT x+1 FROM cnt WHERE x<100) INSERT INTO t SELECT x, x%4, x FROM cnt")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT g, count(*), sum(v) FROM t NOT INDEXED GROUP BY g")
+box.sql.execute("ANALYZE")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT g, count(*), sum(v) FROM t NOT INDEXED GROUP BY g")
+box.sql.execute("SELECT g, count(*), sum(v) FROM t NOT INDEXED GROUP BY g")
+box.sql.execute("SELECT g, max(v) FROM t NOT INDEXED GROUP BY g HAVING max(v) > 97 LIMIT 2")
+box.sql.execute("UPDATE t SET g = NULL WHERE id > 96")
+box.sql.execute("SELECT g, count(*), sum(v) FROM t NOT INDEXED GROUP BY g")
+box.sql.execute("EXPLAIN QUERY PLAN SELECT DISTINCT g FROM t NOT INDEXED ORDER BY g")
+box.sql.execute("SELECT DISTINCT g FROM t NOT INDEXED ORDER BY g")
+-- DISTINCT aggregates need a set per group, so rows are sorted.
+box.sql.execute("EXPLAIN QUERY PLAN SELECT g, count(DISTINCT v) FROM t NOT INDEXED GROUP BY g")
+box.sql.execute("DROP TABLE t")
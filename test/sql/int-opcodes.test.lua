@@ -0,0 +1,37 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- Comparisons and arithmetic over integer columns and literals
+-- use opcodes specialized for integers.
+--
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, a INT, b INT, r FLOAT, s TEXT)")
+box.sql.execute("INSERT INTO t VALUES (1, 1, 2, 1.5, '1'), (2, 5, 3, 2.5, '5'), (3, NULL, 3, NULL, NULL), (4, 9223372036854775807, 1, 0.5, 'x')")
+int_ops = {EqInt = true, NeInt = true, LtInt = true, LeInt = true, GtInt = true, GeInt = true, AddInt = true, SubtractInt = true, MultiplyInt = true}
+test_run:cmd("setopt delimiter ';'")
+function int_opcodes(sql)
+    local res = {}
+    for _, row in ipairs(box.sql.execute("EXPLAIN " .. sql)) do
+        if int_ops[row[2]] then
+            table.insert(res, row[2])
+        end
+    end
+    return res
+end;
+test_run:cmd("setopt delimiter ''");
+int_opcodes("SELECT id FROM t WHERE a < b")
+int_opcodes("SELECT id FROM t WHERE a + b * 2 >= 7")
+int_opcodes("SELECT a - b FROM t")
+int_opcodes("SELECT id FROM t WHERE r < b")
+int_opcodes("SELECT id FROM t WHERE s = a")
+int_opcodes("SELECT a = b FROM t")
+box.sql.execute("SELECT id FROM t WHERE a < b")
+box.sql.execute("SELECT id FROM t WHERE a != 5")
+box.sql.execute("SELECT id FROM t WHERE a IS NOT 5")
+box.sql.execute("SELECT id, a - b, b * 2 FROM t WHERE id < 4")
+-- Integer overflow falls back to the generic opcodes.
+box.sql.execute("SELECT id, a + b FROM t WHERE a + b > 3")
+box.sql.execute("SELECT id, a * b FROM t")
+
+box.sql.execute("DROP TABLE t")
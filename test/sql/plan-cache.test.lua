@@ -0,0 +1,59 @@
+remote = require('net.box')
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+box.sql.execute('create table test (id int primary key, a int, b text)')
+box.schema.user.grant('guest','read,write,execute', 'universe')
+cn = remote.connect(box.cfg.listen)
+
+--
+-- With sql_plan_cache statements which differ only in literals
+-- share a compiled program.
+--
+box.cfg{sql_plan_cache = true}
+cn:execute("insert into test values (1, 10, 'a')")
+size = box.stat.sql().cache.size
+hit, miss = box.stat.sql().cache.hit, box.stat.sql().cache.miss
+cn:execute("insert into test values (2, 20, 'b''c')")
+cn:execute("insert into test  values (3, 30, 'd') -- comment")
+box.stat.sql().cache.size - size
+box.stat.sql().cache.hit - hit
+box.stat.sql().cache.miss - miss
+cn:execute("select b from test where id = 2").rows[1][1] == "b'c"
+cn:execute("select a, b from test where id = 3")
+cn:execute("select a, b from test where b = 'a' and a > 1.5")
+box.stat.sql().cache.size - size
+-- Column numbers in ORDER BY are not replaced.
+cn:execute("select id from test order by 1 desc")
+cn:execute("select id from test where a < 100 group by 1 limit 2")
+-- A program compiled before a schema change is recompiled.
+box.sql.execute('create index i on test(a)')
+cn:execute("select id from test where a = 20")
+cn:execute("select id from test where a = 30")
+-- Errors.
+cn:execute("select id from test where a = 9223372036854775808")
+cn:execute("select id from not_existing where a = 1")
+-- A text which fails to compile is compiled again only after
+-- a schema change.
+size = box.stat.sql().cache.size
+cn:execute("select id from not_existing where a = 2")
+box.sql.execute('create table not_existing (id int primary key, a int)')
+cn:execute("select id from not_existing where a = 3")
+box.stat.sql().cache.size - size
+box.sql.execute('drop table not_existing')
+
+-- Statements of the plan cache don't evict statements prepared
+-- by clients.
+sel = cn:prepare("select a from test where id = ?")
+for i = 1, 1100 do cn:execute("select a as c" .. i .. " from test where id = 1") end
+cn:prepare("select a from test where id = ?").stmt_id == sel.stmt_id
+cn:execute(sel.stmt_id, {1}).rows
+
+box.cfg{sql_plan_cache = false}
+size = box.stat.sql().cache.size
+cn:execute("select id from test where a = 10 and b = 'a'")
+box.stat.sql().cache.size - size
+
+cn:close()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
+box.sql.execute('drop table test')
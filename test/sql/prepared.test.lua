@@ -0,0 +1,37 @@
+remote = require('net.box')
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+box.sql.execute('create table test (id int primary key, a int)')
+box.schema.user.grant('guest','read,write,execute', 'universe')
+cn = remote.connect(box.cfg.listen)
+box.stat.reset()
+
+ins = cn:prepare('insert into test values (?, ?)')
+type(ins.stmt_id)
+sel = cn:prepare('select * from test where id = ?')
+-- The same statement is compiled only once.
+cn:prepare('insert into test values (?, ?)').stmt_id == ins.stmt_id
+cn:execute(ins.stmt_id, {1, 10})
+cn:execute(sel.stmt_id, {1})
+hit, miss = box.stat.sql().cache.hit, box.stat.sql().cache.miss
+cn:execute(ins.stmt_id, {2, 20})
+cn:execute(sel.stmt_id, {2})
+box.stat.sql().cache.hit - hit
+box.stat.sql().cache.miss - miss
+box.stat.PREPARE.total
+
+-- A statement is recompiled after schema change.
+box.sql.execute('create index i on test(a)')
+cn:execute(sel.stmt_id, {1})
+box.stat.sql().cache.hit - hit
+box.stat.sql().cache.miss - miss
+
+-- Errors.
+cn:execute(0xFFFFFFF, {})
+cn:prepare('select * from not_existing')
+box.sql.execute('drop table test')
+cn:execute(sel.stmt_id, {1})
+
+cn:close()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,94 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+
+--
+-- box.sql.profile() executes a statement and returns how many
+-- times each instruction and each table loop was run.
+--
+box.sql.execute("CREATE TABLE t1(id INT PRIMARY KEY, a INT)")
+box.sql.execute("CREATE TABLE t2(id INT PRIMARY KEY, b INT)")
+box.sql.execute("INSERT INTO t1 VALUES (1, 10), (2, 20), (3, 30)")
+box.sql.execute("INSERT INTO t2 VALUES (1, 100), (3, 300)")
+test_run:cmd("setopt delimiter ';'")
+function executions(profile, opcode)
+    local n = 0
+    for _, row in ipairs(profile.opcodes) do
+        if row[2] == opcode then
+            n = n + row[6]
+        end
+    end
+    return n
+end;
+function total_time(profile)
+    local t = 0
+    for _, row in ipairs(profile.opcodes) do
+        t = t + row[7]
+    end
+    return t
+end;
+function loops(profile)
+    local res = {}
+    for _, row in ipairs(profile.loops) do
+        table.insert(res, {row[2], row[4], row[5]})
+    end
+    return res
+end;
+function columns(profile)
+    local res = {}
+    for _, row in ipairs(profile.opcodes) do
+        if row[2] == 'Column' then
+            table.insert(res, {row[6], row[7] > 0})
+        end
+    end
+    return res
+end;
+test_run:cmd("setopt delimiter ''");
+
+p = box.sql.profile("SELECT a FROM t1")
+p.opcodes[0]
+p.loops[0]
+p.rows
+executions(p, 'Init')
+executions(p, 'ResultRow')
+executions(p, 'Next')
+total_time(p) > 0
+loops(p)
+
+-- Each column read is accounted to its own instruction, even
+-- when a run of them reads one row.
+p = box.sql.profile("SELECT id, a FROM t1")
+p.rows
+executions(p, 'Column')
+columns(p)
+
+-- Loops of a join: the inner loop is started once per row of
+-- the outer one.
+p = box.sql.profile("SELECT t1.a, t2.b FROM t1 CROSS JOIN t2 WHERE t1.id = t2.id")
+p.rows
+executions(p, 'ResultRow')
+loops(p)
+
+-- Statements without a result set are profiled too.
+p = box.sql.profile("UPDATE t1 SET a = a + 1 WHERE id > 1")
+p.rows
+loops(p)
+box.sql.execute("SELECT * FROM t1")
+p = box.sql.profile("INSERT INTO t2 VALUES (2, 200)")
+p.rows
+#p.loops
+box.sql.execute("SELECT * FROM t2")
+
+-- Errors are raised as by box.sql.execute().
+box.sql.profile("SELECT * FROM t3")
+box.sql.profile("INSERT INTO t2 VALUES (2, 200)")
+-- An error in a trigger program is raised too.
+box.sql.execute("CREATE TRIGGER t1t AFTER INSERT ON t1 BEGIN INSERT INTO t2 VALUES (1, 1); END;")
+box.sql.profile("INSERT INTO t1 VALUES (4, 40)")
+box.sql.execute("DROP TRIGGER t1t")
+
+-- Profiling does not affect later executions.
+box.sql.execute("SELECT count(*) FROM t1 CROSS JOIN t2 WHERE t1.id = t2.id")
+
+box.sql.execute("DROP TABLE t1")
+box.sql.execute("DROP TABLE t2")
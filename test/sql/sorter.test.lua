@@ -0,0 +1,62 @@
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
+fiber = require('fiber')
+
+--
+-- Large sorts are done in the worker thread pool, so that
+-- other fibers run while the sort is in progress.
+--
+box.sql.execute("CREATE TABLE t(id INT PRIMARY KEY, x INT, s TEXT)")
+box.begin() for i = 1, 20000 do box.space.T:insert{i, i * 7919 % 20011, tostring(i)} end box.commit()
+ticks = 0
+ticker = fiber.create(function() while true do ticks = ticks + 1 fiber.sleep(0) end end)
+ticks_before = ticks rows = box.sql.execute("SELECT x, s FROM t ORDER BY x, s") ticks_after = ticks
+ticks_after > ticks_before
+#rows
+ok = true for i = 2, #rows do if rows[i - 1][1] > rows[i][1] then ok = false end end
+ok
+rows[1]
+rows[20000]
+-- A sort inside a transaction must not yield.
+box.begin() box.space.T:replace{1, 1, '1'} rows = box.sql.execute("SELECT x FROM t ORDER BY x") box.commit()
+rows[1]
+ticker:cancel()
+
+--
+-- sql_sorter_memory limits the memory a sort takes before it
+-- spills to temporary files.
+--
+box.cfg{sql_sorter_memory = 0}
+box.cfg{sql_sorter_memory = 64 * 1024}
+rows = box.sql.execute("SELECT x, s FROM t ORDER BY s DESC")
+#rows
+rows[1]
+rows[20000]
+box.cfg{sql_sorter_memory = 2 * 1024 * 1024}
+
+box.sql.execute("DROP TABLE t")
+
+--
+-- A sort yields only when the scan is over and the cursors on
+-- spaces are closed, so DML and DDL done meanwhile do not touch
+-- the result.
+--
+box.sql.execute("pragma sql_default_engine='memtx'")
+box.sql.execute("CREATE TABLE t2(id INT PRIMARY KEY, x INT, s TEXT)")
+box.sql.execute("CREATE INDEX t2x ON t2(x)")
+box.begin() for i = 1, 20000 do box.space.T2:insert{i, i * 7919 % 20011, tostring(i)} end box.commit()
+rows = nil
+f = fiber.create(function() rows = box.sql.execute("SELECT id, s FROM t2 WHERE x > 0 ORDER BY s") end)
+rows == nil
+box.space.T2:replace{1, 1, 'a'} box.space.T2:delete{2}
+box.sql.execute("DROP INDEX t2x ON t2")
+box.sql.execute("DROP TABLE t2")
+while rows == nil do fiber.sleep(0.01) end
+#rows
+ok = true for i = 2, #rows do if rows[i - 1][2] > rows[i][2] then ok = false end end
+ok
+rows[1]
+rows[2]
+rows[20000]
+box.sql.execute('pragma sql_default_engine=\''..engine..'\'')
@@ -166,6 +166,7 @@ test_percentile(void)
 		fail_if(result != expected);
 		int64_t result_lo = histogram_percentile_lower(hist, pct);
 		fail_if(result_lo != expected_lo);
+		fail_if(histogram_permille(hist, pct * 10) != expected);
 	}
 
 	histogram_delete(hist);
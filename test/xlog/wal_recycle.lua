@@ -0,0 +1,10 @@
+#!/usr/bin/env tarantool
+
+box.cfg {
+    listen = os.getenv("LISTEN"),
+    wal_mode = 'fsync',
+    rows_per_wal = 10,
+    checkpoint_count = 1,
+}
+
+require('console').listen(os.getenv('ADMIN'))
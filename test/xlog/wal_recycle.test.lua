@@ -0,0 +1,83 @@
+test_run = require('test_run').new()
+
+--
+-- Check that in the fsync mode WAL files deleted by garbage
+-- collection are kept for reuse and that the data written to
+-- recycled files is recovered correctly.
+--
+test_run:cmd('create server test with script = "xlog/wal_recycle.lua"')
+test_run:cmd('start server test')
+test_run:cmd('switch test')
+
+fio = require('fio')
+function recycled() return #fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog.recycled')) end
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 50 do s:replace{i} end
+box.snapshot()
+test_run:wait_cond(function() return recycled() > 0 end, 10)
+recycled() <= 4
+
+-- New WAL files are created from recycled ones.
+for i = 51, 100 do s:replace{i} end
+
+test_run:cmd('restart server test')
+box.space.test:count()
+box.space.test:get(100)
+
+-- Files left unsealed by the restart have their preallocated
+-- zeros cut off, so any WAL can be read to the end.
+fio = require('fio')
+xlog = require('xlog')
+function rows(path) local n = 0 for _ in xlog.pairs(path) do n = n + 1 end return n end
+files = fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog'))
+#files > 0
+ok = true
+for _, f in ipairs(files) do ok = ok and pcall(rows, f) end
+ok
+
+-- Zeros in the middle of a file that isn't being written
+-- are reported as corruption rather than as its end.
+data = fio.open(files[1]):read(fio.stat(files[1]).size)
+first = data:find('\xd5\xba\x0b\xab', 1, true)
+second = data:find('\xd5\xba\x0b\xab', first + 1, true)
+second ~= nil
+broken = fio.pathjoin(fio.tempdir(), 'broken.xlog')
+f = fio.open(broken, {'O_CREAT', 'O_WRONLY'}, tonumber('644', 8))
+f:write(data:sub(1, second - 1) .. string.rep('\0', #data - second + 1))
+f:close()
+(pcall(rows, broken))
+
+-- A recycled file is zeroed entirely, so rows of the log it
+-- was recycled from aren't left past the data written to it,
+-- even if it is larger than the space preallocated at once.
+box.schema.user.grant('guest', 'replication')
+for i = 1, 40 do box.space.test:replace{i, string.rep('x', 200000)} end
+box.snapshot()
+function recycled() return #fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog.recycled')) end
+test_run:wait_cond(function() return recycled() > 0 end, 10)
+for i = 101, 105 do box.space.test:replace{i} end
+test_run:cmd('restart server test')
+for i = 106, 110 do box.space.test:replace{i} end
+fio = require('fio')
+xlog = require('xlog')
+function rows(path) local n = 0 for _ in xlog.pairs(path) do n = n + 1 end return n end
+ok = true
+for _, f in ipairs(fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog'))) do ok = ok and pcall(rows, f) end
+ok
+
+test_run:cmd('switch default')
+-- The recycled file is read to the end by relay.
+test_run:cmd('create server replica with rpl_master=test, script="xlog/replica.lua"')
+test_run:cmd('start server replica')
+test_run:cmd('switch replica')
+test_run:wait_cond(function() return box.space.test:count() == 110 end, 10)
+box.space.test:get(105)
+test_run:cmd('switch default')
+test_run:cmd('stop server replica')
+test_run:cmd('cleanup server replica')
+test_run:cmd('delete server replica')
+test_run:cmd('stop server test')
+test_run:cmd('cleanup server test')
+test_run:cmd('delete server test')